@@ -0,0 +1,112 @@
+#include "bench.h"
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace Physics_Engine;
+
+BenchRandom::BenchRandom(uint64_t seed)
+{
+	BenchRandom::seed(seed);
+}
+
+void BenchRandom::seed(uint64_t seed)
+{
+	// The state must never be zero.
+	state = seed ? seed : 0x9e3779b97f4a7c15ull;
+}
+
+uint64_t BenchRandom::next()
+{
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545f4914f6cdd1dull;
+}
+
+real BenchRandom::randomReal(real min, real max)
+{
+	// The top 53 bits give every double in [0, 1) an equal chance.
+	real unit = (real)(next() >> 11) * ((real)1 / (real)(1ull << 53));
+	return min + (max - min) * unit;
+}
+
+Vector3 BenchRandom::randomVector(const Vector3 &min, const Vector3 &max)
+{
+	return Vector3(
+		randomReal(min.x, max.x),
+		randomReal(min.y, max.y),
+		randomReal(min.z, max.z)
+		);
+}
+
+unsigned BenchRandom::randomInt(unsigned max)
+{
+	return max ? (unsigned)(next() % max) : 0;
+}
+
+size_t Physics_Engine::getPeakMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+#ifdef __APPLE__
+	return (size_t)usage.ru_maxrss;
+#else
+	// Linux gives the peak in kilobytes.
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+bool Physics_Engine::writeResults(const char *filename, const std::vector<BenchResult> &results,
+	const std::vector<KernelResult> &kernelResults)
+{
+	FILE *file = fopen(filename, "w");
+	if (!file)
+		return false;
+
+	fputs("{\n\t\"version\": 1,\n\t\"results\": [\n", file);
+	for (unsigned i = 0; i < results.size(); i++)
+	{
+		const BenchResult &result = results[i];
+
+		// Names are plain identifiers, so they need no escaping.
+		fprintf(file, "\t\t{\"scene\": \"%s\", \"size\": %u, \"frames\": %u, "
+			"\"nsPerStep\": %.1f, \"minNsPerStep\": %.1f, \"maxNsPerStep\": %.1f, "
+			"\"contactsPerStep\": %.2f, \"iterationsPerStep\": %.2f, \"peakMemory\": %llu}%s\n",
+			result.scene.c_str(), result.size, result.frames,
+			result.nsPerStep, result.minNsPerStep, result.maxNsPerStep,
+			result.contactsPerStep, result.iterationsPerStep,
+			(unsigned long long)result.peakMemory,
+			i + 1 < results.size() ? "," : "");
+	}
+	fputs("\t],\n\t\"kernels\": [\n", file);
+	for (unsigned i = 0; i < kernelResults.size(); i++)
+	{
+		const KernelResult &result = kernelResults[i];
+
+		fprintf(file, "\t\t{\"kernel\": \"%s\", \"variant\": \"%s\", \"calls\": %u, "
+			"\"nsPerCall\": %.3f, \"minNsPerCall\": %.3f, \"hitRate\": %.4f, \"speedup\": %.3f}%s\n",
+			result.kernel.c_str(), result.variant.c_str(), result.calls,
+			result.nsPerCall, result.minNsPerCall, result.hitRate, result.speedup,
+			i + 1 < kernelResults.size() ? "," : "");
+	}
+	fputs("\t]\n}\n", file);
+
+	bool written = !ferror(file);
+	fclose(file);
+	return written;
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "../Physics Engine/Math/core.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace Physics_Engine
+{
+	/*
+		A small random number generator (xorshift64*) for building the
+		benchmark scenes. Unlike Random, which seeds itself from the
+		time, it always gives the same numbers for the same seed, so
+		every run of the benchmark simulates the same scenes.
+	*/
+	class BenchRandom
+	{
+	protected:
+		uint64_t state;
+
+	public:
+		BenchRandom(uint64_t seed = 1);
+
+		void seed(uint64_t seed);
+		uint64_t next();
+
+		// Returns a number in [min, max).
+		real randomReal(real min, real max);
+		Vector3 randomVector(const Vector3 &min, const Vector3 &max);
+
+		// Returns a number in [0, max).
+		unsigned randomInt(unsigned max);
+	};
+
+	// Holds the timings of one scene run at one size.
+	struct BenchResult
+	{
+		std::string scene;
+		unsigned size;
+		unsigned frames;
+
+		// The mean, fastest and slowest step, in nanoseconds.
+		double nsPerStep;
+		double minNsPerStep;
+		double maxNsPerStep;
+
+		// The mean number of contacts and resolver iterations per step.
+		double contactsPerStep;
+		double iterationsPerStep;
+
+		/*
+			The peak memory of the whole process, in bytes, once the
+			scene has run. The peak never goes down, so it only says
+			something about a scene if the scenes before it were smaller.
+		*/
+		size_t peakMemory;
+	};
+
+	// Holds the timings of one variant of one kernel.
+	struct KernelResult
+	{
+		std::string kernel;
+		std::string variant;
+
+		// The number of calls timed.
+		unsigned calls;
+
+		// The mean and fastest time per call, over the batches, in nanoseconds.
+		double nsPerCall;
+		double minNsPerCall;
+
+		// The fraction of the calls that found a contact or an intersection.
+		double hitRate;
+
+		// The speed against the first variant of the same kernel.
+		double speedup;
+	};
+
+	// Returns the most memory the process has used so far, in bytes, or 0 if unknown.
+	size_t getPeakMemory();
+
+	/*
+		Writes the results of the scenes and the kernels as JSON, so runs from different versions can
+		be compared by a script. Returns false if the file can't be
+		written.
+	*/
+	bool writeResults(const char *filename, const std::vector<BenchResult> &results,
+		const std::vector<KernelResult> &kernelResults);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,466 @@
+#include "kernels.h"
+#include "../Physics Engine/Collision/NarrowPhase.h"
+#include "../Physics Engine/Collision/Query.h"
+#include "../Physics Engine/World/clock.h"
+#include <vector>
+
+using namespace Physics_Engine;
+
+// The number of inputs of each kind. They fit in the cache, so the kernels are timed rather than memory.
+static const unsigned inputCount = 4096;
+
+// The most contacts one call can make (boxAndHalfSpace reserves eight).
+static const unsigned contactsPerCall = 8;
+
+/*
+	Gives the benchmark the resolver's view of a contact, so its
+	helpers can be timed on their own.
+*/
+class BenchContact : public Contact
+{
+public:
+	void prepare(real duration)
+	{
+		calculateInternals(duration);
+	}
+
+	Vector3 frictionImpulse(Matrix3X3 *inverseInertiaTensor)
+	{
+		return calculateFrictionImpulse(inverseInertiaTensor);
+	}
+};
+
+struct Physics_Engine::KernelInputs
+{
+	/*
+		The primitives of the i'th call are the i'th of each array, and
+		each has its own body. The shapes are scattered over a small
+		region, so about half of the pairs touch.
+	*/
+	std::vector<RigidBody> bodies;
+	std::vector<CollisionSphere> spheres;
+	std::vector<CollisionSphere> otherSpheres;
+	std::vector<CollisionBox> boxes;
+	std::vector<CollisionBox> otherBoxes;
+	std::vector<CollisionPlane> planes;
+
+	// Contacts between two moving bodies, ready to be resolved.
+	std::vector<BenchContact> contacts;
+	std::vector<Matrix3X3> inverseInertiaTensors;
+
+	std::vector<Matrix3X3> matrices;
+
+	// Packets of rays, each with a box to test against, and single rays to cast at the boxes.
+	std::vector<RayPacket> rayPackets;
+	std::vector<BoundingBox> rayBoxes;
+	std::vector<ShapeCast> casts;
+
+	// Holds the contacts the detectors write.
+	std::vector<Contact> contactArray;
+	CollisionData collisionData;
+
+	// Resets the collision data, so a batch of calls never runs out of room.
+	void resetContacts()
+	{
+		collisionData.contactArray = &contactArray[0];
+		collisionData.reset((unsigned)contactArray.size());
+	}
+};
+
+static Quaternion randomOrientation(BenchRandom &random)
+{
+	Quaternion orientation(
+		random.randomReal(-1, 1),
+		random.randomReal(-1, 1),
+		random.randomReal(-1, 1),
+		random.randomReal(-1, 1));
+	orientation.normalize();
+	return orientation;
+}
+
+static void setBody(RigidBody &body, BenchRandom &random, const Vector3 &halfSize)
+{
+	body.setPosition(random.randomVector(Vector3(-2, -2, -2), Vector3(2, 2, 2)));
+	body.setOrientation(randomOrientation(random));
+	body.setVelocity(random.randomVector(Vector3(-5, -5, -5), Vector3(5, 5, 5)));
+	body.setRotation(random.randomVector(Vector3(-2, -2, -2), Vector3(2, 2, 2)));
+
+	real mass = halfSize.x * halfSize.y * halfSize.z * 8;
+	body.setMass(mass);
+
+	Matrix3X3 tensor;
+	tensor.setBlockInertiaTensor(halfSize, mass);
+	body.setInertiaTensor(tensor);
+
+	body.setAwake();
+	body.calculateDerivedData();
+}
+
+KernelInputs* Physics_Engine::createKernelInputs(uint64_t seed)
+{
+	BenchRandom random(seed);
+	KernelInputs *inputs = new KernelInputs();
+
+	// Five bodies for each call, which the primitives and contacts share.
+	inputs->bodies.resize(inputCount * 5);
+	inputs->spheres.resize(inputCount);
+	inputs->otherSpheres.resize(inputCount);
+	inputs->boxes.resize(inputCount);
+	inputs->otherBoxes.resize(inputCount);
+	inputs->planes.resize(inputCount);
+	inputs->contacts.resize(inputCount);
+	inputs->inverseInertiaTensors.resize(inputCount * 2);
+	inputs->matrices.resize(inputCount);
+	inputs->rayPackets.resize(inputCount);
+	inputs->rayBoxes.reserve(inputCount);
+	inputs->casts.resize(inputCount);
+	inputs->contactArray.resize(inputCount * contactsPerCall);
+
+	for (unsigned i = 0; i < inputCount; i++)
+	{
+		RigidBody *bodies = &inputs->bodies[i * 5];
+
+		CollisionSphere &sphere = inputs->spheres[i];
+		sphere.radius = random.randomReal(0.5, 1.5);
+		sphere.body = &bodies[0];
+		setBody(bodies[0], random, Vector3(sphere.radius, sphere.radius, sphere.radius));
+		sphere.calculateInternals();
+
+		CollisionSphere &otherSphere = inputs->otherSpheres[i];
+		otherSphere.radius = random.randomReal(0.5, 1.5);
+		otherSphere.body = &bodies[1];
+		setBody(bodies[1], random, Vector3(otherSphere.radius, otherSphere.radius, otherSphere.radius));
+		otherSphere.calculateInternals();
+
+		CollisionBox &box = inputs->boxes[i];
+		box.halfSize = random.randomVector(Vector3(0.5, 0.5, 0.5), Vector3(1.5, 1.5, 1.5));
+		box.body = &bodies[2];
+		setBody(bodies[2], random, box.halfSize);
+		box.calculateInternals();
+
+		CollisionBox &otherBox = inputs->otherBoxes[i];
+		otherBox.halfSize = random.randomVector(Vector3(0.5, 0.5, 0.5), Vector3(1.5, 1.5, 1.5));
+		otherBox.body = &bodies[3];
+		setBody(bodies[3], random, otherBox.halfSize);
+		otherBox.calculateInternals();
+
+		CollisionPlane &plane = inputs->planes[i];
+		plane.normal = random.randomVector(Vector3(-1, -1, -1), Vector3(1, 1, 1));
+		plane.normal.normalise();
+		plane.offset = random.randomReal(-1, 1);
+		plane.body = NULL;
+
+		// A contact between the first box and a fifth body, touching somewhere between them.
+		setBody(bodies[4], random, Vector3(1, 1, 1));
+		BenchContact &contact = inputs->contacts[i];
+		contact.setBodyData(&bodies[2], &bodies[4], random.randomReal(0.2, 1), random.randomReal(0, 0.8));
+		contact.contactNormal = bodies[2].getPosition() - bodies[4].getPosition();
+		if (contact.contactNormal.squareMagnitude() < 1e-6)
+			contact.contactNormal = Vector3(0, 1, 0);
+		contact.contactNormal.normalise();
+		contact.contactPoint = (bodies[2].getPosition() + bodies[4].getPosition()) * 0.5;
+		contact.penetration = random.randomReal(0, 0.1);
+		contact.prepare((real)1 / 60);
+
+		bodies[2].getInverseInertiaTensorWorld(&inputs->inverseInertiaTensors[i * 2]);
+		bodies[4].getInverseInertiaTensorWorld(&inputs->inverseInertiaTensors[i * 2 + 1]);
+
+		// A matrix with a strong diagonal is never close to singular.
+		Matrix3X3 &matrix = inputs->matrices[i];
+		for (unsigned j = 0; j < 9; j++)
+			matrix.data[j] = random.randomReal(-1, 1);
+		matrix.data[0] += 4;
+		matrix.data[4] += 4;
+		matrix.data[8] += 4;
+
+		// Rays from around the region, aimed near enough their box that about half hit.
+		Vector3 corner = random.randomVector(Vector3(-2, -2, -2), Vector3(2, 2, 2));
+		Vector3 size = random.randomVector(Vector3(0.5, 0.5, 0.5), Vector3(2, 2, 2));
+		inputs->rayBoxes.push_back(BoundingBox(corner, corner + size));
+
+		Vector3 aim = corner + size * 0.5;
+		for (unsigned lane = 0; lane < 4; lane++)
+		{
+			Vector3 origin = random.randomVector(Vector3(-4, -4, -4), Vector3(4, 4, 4));
+			Vector3 direction = aim + random.randomVector(Vector3(-2, -2, -2), Vector3(2, 2, 2)) - origin;
+			direction.normalise();
+			inputs->rayPackets[i].set(lane, RaySegment(origin, direction, 8));
+		}
+
+		Vector3 origin = random.randomVector(Vector3(-4, -4, -4), Vector3(4, 4, 4));
+		Ray ray(origin, box.getAxis(3) + random.randomVector(Vector3(-2, -2, -2), Vector3(2, 2, 2)) - origin, 8);
+		CollisionQuery::makeCast(ray, &inputs->casts[i]);
+	}
+
+	return inputs;
+}
+
+void Physics_Engine::destroyKernelInputs(KernelInputs *inputs)
+{
+	delete inputs;
+}
+
+unsigned Physics_Engine::getKernelInputCount()
+{
+	return inputCount;
+}
+
+static unsigned detectSphereAndSphere(KernelInputs &inputs, unsigned count, real &sink)
+{
+	inputs.resetContacts();
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+		hits += CollisionDectector::sphereAndSphere(inputs.spheres[i], inputs.otherSpheres[i], &inputs.collisionData) > 0;
+	sink += inputs.collisionData.contactCount;
+	return hits;
+}
+
+static unsigned detectSphereAndHalfSpace(KernelInputs &inputs, unsigned count, real &sink)
+{
+	inputs.resetContacts();
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+		hits += CollisionDectector::sphereAndHalfSpace(inputs.spheres[i], inputs.planes[i], &inputs.collisionData) > 0;
+	sink += inputs.collisionData.contactCount;
+	return hits;
+}
+
+static unsigned detectBoxAndHalfSpace(KernelInputs &inputs, unsigned count, real &sink)
+{
+	inputs.resetContacts();
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+		hits += CollisionDectector::boxAndHalfSpace(inputs.boxes[i], inputs.planes[i], &inputs.collisionData) > 0;
+	sink += inputs.collisionData.contactCount;
+	return hits;
+}
+
+static unsigned detectBoxAndSphere(KernelInputs &inputs, unsigned count, real &sink)
+{
+	inputs.resetContacts();
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+		hits += CollisionDectector::boxAndSphere(inputs.boxes[i], inputs.spheres[i], &inputs.collisionData) > 0;
+	sink += inputs.collisionData.contactCount;
+	return hits;
+}
+
+static unsigned detectBoxAndBox(KernelInputs &inputs, unsigned count, real &sink)
+{
+	inputs.resetContacts();
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+		hits += CollisionDectector::boxAndBox(inputs.boxes[i], inputs.otherBoxes[i], &inputs.collisionData) > 0;
+	sink += inputs.collisionData.contactCount;
+	return hits;
+}
+
+static unsigned intersectSphereAndHalfSpace(KernelInputs &inputs, unsigned count, real &sink)
+{
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+		hits += IntersectionTests::sphereAndHalfSpace(inputs.spheres[i], inputs.planes[i]);
+	sink += hits;
+	return hits;
+}
+
+static unsigned intersectSphereAndSphere(KernelInputs &inputs, unsigned count, real &sink)
+{
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+		hits += IntersectionTests::sphereAndSphere(inputs.spheres[i], inputs.otherSpheres[i]);
+	sink += hits;
+	return hits;
+}
+
+static unsigned intersectBoxAndBox(KernelInputs &inputs, unsigned count, real &sink)
+{
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+		hits += IntersectionTests::boxAndBox(inputs.boxes[i], inputs.otherBoxes[i]);
+	sink += hits;
+	return hits;
+}
+
+static unsigned intersectBoxAndHalfSpace(KernelInputs &inputs, unsigned count, real &sink)
+{
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+		hits += IntersectionTests::boxAndHalfSpace(inputs.boxes[i], inputs.planes[i]);
+	sink += hits;
+	return hits;
+}
+
+static unsigned frictionImpulse(KernelInputs &inputs, unsigned count, real &sink)
+{
+	for (unsigned i = 0; i < count; i++)
+	{
+		Vector3 impulse = inputs.contacts[i].frictionImpulse(&inputs.inverseInertiaTensors[i * 2]);
+		sink += impulse.x + impulse.y + impulse.z;
+	}
+	return count;
+}
+
+static unsigned matrixInverse(KernelInputs &inputs, unsigned count, real &sink)
+{
+	for (unsigned i = 0; i < count; i++)
+	{
+		Matrix3X3 inverse = inputs.matrices[i].inverse();
+		sink += inverse.data[0] + inverse.data[4] + inverse.data[8];
+	}
+	return count;
+}
+
+/*
+	The transform and inertia tensor helpers are private to body.cpp,
+	and calculateDerivedData is nothing but the two of them (and
+	normalising the orientation), so it is timed in their place. The
+	body is marked dirty first, or nothing would be recalculated.
+*/
+static unsigned derivedData(KernelInputs &inputs, unsigned count, real &sink)
+{
+	for (unsigned i = 0; i < count; i++)
+	{
+		RigidBody &body = inputs.bodies[i * 5 + 2];
+		body.markDirty();
+		body.calculateDerivedData();
+		sink += body.getTransform().data[3];
+	}
+	return count;
+}
+
+static unsigned rayPacketAndBoxScalar(KernelInputs &inputs, unsigned count, real &sink)
+{
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		unsigned mask = inputs.rayBoxes[i].intersectsRaysScalar(inputs.rayPackets[i], 15);
+		hits += mask != 0;
+		sink += mask;
+	}
+	return hits;
+}
+
+#ifdef PHYSICS_SSE2
+static unsigned rayPacketAndBoxSSE2(KernelInputs &inputs, unsigned count, real &sink)
+{
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		unsigned mask = inputs.rayBoxes[i].intersectsRays(inputs.rayPackets[i], 15);
+		hits += mask != 0;
+		sink += mask;
+	}
+	return hits;
+}
+#endif
+
+static unsigned castRayAndBox(KernelInputs &inputs, unsigned count, real &sink)
+{
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		RaycastHit hit;
+		if (CastTests::rayAndBox(inputs.casts[i], inputs.boxes[i], 8, &hit))
+		{
+			hits++;
+			sink += hit.distance;
+		}
+	}
+	return hits;
+}
+
+static unsigned castSphereAndBox(KernelInputs &inputs, unsigned count, real &sink)
+{
+	unsigned hits = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		ShapeCast cast = inputs.casts[i];
+		cast.type = CAST_SPHERE;
+		cast.radius = inputs.spheres[i].radius;
+
+		RaycastHit hit;
+		if (CastTests::sphereAndBox(cast, inputs.boxes[i], 8, &hit))
+		{
+			hits++;
+			sink += hit.distance;
+		}
+	}
+	return hits;
+}
+
+/*
+	Each routine is listed once for each of its variants, with the
+	variant the others are compared against first. The SIMD variants
+	are only listed where the target has the instructions.
+*/
+static const BenchKernel kernels[] =
+{
+	{ "CollisionDectector::sphereAndSphere", "scalar", detectSphereAndSphere },
+	{ "CollisionDectector::sphereAndHalfSpace", "scalar", detectSphereAndHalfSpace },
+	{ "CollisionDectector::boxAndHalfSpace", "scalar", detectBoxAndHalfSpace },
+	{ "CollisionDectector::boxAndSphere", "scalar", detectBoxAndSphere },
+	{ "CollisionDectector::boxAndBox", "scalar", detectBoxAndBox },
+	{ "IntersectionTests::sphereAndHalfSpace", "scalar", intersectSphereAndHalfSpace },
+	{ "IntersectionTests::sphereAndSphere", "scalar", intersectSphereAndSphere },
+	{ "IntersectionTests::boxAndBox", "scalar", intersectBoxAndBox },
+	{ "IntersectionTests::boxAndHalfSpace", "scalar", intersectBoxAndHalfSpace },
+	{ "Contact::calculateFrictionImpulse", "scalar", frictionImpulse },
+	{ "Matrix3X3::inverse", "scalar", matrixInverse },
+	{ "RigidBody::calculateDerivedData", "scalar", derivedData },
+	{ "BoundingBox::intersectsRays", "scalar", rayPacketAndBoxScalar },
+#ifdef PHYSICS_SSE2
+	{ "BoundingBox::intersectsRays", "sse2", rayPacketAndBoxSSE2 },
+#endif
+	{ "CastTests::rayAndBox", "scalar", castRayAndBox },
+	{ "CastTests::sphereAndBox", "scalar", castSphereAndBox }
+};
+
+unsigned Physics_Engine::getBenchKernelCount()
+{
+	return sizeof(kernels) / sizeof(kernels[0]);
+}
+
+const BenchKernel& Physics_Engine::getBenchKernel(unsigned index)
+{
+	return kernels[index];
+}
+
+// Keeps the results of the kernels alive, so they can't be optimised away.
+static volatile real kernelSink;
+
+KernelResult Physics_Engine::runKernel(const BenchKernel &kernel, KernelInputs &inputs, unsigned batches)
+{
+	KernelResult result;
+	result.kernel = kernel.name;
+	result.variant = kernel.variant;
+	result.calls = batches * inputCount;
+	result.minNsPerCall = 0;
+	result.speedup = 1;
+
+	real sink = 0;
+
+	// One batch first, to warm the caches and the branch predictors.
+	kernel.function(inputs, inputCount, sink);
+
+	double totalTime = 0;
+	unsigned hits = 0;
+
+	Clock clock;
+	for (unsigned i = 0; i < batches; i++)
+	{
+		clock.tick();
+		hits += kernel.function(inputs, inputCount, sink);
+		double time = clock.tick() * 1e9 / inputCount;
+
+		totalTime += time;
+		if (i == 0 || time < result.minNsPerCall)
+			result.minNsPerCall = time;
+	}
+
+	result.nsPerCall = batches ? totalTime / batches : 0;
+	result.hitRate = result.calls ? (double)hits / result.calls : 0;
+
+	kernelSink = sink;
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef BENCH_KERNELS_H
+#define BENCH_KERNELS_H
+
+#include "bench.h"
+
+namespace Physics_Engine
+{
+	struct KernelInputs;
+
+	/*
+		Runs a kernel once on each of the first count inputs. Returns
+		the number of calls that found a contact or an intersection,
+		and adds something from every result into the sink, so the
+		compiler can't leave any of the work out.
+	*/
+	typedef unsigned (*KernelFunction)(KernelInputs &inputs, unsigned count, real &sink);
+
+	/*
+		A single routine that is timed on its own. A routine can have
+		more than one variant (such as a scalar and a SIMD version),
+		which share its name and are reported side by side, each
+		against the first variant listed.
+	*/
+	struct BenchKernel
+	{
+		const char *name;
+		const char *variant;
+		KernelFunction function;
+	};
+
+	unsigned getBenchKernelCount();
+	const BenchKernel& getBenchKernel(unsigned index);
+
+	/*
+		Holds the random inputs the kernels are run on. They are made
+		once from a fixed seed, so every kernel and every run sees the
+		same ones.
+	*/
+	KernelInputs* createKernelInputs(uint64_t seed);
+	void destroyKernelInputs(KernelInputs *inputs);
+
+	// Returns the number of inputs, which is the number of calls in each batch.
+	unsigned getKernelInputCount();
+
+	/*
+		Times the kernel over the given number of batches of calls.
+		The fastest batch is reported as well as the mean, as it is the
+		least disturbed by the rest of the machine.
+	*/
+	KernelResult runKernel(const BenchKernel &kernel, KernelInputs &inputs, unsigned batches);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include "bench.h"
+#include "scenes.h"
+#include "kernels.h"
+#include "../Physics Engine/World/clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Physics_Engine;
+
+/*
+	Runs the demo scenes without a window and reports how long a step
+	takes, or times the narrowphase and resolver routines on their own.
+	Usage:
+
+		Benchmark [--scene name] [--size n] [--frames n] [--json file]
+		Benchmark --kernels [--kernel name] [--batches n] [--json file]
+
+	Without --scene every scene is run, and without --size each scene
+	is run at its default sizes. --frames overrides the number of steps
+	taken at each size. With --kernels every routine (or the one named)
+	is run over batches of random inputs instead. The results are
+	printed as a table and, with --json, also written as JSON.
+*/
+
+// The steps are the same length as in the demos.
+static const real stepDuration = (real)1 / 60;
+
+// The steps taken before timing starts, so the caches are warm.
+static const unsigned warmupFrames = 5;
+
+// The seed of the kernels' inputs.
+static const uint64_t kernelSeed = 54321;
+
+static void printUsage()
+{
+	printf("Usage: Benchmark [--scene name] [--size n] [--frames n] [--json file]\n");
+	printf("       Benchmark --kernels [--kernel name] [--batches n] [--json file]\n");
+	printf("Scenes:\n");
+	for (unsigned i = 0; i < getBenchSceneCount(); i++)
+	{
+		const BenchSceneInfo &info = getBenchSceneInfo(i);
+		printf("  %-12s %s, sized by %s (%u, %u, %u)\n", info.name, info.demo, info.sizeUnit,
+			info.sizes[0], info.sizes[1], info.sizes[2]);
+	}
+	printf("Kernels:\n");
+	for (unsigned i = 0; i < getBenchKernelCount(); i++)
+	{
+		const BenchKernel &kernel = getBenchKernel(i);
+		printf("  %s (%s)\n", kernel.name, kernel.variant);
+	}
+}
+
+static BenchResult runScene(const BenchSceneInfo &info, unsigned size, unsigned frames)
+{
+	BenchScene *scene = createBenchScene(info.name);
+	scene->build(size);
+
+	for (unsigned i = 0; i < warmupFrames; i++)
+		scene->step(stepDuration);
+
+	BenchResult result;
+	result.scene = info.name;
+	result.size = size;
+	result.frames = frames;
+	result.minNsPerStep = 0;
+	result.maxNsPerStep = 0;
+
+	double totalTime = 0;
+	double totalContacts = 0;
+	double totalIterations = 0;
+
+	Clock clock;
+	for (unsigned i = 0; i < frames; i++)
+	{
+		clock.tick();
+		scene->step(stepDuration);
+		double time = clock.tick() * 1e9;
+
+		totalTime += time;
+		totalContacts += scene->getContactCount();
+		totalIterations += scene->getIterationsUsed();
+
+		if (i == 0 || time < result.minNsPerStep)
+			result.minNsPerStep = time;
+		if (time > result.maxNsPerStep)
+			result.maxNsPerStep = time;
+	}
+
+	result.nsPerStep = frames ? totalTime / frames : 0;
+	result.contactsPerStep = frames ? totalContacts / frames : 0;
+	result.iterationsPerStep = frames ? totalIterations / frames : 0;
+
+	delete scene;
+
+	// Taken after the scene is freed, though its peak is still counted.
+	result.peakMemory = getPeakMemory();
+	return result;
+}
+
+static void runKernels(const char *kernelName, unsigned batches, std::vector<KernelResult> &results)
+{
+	KernelInputs *inputs = createKernelInputs(kernelSeed);
+
+	printf("%-40s %-8s %10s %10s %10s %8s %8s\n", "kernel", "variant", "calls",
+		"ns/call", "min ns", "hits", "speedup");
+
+	unsigned first = 0;
+	for (unsigned i = 0; i < getBenchKernelCount(); i++)
+	{
+		const BenchKernel &kernel = getBenchKernel(i);
+		if (kernelName && strcmp(kernelName, kernel.name) != 0)
+			continue;
+
+		KernelResult result = runKernel(kernel, *inputs, batches);
+
+		// The variants of a kernel are listed together, so the first is the one before them.
+		if (results.empty() || results[first].kernel != result.kernel)
+			first = (unsigned)results.size();
+		else if (result.minNsPerCall > 0)
+			result.speedup = results[first].minNsPerCall / result.minNsPerCall;
+		results.push_back(result);
+
+		printf("%-40s %-8s %10u %10.2f %10.2f %7.1f%% %7.2fx\n",
+			result.kernel.c_str(), result.variant.c_str(), result.calls,
+			result.nsPerCall, result.minNsPerCall, result.hitRate * 100, result.speedup);
+		fflush(stdout);
+	}
+
+	destroyKernelInputs(inputs);
+}
+
+int main(int argc, char **argv)
+{
+	const char *sceneName = NULL;
+	const char *jsonFile = NULL;
+	const char *kernelName = NULL;
+	unsigned size = 0;
+	unsigned frames = 0;
+	bool kernels = false;
+	unsigned batches = 200;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--scene") == 0 && hasValue)
+			sceneName = argv[++i];
+		else if (strcmp(argv[i], "--size") == 0 && hasValue)
+			size = (unsigned)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+			frames = (unsigned)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--json") == 0 && hasValue)
+			jsonFile = argv[++i];
+		else if (strcmp(argv[i], "--kernels") == 0)
+			kernels = true;
+		else if (strcmp(argv[i], "--kernel") == 0 && hasValue)
+		{
+			kernels = true;
+			kernelName = argv[++i];
+		}
+		else if (strcmp(argv[i], "--batches") == 0 && hasValue)
+			batches = (unsigned)atoi(argv[++i]);
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+
+	std::vector<BenchResult> results;
+	std::vector<KernelResult> kernelResults;
+	if (kernels)
+	{
+		runKernels(kernelName, batches, kernelResults);
+
+		if (jsonFile && !writeResults(jsonFile, results, kernelResults))
+		{
+			printf("Couldn't write '%s'.\n", jsonFile);
+			return 1;
+		}
+		return 0;
+	}
+
+	if (sceneName)
+	{
+		BenchScene *scene = createBenchScene(sceneName);
+		if (!scene)
+		{
+			printf("Unknown scene '%s'.\n", sceneName);
+			printUsage();
+			return 1;
+		}
+		delete scene;
+	}
+
+	printf("%-12s %8s %7s %14s %14s %14s %12s %12s %10s\n", "scene", "size", "frames",
+		"ns/step", "min ns", "max ns", "contacts", "iterations", "peak MB");
+
+	/*
+		The sizes are run smallest first, so the peak memory reported for
+		each is mostly its own.
+	*/
+	for (unsigned s = 0; s < getBenchSceneCount(); s++)
+	{
+		const BenchSceneInfo &info = getBenchSceneInfo(s);
+		if (sceneName && strcmp(sceneName, info.name) != 0)
+			continue;
+
+		for (unsigned i = 0; i < 3; i++)
+		{
+			unsigned runSize = size ? size : info.sizes[i];
+			unsigned runFrames = frames ? frames : info.frames[i];
+
+			BenchResult result = runScene(info, runSize, runFrames);
+			results.push_back(result);
+
+			printf("%-12s %8u %7u %14.0f %14.0f %14.0f %12.1f %12.1f %10.1f\n",
+				result.scene.c_str(), result.size, result.frames,
+				result.nsPerStep, result.minNsPerStep, result.maxNsPerStep,
+				result.contactsPerStep, result.iterationsPerStep,
+				result.peakMemory / (1024.0 * 1024.0));
+			fflush(stdout);
+
+			// A size given on the command line is only run once.
+			if (size)
+				break;
+		}
+	}
+
+	if (jsonFile && !writeResults(jsonFile, results, kernelResults))
+	{
+		printf("Couldn't write '%s'.\n", jsonFile);
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
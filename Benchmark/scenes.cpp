@@ -0,0 +1,892 @@
+#include "scenes.h"
+#include "bench.h"
+#include "../Physics Engine/Collision/NarrowPhase.h"
+#include "../Physics Engine/Collision/Compound.h"
+#include "../Physics Engine/Collision/SpatialHash.h"
+#include "../Physics Engine/Dynamics/cloth.h"
+#include "../Physics Engine/Dynamics/force_gen.h"
+#include "../Physics Engine/Dynamics/pworld.h"
+#include "../Physics Engine/World/arena.h"
+#include "../Physics Engine/World/pool.h"
+#include "../Physics Engine/World/sleep.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+using namespace Physics_Engine;
+
+// Every scene is built from the same seed, so runs can be compared.
+static const uint64_t sceneSeed = 12345;
+
+/*
+	CollisionTest: boxes dropped onto the ground, where they settle and
+	go to sleep. The boxes are spread over an area that grows with
+	their number, so larger scenes have the same density as the demo.
+
+	The demo tests every pair of boxes, which would take the whole run
+	at ten thousand boxes, so the pairs are found with a spatial hash
+	instead. The narrowphase, resolver and sleep system are the same.
+*/
+class BoxesScene : public BenchScene
+{
+protected:
+	std::vector<RigidBody> bodies;
+	std::vector<RigidBody*> bodyPointers;
+	std::vector<CollisionBox> boxes;
+
+	// Holds the centre of each box, for the spatial hash.
+	std::vector<Vector3> positions;
+	SpatialHash hash;
+	std::vector<unsigned> candidates;
+
+	Arena arena;
+	CollisionData collisionData;
+	ContactResolver resolver;
+	SleepSystem sleepSystem;
+	CollisionFilter filter;
+
+public:
+	BoxesScene()
+		: resolver(10)
+	{
+
+	}
+
+	virtual void build(unsigned size)
+	{
+		BenchRandom random(sceneSeed);
+
+		bodies.resize(size);
+		bodyPointers.resize(size);
+		boxes.resize(size);
+		positions.resize(size);
+
+		// The demo drops 30 boxes over an area about 20 units across.
+		real extent = (real)20 * sqrt((real)size / 30);
+		if (extent < 20)
+			extent = 20;
+
+		for (unsigned i = 0; i < size; i++)
+		{
+			RigidBody *body = &bodies[i];
+			CollisionBox &box = boxes[i];
+			box.body = body;
+			box.halfSize = Vector3(1, 1, 1);
+			bodyPointers[i] = body;
+
+			body->setId(i);
+			body->setPosition(random.randomVector(
+				Vector3(-extent / 2, 2, -extent / 2), Vector3(extent / 2, 20, extent / 2)));
+			body->setOrientation(Quaternion(1, 0, 0, 0));
+			body->setVelocity(Vector3());
+			body->setRotation(Vector3());
+
+			// The same mass and damping as the boxes in the demo.
+			real mass = box.halfSize.x * box.halfSize.y * box.halfSize.z * 8.0f;
+			body->setMass(mass);
+
+			Matrix3X3 tensor;
+			tensor.setBlockInertiaTensor(box.halfSize, mass);
+			body->setInertiaTensor(tensor);
+
+			body->setLinearDamping(0.95f);
+			body->setAngularDamping(0.8f);
+			body->clearAccumulators();
+			body->setAcceleration(0, -10.0f, 0);
+
+			body->setCanSleep(true);
+			body->setAwake();
+
+			body->calculateDerivedData();
+			box.calculateInternals();
+		}
+
+		// A query then only covers the cells next to the box's own.
+		hash.setCellSize(getReach());
+		collisionData.presize(size * 4);
+	}
+
+	virtual void step(real duration)
+	{
+		CollisionPlane plane;
+		plane.normal = Vector3(0, 1, 0);
+		plane.offset = 0;
+
+		arena.reset();
+		collisionData.reset(&arena);
+		collisionData.friction = (real)0.9;
+		collisionData.restitution = (real)0.6;
+		collisionData.tolerance = (real)0.1;
+
+		unsigned count = (unsigned)boxes.size();
+		for (unsigned i = 0; i < count; i++)
+		{
+			if (filter.shouldCollide(boxes[i], plane))
+				CollisionDectector::boxAndHalfSpace(boxes[i], plane, &collisionData);
+		}
+
+		generateBoxContacts();
+
+		collisionData.gatherContacts();
+		resolver.resolveContacts(collisionData.contactArray, collisionData.contactCount, duration);
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			bodies[i].integrate(duration);
+			boxes[i].calculateInternals();
+		}
+
+		sleepSystem.update(count ? &bodyPointers[0] : NULL, count,
+			collisionData.contactArray, collisionData.contactCount, arena);
+	}
+
+	virtual unsigned getContactCount() const
+	{
+		return collisionData.contactCount;
+	}
+
+	virtual unsigned getIterationsUsed() const
+	{
+		return resolver.velocityIterationsUsed + resolver.positionIterationsUsed;
+	}
+
+protected:
+	// Finds the pairs of boxes that may touch, and writes their contacts.
+	virtual void generateBoxContacts()
+	{
+		unsigned count = (unsigned)boxes.size();
+		for (unsigned i = 0; i < count; i++)
+			positions[i] = bodies[i].getPosition();
+		hash.build(count ? &positions[0] : NULL, count);
+
+		real reach = getReach();
+		for (unsigned i = 0; i < count; i++)
+		{
+			const Vector3 &position = positions[i];
+			hash.query(position - Vector3(reach, reach, reach),
+				position + Vector3(reach, reach, reach), candidates);
+
+			// Each pair is tested once, by the box with the lower index.
+			for (unsigned c = 0; c < candidates.size(); c++)
+			{
+				unsigned other = candidates[c];
+				if (other > i && filter.shouldCollide(boxes[i], boxes[other]))
+					CollisionDectector::boxAndBox(boxes[i], boxes[other], &collisionData);
+			}
+		}
+	}
+
+	// Returns the furthest apart the centres of two touching boxes can be.
+	static real getReach()
+	{
+		return 2 * sqrt((real)3);
+	}
+};
+
+/*
+	The boxes again, with the pairs found by a bounding volume hierarchy
+	instead of the spatial hash. The tree is built once and refitted
+	each step, which only fits the leaves of bodies that moved again,
+	so the boxes that have gone to sleep cost next to nothing.
+*/
+class BoxesTreeScene : public BoxesScene
+{
+	BVH_Node<BoundingBox> *tree;
+	std::vector<PotentialContact> potentialContacts;
+
+public:
+	BoxesTreeScene()
+		: tree(NULL)
+	{
+
+	}
+
+	virtual ~BoxesTreeScene()
+	{
+		delete tree;
+	}
+
+	virtual void build(unsigned size)
+	{
+		BoxesScene::build(size);
+
+		delete tree;
+		tree = NULL;
+		for (unsigned i = 0; i < size; i++)
+		{
+			BoundingBox volume(boxes[i]);
+			if (tree)
+				tree->insert(&bodies[i], volume, &boxes[i]);
+			else
+				tree = new BVH_Node<BoundingBox>(NULL, volume, &bodies[i], &boxes[i]);
+		}
+
+		// A box in a pile touches a handful of others at most.
+		potentialContacts.resize(size * 8);
+	}
+
+protected:
+	virtual void generateBoxContacts()
+	{
+		if (!tree)
+			return;
+
+		tree->refit();
+		unsigned found = tree->getPotentialContacts(&potentialContacts[0],
+			(unsigned)potentialContacts.size(), &filter);
+
+		for (unsigned i = 0; i < found; i++)
+		{
+			PotentialContact &pair = potentialContacts[i];
+			CollisionDectector::boxAndBox(*static_cast<CollisionBox*>(pair.primitives[0]),
+				*static_cast<CollisionBox*>(pair.primitives[1]), &collisionData);
+		}
+	}
+
+private:
+	// The scene owns the tree, so it can't be copied.
+	BoxesTreeScene(const BoxesTreeScene &);
+	BoxesTreeScene& operator=(const BoxesTreeScene &);
+};
+
+/*
+	CollisionTest: tables dropped onto the ground and each other. Each
+	table is a compound of a top and four legs on one body, as in the
+	demo, so the spatial hash has one entry per table and the detector
+	goes down to the parts near the other table of a pair.
+*/
+class TablesScene : public BenchScene
+{
+protected:
+	struct Table
+	{
+		RigidBody body;
+		CollisionCompound compound;
+		CollisionBox parts[5];
+	};
+
+	// The compounds can't be copied, so the tables are kept in one array.
+	Table *tables;
+	unsigned count;
+
+	std::vector<RigidBody*> bodyPointers;
+	std::vector<Vector3> positions;
+	SpatialHash hash;
+	std::vector<unsigned> candidates;
+
+	Arena arena;
+	CollisionData collisionData;
+	ContactResolver resolver;
+	SleepSystem sleepSystem;
+	CollisionFilter filter;
+
+public:
+	TablesScene()
+		: tables(NULL), count(0), resolver(10)
+	{
+
+	}
+
+	virtual ~TablesScene()
+	{
+		delete[] tables;
+	}
+
+	virtual void build(unsigned size)
+	{
+		BenchRandom random(sceneSeed);
+
+		delete[] tables;
+		tables = new Table[size];
+		count = size;
+		bodyPointers.resize(size);
+		positions.resize(size);
+
+		// The tables are spread out at the same density as the boxes.
+		real extent = (real)20 * sqrt((real)size / 30);
+		if (extent < 20)
+			extent = 20;
+
+		for (unsigned i = 0; i < size; i++)
+		{
+			Table &table = tables[i];
+			RigidBody *body = &table.body;
+			bodyPointers[i] = body;
+
+			// The same parts as the table in the demo.
+			table.compound.body = body;
+			table.parts[0].halfSize = Vector3(1.5f, 0.1f, 1.0f);
+			table.parts[0].offset.setOrientationAndPos(Quaternion(1, 0, 0, 0), Vector3(0, 0.5f, 0));
+			for (unsigned p = 1; p < 5; p++)
+			{
+				Vector3 position((p & 1) ? 1.3f : -1.3f, -0.1f, (p & 2) ? 0.8f : -0.8f);
+				table.parts[p].halfSize = Vector3(0.1f, 0.5f, 0.1f);
+				table.parts[p].offset.setOrientationAndPos(Quaternion(1, 0, 0, 0), position);
+			}
+
+			real mass = 0;
+			for (unsigned p = 0; p < 5; p++)
+			{
+				const Vector3 &halfSize = table.parts[p].halfSize;
+				mass += halfSize.x * halfSize.y * halfSize.z * 8.0f;
+				table.compound.addChild(&table.parts[p]);
+			}
+
+			body->setId(i);
+			body->setPosition(random.randomVector(
+				Vector3(-extent / 2, 2, -extent / 2), Vector3(extent / 2, 20, extent / 2)));
+			body->setOrientation(Quaternion(1, 0, 0, 0));
+			body->setVelocity(Vector3());
+			body->setRotation(Vector3());
+			body->setMass(mass);
+
+			const BoundingBox &local = table.compound.getLocalBounds();
+			Matrix3X3 tensor;
+			tensor.setBlockInertiaTensor((local.max - local.min) * 0.5f, mass);
+			body->setInertiaTensor(tensor);
+
+			body->setLinearDamping(0.95f);
+			body->setAngularDamping(0.8f);
+			body->clearAccumulators();
+			body->setAcceleration(0, -10.0f, 0);
+
+			body->setCanSleep(true);
+			body->setAwake();
+
+			body->calculateDerivedData();
+			table.compound.calculateInternals();
+		}
+
+		hash.setCellSize(getReach());
+		collisionData.presize(size * 8);
+	}
+
+	virtual void step(real duration)
+	{
+		CollisionPlane plane;
+		plane.normal = Vector3(0, 1, 0);
+		plane.offset = 0;
+
+		arena.reset();
+		collisionData.reset(&arena);
+		collisionData.friction = (real)0.9;
+		collisionData.restitution = (real)0.6;
+		collisionData.tolerance = (real)0.1;
+
+		for (unsigned i = 0; i < count; i++)
+			positions[i] = tables[i].body.getPosition();
+		hash.build(count ? &positions[0] : NULL, count);
+
+		real reach = getReach();
+		for (unsigned i = 0; i < count; i++)
+		{
+			const CollisionCompound &compound = tables[i].compound;
+			if (filter.shouldCollide(compound, plane))
+				CollisionDectector::detect(compound, plane, &collisionData);
+
+			const Vector3 &position = positions[i];
+			hash.query(position - Vector3(reach, reach, reach),
+				position + Vector3(reach, reach, reach), candidates);
+
+			// Each pair is tested once, by the table with the lower index, if their bounds meet.
+			BoundingBox bounds = compound.getBounds();
+			for (unsigned c = 0; c < candidates.size(); c++)
+			{
+				unsigned other = candidates[c];
+				if (other <= i || !filter.shouldCollide(compound, tables[other].compound))
+					continue;
+
+				BoundingBox otherBounds = tables[other].compound.getBounds();
+				if (bounds.overlaps(&otherBounds))
+					CollisionDectector::detect(compound, tables[other].compound, &collisionData);
+			}
+		}
+
+		collisionData.gatherContacts();
+		resolver.resolveContacts(collisionData.contactArray, collisionData.contactCount, duration);
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			tables[i].body.integrate(duration);
+			tables[i].compound.calculateInternals();
+		}
+
+		sleepSystem.update(count ? &bodyPointers[0] : NULL, count,
+			collisionData.contactArray, collisionData.contactCount, arena);
+	}
+
+	virtual unsigned getContactCount() const
+	{
+		return collisionData.contactCount;
+	}
+
+	virtual unsigned getIterationsUsed() const
+	{
+		return resolver.velocityIterationsUsed + resolver.positionIterationsUsed;
+	}
+
+protected:
+	/*
+		Returns the furthest apart the centres of two touching tables
+		can be, twice the distance to a corner of the top.
+	*/
+	static real getReach()
+	{
+		return 2 * sqrt((real)(1.5 * 1.5 + 0.6 * 0.6 + 1.0 * 1.0));
+	}
+
+private:
+	TablesScene(const TablesScene &);
+	TablesScene& operator=(const TablesScene &);
+};
+
+/*
+	ClothDemo: a square of cloth blown onto a sphere, colliding with
+	itself. The size is the number of particles along each side, and
+	the spacing between them is the same as in the demo.
+
+	The cloth doesn't make contacts, so the contacts are its distance
+	constraints and the iterations are the passes made over them.
+*/
+class ClothScene : public BenchScene
+{
+protected:
+	Cloth *cloth;
+	Sphere sphere;
+
+public:
+	ClothScene()
+		: cloth(NULL), sphere(Vector3(), 1)
+	{
+
+	}
+
+	virtual ~ClothScene()
+	{
+		delete cloth;
+	}
+
+	virtual void build(unsigned size)
+	{
+		// The demo has 50 particles over 10 units.
+		real width = (real)size * (real)0.2;
+
+		delete cloth;
+		cloth = new Cloth(width, width, size, size);
+		cloth->setSelfCollision(true, 0.05f);
+
+		// The sphere is under the same part of the cloth as in the demo.
+		sphere = Sphere(Vector3(width * (real)0.7, -5, 0), width * (real)0.15);
+	}
+
+	virtual void step(real duration)
+	{
+		cloth->addForce(Vector3(0.0, -0.02, 0.0));
+		cloth->addWindForce(Vector3(0.5, 0, 0.2));
+		cloth->timeStep(duration);
+		cloth->ballCollision(sphere);
+		cloth->updateNormals();
+	}
+
+	virtual unsigned getContactCount() const
+	{
+		return cloth->getConstraintCount();
+	}
+
+	virtual unsigned getIterationsUsed() const
+	{
+		return CONSTRAINT_ITERATIONS;
+	}
+};
+
+/*
+	BridgeDemo: a rope bridge of particles hanging from cables. The
+	size is the number of sections, each of which has a rod across
+	it and two particles hanging from supports, with cables joining
+	it to the next section. The demo has six sections.
+*/
+class BridgeScene : public BenchScene
+{
+protected:
+	ParticleWorld *world;
+	std::vector<Particle> particles;
+	std::vector<ParticleCable> cables;
+	std::vector<ParticleCableConstraint> supports;
+	std::vector<ParticleRod> rods;
+
+public:
+	BridgeScene()
+		: world(NULL)
+	{
+
+	}
+
+	virtual ~BridgeScene()
+	{
+		delete world;
+	}
+
+	virtual void build(unsigned size)
+	{
+		unsigned count = size * 2;
+
+		// The demo has room for ten contacts per particle.
+		delete world;
+		world = new ParticleWorld(count * 10);
+
+		particles.resize(count);
+		for (unsigned i = 0; i < count; i++)
+		{
+			Particle &particle = particles[i];
+			particle.setPosition((real)(i / 2) * 2.0f - 5.0f, 4, (real)(i % 2) * 2.0f - 1.0f);
+			particle.setVelocity(0, 0, 0);
+			particle.setDamping(0.9f);
+			particle.setAcceleration(Vector3(0, -9.81, 0));
+			particle.setMass(1);
+			particle.clearAccumulator();
+			world->getParticles().push_back(&particle);
+		}
+
+		cables.resize(count - 2);
+		for (unsigned i = 0; i < cables.size(); i++)
+		{
+			cables[i].particle[0] = &particles[i];
+			cables[i].particle[1] = &particles[i + 2];
+			cables[i].maxLength = 1.9f;
+			cables[i].restitution = 0.3f;
+			cables[i].particle[1]->setVelocity(Vector3(1, 2, 3));
+			world->getContactGenerators().push_back(&cables[i]);
+		}
+
+		// The supports are shortest at the ends of the bridge, so it sags in the middle.
+		supports.resize(count);
+		for (unsigned i = 0; i < count; i++)
+		{
+			unsigned section = i / 2;
+			unsigned fromEnd = section < size - 1 - section ? section : size - 1 - section;
+
+			supports[i].particle = &particles[i];
+			supports[i].anchor = Vector3((real)section * 2.2f - 5.5f, 6, (real)(i % 2) * 1.6f - 0.8f);
+			supports[i].maxLength = (real)fromEnd * 0.5f + 3.0f;
+			supports[i].restitution = 0.5f;
+			world->getContactGenerators().push_back(&supports[i]);
+		}
+
+		rods.resize(size);
+		for (unsigned i = 0; i < size; i++)
+		{
+			rods[i].particle[0] = &particles[i * 2];
+			rods[i].particle[1] = &particles[i * 2 + 1];
+			rods[i].length = 2;
+			world->getContactGenerators().push_back(&rods[i]);
+		}
+	}
+
+	virtual void step(real duration)
+	{
+		world->startFrame();
+		world->runPhysics(duration);
+	}
+
+	virtual unsigned getContactCount() const
+	{
+		return world->getContactCount();
+	}
+
+	virtual unsigned getIterationsUsed() const
+	{
+		return world->getIterationsUsed();
+	}
+};
+
+/*
+	AirplaneDemo: aircraft flying under their own propulsion, with
+	wings, a rudder and a tail in a shared wind. The size is the number
+	of aircraft. Each is given its own fixed control settings, as no
+	one is flying them.
+*/
+class AirplaneScene : public BenchScene
+{
+protected:
+	struct Aircraft
+	{
+		AeroControl leftWing;
+		AeroControl rightWing;
+		AeroControl rudder;
+		Aero tail;
+		RigidBody body;
+
+		Aircraft(const Vector3 *windspeed)
+			: leftWing(Matrix3X3(0, 0, 0, -1, -0.5f, 0, 0, 0, 0),
+				Matrix3X3(0, 0, 0, -0.995f, -0.5f, 0, 0, 0, 0),
+				Matrix3X3(0, 0, 0, -1.005f, -0.5f, 0, 0, 0, 0),
+				Vector3(-1.0f, 0.0f, -2.0f), windspeed),
+			rightWing(Matrix3X3(0, 0, 0, -1, -0.5f, 0, 0, 0, 0),
+				Matrix3X3(0, 0, 0, -0.995f, -0.5f, 0, 0, 0, 0),
+				Matrix3X3(0, 0, 0, -1.005f, -0.5f, 0, 0, 0, 0),
+				Vector3(-1.0f, 0.0f, 2.0f), windspeed),
+			rudder(Matrix3X3(0, 0, 0, 0, 0, 0, 0, 0, 0),
+				Matrix3X3(0, 0, 0, 0, 0, 0, 0.01f, 0, 0),
+				Matrix3X3(0, 0, 0, 0, 0, 0, -0.01f, 0, 0),
+				Vector3(2.0f, 0.5f, 0), windspeed),
+			tail(Matrix3X3(0, 0, 0, -1, -0.5f, 0, 0, 0, -0.1f),
+				Vector3(2.0f, 0, 0), windspeed)
+		{
+
+		}
+	};
+
+	/*
+		The registry holds pointers to the aircraft, so they are only
+		added after the storage for all of them has been reserved.
+	*/
+	std::vector<Aircraft> aircraft;
+	std::vector<Vector3> startPositions;
+	ForceRegistry registry;
+	Vector3 windspeed;
+
+public:
+	virtual void build(unsigned size)
+	{
+		BenchRandom random(sceneSeed);
+
+		registry.clear();
+		aircraft.clear();
+		aircraft.reserve(size);
+		startPositions.resize(size);
+
+		for (unsigned i = 0; i < size; i++)
+		{
+			aircraft.push_back(Aircraft(&windspeed));
+			Aircraft &plane = aircraft.back();
+
+			// The aircraft don't interact, so they can start anywhere.
+			startPositions[i] = random.randomVector(Vector3(-100, 0, -100), Vector3(100, 0, 100));
+			reset(plane, startPositions[i]);
+
+			plane.body.setMass(2.5f);
+			Matrix3X3 inertiaTensor;
+			inertiaTensor.setBlockInertiaTensor(Vector3(2, 3, 1), plane.body.getMass());
+			plane.body.setInertiaTensor(inertiaTensor);
+			plane.body.setDamping(0.8f, 0.8f);
+			plane.body.setAcceleration(Vector3(0, -9.81, 0));
+			plane.body.calculateDerivedData();
+			plane.body.setAwake();
+			plane.body.setCanSleep(false);
+
+			real wings = random.randomReal(-0.5f, 0.5f);
+			plane.leftWing.setControl(wings + random.randomReal(-0.1f, 0.1f));
+			plane.rightWing.setControl(wings - random.randomReal(-0.1f, 0.1f));
+			plane.rudder.setControl(random.randomReal(-0.5f, 0.5f));
+		}
+
+		for (unsigned i = 0; i < size; i++)
+		{
+			registry.add(&aircraft[i].body, &aircraft[i].leftWing);
+			registry.add(&aircraft[i].body, &aircraft[i].rightWing);
+			registry.add(&aircraft[i].body, &aircraft[i].rudder);
+			registry.add(&aircraft[i].body, &aircraft[i].tail);
+		}
+	}
+
+	virtual void step(real duration)
+	{
+		for (unsigned i = 0; i < aircraft.size(); i++)
+		{
+			RigidBody &body = aircraft[i].body;
+			body.clearAccumulators();
+
+			Vector3 propulsion(-7.0f, 0.0f, 0.0f);
+			propulsion = body.getTransform().transformDirection(propulsion);
+			if (body.getVelocity().magnitude() <= 20)
+				body.addForce(propulsion);
+		}
+
+		registry.updateForces(duration);
+
+		for (unsigned i = 0; i < aircraft.size(); i++)
+		{
+			RigidBody &body = aircraft[i].body;
+			body.integrate(duration);
+
+			// As in the demo, the ground stops the aircraft, and crashing starts them again.
+			Vector3 position = body.getPosition();
+			if (position.y < 0.0f)
+			{
+				position.y = 0.0f;
+				body.moveTo(position, body.getOrientation());
+
+				if (body.getVelocity().y < -10.0f)
+					reset(aircraft[i], startPositions[i]);
+			}
+		}
+	}
+
+	virtual unsigned getContactCount() const
+	{
+		return 0;
+	}
+
+	virtual unsigned getIterationsUsed() const
+	{
+		return 0;
+	}
+
+protected:
+	static void reset(Aircraft &plane, const Vector3 &position)
+	{
+		plane.body.setPosition(position);
+		plane.body.setOrientation(1, 0, 0, 0);
+		plane.body.setVelocity(0, 0, 0);
+		plane.body.setRotation(0, 0, 0);
+	}
+};
+
+/*
+	ProjectileDemo: rounds fired from a gun, each removed from its pool
+	when it lands or leaves the range. The size is the number of rounds
+	that may be in flight, and the gun fires whenever one is free,
+	going through the types of shot in turn. The demo allows 16 rounds.
+*/
+class ProjectileScene : public BenchScene
+{
+protected:
+	enum ShotType
+	{
+		PISTOL,
+		ARTILLERY,
+		FIREBALL,
+		LASER,
+		SHOT_TYPES
+	};
+
+	Pool<Particle> rounds;
+	unsigned maxRounds;
+	unsigned nextShot;
+
+public:
+	ProjectileScene()
+		: maxRounds(0), nextShot(0)
+	{
+
+	}
+
+	virtual void build(unsigned size)
+	{
+		rounds.clear();
+		rounds.reserve(size);
+		maxRounds = size;
+		nextShot = 0;
+	}
+
+	virtual void step(real duration)
+	{
+		while (rounds.getCount() < maxRounds)
+			fire();
+
+		// Removing a round moves the last one into its place, so go backwards.
+		for (unsigned i = rounds.getCount(); i > 0; i--)
+		{
+			Particle &round = rounds[i - 1];
+			round.intergrate(duration);
+
+			const Vector3 &position = round.getPosition();
+			if (position.y < 0.0f || position.y > 50.0f || position.z > 200.0f)
+				rounds.remove(rounds.getHandle(i - 1));
+		}
+	}
+
+	virtual unsigned getContactCount() const
+	{
+		return 0;
+	}
+
+	virtual unsigned getIterationsUsed() const
+	{
+		return 0;
+	}
+
+protected:
+	// Fires a round with the same properties as in the demo.
+	void fire()
+	{
+		Particle *round = rounds.get(rounds.add());
+
+		switch (nextShot)
+		{
+		case PISTOL:
+			round->setMass(2.0f);
+			round->setVelocity(0.0f, 0.0f, 35.0f);
+			round->setAcceleration(0.0f, -1.0f, 0.0f);
+			round->setDamping(0.99f);
+			break;
+
+		case ARTILLERY:
+			round->setMass(200.0f);
+			round->setVelocity(-3.0f, 25.0f, 20.0f);
+			round->setAcceleration(-1.0f, -20.0f, 0.0f);
+			round->setDamping(0.99f);
+			break;
+
+		case FIREBALL:
+			round->setMass(1.0f);
+			round->setVelocity(0.0f, 0.0f, 10.0f);
+			round->setAcceleration(0.0f, 0.9f, 0.0f);
+			round->setDamping(0.9f);
+			break;
+
+		case LASER:
+			round->setMass(0.1f);
+			round->setVelocity(0.0f, 0.0f, 100.0f);
+			round->setAcceleration(0.0f, 0.0f, 0.0f);
+			round->setDamping(0.99f);
+			break;
+		}
+
+		round->setPosition(0.0f, 1.5f, 0.0f);
+		round->clearAccumulator();
+
+		nextShot = (nextShot + 1) % SHOT_TYPES;
+	}
+};
+
+static const BenchSceneInfo sceneInfo[] =
+{
+	{ "boxes", "CollisionTest", "boxes", { 30, 1000, 10000 }, { 600, 300, 60 } },
+	{ "boxes-bvh", "CollisionTest", "boxes", { 30, 1000, 10000 }, { 600, 300, 60 } },
+	{ "tables", "CollisionTest", "tables", { 1, 1000, 10000 }, { 600, 300, 60 } },
+	{ "cloth", "ClothDemo", "particles per side", { 50, 128, 512 }, { 300, 60, 10 } },
+	{ "bridge", "BridgeDemo", "sections", { 6, 100, 1000 }, { 600, 300, 60 } },
+	{ "airplane", "AirplaneDemo", "aircraft", { 1, 1000, 100000 }, { 600, 300, 60 } },
+	{ "projectile", "ProjectileDemo", "rounds", { 16, 1000, 100000 }, { 600, 300, 60 } }
+};
+
+unsigned Physics_Engine::getBenchSceneCount()
+{
+	return sizeof(sceneInfo) / sizeof(sceneInfo[0]);
+}
+
+const BenchSceneInfo& Physics_Engine::getBenchSceneInfo(unsigned index)
+{
+	return sceneInfo[index];
+}
+
+BenchScene* Physics_Engine::createBenchScene(const char *name)
+{
+	if (strcmp(name, "boxes") == 0)
+		return new BoxesScene();
+	if (strcmp(name, "boxes-bvh") == 0)
+		return new BoxesTreeScene();
+	if (strcmp(name, "tables") == 0)
+		return new TablesScene();
+	if (strcmp(name, "cloth") == 0)
+		return new ClothScene();
+	if (strcmp(name, "bridge") == 0)
+		return new BridgeScene();
+	if (strcmp(name, "airplane") == 0)
+		return new AirplaneScene();
+	if (strcmp(name, "projectile") == 0)
+		return new ProjectileScene();
+
+	return NULL;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef BENCH_SCENES_H
+#define BENCH_SCENES_H
+
+#include "../Physics Engine/Math/core.h"
+
+namespace Physics_Engine
+{
+	/*
+		A scene from one of the demos, set up without any windows or
+		rendering so it can be stepped as fast as possible. The size
+		scales the scene, what it counts depends on the scene (see
+		BenchSceneInfo).
+	*/
+	class BenchScene
+	{
+	public:
+		virtual ~BenchScene() {}
+
+		virtual void build(unsigned size) = 0;
+		virtual void step(real duration) = 0;
+
+		// Returns the number of contacts resolved in the last step.
+		virtual unsigned getContactCount() const = 0;
+
+		// Returns the number of resolver iterations taken in the last step.
+		virtual unsigned getIterationsUsed() const = 0;
+	};
+
+	// Describes a scene and the sizes it is run at by default.
+	struct BenchSceneInfo
+	{
+		const char *name;
+
+		// The demo the scene comes from, and what its size counts.
+		const char *demo;
+		const char *sizeUnit;
+
+		/*
+			The default sizes, smallest first, and the number of frames
+			each is stepped for. The first size is the one in the demo.
+		*/
+		unsigned sizes[3];
+		unsigned frames[3];
+	};
+
+	unsigned getBenchSceneCount();
+	const BenchSceneInfo& getBenchSceneInfo(unsigned index);
+
+	// Returns a new scene with the given name, or NULL if there is no such scene.
+	BenchScene* createBenchScene(const char *name);
+}
+#endif
\ No newline at end of file
@@ -1,11 +1,14 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#include "../World/clock.h"
+
 namespace Physics_Engine
 {
 	class Timer
 	{
 	private:
+		Clock clock;
 		double currentTime, previousTime;
 		float duration;
 
@@ -1,5 +1,6 @@
 #include "application.h"
 #include "Timer.h"
+#include "../World/profiler.h"
 #include <iostream>
 #include <gl/glut.h>
 #include <stdio.h>
@@ -424,7 +425,7 @@ int Application::Execute()
 					ImGui::TextWrapped("The right and left arrow keys control the Rudder. Keys W, S and A, D control movement of the Aileron, there is no Elevator in this simulation. The lift is genetated by the aerodynamic surface of the Aileron.");
 
 				if (switchDemos[1])	// Cloth Demo.
-					ImGui::TextWrapped("Use WASD to control the ball on screen. The cloth uses structrual, shear and bend constraints to shape the cloth under external forces. The cloth can self interpenetrate.\n\nDebug Mode: Draws normals, attached points.");
+					ImGui::TextWrapped("Use WASD to control the ball on screen. The cloth uses structrual, shear and bend constraints to shape the cloth under external forces. The cloth collides with itself, and falls onto a crate on the ground. Press X to simulate the same sheet as an XPBD soft body, and C to go back.\n\nDebug Mode: Draws normals, attached points.");
 
 				if (getDemo(2))	// Projectile Demo.
 					ImGui::TextWrapped("Use Keys 1, 2, 3, 4 to switch between different projectiles and left mouse click to shoot.");
@@ -433,11 +434,26 @@ int Application::Execute()
 					ImGui::TextWrapped("Demonstration of particle constraints to make a bridge structure.");
 
 				if (getDemo(4))	// Collision Test Demo.
-					ImGui::TextWrapped("Rigid body collision Demo.\n\nPress 'R' to reset the scene.");
+					ImGui::TextWrapped("Rigid body collision Demo. The outlined box over the table is a trigger, which lights up while boxes fall through it.\n\nPress 'R' to reset the scene.");
 
 				ImGui::TextWrapped("\nFollow me on twitter @_DarrenSweeney\nMy Website: darrensweeney.net");
 			}
 
+#ifdef PHYSICS_PROFILE
+			if (ImGui::CollapsingHeader("Profiler", NULL, true, false))
+			{
+				// Average milliseconds and calls per frame for each zone.
+				for (Physics_Engine::ProfileSite *site = Physics_Engine::Profiler::getSites(); site; site = site->next)
+				{
+					ImGui::Text("%-44s %7.3f ms %7.1f calls", site->name,
+						site->averageTime * 1000.0, site->averageCalls);
+				}
+
+				if (ImGui::Button("Save Chrome Trace"))
+					Physics_Engine::Profiler::writeChromeTrace("trace.json");
+			}
+#endif
+
 			ImGui::End();
 		}
 
@@ -455,6 +471,8 @@ int Application::Execute()
 		glPopMatrix();
 
 		Update();
+
+		PROFILE_END_FRAME();
 	}
 
 	CleanUp();
@@ -1,4 +1,5 @@
 #include "Timer.h"
+#include "../World/stepper.h"
 
 class Application
 {
@@ -8,6 +9,12 @@ protected:
 
 	Physics_Engine::Timer timer;
 
+	/*
+		Splits the frame time into fixed steps, so the demos behave
+		the same however fast the frames are drawn.
+	*/
+	Physics_Engine::FixedStepper stepper;
+
 	bool switchDemos[5];
 
 	// Drawing visual information of the physics simulation.
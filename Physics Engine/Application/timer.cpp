@@ -1,5 +1,4 @@
 #include "Timer.h"
-#include <GLFW\glfw3.h>
 
 using namespace Physics_Engine;
 
@@ -17,7 +16,7 @@ void Timer::Update()
 	if (timerPaused == false)
 	{
 		previousTime = currentTime;
-		currentTime = glfwGetTime();
+		currentTime = clock.getTime();
 		duration = (currentTime - previousTime);
 	}
 }
@@ -1,7 +1,58 @@
 #include "BroadPhase.h"
+#include "Compound.h"
+
+#ifdef PHYSICS_SSE2
+#include <emmintrin.h>
+#endif
 
 using namespace Physics_Engine;
 
+// Returns the reciprocal of the value, or a huge value with its sign if it is zero.
+static inline real safeInverse(real value)
+{
+	if (value == 0)
+		return REAL_MAX;
+
+	return (real)1 / value;
+}
+
+RaySegment::RaySegment(const Vector3 &origin, const Vector3 &direction, real length,
+	const Vector3 &expansion)
+	: origin(origin), direction(direction), length(length), expansion(expansion)
+{
+	inverseDirection = Vector3(safeInverse(direction.x), safeInverse(direction.y),
+		safeInverse(direction.z));
+}
+
+void RayPacket::set(unsigned lane, const RaySegment &segment)
+{
+	originX[lane] = segment.origin.x;
+	originY[lane] = segment.origin.y;
+	originZ[lane] = segment.origin.z;
+	directionX[lane] = segment.direction.x;
+	directionY[lane] = segment.direction.y;
+	directionZ[lane] = segment.direction.z;
+	inverseX[lane] = segment.inverseDirection.x;
+	inverseY[lane] = segment.inverseDirection.y;
+	inverseZ[lane] = segment.inverseDirection.z;
+	length[lane] = segment.length;
+	expansion = segment.expansion;
+}
+
+BoundingSphere::BoundingSphere(const Vector3 &center, real radius)
+	: center(center), radius(radius)
+{
+
+}
+
+BoundingSphere::BoundingSphere(const CollisionPrimitive &primitive)
+{
+	// The sphere around the primitive's box is loose, but cheap to find.
+	BoundingBox box = CollisionCompound::getPrimitiveBounds(primitive);
+	center = (box.min + box.max) * (real)0.5;
+	radius = (box.max - center).magnitude();
+}
+
 BoundingSphere::BoundingSphere(const BoundingSphere &one, const BoundingSphere &two)
 {
 	Vector3 centerOffset = two.center - one.center;
@@ -62,4 +113,236 @@ real BoundingSphere::getGrowth(const BoundingSphere &other) const
 		area of the sphere.
 	*/
 	return newSphere.radius*newSphere.radius - radius * radius;
-}
\ No newline at end of file
+}
+
+/*
+	Finds where a ray enters a sphere, clipped to the start of the ray.
+	Returns false if it misses, or only hits beyond the given length.
+*/
+static inline bool rayAndSphere(const Vector3 &origin, const Vector3 &direction, real length,
+	const Vector3 &center, real radius, real *entry)
+{
+	Vector3 offset = origin - center;
+	real b = offset * direction;
+	real c = offset.squareMagnitude() - radius * radius;
+
+	// Starting inside.
+	if (c <= 0)
+	{
+		*entry = 0;
+		return true;
+	}
+
+	// Starting outside and pointing away.
+	if (b > 0)
+		return false;
+
+	real discriminant = b * b - c;
+	if (discriminant < 0)
+		return false;
+
+	*entry = -b - real_sqrt(discriminant);
+	return *entry <= length;
+}
+
+bool BoundingSphere::intersectsRay(const RaySegment &segment, real *entry) const
+{
+	return rayAndSphere(segment.origin, segment.direction, segment.length, center,
+		radius + segment.expansion.magnitude(), entry);
+}
+
+unsigned BoundingSphere::intersectsRays(const RayPacket &packet, unsigned mask) const
+{
+	real grownRadius = radius + packet.expansion.magnitude();
+	real entry;
+
+	unsigned hits = 0;
+	for (unsigned i = 0; i < 4; i++)
+	{
+		if (!(mask & (1 << i)))
+			continue;
+
+		Vector3 origin(packet.originX[i], packet.originY[i], packet.originZ[i]);
+		Vector3 direction(packet.directionX[i], packet.directionY[i], packet.directionZ[i]);
+		if (rayAndSphere(origin, direction, packet.length[i], center, grownRadius, &entry))
+			hits |= 1 << i;
+	}
+	return hits;
+}
+
+real BoundingSphere::getDistance(const Vector3 &point) const
+{
+	real distance = (point - center).magnitude() - radius;
+	return distance > 0 ? distance : 0;
+}
+
+
+BoundingBox::BoundingBox(const Vector3 &min, const Vector3 &max)
+	: min(min), max(max)
+{
+
+}
+
+BoundingBox::BoundingBox(const CollisionPrimitive &primitive)
+{
+	*this = CollisionCompound::getPrimitiveBounds(primitive);
+}
+
+BoundingBox::BoundingBox(const BoundingBox &one, const BoundingBox &two)
+{
+	min.x = one.min.x < two.min.x ? one.min.x : two.min.x;
+	min.y = one.min.y < two.min.y ? one.min.y : two.min.y;
+	min.z = one.min.z < two.min.z ? one.min.z : two.min.z;
+	max.x = one.max.x > two.max.x ? one.max.x : two.max.x;
+	max.y = one.max.y > two.max.y ? one.max.y : two.max.y;
+	max.z = one.max.z > two.max.z ? one.max.z : two.max.z;
+}
+
+bool BoundingBox::overlaps(const BoundingBox *other) const
+{
+	return min.x < other->max.x && other->min.x < max.x &&
+		min.y < other->max.y && other->min.y < max.y &&
+		min.z < other->max.z && other->min.z < max.z;
+}
+
+real BoundingBox::getSurfaceArea() const
+{
+	Vector3 size = max - min;
+	return (real)2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+real BoundingBox::getGrowth(const BoundingBox &other) const
+{
+	BoundingBox newBox(*this, other);
+
+	// As for spheres, the growth is in surface area.
+	return newBox.getSurfaceArea() - getSurfaceArea();
+}
+
+real BoundingBox::getDistance(const Vector3 &point) const
+{
+	Vector3 outside;
+	for (unsigned i = 0; i < 3; i++)
+	{
+		if (point[i] < min[i])
+			outside[i] = min[i] - point[i];
+		else if (point[i] > max[i])
+			outside[i] = point[i] - max[i];
+	}
+	return outside.magnitude();
+}
+
+bool BoundingBox::intersectsRay(const RaySegment &segment, real *entry) const
+{
+	Vector3 low = min - segment.expansion;
+	Vector3 high = max + segment.expansion;
+
+	real tMin = 0;
+	real tMax = segment.length;
+
+	for (unsigned i = 0; i < 3; i++)
+	{
+		real t1 = (low[i] - segment.origin[i]) * segment.inverseDirection[i];
+		real t2 = (high[i] - segment.origin[i]) * segment.inverseDirection[i];
+		if (t1 > t2)
+		{
+			real swap = t1;
+			t1 = t2;
+			t2 = swap;
+		}
+
+		if (t1 > tMin)
+			tMin = t1;
+		if (t2 < tMax)
+			tMax = t2;
+		if (tMin > tMax)
+			return false;
+	}
+
+	*entry = tMin;
+	return true;
+}
+
+// Narrows the [tMin, tMax] range of a ray to where it is inside the slab between low and high.
+static inline void slab(real low, real high, real origin, real inverse, real &tMin, real &tMax)
+{
+	real t1 = (low - origin) * inverse;
+	real t2 = (high - origin) * inverse;
+
+	real enter = t1 < t2 ? t1 : t2;
+	real exit = t1 < t2 ? t2 : t1;
+	tMin = enter > tMin ? enter : tMin;
+	tMax = exit < tMax ? exit : tMax;
+}
+
+unsigned BoundingBox::intersectsRaysScalar(const RayPacket &packet, unsigned mask) const
+{
+	Vector3 low = min - packet.expansion;
+	Vector3 high = max + packet.expansion;
+
+	unsigned hits = 0;
+	for (unsigned lane = 0; lane < 4; lane++)
+	{
+		if (!(mask & (1 << lane)))
+			continue;
+
+		real tMin = 0;
+		real tMax = packet.length[lane];
+		slab(low.x, high.x, packet.originX[lane], packet.inverseX[lane], tMin, tMax);
+		slab(low.y, high.y, packet.originY[lane], packet.inverseY[lane], tMin, tMax);
+		slab(low.z, high.z, packet.originZ[lane], packet.inverseZ[lane], tMin, tMax);
+
+		hits |= (unsigned)(tMin <= tMax) << lane;
+	}
+	return hits;
+}
+
+#ifdef PHYSICS_SSE2
+/*
+	Narrows the [tMin, tMax] ranges of two lanes to where they are
+	inside the slab between low and high on one axis.
+*/
+static inline void slabPair(__m128d low, __m128d high, const real *origin, const real *inverse,
+	__m128d &tMin, __m128d &tMax)
+{
+	__m128d o = _mm_loadu_pd(origin);
+	__m128d inv = _mm_loadu_pd(inverse);
+	__m128d t1 = _mm_mul_pd(_mm_sub_pd(low, o), inv);
+	__m128d t2 = _mm_mul_pd(_mm_sub_pd(high, o), inv);
+
+	tMin = _mm_max_pd(tMin, _mm_min_pd(t1, t2));
+	tMax = _mm_min_pd(tMax, _mm_max_pd(t1, t2));
+}
+
+unsigned BoundingBox::intersectsRays(const RayPacket &packet, unsigned mask) const
+{
+	Vector3 low = min - packet.expansion;
+	Vector3 high = max + packet.expansion;
+
+	/*
+		The rays are real (double) precision, so a register holds two
+		lanes. The packet is done as two pairs, sharing the box.
+	*/
+	unsigned hits = 0;
+	for (unsigned pair = 0; pair < 4; pair += 2)
+	{
+		if (!(mask & (3 << pair)))
+			continue;
+
+		__m128d tMin = _mm_setzero_pd();
+		__m128d tMax = _mm_loadu_pd(packet.length + pair);
+
+		slabPair(_mm_set1_pd(low.x), _mm_set1_pd(high.x), packet.originX + pair, packet.inverseX + pair, tMin, tMax);
+		slabPair(_mm_set1_pd(low.y), _mm_set1_pd(high.y), packet.originY + pair, packet.inverseY + pair, tMin, tMax);
+		slabPair(_mm_set1_pd(low.z), _mm_set1_pd(high.z), packet.originZ + pair, packet.inverseZ + pair, tMin, tMax);
+
+		hits |= (unsigned)_mm_movemask_pd(_mm_cmple_pd(tMin, tMax)) << pair;
+	}
+	return hits & mask;
+}
+#else
+unsigned BoundingBox::intersectsRays(const RayPacket &packet, unsigned mask) const
+{
+	return intersectsRaysScalar(packet, mask);
+}
+#endif
\ No newline at end of file
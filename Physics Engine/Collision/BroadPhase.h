@@ -2,9 +2,60 @@
 #define BROADPHASE_H
 
 #include "../Dynamics/body.h"
+#include "NarrowPhase.h"
 
 namespace Physics_Engine
 {
+	/*
+		A ray, or the path of a shape, to be tested against bounding
+		volumes. The expansion grows each volume by that much on each
+		axis, so a volume is hit if the shape moving along the ray
+		would touch it. For a ray it is zero.
+	*/
+	struct RaySegment
+	{
+		Vector3 origin;
+		Vector3 direction;
+
+		/*
+			Holds the reciprocal of each component of the direction. Zero
+			components are given a huge value instead of infinity, so the
+			slab tests never multiply infinity by zero.
+		*/
+		Vector3 inverseDirection;
+
+		real length;
+		Vector3 expansion;
+
+		RaySegment()
+			: length(0)
+		{
+
+		}
+
+		// The direction should be of unit length, the length is then in world units.
+		RaySegment(const Vector3 &origin, const Vector3 &direction, real length,
+			const Vector3 &expansion = Vector3());
+	};
+
+	/*
+		Four ray segments to be tested against a volume at once. The
+		components are stored in separate arrays, so a SIMD register
+		can be loaded with the same component of each ray. They all
+		share one expansion.
+	*/
+	struct RayPacket
+	{
+		real originX[4], originY[4], originZ[4];
+		real directionX[4], directionY[4], directionZ[4];
+		real inverseX[4], inverseY[4], inverseZ[4];
+		real length[4];
+		Vector3 expansion;
+
+		// Copies the given segment into one of the four lanes.
+		void set(unsigned lane, const RaySegment &segment);
+	};
+
 	struct BoundingSphere
 	{
 		Vector3 center;
@@ -17,6 +68,12 @@ namespace Physics_Engine
 		// Creates a bounding sphere to enclose the two given bounding spheres.
 		BoundingSphere(const BoundingSphere &one, const BoundingSphere &two);
 
+		/*
+			Creates a bounding sphere to enclose the given primitive, as
+			of its last calculateInternals.
+		*/
+		explicit BoundingSphere(const CollisionPrimitive &primitive);
+
 		bool overlaps(const BoundingSphere *other) const;
 
 		/*
@@ -38,11 +95,92 @@ namespace Physics_Engine
 		{
 			return ((real)1.333333) * R_PI * radius * radius * radius;
 		}
+
+		// Moves the sphere by the given offset.
+		void translate(const Vector3 &offset)
+		{
+			center += offset;
+		}
+
+		/*
+			Checks whether the segment hits the sphere, grown by the length
+			of the segment's expansion. If it does the distance along the
+			segment it enters at (zero if it starts inside) is written to
+			entry.
+		*/
+		bool intersectsRay(const RaySegment &segment, real *entry) const;
+
+		/*
+			Tests the rays of the packet in the given mask (bit i for lane
+			i), and returns the mask of those that hit.
+		*/
+		unsigned intersectsRays(const RayPacket &packet, unsigned mask) const;
+
+		// Returns the distance from the point to the sphere, or zero if it is inside.
+		real getDistance(const Vector3 &point) const;
+	};
+
+	/*
+		An axis aligned bounding box. It can be used in place of a
+		bounding sphere in the hierarchy, and fits long or flat bodies
+		more tightly. Rays are tested against it with slab tests, four
+		at a time with SIMD where it is available.
+	*/
+	struct BoundingBox
+	{
+		Vector3 min;
+		Vector3 max;
+
+	public:
+		// Creates a new bounding box with the given corners.
+		BoundingBox(const Vector3 &min, const Vector3 &max);
+
+		// Creates a bounding box to enclose the two given bounding boxes.
+		BoundingBox(const BoundingBox &one, const BoundingBox &two);
+
+		// Creates a bounding box to enclose the given primitive, in world coordinates.
+		explicit BoundingBox(const CollisionPrimitive &primitive);
+
+		bool overlaps(const BoundingBox *other) const;
+
+		// Reports the growth in surface area needed to take in the given box.
+		real getGrowth(const BoundingBox &other) const;
+
+		real getSize() const
+		{
+			Vector3 size = max - min;
+			return size.x * size.y * size.z;
+		}
+
+		real getSurfaceArea() const;
+
+		void translate(const Vector3 &offset)
+		{
+			min += offset;
+			max += offset;
+		}
+
+		// See BoundingSphere::intersectsRay, the expansion is added on each axis.
+		bool intersectsRay(const RaySegment &segment, real *entry) const;
+
+		/*
+			Tests the rays of the packet in the given mask, and returns
+			the mask of those that hit. The scalar version is always
+			available, and gives the same results.
+		*/
+		unsigned intersectsRays(const RayPacket &packet, unsigned mask) const;
+		unsigned intersectsRaysScalar(const RayPacket &packet, unsigned mask) const;
+
+		// Returns the distance from the point to the box, or zero if it is inside.
+		real getDistance(const Vector3 &point) const;
 	};
 
 	struct PotentialContact
 	{
 		RigidBody* bodies[2];
+
+		// Holds the primitives of the two leaves, if they were inserted with them.
+		CollisionPrimitive *primitives[2];
 	};
 
 	/*
@@ -67,14 +205,27 @@ namespace Physics_Engine
 		*/
 		RigidBody *body;
 
+		/*
+			Holds the primitive of the body at a leaf, if one was given
+			when the body was inserted. Queries (see CollisionQuery) only
+			report leaves with a primitive, as it is what they test against.
+		*/
+		CollisionPrimitive *primitive;
+
 		// Holds the node immediately above in the tree.
 		BVH_Node *parent;
 
+		/*
+			Holds the transform version (see RigidBody::getTransformVersion)
+			of the body when the volume of a leaf was last fitted to it.
+		*/
+		unsigned transformVersion;
+
 		/*
 			Creates a new node in the hierarchy with the given parameters.
 		*/
 		BVH_Node(BVH_Node *parent, const BoudingVolumeClass &volume,
-			RigidBody *body = NULL);
+			RigidBody *body = NULL, CollisionPrimitive *primitive = NULL);
 
 		/*
 			Checks whether this node is at the bottom of the hierarchy.
@@ -88,15 +239,41 @@ namespace Physics_Engine
 			Checks the potential contacts from this node downward in
 			the hierarchy, writing them to the given array (up to the given limit).
 			Returns the number of potential contacts it found.
+
+			If a filter is given, pairs of leaves with primitives that it
+			rejects are left out, and don't use up any of the limit.
+		*/
+		unsigned getPotentialContacts(PotentialContact* contacts, unsigned limit,
+			const CollisionFilter *filter = NULL) const;
+
+		/*
+			Refits the volumes of the leaves below this node to their
+			primitives, and grows the branches to fit. A leaf is only
+			refitted if its body's transform has changed since, so
+			sleeping bodies cost nothing, and branches are only
+			recalculated if something below them moved. Returns whether
+			anything did.
+
+			Leaves inserted without a primitive keep the volume they were
+			given. The volumes are rebuilt in world coordinates, so a tree
+			kept in another frame (as a compound keeps its parts) must not
+			be refitted.
+		*/
+		bool refit();
+
+		/*
+			Recalculates the volume of this branch from its children,
+			and then those of the branches above it.
 		*/
-		unsigned getPotentialContacts(PotentialContact* contacts, unsigned limit) const;
+		void recalculateBoundingVolume(bool recurse = true);
 
 		/*
-			Inserts the given rigid body, with the given bounding volume,
-			into the hierarchy. This may involve the creation of further
-			bounding volume nodes.
+			Inserts the given rigid body, with the given bounding volume
+			and optionally its primitive, into the hierarchy. This may
+			involve the creation of further bounding volume nodes.
 		*/
-		void insert(RigidBody *body, const BoudingVolumeClass &volume);
+		void insert(RigidBody *body, const BoudingVolumeClass &volume,
+			CollisionPrimitive *primitive = NULL);
 
 		/*
 			Deletes this node, removing it first from the hierarchy,
@@ -126,15 +303,18 @@ namespace Physics_Engine
 		*/
 		unsigned getPotentialContactsWith(const BVH_Node<BoudingVolumeClass> *other,
 			PotentialContact *contacts,
-			unsigned limit) const;
+			unsigned limit,
+			const CollisionFilter *filter = NULL) const;
 	};
 
 	template<class BoundingVolumeClass>
 	BVH_Node<BoundingVolumeClass>::BVH_Node(BVH_Node *parent, const BoundingVolumeClass &volume,
-		RigidBody *body = NULL)
-		: parent(parent), volume(volume), body(body)
+		RigidBody *body, CollisionPrimitive *primitive)
+		: volume(volume), body(body), primitive(primitive), parent(parent)
 	{
 		children[0] = children[1] = NULL;
+
+		transformVersion = body ? body->getTransformVersion() : 0;
 	}
 
 	template<class BoundingVolumeClass> 
@@ -155,6 +335,8 @@ namespace Physics_Engine
 			// Write its data to our parent.
 			parent->volume = sibling->volume;
 			parent->body = sibling->body;
+			parent->primitive = sibling->primitive;
+			parent->transformVersion = sibling->transformVersion;
 			parent->children[0] = sibling->children[0];
 			parent->children[1] = sibling->children[1];
 
@@ -164,11 +346,20 @@ namespace Physics_Engine
 			*/
 			sibling->parent = NULL;
 			sibling->body = NULL;
+			sibling->primitive = NULL;
 			sibling->children[0] = NULL;
 			sibling->children[1] = NULL;
 			delete sibling;
 
-			// Recalculate the parent's bounding volume.
+			/*
+				Recalculate the parent's bounding volume, and let the
+				parent's children know who their parent is now.
+			*/
+			if (parent->children[0])
+			{
+				parent->children[0]->parent = parent;
+				parent->children[1]->parent = parent;
+			}
 			parent->recalculateBoundingVolume();
 		}
 
@@ -186,7 +377,7 @@ namespace Physics_Engine
 		if (children[1])
 		{
 			children[1]->parent = NULL;
-			delete children[0];	// ----------- why children[0]
+			delete children[1];
 		}
 	}
 
@@ -198,26 +389,29 @@ namespace Physics_Engine
 	template<class BoundingVolumeClass>
 	bool BVH_Node<BoundingVolumeClass>::overlaps(const BVH_Node<BoundingVolumeClass> *other) const
 	{
-		return volume->overlaps(other->volume);
+		return volume.overlaps(&other->volume);
 	}
 
 	template<class BoundingVolumeClass>
-	void BVH_Node<BoundingVolumeClass>::insert(RigidBody *body, const BoundingVolumeClass &volume)
+	void BVH_Node<BoundingVolumeClass>::insert(RigidBody *newBody, const BoundingVolumeClass &newVolume,
+		CollisionPrimitive *newPrimitive)
 	{
 		/*
 			If we are a leaf, then the only opition is to spawn two
 			new children and place the new body in one.
 		*/
-		if (isleaf())
+		if (isLeaf())
 		{
 			// Child one is a copy of us.
-			children[0] = new BVH_Node<BoundingVolumeClass>(this, volume, body);
+			children[0] = new BVH_Node<BoundingVolumeClass>(this, volume, body, primitive);
+			children[0]->transformVersion = transformVersion;
 
 			// Child two holds the new body.
-			children[1] new BVH_Node<BoundingVolumeClass>(this, newVolume, newBody);
+			children[1] = new BVH_Node<BoundingVolumeClass>(this, newVolume, newBody, newPrimitive);
 
 			// And we now lose the body (we are no longer a leaf).
 			this->body = NULL;
+			this->primitive = NULL;
 
 			// We need to recalculate our bounding volume.
 			recalculateBoundingVolume();
@@ -233,17 +427,18 @@ namespace Physics_Engine
 			if (children[0]->volume.getGrowth(newVolume) <
 				children[1]->volume.getGrowth(newVolume))
 			{
-				children[0]->insert(newBody, newVolume);
+				children[0]->insert(newBody, newVolume, newPrimitive);
 			}
 			else
 			{
-				children[1]->insert(newBody, newVolume);
+				children[1]->insert(newBody, newVolume, newPrimitive);
 			}
 		}
 	}
 
 	template<class BoundingVolumeClass>
-	unsigned BVH_Node<BoundingVolumeClass>::getPotentialContacts(PotentialContact* contacts, unsigned limit) const
+	unsigned BVH_Node<BoundingVolumeClass>::getPotentialContacts(PotentialContact* contacts, unsigned limit,
+		const CollisionFilter *filter) const
 	{
 		/*
 			Early out if we don't have the room for contacts,
@@ -255,16 +450,23 @@ namespace Physics_Engine
 		}
 
 		/*
-			Get the potential contacts of one of our children with the other.
+			Get the potential contacts within each of our children, and
+			then those of one of our children with the other.
 		*/
-		return children[0]->getPotentialContactsWith(children[1], contacts, limit);
+		unsigned count = children[0]->getPotentialContacts(contacts, limit, filter);
+		if (count < limit)
+			count += children[1]->getPotentialContacts(contacts + count, limit - count, filter);
+		if (count < limit)
+			count += children[0]->getPotentialContactsWith(children[1], contacts + count, limit - count, filter);
+		return count;
 	}
 
 	template<class BoundingVolumeClass>
 	unsigned BVH_Node<BoundingVolumeClass>::getPotentialContactsWith(
 		const BVH_Node<BoundingVolumeClass> *other,
 		PotentialContact *contacts,
-		unsigned limit) const
+		unsigned limit,
+		const CollisionFilter *filter) const
 	{
 		if (!overlaps(other) || limit == 0)
 			return 0;
@@ -272,8 +474,16 @@ namespace Physics_Engine
 		// If we are both at leaf nodes, then we have a potential contact.
 		if (isLeaf() && other->isLeaf())
 		{
-			contacts->body[0] = body;
-			contacts->body[1] = other->body;
+			if (filter && primitive && other->primitive &&
+				!filter->shouldCollide(*primitive, *other->primitive))
+			{
+				return 0;
+			}
+
+			contacts->bodies[0] = body;
+			contacts->bodies[1] = other->body;
+			contacts->primitives[0] = primitive;
+			contacts->primitives[1] = other->primitive;
 
 			return 1;
 		}
@@ -283,15 +493,15 @@ namespace Physics_Engine
 			then we descend the other. If both are branches,
 			then we use the one with the largest size.
 		*/
-		if (other->isLeaf() || (!isLeaf() && volume->getSize() >= other->volume->getSize()))
+		if (other->isLeaf() || (!isLeaf() && volume.getSize() >= other->volume.getSize()))
 		{
 			// Recurse into self.
-			unsigned count = children[0]->getPotentialContactsWith(other, contacts, limit);
+			unsigned count = children[0]->getPotentialContactsWith(other, contacts, limit, filter);
 
 			// Check that we have enough slots to do the other side too.
 			if (limit > count)
 			{
-				return count + children[1]->getPotentialContactsWith(other, contacts + count, limit - count);
+				return count + children[1]->getPotentialContactsWith(other, contacts + count, limit - count, filter);
 			}
 			else
 			{
@@ -301,12 +511,12 @@ namespace Physics_Engine
 		else
 		{
 			// Recure into the other node.
-			unsigned count = getPotentialContactsWith(other->children[0], contacts, limit);
+			unsigned count = getPotentialContactsWith(other->children[0], contacts, limit, filter);
 
 			// Check that we have enought slots to do the other side too.
 			if (limit > count)
 			{
-				return count + getPotentialContactsWith(other->children[1], contacts + count, limt - count);
+				return count + getPotentialContactsWith(other->children[1], contacts + count, limit - count, filter);
 			}
 			else
 			{
@@ -314,5 +524,45 @@ namespace Physics_Engine
 			}
 		}
 	}
+
+	template<class BoundingVolumeClass>
+	void BVH_Node<BoundingVolumeClass>::recalculateBoundingVolume(bool recurse)
+	{
+		if (isLeaf())
+			return;
+
+		volume = BoundingVolumeClass(children[0]->volume, children[1]->volume);
+
+		if (parent && recurse)
+			parent->recalculateBoundingVolume(true);
+	}
+
+	template<class BoundingVolumeClass>
+	bool BVH_Node<BoundingVolumeClass>::refit()
+	{
+		if (isLeaf())
+		{
+			if (!primitive || body->getTransformVersion() == transformVersion)
+				return false;
+
+			/*
+				The primitive's transform may be older than the body's,
+				and the body may have turned as well as moved, so the
+				volume is fitted to it again rather than moved.
+			*/
+			primitive->calculateInternals();
+			volume = BoundingVolumeClass(*primitive);
+			transformVersion = body->getTransformVersion();
+			return true;
+		}
+
+		// Both children are always refitted.
+		bool moved = children[0]->refit();
+		moved = children[1]->refit() || moved;
+
+		if (moved)
+			recalculateBoundingVolume(false);
+		return moved;
+	}
 }
-#endif BROADPHASE.H
\ No newline at end of file
+#endif
\ No newline at end of file
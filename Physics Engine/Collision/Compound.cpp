@@ -0,0 +1,147 @@
+#include "Compound.h"
+
+using namespace Physics_Engine;
+
+CollisionCompound::CollisionCompound()
+	: CollisionPrimitive(PRIMITIVE_COMPOUND), tree(NULL), localBounds(Vector3(), Vector3())
+{
+
+}
+
+CollisionCompound::~CollisionCompound()
+{
+	clearChildren();
+}
+
+bool CollisionCompound::addChild(CollisionPrimitive *child)
+{
+	// The tree's leaves are told apart by their bodies, so it needs one.
+	if (!body || child->getType() == PRIMITIVE_PLANE)
+		return false;
+
+	child->body = body;
+	child->markDirty();
+
+	BoundingBox bounds = getPrimitiveBounds(*child, child->offset, NULL);
+	if (!tree)
+	{
+		tree = new BVH_Node<BoundingBox>(NULL, bounds, body, child);
+		localBounds = bounds;
+	}
+	else
+	{
+		tree->insert(body, bounds, child);
+		localBounds = BoundingBox(localBounds, bounds);
+	}
+
+	children.push_back(child);
+	return true;
+}
+
+void CollisionCompound::clearChildren()
+{
+	delete tree;
+	tree = NULL;
+	children.clear();
+	localBounds = BoundingBox(Vector3(), Vector3());
+}
+
+unsigned CollisionCompound::getChildCount() const
+{
+	return (unsigned)children.size();
+}
+
+CollisionPrimitive *CollisionCompound::getChild(unsigned index) const
+{
+	return children[index];
+}
+
+const BVH_Node<BoundingBox> *CollisionCompound::getTree() const
+{
+	return tree;
+}
+
+const BoundingBox &CollisionCompound::getLocalBounds() const
+{
+	return localBounds;
+}
+
+BoundingBox CollisionCompound::getBounds() const
+{
+	return getPrimitiveBounds(*this, transform, NULL);
+}
+
+BoundingBox CollisionCompound::getPrimitiveBounds(const CollisionPrimitive &primitive, const Matrix3X4 *frame)
+{
+	return getPrimitiveBounds(primitive, primitive.getTransform(), frame);
+}
+
+BoundingBox CollisionCompound::getPrimitiveBounds(const CollisionPrimitive &primitive,
+	const Matrix3X4 &transform, const Matrix3X4 *frame)
+{
+	Vector3 center = transform.getAxisVector(3);
+	if (frame)
+		center = frame->transformInverse(center);
+
+	// Holds the half sizes of the bounds on each axis.
+	Vector3 extents;
+
+	switch (primitive.getType())
+	{
+	case PRIMITIVE_SPHERE:
+	{
+		real radius = static_cast<const CollisionSphere&>(primitive).radius;
+		extents = Vector3(radius, radius, radius);
+		break;
+	}
+
+	case PRIMITIVE_BOX:
+	{
+		const Vector3 &halfSize = static_cast<const CollisionBox&>(primitive).halfSize;
+		for (unsigned i = 0; i < 3; i++)
+		{
+			Vector3 axis = transform.getAxisVector(i);
+			if (frame)
+				axis = frame->transformInverseDirection(axis);
+
+			extents.x += real_abs(axis.x) * halfSize[i];
+			extents.y += real_abs(axis.y) * halfSize[i];
+			extents.z += real_abs(axis.z) * halfSize[i];
+		}
+		break;
+	}
+
+	case PRIMITIVE_COMPOUND:
+	{
+		// The bounds of the corners of the compound's own bounds.
+		const BoundingBox &local = static_cast<const CollisionCompound&>(primitive).localBounds;
+		Vector3 min(REAL_MAX, REAL_MAX, REAL_MAX);
+		Vector3 max(-REAL_MAX, -REAL_MAX, -REAL_MAX);
+
+		for (unsigned corner = 0; corner < 8; corner++)
+		{
+			Vector3 point((corner & 1) ? local.max.x : local.min.x,
+				(corner & 2) ? local.max.y : local.min.y,
+				(corner & 4) ? local.max.z : local.min.z);
+
+			point = transform.transform(point);
+			if (frame)
+				point = frame->transformInverse(point);
+
+			for (unsigned i = 0; i < 3; i++)
+			{
+				if (point[i] < min[i])
+					min[i] = point[i];
+				if (point[i] > max[i])
+					max[i] = point[i];
+			}
+		}
+		return BoundingBox(min, max);
+	}
+
+	default:
+		return BoundingBox(Vector3(-REAL_MAX, -REAL_MAX, -REAL_MAX), Vector3(REAL_MAX, REAL_MAX, REAL_MAX));
+	}
+
+	return BoundingBox(center - extents, center + extents);
+}
\ No newline at end of file
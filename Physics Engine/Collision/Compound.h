@@ -0,0 +1,82 @@
+#ifndef COMPOUND_H
+#define COMPOUND_H
+
+#include "BroadPhase.h"
+#include <vector>
+
+namespace Physics_Engine
+{
+	/*
+		A primitive made of other primitives on the same body, such as a
+		table made of boxes. The broad phase sees it as one primitive,
+		with one volume around all its children (see getBounds), so its
+		children never show up as pairs with each other. The narrow
+		phase (see CollisionDectector::detect) only goes down to the
+		children near the other primitive of a pair, which it finds with
+		a hierarchy of the children's bounds in the body's coordinates.
+
+		The children's offsets are from the body, as for any primitive,
+		and the compound's own offset should be left as the identity.
+		Only the compound's calculateInternals needs to be called; the
+		children's transforms are brought up to date as they are tested.
+		Planes have no bounds, so can't be children. The compound
+		doesn't own its children, but they should outlive it.
+	*/
+	class CollisionCompound : public CollisionPrimitive
+	{
+	protected:
+		std::vector<CollisionPrimitive*> children;
+
+		// Holds the hierarchy of the children, or NULL if there are none.
+		BVH_Node<BoundingBox> *tree;
+
+		// Holds the bounds of all the children, in the body's coordinates.
+		BoundingBox localBounds;
+
+	public:
+		CollisionCompound();
+		~CollisionCompound();
+
+		/*
+			Adds a child, putting it on the compound's body. Returns false,
+			without adding it, for a plane or if the compound's body hasn't
+			been set yet.
+		*/
+		bool addChild(CollisionPrimitive *child);
+
+		// Removes all the children.
+		void clearChildren();
+
+		unsigned getChildCount() const;
+		CollisionPrimitive *getChild(unsigned index) const;
+
+		// Returns the hierarchy of the children, in the body's coordinates.
+		const BVH_Node<BoundingBox> *getTree() const;
+		const BoundingBox &getLocalBounds() const;
+
+		/*
+			Returns the bounds of the compound in world coordinates, as of
+			the last calculateInternals, for a broad phase hierarchy.
+		*/
+		BoundingBox getBounds() const;
+
+		/*
+			Returns the bounds of any primitive, in world coordinates or
+			in those of the given frame. A plane is given bounds that
+			cover everything.
+		*/
+		static BoundingBox getPrimitiveBounds(const CollisionPrimitive &primitive,
+			const Matrix3X4 *frame = NULL);
+
+	protected:
+		// As getPrimitiveBounds, for the primitive placed with the given transform.
+		static BoundingBox getPrimitiveBounds(const CollisionPrimitive &primitive,
+			const Matrix3X4 &transform, const Matrix3X4 *frame);
+
+	private:
+		// Compounds can't be copied, as they own their hierarchy.
+		CollisionCompound(const CollisionCompound &);
+		CollisionCompound &operator=(const CollisionCompound &);
+	};
+}
+#endif
\ No newline at end of file
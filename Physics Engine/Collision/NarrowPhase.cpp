@@ -1,12 +1,77 @@
 #include "NarrowPhase.h"
+#include "Compound.h"
+#include "../World/profiler.h"
+#include "../World/arena.h"
 #include <cstdlib>
+#include <string.h>
 #include <assert.h>
 
 using namespace Physics_Engine;
 
 void CollisionPrimitive::calculateInternals()
 {
+	if (transformBody == body && transformVersion == body->getTransformVersion())
+		return;
+
 	transform = body->getTransform() * offset;
+	transformBody = body;
+	transformVersion = body->getTransformVersion();
+}
+
+void CollisionData::reset(Arena *arena)
+{
+	/*
+		If the last step needed more than one chunk, the first chunk is
+		made big enough for all of it, with some to spare.
+	*/
+	if (overflows > 0 && highWaterMark > chunkSize)
+		chunkSize = highWaterMark + highWaterMark / 4;
+
+	CollisionData::arena = arena;
+	contactArray = arena->allocateArray<Contact>(chunkSize);
+	reset(chunkSize);
+}
+
+void CollisionData::addChunk(unsigned count)
+{
+	chunks.push_back(ContactChunk());
+	chunks.back().contacts = chunkStart;
+	chunks.back().count = (unsigned)(contacts - chunkStart);
+
+	unsigned size = chunkSize > count ? chunkSize : count;
+	chunkStart = arena->allocateArray<Contact>(size);
+	contacts = chunkStart;
+	contactsLeft = size;
+
+	overflows++;
+	totalOverflows++;
+}
+
+Contact* CollisionData::gatherContacts()
+{
+	if (chunks.empty())
+		return contactArray;
+
+	Contact *gathered = arena->allocateArray<Contact>(contactCount);
+	Contact *next = gathered;
+	for (unsigned i = 0; i < chunks.size(); i++)
+	{
+		memcpy(next, chunks[i].contacts, chunks[i].count * sizeof(Contact));
+		next += chunks[i].count;
+	}
+	memcpy(next, chunkStart, (contacts - chunkStart) * sizeof(Contact));
+
+	/*
+		Any more contacts found will start a new chunk, rather than
+		going after the gathered ones.
+	*/
+	chunks.clear();
+	contactArray = gathered;
+	chunkStart = gathered;
+	contacts = gathered + contactCount;
+	contactsLeft = 0;
+
+	return contactArray;
 }
 
 static inline real transformToAxis(const CollisionBox &box, const Vector3 &axis)
@@ -28,6 +93,13 @@ static inline real transformToAxis(const CollisionBox &box, const Vector3 &axis)
 static inline bool overLapOnAxis(const CollisionBox &one, const CollisionBox &two,
 	const Vector3 &axis, const Vector3 &toCenter)
 {
+	/*
+		The cross product of two parallel axes is zero, and can't
+		separate anything, so it is skipped.
+	*/
+	if (axis.squareMagnitude() < 0.0001)
+		return true;
+
 	// Project the half-size of one onto axis.
 	real oneProject = transformToAxis(one, axis);
 	real twoProject = transformToAxis(two, axis);
@@ -38,6 +110,25 @@ static inline bool overLapOnAxis(const CollisionBox &one, const CollisionBox &tw
 	// Check for overlap
 	return (distance < oneProject + twoProject);
 }
+
+bool IntersectionTests::sphereAndHalfSpace(const CollisionSphere &sphere, const CollisionPlane &plane)
+{
+	// Find the distance from the origin.
+	real ballDistance = plane.normal * sphere.getAxis(3) - sphere.radius;
+
+	// Check for the intersection.
+	return ballDistance <= plane.offset;
+}
+
+bool IntersectionTests::sphereAndSphere(const CollisionSphere &one, const CollisionSphere &two)
+{
+	// Find the vector between the objects.
+	Vector3 midline = one.getAxis(3) - two.getAxis(3);
+
+	// See if it is large enough.
+	return midline.squareMagnitude() < (one.radius + two.radius) * (one.radius + two.radius);
+}
+
 /*
 	This preprocessor definition is only used as a convenience
 	in the boxAndBox intersection method.
@@ -74,18 +165,121 @@ bool IntersectionTests::boxAndBox(const CollisionBox & one, const CollisionBox &
 }
 #undef TEST_OVERLAP
 
+bool IntersectionTests::boxAndSphere(const CollisionBox &box, const CollisionSphere &sphere)
+{
+	// Find the point of the box closest to the sphere's center, in the box's coordinates.
+	Vector3 relativeCenter = box.transform.transformInverse(sphere.getAxis(3));
+	Vector3 closestPoint = relativeCenter;
+	for (unsigned i = 0; i < 3; i++)
+	{
+		if (closestPoint[i] > box.halfSize[i])
+			closestPoint[i] = box.halfSize[i];
+		if (closestPoint[i] < -box.halfSize[i])
+			closestPoint[i] = -box.halfSize[i];
+	}
+
+	return (closestPoint - relativeCenter).squareMagnitude() <= sphere.radius * sphere.radius;
+}
+
 bool IntersectionTests::boxAndHalfSpace(const CollisionBox &box, const CollisionPlane &plane)
 {
 	// Working out the projection radius of the box onto the plane direction.
 	real projectedRadius = transformToAxis(box, plane.normal);
 
 	// Compute distance of box center from the plane.
-	real distance = plane.normal * box.getAxis(3) - projectedRadius;
+	real distance = plane.normal * box.getAxis(3) - plane.offset;
 
 	/*
-		Intersection occurs when distance falls with [-r, r] interval.
+		The box reaches the half space when its center is no further
+		in front of the plane than its projected radius. Any distance
+		below that, however far behind the plane, is an overlap.
 	*/
-	return real_abs(distance) <= projectedRadius;
+	return distance <= projectedRadius;
+}
+
+// Tests the children below the node whose bounds overlap the given bounds against the primitive.
+static bool overlapBelow(const BVH_Node<BoundingBox> *node, const BoundingBox &bounds,
+	const CollisionPrimitive &other)
+{
+	if (!node->volume.overlaps(&bounds))
+		return false;
+
+	if (node->isLeaf())
+	{
+		node->primitive->calculateInternals();
+		return IntersectionTests::overlap(*node->primitive, other);
+	}
+
+	return overlapBelow(node->children[0], bounds, other) ||
+		overlapBelow(node->children[1], bounds, other);
+}
+
+// Returns where a type of primitive comes in the pairs the tests take.
+static inline unsigned getTestOrder(PrimitiveType type)
+{
+	switch (type)
+	{
+	case PRIMITIVE_BOX:
+		return 0;
+	case PRIMITIVE_SPHERE:
+		return 1;
+	default:
+		return 2;
+	}
+}
+
+bool IntersectionTests::overlap(const CollisionPrimitive &one, const CollisionPrimitive &two)
+{
+	if (one.getType() == PRIMITIVE_COMPOUND || two.getType() == PRIMITIVE_COMPOUND)
+	{
+		const CollisionCompound &compound = static_cast<const CollisionCompound&>(
+			one.getType() == PRIMITIVE_COMPOUND ? one : two);
+		const CollisionPrimitive &other = one.getType() == PRIMITIVE_COMPOUND ? two : one;
+		if (!compound.getTree())
+			return false;
+
+		BoundingBox bounds = CollisionCompound::getPrimitiveBounds(other, &compound.getTransform());
+		return overlapBelow(compound.getTree(), bounds, other);
+	}
+
+	// Put the pair in the order the tests take them: a box, then a sphere, then a plane.
+	const CollisionPrimitive *first = &one;
+	const CollisionPrimitive *second = &two;
+	if (getTestOrder(first->getType()) > getTestOrder(second->getType()))
+	{
+		first = &two;
+		second = &one;
+	}
+
+	if (first->getType() == PRIMITIVE_BOX)
+	{
+		const CollisionBox &box = *static_cast<const CollisionBox*>(first);
+		switch (second->getType())
+		{
+		case PRIMITIVE_BOX:
+			return boxAndBox(box, *static_cast<const CollisionBox*>(second));
+		case PRIMITIVE_SPHERE:
+			return boxAndSphere(box, *static_cast<const CollisionSphere*>(second));
+		case PRIMITIVE_PLANE:
+			return boxAndHalfSpace(box, *static_cast<const CollisionPlane*>(second));
+		default:
+			break;
+		}
+	}
+	else if (first->getType() == PRIMITIVE_SPHERE)
+	{
+		const CollisionSphere &sphere = *static_cast<const CollisionSphere*>(first);
+		switch (second->getType())
+		{
+		case PRIMITIVE_SPHERE:
+			return sphereAndSphere(sphere, *static_cast<const CollisionSphere*>(second));
+		case PRIMITIVE_PLANE:
+			return sphereAndHalfSpace(sphere, *static_cast<const CollisionPlane*>(second));
+		default:
+			break;
+		}
+	}
+	return false;
 }
 
 /*
@@ -241,14 +435,40 @@ void fillPointFaceBoxBox(const CollisionBox &one, const CollisionBox &two,
 	contact->setBodyData(one.body, two.body, data->friction, data->restitution);
 }
 
+// Triggers never make contacts, detect reports their overlaps instead.
+static inline bool hasTrigger(const CollisionPrimitive &one, const CollisionPrimitive &two)
+{
+	return one.isTrigger || two.isTrigger;
+}
+
+/*
+	A body only takes part in collision detection if it is awake and
+	can move. Pairs with nothing active in them are skipped, so sleeping
+	bodies resting on each other, or on the world, cost almost nothing.
+*/
+static inline bool isActive(const RigidBody *body)
+{
+	return body && body->getAwake() && body->getInverseMass() > 0;
+}
+
 unsigned CollisionDectector::sphereAndSphere(const CollisionSphere &one,
 	const CollisionSphere &two,
 	CollisionData *data)
 {
+	PROFILE_ZONE("CollisionDectector::sphereAndSphere");
+
+	if (hasTrigger(one, two))
+		return 0;
+
 	// Make sure we have contacts.
-	if (data->contactsLeft <= 0)
+	if (!data->reserve(1))
 		return 0;
 
+	if (!isActive(one.body) && !isActive(two.body))
+		return 0;
+
+	data->pairTests[PAIR_SPHERE_SPHERE]++;
+
 	// Cache the sphere positions.
 	Vector3 positionOne = one.getAxis(3);
 	Vector3 positionTwo = two.getAxis(3);
@@ -273,7 +493,7 @@ unsigned CollisionDectector::sphereAndSphere(const CollisionSphere &one,
 	contact->penetration = (one.radius + two.radius - size);
 	contact->setBodyData(one.body, two.body, data->friction, data->restitution);
 
-	data->addContacts(1);
+	data->addContacts(1, PAIR_SPHERE_SPHERE);
 
 	return 1;
 }
@@ -282,10 +502,20 @@ unsigned CollisionDectector::sphereAndHalfSpace(const CollisionSphere &sphere,
 	const CollisionPlane &plane,
 	CollisionData *data)
 {
+	PROFILE_ZONE("CollisionDectector::sphereAndHalfSpace");
+
+	if (hasTrigger(sphere, plane))
+		return 0;
+
 	// Make sure we have enough contacts.
-	if (data->contactCount <= 0)
+	if (!data->reserve(1))
+		return 0;
+
+	if (!isActive(sphere.body))
 		return 0;
 
+	data->pairTests[PAIR_SPHERE_HALFSPACE]++;
+
 	// Cache the sphere position.
 	Vector3 spherePos = sphere.getAxis(3);
 
@@ -302,7 +532,7 @@ unsigned CollisionDectector::sphereAndHalfSpace(const CollisionSphere &sphere,
 	contact->contactPoint = spherePos - plane.normal * (ballDistance + sphere.radius);
 	contact->setBodyData(sphere.body, NULL, data->friction, data->restitution);
 
-	data->addContacts(1);
+	data->addContacts(1, PAIR_SPHERE_HALFSPACE);
 	return 1;
 }
 
@@ -310,10 +540,20 @@ unsigned CollisionDectector::boxAndHalfSpace(const CollisionBox &box,
 	const CollisionPlane &plane,
 	CollisionData *data)
 {
-	// Make sure we have enough contacts.
-	if (data->contactsLeft <= 0)
+	PROFILE_ZONE("CollisionDectector::boxAndHalfSpace");
+
+	if (hasTrigger(box, plane))
+		return 0;
+
+	// Make sure we have room for every vertex touching.
+	if (!data->reserve(8))
+		return 0;
+
+	if (!isActive(box.body))
 		return 0;
 
+	data->pairTests[PAIR_BOX_HALFSPACE]++;
+
 	// Check for intersetion.
 	if (!IntersectionTests::boxAndHalfSpace(box, plane))
 	{
@@ -367,11 +607,11 @@ unsigned CollisionDectector::boxAndHalfSpace(const CollisionBox &box,
 			contactUsed++;
 
 			if (contactUsed == (unsigned)data->contactsLeft)
-				return contactUsed;
+				break;
 		}
 	}
 
-	data->addContacts(contactUsed);
+	data->addContacts(contactUsed, PAIR_BOX_HALFSPACE);
 
 	return contactUsed;
 }
@@ -380,6 +620,20 @@ unsigned CollisionDectector::boxAndSphere(const CollisionBox &box,
 	const CollisionSphere &sphere,
 	CollisionData *data)
 {
+	PROFILE_ZONE("CollisionDectector::boxAndSphere");
+
+	if (hasTrigger(box, sphere))
+		return 0;
+
+	// Make sure we have contacts.
+	if (!data->reserve(1))
+		return 0;
+
+	if (!isActive(box.body) && !isActive(sphere.body))
+		return 0;
+
+	data->pairTests[PAIR_BOX_SPHERE]++;
+
 	/*
 		Transform the center of the sphere into box coordinates.
 		The box can be oriented in any direction, so the following
@@ -438,7 +692,7 @@ unsigned CollisionDectector::boxAndSphere(const CollisionBox &box,
 	contact->penetration = sphere.radius - real_sqrt(distance);
 	contact->setBodyData(box.body, sphere.body, data->friction, data->restitution);
 
-	data->addContacts(1);
+	data->addContacts(1, PAIR_BOX_SPHERE);
 	return 1;
 }
 
@@ -452,6 +706,20 @@ if (!tryAxis(one, two, (axis), toCenter, (index), pen, best)) return 0;
 
 unsigned CollisionDectector::boxAndBox(const CollisionBox &one, const CollisionBox &two, CollisionData *data)
 {
+	PROFILE_ZONE("CollisionDectector::boxAndBox");
+
+	if (hasTrigger(one, two))
+		return 0;
+
+	// Make sure we have contacts.
+	if (!data->reserve(1))
+		return 0;
+
+	if (!isActive(one.body) && !isActive(two.body))
+		return 0;
+
+	data->pairTests[PAIR_BOX_BOX]++;
+
 	if (!IntersectionTests::boxAndBox(one, two))
 		return 0;
 
@@ -508,7 +776,7 @@ unsigned CollisionDectector::boxAndBox(const CollisionBox &one, const CollisionB
 	{
 		// We have got a vertex of box two on a face of box one.
 		fillPointFaceBoxBox(one, two, toCenter, data, best, pen);
-		data->addContacts(1);
+		data->addContacts(1, PAIR_BOX_BOX);
 		return 1;
 	}
 	else if (best < 6)
@@ -520,7 +788,7 @@ unsigned CollisionDectector::boxAndBox(const CollisionBox &one, const CollisionB
 			their centers).
 		*/
 		fillPointFaceBoxBox(two, one, toCenter * -1.0f, data, best - 3, pen);
-		data->addContacts(1);
+		data->addContacts(1, PAIR_BOX_BOX);
 		return 1;
 	}
 	else
@@ -581,11 +849,99 @@ unsigned CollisionDectector::boxAndBox(const CollisionBox &one, const CollisionB
 		contact->contactPoint = vertex;
 		contact->setBodyData(one.body, two.body,
 			data->friction, data->restitution);
-		data->addContacts(1);
+		data->addContacts(1, PAIR_BOX_BOX);
 
 		return 1;
 	}
 	
 	return 0;
 }
-#undef CHECK_OVERLAP
\ No newline at end of file
+#undef CHECK_OVERLAP
+
+// Tests the children below the node whose bounds overlap the given bounds against the primitive.
+static unsigned compoundBelow(const BVH_Node<BoundingBox> *node, const BoundingBox &bounds,
+	const CollisionPrimitive &other, CollisionData *data, bool *triggered)
+{
+	if (!node->volume.overlaps(&bounds))
+		return 0;
+
+	if (node->isLeaf())
+	{
+		node->primitive->calculateInternals();
+		return CollisionDectector::detect(*node->primitive, other, data, triggered);
+	}
+
+	return compoundBelow(node->children[0], bounds, other, data, triggered) +
+		compoundBelow(node->children[1], bounds, other, data, triggered);
+}
+
+unsigned CollisionDectector::compoundAndPrimitive(const CollisionCompound &compound,
+	const CollisionPrimitive &other, CollisionData *data, bool *triggered)
+{
+	if (!compound.getTree())
+		return 0;
+
+	// The other primitive's bounds are found in the body's coordinates, where the tree is.
+	BoundingBox bounds = CollisionCompound::getPrimitiveBounds(other, &compound.getTransform());
+	Vector3 tolerance(data->tolerance, data->tolerance, data->tolerance);
+	bounds.min -= tolerance;
+	bounds.max += tolerance;
+
+	return compoundBelow(compound.getTree(), bounds, other, data, triggered);
+}
+
+unsigned CollisionDectector::detect(const CollisionPrimitive &one, const CollisionPrimitive &two,
+	CollisionData *data, bool *triggered)
+{
+	// A trigger only reports overlaps, it never makes contacts.
+	if (one.isTrigger || two.isTrigger)
+	{
+		if (triggered && IntersectionTests::overlap(one, two))
+			*triggered = true;
+		return 0;
+	}
+
+	if (one.getType() == PRIMITIVE_COMPOUND)
+		return compoundAndPrimitive(static_cast<const CollisionCompound&>(one), two, data, triggered);
+	if (two.getType() == PRIMITIVE_COMPOUND)
+		return compoundAndPrimitive(static_cast<const CollisionCompound&>(two), one, data, triggered);
+
+	// Put the pair in the order the tests take them: a box, then a sphere, then a plane.
+	const CollisionPrimitive *first = &one;
+	const CollisionPrimitive *second = &two;
+	if (getTestOrder(first->getType()) > getTestOrder(second->getType()))
+	{
+		first = &two;
+		second = &one;
+	}
+
+	if (first->getType() == PRIMITIVE_BOX)
+	{
+		const CollisionBox &box = *static_cast<const CollisionBox*>(first);
+		switch (second->getType())
+		{
+		case PRIMITIVE_BOX:
+			return boxAndBox(box, *static_cast<const CollisionBox*>(second), data);
+		case PRIMITIVE_SPHERE:
+			return boxAndSphere(box, *static_cast<const CollisionSphere*>(second), data);
+		case PRIMITIVE_PLANE:
+			return boxAndHalfSpace(box, *static_cast<const CollisionPlane*>(second), data);
+		default:
+			break;
+		}
+	}
+	else if (first->getType() == PRIMITIVE_SPHERE)
+	{
+		const CollisionSphere &sphere = *static_cast<const CollisionSphere*>(first);
+		switch (second->getType())
+		{
+		case PRIMITIVE_SPHERE:
+			return sphereAndSphere(sphere, *static_cast<const CollisionSphere*>(second), data);
+		case PRIMITIVE_PLANE:
+			return sphereAndHalfSpace(sphere, *static_cast<const CollisionPlane*>(second), data);
+		default:
+			break;
+		}
+	}
+	return 0;
+}
\ No newline at end of file
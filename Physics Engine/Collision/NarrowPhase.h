@@ -3,9 +3,22 @@
 
 #include "contacts.h"
 #include "../Dynamics/body.h"
+#include <vector>
 
 namespace Physics_Engine
 {
+	class Arena;
+	class CollisionCompound;
+
+	// The kinds of primitive, so code given a CollisionPrimitive can tell what it is.
+	enum PrimitiveType
+	{
+		PRIMITIVE_SPHERE,
+		PRIMITIVE_BOX,
+		PRIMITIVE_PLANE,
+		PRIMITIVE_COMPOUND
+	};
+
 	class CollisionPrimitive
 	{
 	public:
@@ -24,13 +37,42 @@ namespace Physics_Engine
 
 		/* 
 			The offset of this primitive from the given rigid body.
-			Offset is the rotation and translation.
+			Offset is the rotation and translation. If it is changed once
+			the transform has been calculated, call markDirty.
 		*/
 		Matrix3X4 offset;
 
-		// Calculates the internals for the primitive.
+		/*
+			Holds the groups this primitive belongs to, and the groups it
+			collides with, one bit for each. Two primitives are only
+			tested if each is in a group the other collides with (see
+			CollisionFilter). By default everything is in the first group
+			and collides with every group.
+		*/
+		unsigned collisionGroup;
+		unsigned collisionMask;
+
+		/*
+			Holds whether this primitive is a trigger. A trigger is only
+			checked for overlaps, which are reported as contact events
+			(see ContactEvents), and never makes contacts.
+		*/
+		bool isTrigger;
+
+		/*
+			Calculates the internals for the primitive. They are only
+			recalculated if the body's derived data has been since they
+			last were (or the primitive was marked dirty), so this costs
+			next to nothing for a body that hasn't moved.
+		*/
 		void calculateInternals();
 
+		// Makes the next calculateInternals recalculate the transform.
+		void markDirty()
+		{
+			transformBody = NULL;
+		}
+
 		/*
 			This is a convenience function to allow access to the 
 			axis vectors in the transform for this primitive.
@@ -51,6 +93,11 @@ namespace Physics_Engine
 			return transform;
 		}
 
+		PrimitiveType getType() const
+		{
+			return type;
+		}
+
 	protected:
 		/*
 			The resultant transform of the primitive. This is
@@ -58,12 +105,35 @@ namespace Physics_Engine
 			with the transform of the rigid body.
 		*/
 		Matrix3X4 transform;
+
+		// Set by each kind of primitive when it is made.
+		PrimitiveType type;
+
+		/*
+			Holds the body, and its transform version, that the transform
+			was last calculated from.
+		*/
+		const RigidBody *transformBody;
+		unsigned transformVersion;
+
+		CollisionPrimitive(PrimitiveType type)
+			: body(NULL), collisionGroup(1), collisionMask(~0u), isTrigger(false), type(type),
+			transformBody(NULL), transformVersion(0)
+		{
+
+		}
 	};
 
 	class CollisionSphere : public CollisionPrimitive
 	{
 	public:
 		real radius;
+
+		CollisionSphere()
+			: CollisionPrimitive(PRIMITIVE_SPHERE)
+		{
+
+		}
 	};
 
 	class CollisionPlane : public CollisionPrimitive
@@ -73,12 +143,69 @@ namespace Physics_Engine
 
 		// The distance of the plane from the origin.
 		real offset;
+
+		CollisionPlane()
+			: CollisionPrimitive(PRIMITIVE_PLANE)
+		{
+
+		}
 	};
 
 	class CollisionBox : public CollisionPrimitive
 	{
 	public:
 		Vector3 halfSize;
+
+		CollisionBox()
+			: CollisionPrimitive(PRIMITIVE_BOX)
+		{
+
+		}
+	};
+
+	/*
+		A function that decides whether a pair of primitives that passed
+		the group and mask test should be tested after all. The user data
+		is what was given with the function to the filter.
+	*/
+	typedef bool (*CollisionFilterCallback)(const CollisionPrimitive &one,
+		const CollisionPrimitive &two, void *userData);
+
+	/*
+		Decides which pairs of primitives go on to the narrow phase. It
+		is applied to the pairs found by the broad phase (or to every
+		pair, if there isn't one) before any CollisionDectector test, so
+		a pair that is filtered out costs no more than the check. The
+		group and mask bits are tested first, and the callback, if there
+		is one, only sees pairs that pass them.
+	*/
+	class CollisionFilter
+	{
+	protected:
+		CollisionFilterCallback callback;
+		void *userData;
+
+	public:
+		CollisionFilter()
+			: callback(NULL), userData(NULL)
+		{
+
+		}
+
+		// Sets the function to call for each pair, or NULL for none.
+		void setCallback(CollisionFilterCallback callback, void *userData = NULL)
+		{
+			CollisionFilter::callback = callback;
+			CollisionFilter::userData = userData;
+		}
+
+		bool shouldCollide(const CollisionPrimitive &one, const CollisionPrimitive &two) const
+		{
+			if (!(one.collisionGroup & two.collisionMask) || !(two.collisionGroup & one.collisionMask))
+				return false;
+
+			return !callback || callback(one, two, userData);
+		}
 	};
 
 	/*
@@ -95,12 +222,49 @@ namespace Physics_Engine
 
 		static bool boxAndBox(const CollisionBox &one, const CollisionBox &two);
 
+		static bool boxAndSphere(const CollisionBox &box, const CollisionSphere &sphere);
+
+		/*
+			The half space is solid behind the plane, so a box that is
+			completely behind it overlaps it.
+		*/
 		static bool boxAndHalfSpace(const CollisionBox &box, const CollisionPlane &plane);
+
+		/*
+			Picks the test for the types of the two primitives, whichever
+			order they are in, going down to the children of a compound.
+			Two planes never overlap.
+		*/
+		static bool overlap(const CollisionPrimitive &one, const CollisionPrimitive &two);
+	};
+
+	// The kinds of primitive pair the detectors handle, for counting what they find.
+	enum CollisionPairType
+	{
+		PAIR_SPHERE_SPHERE,
+		PAIR_SPHERE_HALFSPACE,
+		PAIR_BOX_HALFSPACE,
+		PAIR_BOX_SPHERE,
+		PAIR_BOX_BOX,
+		COLLISION_PAIR_TYPES
 	};
 
 	/*
 		A helper structure that contains information for the detector to use
 		in the building its contact data.
+
+		The contacts can either go into a fixed array, set up with
+		reset(maxContacts), or be allocated from an arena with
+		reset(arena). With an arena no contacts are ever lost: when the
+		space runs out a new chunk is started, and contacts already
+		written stay where they are. gatherContacts() then puts them
+		into one array for the resolver, which only copies anything in
+		the steps that overflowed.
+
+		The data keeps statistics across steps. After a step that
+		overflowed, the first chunk of later steps is made large enough
+		for it, so a simulation that has settled uses a single chunk
+		and never copies.
 	*/
 	struct CollisionData
 	{
@@ -128,10 +292,100 @@ namespace Physics_Engine
 		*/
 		real tolerance;
 
-		// Checks if there are more contacts avaible in the contact data.
+		// Holds the arena the contacts come from, or NULL if they are in a fixed array.
+		Arena *arena;
+
+		// Holds the number of contacts the first chunk of a step has room for.
+		unsigned chunkSize;
+
+		// Holds the most contacts found in a single step.
+		unsigned highWaterMark;
+
+		/*
+			Holds the number of times the contacts didn't fit during the
+			current step. With an arena each of these is a new chunk,
+			with a fixed array it is a detector that was turned away, and
+			its contacts are lost.
+		*/
+		unsigned overflows;
+
+		// Holds the number of overflows in all the steps so far.
+		unsigned totalOverflows;
+
+		/*
+			Holds the number of detector calls turned away in the current
+			step because a fixed array was full. Their contacts are lost.
+		*/
+		unsigned droppedTests;
+
+		/*
+			Holds the number of pairs of each type that were tested in the
+			current step, and how many of them made contacts. Pairs
+			skipped because neither body was awake aren't counted.
+		*/
+		unsigned pairTests[COLLISION_PAIR_TYPES];
+		unsigned pairHits[COLLISION_PAIR_TYPES];
+
+	protected:
+		struct ContactChunk
+		{
+			Contact *contacts;
+			unsigned count;
+		};
+
+		// Holds the chunks filled before the current one.
+		std::vector<ContactChunk> chunks;
+
+		// Holds the start of the chunk being written to.
+		Contact *chunkStart;
+
+	public:
+		CollisionData()
+			: contactArray(0), contacts(0), contactsLeft(0), contactCount(0),
+			friction(0), restitution(0), tolerance(0), arena(0), chunkSize(256),
+			highWaterMark(0), overflows(0), totalOverflows(0), droppedTests(0), chunkStart(0)
+		{
+			clearPairCounts();
+		}
+
+		/*
+			Checks if there are more contacts avaible in the contact data,
+			starting a new chunk if they come from an arena.
+		*/
 		bool hasMoreContacts()
 		{
-			return contactsLeft > 0;
+			return reserve(1);
+		}
+
+		/*
+			Makes room for the given number of contacts if it can. Returns
+			false if there is no room for any more at all.
+		*/
+		bool reserve(unsigned count)
+		{
+			if (contactsLeft >= (int)count)
+				return true;
+
+			if (arena)
+			{
+				addChunk(count);
+				return true;
+			}
+
+			if (contactsLeft > 0)
+				return true;
+
+			overflows++;
+			totalOverflows++;
+			droppedTests++;
+			return false;
+		}
+
+		// Puts the contacts found so far into a fixed order, by body id.
+		void sortContacts()
+		{
+			gatherContacts();
+			ContactResolver::sortContacts(contactArray, contactCount);
 		}
 
 		// Resets the data so that it has no used contacts recorded.
@@ -140,27 +394,72 @@ namespace Physics_Engine
 			contactsLeft = maxContacts;
 			contactCount = 0;
 			contacts = contactArray;
+			chunkStart = contactArray;
+			chunks.clear();
+			overflows = 0;
+			droppedTests = 0;
+			clearPairCounts();
+		}
+
+		/*
+			Resets the data to allocate its contacts from the arena. The
+			arena should have been reset for the step first.
+		*/
+		void reset(Arena *arena);
+
+		/*
+			Sets the room in the first chunk of each step, when the
+			number of contacts to expect is known.
+		*/
+		void presize(unsigned contacts)
+		{
+			chunkSize = contacts;
 		}
 
+		/*
+			Makes contactArray hold all the contacts found since the
+			reset, in the order they were found, and returns it.
+		*/
+		Contact* gatherContacts();
+
 		/*
 			Notifies the data that the given number of contacts have
-			been added.
+			been added by a test of the given type of pair.
 		*/
-		void addContacts(unsigned count)
+		void addContacts(unsigned count, CollisionPairType type)
 		{
+			if (count > 0)
+				pairHits[type]++;
+
 			// Reduce the number of contacts remaining, add number used.
 			contactsLeft -= count;
 			contactCount += count;
 
 			// Move the array forward
 			contacts += count;
+
+			if (contactCount > highWaterMark)
+				highWaterMark = contactCount;
+		}
+
+		void clearPairCounts()
+		{
+			for (unsigned i = 0; i < COLLISION_PAIR_TYPES; i++)
+				pairTests[i] = pairHits[i] = 0;
 		}
+
+	protected:
+		void addChunk(unsigned count);
 	};
 
 	/*
 		Each of the functions has the same format: it takes the details
 		of two objects, and a pointer to a contact array to fill. It
 		returns the number of contacts it wrote into the array.
+
+		No contacts are generated unless at least one of the objects
+		has a body that is awake and can move, nor for a pair with a
+		trigger in it (detect reports those as overlaps).
 	*/
 	class CollisionDectector
 	{
@@ -180,6 +479,25 @@ namespace Physics_Engine
 		static unsigned boxAndSphere(const CollisionBox &box, const CollisionSphere &sphere, CollisionData *data);
 
 		static unsigned boxAndBox(const CollisionBox &one, const CollisionBox &two, CollisionData *data);
+
+		/*
+			Tests the children of the compound whose bounds overlap the
+			other primitive (grown by the data's tolerance) against it.
+		*/
+		static unsigned compoundAndPrimitive(const CollisionCompound &compound,
+			const CollisionPrimitive &other, CollisionData *data, bool *triggered = NULL);
+
+		/*
+			Picks the test for the types of the two primitives, whichever
+			order they are in. Two planes never collide.
+
+			A pair with a trigger in it, including a trigger child of a
+			compound, is only tested for overlap and writes no contacts.
+			If triggered is given, it is set when such a pair overlaps,
+			so the caller can add the pair to its contact events.
+		*/
+		static unsigned detect(const CollisionPrimitive &one, const CollisionPrimitive &two,
+			CollisionData *data, bool *triggered = NULL);
 	};
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,717 @@
+#include "Query.h"
+#include "Compound.h"
+
+using namespace Physics_Engine;
+
+// The distance within which a moving sphere counts as touching a box.
+static const real castTolerance = (real)1e-6;
+
+// The most steps taken to close in on a box, see sweepSphereAndBox.
+static const unsigned maxCastSteps = 64;
+
+bool CollisionQuery::makeCast(const Ray &ray, ShapeCast *cast)
+{
+	real length = ray.direction.magnitude();
+	if (length == 0)
+		return false;
+
+	cast->type = CAST_RAY;
+	cast->origin = ray.origin;
+	cast->direction = ray.direction * ((real)1 / length);
+	cast->radius = 0;
+	cast->halfSize = Vector3();
+	return true;
+}
+
+Vector3 ShapeCast::getExpansion() const
+{
+	switch (type)
+	{
+	case CAST_SPHERE:
+		return Vector3(radius, radius, radius);
+
+	case CAST_BOX:
+	{
+		// The half sizes of the box's axis aligned bounds.
+		Vector3 expansion;
+		for (unsigned i = 0; i < 3; i++)
+		{
+			Vector3 axis = transform.getAxisVector(i) * halfSize[i];
+			expansion.x += real_abs(axis.x);
+			expansion.y += real_abs(axis.y);
+			expansion.z += real_abs(axis.z);
+		}
+		return expansion;
+	}
+
+	default:
+		return Vector3();
+	}
+}
+
+void ShapeCast::setBox(const Quaternion &orientation, const Vector3 &halfSize)
+{
+	type = CAST_BOX;
+	ShapeCast::halfSize = halfSize;
+
+	/*
+		Matrix3X4::setOrientationAndPos gives the transpose of the
+		rotation a body with this orientation has, so it is built here.
+	*/
+	const Quaternion &q = orientation;
+	transform.data[0] = 1 - 2 * q.j*q.j - 2 * q.k*q.k;
+	transform.data[1] = 2 * q.i*q.j - 2 * q.r*q.k;
+	transform.data[2] = 2 * q.i*q.k + 2 * q.r*q.j;
+	transform.data[3] = origin.x;
+
+	transform.data[4] = 2 * q.i*q.j + 2 * q.r*q.k;
+	transform.data[5] = 1 - 2 * q.i*q.i - 2 * q.k*q.k;
+	transform.data[6] = 2 * q.j*q.k - 2 * q.r*q.i;
+	transform.data[7] = origin.y;
+
+	transform.data[8] = 2 * q.i*q.k - 2 * q.r*q.j;
+	transform.data[9] = 2 * q.j*q.k + 2 * q.r*q.i;
+	transform.data[10] = 1 - 2 * q.i*q.i - 2 * q.j*q.j;
+	transform.data[11] = origin.z;
+}
+
+void OverlapQuery::setSphere(const Vector3 &center, real radius)
+{
+	shape.type = CAST_SPHERE;
+	shape.origin = center;
+	shape.direction = Vector3(1, 0, 0);
+	shape.radius = radius;
+	shape.halfSize = Vector3();
+}
+
+void OverlapQuery::setBox(const Vector3 &center, const Quaternion &orientation, const Vector3 &halfSize)
+{
+	shape.origin = center;
+	shape.direction = Vector3(1, 0, 0);
+	shape.radius = 0;
+	shape.setBox(orientation, halfSize);
+}
+
+void OverlapQuery::setAABB(const Vector3 &min, const Vector3 &max)
+{
+	setBox((min + max) * (real)0.5, Quaternion(1, 0, 0, 0), (max - min) * (real)0.5);
+}
+
+RaySegment OverlapQuery::getSegment() const
+{
+	return RaySegment(shape.origin, shape.direction, 0, shape.getExpansion());
+}
+
+bool CollisionQuery::overlapTest(const OverlapQuery &query, CollisionPrimitive &primitive)
+{
+	RaycastHit hit;
+	return CastTests::cast(query.shape, primitive, 0, &hit);
+}
+
+/*
+	Fills in a hit for something that starts inside the primitive, at
+	its origin and facing back along its direction.
+*/
+static inline bool startInside(const ShapeCast &cast, RaycastHit *hit)
+{
+	hit->point = cast.origin;
+	hit->normal = cast.direction * -1;
+	hit->distance = 0;
+	return true;
+}
+
+/*
+	Finds where a ray reaches the given distance from a point. Returns
+	false if it doesn't within the given distance along the ray. A ray
+	starting within it gives a distance of zero.
+*/
+static bool sweepSphere(const Vector3 &origin, const Vector3 &direction, real maxDistance,
+	const Vector3 &center, real radius, real *distance)
+{
+	Vector3 offset = origin - center;
+	real b = offset * direction;
+	real c = offset.squareMagnitude() - radius * radius;
+
+	if (c <= 0)
+	{
+		*distance = 0;
+		return true;
+	}
+
+	if (b > 0)
+		return false;
+
+	real discriminant = b * b - c;
+	if (discriminant < 0)
+		return false;
+
+	*distance = -b - real_sqrt(discriminant);
+	return *distance <= maxDistance;
+}
+
+/*
+	Finds where a ray (in the box's coordinates) enters a box centred on
+	the origin, and the axis of the face it enters through. Returns false
+	if it misses within the given distance. A ray starting inside gives
+	an entry of zero and an axis of 3.
+*/
+static bool sweepSlabs(const Vector3 &origin, const Vector3 &direction, const Vector3 &halfSize,
+	real maxDistance, real *entry, real *exit, unsigned *axis)
+{
+	real tEnter = -REAL_MAX;
+	real tExit = REAL_MAX;
+	*axis = 3;
+
+	for (unsigned i = 0; i < 3; i++)
+	{
+		// Parallel to the slab, so either always in it or never.
+		if (direction[i] == 0)
+		{
+			if (real_abs(origin[i]) > halfSize[i])
+				return false;
+			continue;
+		}
+
+		real inverse = (real)1 / direction[i];
+		real t1 = (-halfSize[i] - origin[i]) * inverse;
+		real t2 = (halfSize[i] - origin[i]) * inverse;
+		if (t1 > t2)
+		{
+			real swap = t1;
+			t1 = t2;
+			t2 = swap;
+		}
+
+		if (t1 > tEnter)
+		{
+			tEnter = t1;
+			*axis = i;
+		}
+		if (t2 < tExit)
+			tExit = t2;
+
+		if (tEnter > tExit)
+			return false;
+	}
+
+	if (tExit < 0 || tEnter > maxDistance)
+		return false;
+
+	if (tEnter <= 0)
+	{
+		tEnter = 0;
+		*axis = 3;
+	}
+
+	*entry = tEnter;
+	*exit = tExit;
+	return true;
+}
+
+// Returns the point of a box centred on the origin closest to the given point.
+static inline Vector3 clampToBox(const Vector3 &point, const Vector3 &halfSize)
+{
+	Vector3 result = point;
+	for (unsigned i = 0; i < 3; i++)
+	{
+		if (result[i] > halfSize[i])
+			result[i] = halfSize[i];
+		if (result[i] < -halfSize[i])
+			result[i] = -halfSize[i];
+	}
+	return result;
+}
+
+/*
+	Moves a sphere (in the box's coordinates) toward a box centred on
+	the origin, and finds where it first touches. The closest point on
+	the box and the box's outward normal there are written out, unless
+	the sphere starts touching the box (which gives a distance of zero).
+
+	The box grown by the radius on each side is entered at or before
+	the sphere touches (they only differ at the edges and corners), so
+	the sphere starts there and is moved on by its distance from the
+	box less its radius, which can't take it past the box. At a face
+	the first step is already touching.
+*/
+static bool sweepSphereAndBox(const Vector3 &center, const Vector3 &direction, const Vector3 &halfSize,
+	real radius, real maxDistance, real *distance, Vector3 *closest, Vector3 *normal)
+{
+	Vector3 grown = halfSize + Vector3(radius, radius, radius);
+
+	real entry, exit;
+	unsigned axis;
+	if (!sweepSlabs(center, direction, grown, maxDistance, &entry, &exit, &axis))
+		return false;
+
+	real t = entry;
+	for (unsigned step = 0; step < maxCastSteps; step++)
+	{
+		Vector3 position = center + direction * t;
+		Vector3 point = clampToBox(position, halfSize);
+		Vector3 offset = position - point;
+		real gap = offset.magnitude();
+
+		if (gap <= radius + castTolerance)
+		{
+			*distance = t;
+			if (t == 0 || gap == 0)
+				return true;
+
+			*closest = point;
+			*normal = offset * ((real)1 / gap);
+			return true;
+		}
+
+		t += gap - radius;
+		if (t > exit || t > maxDistance)
+			return false;
+	}
+
+	return false;
+}
+
+/*
+	Returns the point of a box furthest along the given direction. Axes
+	across the direction are left at the centre, so a face or an edge
+	facing the direction gives its middle.
+*/
+static Vector3 supportPoint(const Matrix3X4 &transform, const Vector3 &halfSize, const Vector3 &direction)
+{
+	Vector3 point = transform.getAxisVector(3);
+	for (unsigned i = 0; i < 3; i++)
+	{
+		Vector3 axis = transform.getAxisVector(i);
+		real along = axis * direction;
+		if (along > castTolerance)
+			point += axis * halfSize[i];
+		else if (along < -castTolerance)
+			point -= axis * halfSize[i];
+	}
+	return point;
+}
+
+// Returns the half length of the box's projection onto the axis.
+static inline real projectBox(const Matrix3X4 &transform, const Vector3 &halfSize, const Vector3 &axis)
+{
+	return halfSize.x * real_abs(axis * transform.getAxisVector(0)) +
+		halfSize.y * real_abs(axis * transform.getAxisVector(1)) +
+		halfSize.z * real_abs(axis * transform.getAxisVector(2));
+}
+
+void CollisionQuery::closestPoint(const Vector3 &point, CollisionPrimitive &primitive, RaycastHit *hit)
+{
+	hit->body = primitive.body;
+	hit->primitive = &primitive;
+	hit->point = point;
+	hit->normal = Vector3();
+	hit->distance = 0;
+
+	switch (primitive.getType())
+	{
+	case PRIMITIVE_SPHERE:
+	{
+		const CollisionSphere &sphere = static_cast<const CollisionSphere&>(primitive);
+		Vector3 offset = point - sphere.getAxis(3);
+		real distance = offset.magnitude();
+		if (distance <= sphere.radius)
+			return;
+
+		hit->normal = offset * ((real)1 / distance);
+		hit->point = sphere.getAxis(3) + hit->normal * sphere.radius;
+		hit->distance = distance - sphere.radius;
+		return;
+	}
+
+	case PRIMITIVE_BOX:
+	{
+		const CollisionBox &box = static_cast<const CollisionBox&>(primitive);
+		Vector3 local = box.getTransform().transformInverse(point);
+		Vector3 clamped = clampToBox(local, box.halfSize);
+		if (clamped.x == local.x && clamped.y == local.y && clamped.z == local.z)
+			return;
+
+		hit->point = box.getTransform().transform(clamped);
+		Vector3 offset = point - hit->point;
+		hit->distance = offset.magnitude();
+		hit->normal = offset * ((real)1 / hit->distance);
+		return;
+	}
+
+	case PRIMITIVE_PLANE:
+	{
+		const CollisionPlane &plane = static_cast<const CollisionPlane&>(primitive);
+		real height = plane.normal * point - plane.offset;
+		if (height <= 0)
+			return;
+
+		hit->point = point - plane.normal * height;
+		hit->normal = plane.normal;
+		hit->distance = height;
+		return;
+	}
+
+	case PRIMITIVE_COMPOUND:
+	{
+		// The closest point on any child, or nowhere for a compound with none.
+		const CollisionCompound &compound = static_cast<const CollisionCompound&>(primitive);
+		hit->distance = REAL_MAX;
+		for (unsigned i = 0; i < compound.getChildCount(); i++)
+		{
+			CollisionPrimitive *child = compound.getChild(i);
+			child->calculateInternals();
+
+			RaycastHit childHit;
+			closestPoint(point, *child, &childHit);
+			if (childHit.distance < hit->distance)
+				*hit = childHit;
+		}
+		return;
+	}
+	}
+}
+
+/*
+	Finds how far something travels before reaching a plane, given the
+	height of its lowest point above the plane and how fast it moves
+	toward it for each unit it travels.
+*/
+static bool sweepHalfSpace(real height, real approach, real maxDistance, real *distance)
+{
+	if (height <= 0)
+	{
+		*distance = 0;
+		return true;
+	}
+
+	if (approach <= 0)
+		return false;
+
+	*distance = height / approach;
+	return *distance <= maxDistance;
+}
+
+bool CastTests::rayAndSphere(const ShapeCast &cast, const CollisionSphere &sphere,
+	real maxDistance, RaycastHit *hit)
+{
+	return sphereAndSphere(cast, sphere, maxDistance, hit);
+}
+
+bool CastTests::sphereAndSphere(const ShapeCast &cast, const CollisionSphere &sphere,
+	real maxDistance, RaycastHit *hit)
+{
+	// A ray is a sphere with no radius.
+	Vector3 center = sphere.getAxis(3);
+	real distance;
+	if (!sweepSphere(cast.origin, cast.direction, maxDistance, center, sphere.radius + cast.radius, &distance))
+		return false;
+
+	if (distance == 0)
+		return startInside(cast, hit);
+
+	Vector3 normal = cast.origin + cast.direction * distance - center;
+	normal.normalise();
+
+	hit->normal = normal;
+	hit->point = center + normal * sphere.radius;
+	hit->distance = distance;
+	return true;
+}
+
+bool CastTests::rayAndBox(const ShapeCast &cast, const CollisionBox &box,
+	real maxDistance, RaycastHit *hit)
+{
+	const Matrix3X4 &transform = box.getTransform();
+	Vector3 origin = transform.transformInverse(cast.origin);
+	Vector3 direction = transform.transformInverseDirection(cast.direction);
+
+	real entry, exit;
+	unsigned axis;
+	if (!sweepSlabs(origin, direction, box.halfSize, maxDistance, &entry, &exit, &axis))
+		return false;
+
+	if (axis == 3)
+		return startInside(cast, hit);
+
+	// The face entered faces back along the ray.
+	Vector3 normal;
+	normal[axis] = direction[axis] > 0 ? -1 : 1;
+
+	hit->normal = transform.transformDirection(normal);
+	hit->point = cast.origin + cast.direction * entry;
+	hit->distance = entry;
+	return true;
+}
+
+bool CastTests::rayAndHalfSpace(const ShapeCast &cast, const CollisionPlane &plane,
+	real maxDistance, RaycastHit *hit)
+{
+	return sphereAndHalfSpace(cast, plane, maxDistance, hit);
+}
+
+bool CastTests::sphereAndBox(const ShapeCast &cast, const CollisionBox &box,
+	real maxDistance, RaycastHit *hit)
+{
+	if (cast.radius <= 0)
+		return rayAndBox(cast, box, maxDistance, hit);
+
+	const Matrix3X4 &transform = box.getTransform();
+	Vector3 center = transform.transformInverse(cast.origin);
+	Vector3 direction = transform.transformInverseDirection(cast.direction);
+
+	real distance;
+	Vector3 closest, normal;
+	if (!sweepSphereAndBox(center, direction, box.halfSize, cast.radius, maxDistance,
+		&distance, &closest, &normal))
+	{
+		return false;
+	}
+
+	if (distance == 0)
+		return startInside(cast, hit);
+
+	hit->normal = transform.transformDirection(normal);
+	hit->point = transform.transform(closest);
+	hit->distance = distance;
+	return true;
+}
+
+bool CastTests::sphereAndHalfSpace(const ShapeCast &cast, const CollisionPlane &plane,
+	real maxDistance, RaycastHit *hit)
+{
+	real height = plane.normal * cast.origin - cast.radius - plane.offset;
+
+	real distance;
+	if (!sweepHalfSpace(height, -(plane.normal * cast.direction), maxDistance, &distance))
+		return false;
+
+	if (distance == 0)
+		return startInside(cast, hit);
+
+	hit->normal = plane.normal;
+	hit->point = cast.origin - plane.normal * cast.radius + cast.direction * distance;
+	hit->distance = distance;
+	return true;
+}
+
+bool CastTests::boxAndSphere(const ShapeCast &cast, const CollisionSphere &sphere,
+	real maxDistance, RaycastHit *hit)
+{
+	/*
+		Moving the box toward the sphere is the same as moving the
+		sphere the other way toward the box, which is done in the
+		box's coordinates.
+	*/
+	Vector3 center = cast.transform.transformInverse(sphere.getAxis(3));
+	Vector3 direction = cast.transform.transformInverseDirection(cast.direction * -1);
+
+	real distance;
+	Vector3 closest, normal;
+	if (!sweepSphereAndBox(center, direction, cast.halfSize, sphere.radius, maxDistance,
+		&distance, &closest, &normal))
+	{
+		return false;
+	}
+
+	if (distance == 0)
+		return startInside(cast, hit);
+
+	// The box's normal faces the sphere, the sphere's faces back at the box.
+	hit->normal = cast.transform.transformDirection(normal) * -1;
+	hit->point = cast.transform.transform(closest) + cast.direction * distance;
+	hit->distance = distance;
+	return true;
+}
+
+bool CastTests::boxAndBox(const ShapeCast &cast, const CollisionBox &box,
+	real maxDistance, RaycastHit *hit)
+{
+	/*
+		The boxes overlap once their projections overlap on every one
+		of the fifteen separating axes (the axes of each box, and the
+		products of each pair of them). The cast box touches the other
+		when the last axis to close closes, as long as that is before
+		the first one opens again.
+	*/
+	const Matrix3X4 &other = box.getTransform();
+	Vector3 offset = other.getAxisVector(3) - cast.transform.getAxisVector(3);
+
+	real tEnter = -REAL_MAX;
+	real tExit = REAL_MAX;
+	unsigned enterIndex = 0;
+	Vector3 enterAxis;
+	real enterSide = 0;
+
+	for (unsigned index = 0; index < 15; index++)
+	{
+		Vector3 axis;
+		if (index < 3)
+			axis = cast.transform.getAxisVector(index);
+		else if (index < 6)
+			axis = other.getAxisVector(index - 3);
+		else
+		{
+			axis = cast.transform.getAxisVector((index - 6) / 3) %
+				other.getAxisVector((index - 6) % 3);
+
+			// Parallel edges give no axis, the face axes cover them.
+			if (axis.squareMagnitude() < (real)0.001)
+				continue;
+			axis.normalise();
+		}
+
+		real reach = projectBox(cast.transform, cast.halfSize, axis) +
+			projectBox(other, box.halfSize, axis);
+		real separation = offset * axis;
+		real speed = cast.direction * axis;
+
+		if (real_abs(speed) < castTolerance)
+		{
+			if (real_abs(separation) > reach)
+				return false;
+			continue;
+		}
+
+		real t1 = (separation - reach) / speed;
+		real t2 = (separation + reach) / speed;
+		if (t1 > t2)
+		{
+			real swap = t1;
+			t1 = t2;
+			t2 = swap;
+		}
+
+		if (t1 > tEnter)
+		{
+			tEnter = t1;
+			enterIndex = index;
+			enterAxis = axis;
+			enterSide = separation - speed * t1;
+		}
+		if (t2 < tExit)
+			tExit = t2;
+
+		if (tEnter > tExit)
+			return false;
+	}
+
+	if (tExit < 0 || tEnter > maxDistance)
+		return false;
+
+	if (tEnter <= 0)
+		return startInside(cast, hit);
+
+	// The normal faces from the other box toward the cast box.
+	Vector3 normal = enterSide > 0 ? enterAxis * -1 : enterAxis;
+
+	/*
+		The point is on the feature of one box that meets a face of the
+		other, or between the two edges for an edge-edge contact.
+	*/
+	Matrix3X4 moved = cast.transform;
+	moved.data[3] += cast.direction.x * tEnter;
+	moved.data[7] += cast.direction.y * tEnter;
+	moved.data[11] += cast.direction.z * tEnter;
+
+	Vector3 otherPoint = supportPoint(other, box.halfSize, normal);
+	Vector3 castPoint = supportPoint(moved, cast.halfSize, normal * -1);
+
+	if (enterIndex < 3)
+		hit->point = otherPoint;
+	else if (enterIndex < 6)
+		hit->point = castPoint;
+	else
+		hit->point = (otherPoint + castPoint) * (real)0.5;
+
+	hit->normal = normal;
+	hit->distance = tEnter;
+	return true;
+}
+
+bool CastTests::boxAndHalfSpace(const ShapeCast &cast, const CollisionPlane &plane,
+	real maxDistance, RaycastHit *hit)
+{
+	real height = plane.normal * cast.transform.getAxisVector(3) -
+		projectBox(cast.transform, cast.halfSize, plane.normal) - plane.offset;
+
+	real distance;
+	if (!sweepHalfSpace(height, -(plane.normal * cast.direction), maxDistance, &distance))
+		return false;
+
+	if (distance == 0)
+		return startInside(cast, hit);
+
+	hit->normal = plane.normal;
+	hit->point = supportPoint(cast.transform, cast.halfSize, plane.normal * -1) +
+		cast.direction * distance;
+	hit->distance = distance;
+	return true;
+}
+
+bool CastTests::cast(const ShapeCast &cast, CollisionPrimitive &primitive,
+	real maxDistance, RaycastHit *hit)
+{
+	bool found = false;
+
+	switch (primitive.getType())
+	{
+	case PRIMITIVE_SPHERE:
+	{
+		const CollisionSphere &sphere = static_cast<const CollisionSphere&>(primitive);
+		if (cast.type == CAST_BOX)
+			found = boxAndSphere(cast, sphere, maxDistance, hit);
+		else
+			found = sphereAndSphere(cast, sphere, maxDistance, hit);
+		break;
+	}
+
+	case PRIMITIVE_BOX:
+	{
+		const CollisionBox &box = static_cast<const CollisionBox&>(primitive);
+		if (cast.type == CAST_BOX)
+			found = boxAndBox(cast, box, maxDistance, hit);
+		else if (cast.type == CAST_SPHERE)
+			found = sphereAndBox(cast, box, maxDistance, hit);
+		else
+			found = rayAndBox(cast, box, maxDistance, hit);
+		break;
+	}
+
+	case PRIMITIVE_PLANE:
+	{
+		const CollisionPlane &plane = static_cast<const CollisionPlane&>(primitive);
+		if (cast.type == CAST_BOX)
+			found = boxAndHalfSpace(cast, plane, maxDistance, hit);
+		else
+			found = sphereAndHalfSpace(cast, plane, maxDistance, hit);
+		break;
+	}
+
+	case PRIMITIVE_COMPOUND:
+	{
+		// The nearest hit on any child is reported, with the child as its primitive.
+		const CollisionCompound &compound = static_cast<const CollisionCompound&>(primitive);
+		for (unsigned i = 0; i < compound.getChildCount(); i++)
+		{
+			CollisionPrimitive *child = compound.getChild(i);
+			child->calculateInternals();
+
+			RaycastHit childHit;
+			if (CastTests::cast(cast, *child, maxDistance, &childHit))
+			{
+				maxDistance = childHit.distance;
+				*hit = childHit;
+				found = true;
+			}
+		}
+		return found;
+	}
+	}
+
+	if (found)
+	{
+		hit->primitive = &primitive;
+		hit->body = primitive.body;
+	}
+	return found;
+}
\ No newline at end of file
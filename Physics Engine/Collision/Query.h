@@ -0,0 +1,730 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "BroadPhase.h"
+#include "NarrowPhase.h"
+
+namespace Physics_Engine
+{
+	// A ray for the queries. The direction doesn't need to be of unit length.
+	struct Ray
+	{
+		Vector3 origin;
+		Vector3 direction;
+		real maxDistance;
+
+		Ray()
+			: maxDistance(REAL_MAX)
+		{
+
+		}
+
+		Ray(const Vector3 &origin, const Vector3 &direction, real maxDistance = REAL_MAX)
+			: origin(origin), direction(direction), maxDistance(maxDistance)
+		{
+
+		}
+	};
+
+	/*
+		Holds where a ray or a moving shape hit a primitive. The point is
+		on the surface of the primitive, and the normal is the primitive's
+		surface normal there, facing back toward the ray or shape. The
+		distance is how far the ray or shape travelled along its (unit)
+		direction. Something that starts inside a primitive hits it at a
+		distance of zero, at its origin, with the normal facing back
+		along the direction.
+	*/
+	struct RaycastHit
+	{
+		RigidBody *body;
+		CollisionPrimitive *primitive;
+		Vector3 point;
+		Vector3 normal;
+		real distance;
+
+		RaycastHit()
+			: body(NULL), primitive(NULL), distance(0)
+		{
+
+		}
+	};
+
+	// The kinds of thing that can be cast.
+	enum CastType
+	{
+		CAST_RAY,
+		CAST_SPHERE,
+		CAST_BOX
+	};
+
+	/*
+		Describes a ray or a shape to be moved through the world. A box
+		is given by its transform (at the start of the cast) and its
+		half sizes. The direction must be of unit length.
+	*/
+	struct ShapeCast
+	{
+		CastType type;
+		Vector3 origin;
+		Vector3 direction;
+		real radius;
+		Matrix3X4 transform;
+		Vector3 halfSize;
+
+		// Returns the growth of each axis of a volume needed for the shape to hit it.
+		Vector3 getExpansion() const;
+
+		/*
+			Makes this a box cast, from the origin with the given
+			orientation. The transform is built the same way as a rigid
+			body's.
+		*/
+		void setBox(const Quaternion &orientation, const Vector3 &halfSize);
+	};
+
+	/*
+		Describes a region to test for overlaps: a sphere, a box with
+		any orientation, or an axis aligned box. It is held as a cast
+		that goes nowhere, so it overlaps whatever the cast would hit
+		at a distance of zero.
+	*/
+	struct OverlapQuery
+	{
+		ShapeCast shape;
+
+		void setSphere(const Vector3 &center, real radius);
+		void setBox(const Vector3 &center, const Quaternion &orientation, const Vector3 &halfSize);
+		void setAABB(const Vector3 &min, const Vector3 &max);
+
+		// Returns the segment that finds the volumes the region might overlap.
+		RaySegment getSegment() const;
+	};
+
+	/*
+		Holds a primitive found by an overlap query, and the index of the
+		query that found it (which is zero unless it was in a batch).
+	*/
+	struct OverlapHit
+	{
+		RigidBody *body;
+		CollisionPrimitive *primitive;
+		unsigned query;
+
+		OverlapHit()
+			: body(NULL), primitive(NULL), query(0)
+		{
+
+		}
+
+		OverlapHit(CollisionPrimitive *primitive, unsigned query)
+			: body(primitive->body), primitive(primitive), query(query)
+		{
+
+		}
+	};
+
+	/*
+		A wrapper class that holds the exact tests of a ray or a moving
+		shape against a single primitive, in the style of
+		IntersectionTests. Each returns true if the primitive is hit
+		within the given distance, and fills in the hit (except for its
+		body and primitive).
+	*/
+	class CastTests
+	{
+	public:
+		static bool rayAndSphere(const ShapeCast &cast, const CollisionSphere &sphere,
+			real maxDistance, RaycastHit *hit);
+		static bool rayAndBox(const ShapeCast &cast, const CollisionBox &box,
+			real maxDistance, RaycastHit *hit);
+		static bool rayAndHalfSpace(const ShapeCast &cast, const CollisionPlane &plane,
+			real maxDistance, RaycastHit *hit);
+
+		static bool sphereAndSphere(const ShapeCast &cast, const CollisionSphere &sphere,
+			real maxDistance, RaycastHit *hit);
+		static bool sphereAndBox(const ShapeCast &cast, const CollisionBox &box,
+			real maxDistance, RaycastHit *hit);
+		static bool sphereAndHalfSpace(const ShapeCast &cast, const CollisionPlane &plane,
+			real maxDistance, RaycastHit *hit);
+
+		static bool boxAndSphere(const ShapeCast &cast, const CollisionSphere &sphere,
+			real maxDistance, RaycastHit *hit);
+		static bool boxAndBox(const ShapeCast &cast, const CollisionBox &box,
+			real maxDistance, RaycastHit *hit);
+		static bool boxAndHalfSpace(const ShapeCast &cast, const CollisionPlane &plane,
+			real maxDistance, RaycastHit *hit);
+
+		/*
+			Picks the test for the cast and the type of primitive, and
+			fills in the hit's body and primitive as well. A compound is
+			hit where its nearest child is, and the hit has the child as
+			its primitive.
+		*/
+		static bool cast(const ShapeCast &cast, CollisionPrimitive &primitive,
+			real maxDistance, RaycastHit *hit);
+	};
+
+	/*
+		Spatial queries against a bounding volume hierarchy (see
+		BVH_Node), so a query only tests the primitives near its path
+		rather than every primitive in the world. Only leaves inserted
+		with a primitive are reported. Planes have no bounds, so can't
+		be in a hierarchy; they can be tested directly with CastTests.
+
+		The queries only read the hierarchy, so any number of them can
+		run at once on different threads, as long as nothing changes
+		the hierarchy meanwhile. None of them allocate any memory.
+	*/
+	class CollisionQuery
+	{
+	public:
+		/*
+			Finds the first primitive hit by the ray. Returns false, leaving
+			the hit alone, if nothing is hit.
+		*/
+		template<class BoundingVolumeClass>
+		static bool raycast(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray, RaycastHit *hit);
+
+		/*
+			Writes every primitive hit by the ray to the given array (up to
+			the given limit), in no particular order. Returns the number
+			written.
+		*/
+		template<class BoundingVolumeClass>
+		static unsigned raycastAll(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray,
+			RaycastHit *hits, unsigned limit);
+
+		// As raycast and raycastAll, for a sphere moved along the ray.
+		template<class BoundingVolumeClass>
+		static bool sphereCast(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray,
+			real radius, RaycastHit *hit);
+
+		template<class BoundingVolumeClass>
+		static unsigned sphereCastAll(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray,
+			real radius, RaycastHit *hits, unsigned limit);
+
+		/*
+			As raycast and raycastAll, for a box with the given orientation
+			and half sizes moved along the ray from the ray's origin.
+		*/
+		template<class BoundingVolumeClass>
+		static bool boxCast(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray,
+			const Quaternion &orientation, const Vector3 &halfSize, RaycastHit *hit);
+
+		template<class BoundingVolumeClass>
+		static unsigned boxCastAll(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray,
+			const Quaternion &orientation, const Vector3 &halfSize, RaycastHit *hits, unsigned limit);
+
+		/*
+			Finds the first hit of each of the given rays, writing it to
+			the hit with the same index. Rays that hit nothing have a hit
+			with no primitive. The rays go down the hierarchy four at a
+			time, so each volume is loaded once for four rays and tested
+			against them together (with SIMD where it is available).
+			Returns the number of rays that hit something.
+		*/
+		template<class BoundingVolumeClass>
+		static unsigned raycastBatch(const BVH_Node<BoundingVolumeClass> *root, const Ray *rays,
+			unsigned count, RaycastHit *hits);
+
+		/*
+			Writes every primitive overlapping the sphere, box or axis
+			aligned box to the given array (up to the given limit), in no
+			particular order. Returns the number written.
+		*/
+		template<class BoundingVolumeClass>
+		static unsigned overlapSphere(const BVH_Node<BoundingVolumeClass> *root, const Vector3 &center,
+			real radius, OverlapHit *hits, unsigned limit);
+
+		template<class BoundingVolumeClass>
+		static unsigned overlapBox(const BVH_Node<BoundingVolumeClass> *root, const Vector3 &center,
+			const Quaternion &orientation, const Vector3 &halfSize, OverlapHit *hits, unsigned limit);
+
+		template<class BoundingVolumeClass>
+		static unsigned overlapAABB(const BVH_Node<BoundingVolumeClass> *root, const Vector3 &min,
+			const Vector3 &max, OverlapHit *hits, unsigned limit);
+
+		template<class BoundingVolumeClass>
+		static unsigned overlap(const BVH_Node<BoundingVolumeClass> *root, const OverlapQuery &query,
+			OverlapHit *hits, unsigned limit);
+
+		/*
+			Answers all the given overlap queries, writing the primitives
+			each one finds to the one array (up to the given limit), with
+			the index of the query that found it. The queries go down the
+			hierarchy together, up to overlapBatchSize at a time, so each
+			volume is loaded once for all of them. Returns the number of
+			hits written.
+		*/
+		template<class BoundingVolumeClass>
+		static unsigned overlapBatch(const BVH_Node<BoundingVolumeClass> *root, const OverlapQuery *queries,
+			unsigned count, OverlapHit *hits, unsigned limit);
+
+		/*
+			Finds the (up to) k primitives nearest the point, within the
+			given distance, and writes them to the given array nearest
+			first. Each hit holds the closest point on the primitive, the
+			normal from there toward the point, and the distance; a point
+			inside a primitive is at a distance of zero, with no normal.
+			Returns the number found.
+		*/
+		template<class BoundingVolumeClass>
+		static unsigned nearest(const BVH_Node<BoundingVolumeClass> *root, const Vector3 &point,
+			unsigned k, RaycastHit *hits, real maxDistance = REAL_MAX);
+
+		/*
+			As nearest, for each of the given points. The hits for point i
+			start at hits[i * k], and how many there are is written to
+			counts[i]. Returns the total number found.
+		*/
+		template<class BoundingVolumeClass>
+		static unsigned nearestBatch(const BVH_Node<BoundingVolumeClass> *root, const Vector3 *points,
+			unsigned count, unsigned k, RaycastHit *hits, unsigned *counts, real maxDistance = REAL_MAX);
+
+		/*
+			Sets up a cast from a ray, giving the direction unit length.
+			Returns false if the ray has no direction.
+		*/
+		static bool makeCast(const Ray &ray, ShapeCast *cast);
+
+		// Checks whether the region of the query overlaps the primitive.
+		static bool overlapTest(const OverlapQuery &query, CollisionPrimitive &primitive);
+
+		/*
+			Fills in the hit with the point on the primitive closest to the
+			given point, as for nearest. For a compound it is the closest
+			point on any child, and the hit has that child as its primitive.
+		*/
+		static void closestPoint(const Vector3 &point, CollisionPrimitive &primitive, RaycastHit *hit);
+
+		// The most overlap queries that go down the hierarchy together.
+		static const unsigned overlapBatchSize = 32;
+
+	protected:
+		template<class BoundingVolumeClass>
+		static bool castFirst(const BVH_Node<BoundingVolumeClass> *root, const ShapeCast &cast,
+			real maxDistance, RaycastHit *hit);
+
+		template<class BoundingVolumeClass>
+		static void castFirstBelow(const BVH_Node<BoundingVolumeClass> *node, const ShapeCast &cast,
+			const RaySegment &segment, real &best, RaycastHit *hit);
+
+		template<class BoundingVolumeClass>
+		static unsigned castAll(const BVH_Node<BoundingVolumeClass> *node, const ShapeCast &cast,
+			const RaySegment &segment, RaycastHit *hits, unsigned limit);
+
+		template<class BoundingVolumeClass>
+		static void castPacket(const BVH_Node<BoundingVolumeClass> *node, const ShapeCast *casts,
+			RayPacket &packet, unsigned mask, RaycastHit *hits);
+
+		/*
+			Adds the overlaps of the queries in the mask (bit i for query
+			i) below the node, numbering them from the given first index.
+		*/
+		template<class BoundingVolumeClass>
+		static void overlapGroup(const BVH_Node<BoundingVolumeClass> *node, const OverlapQuery *queries,
+			const RaySegment *segments, unsigned mask, unsigned first, OverlapHit *hits, unsigned limit,
+			unsigned &count);
+
+		template<class BoundingVolumeClass>
+		static void nearestBelow(const BVH_Node<BoundingVolumeClass> *node, const Vector3 &point,
+			unsigned k, RaycastHit *hits, unsigned &found, real maxDistance);
+	};
+
+	template<class BoundingVolumeClass>
+	bool CollisionQuery::raycast(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray, RaycastHit *hit)
+	{
+		ShapeCast cast;
+		if (!makeCast(ray, &cast))
+			return false;
+
+		return castFirst(root, cast, ray.maxDistance, hit);
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::raycastAll(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray,
+		RaycastHit *hits, unsigned limit)
+	{
+		ShapeCast cast;
+		if (!root || !makeCast(ray, &cast))
+			return 0;
+
+		RaySegment segment(cast.origin, cast.direction, ray.maxDistance);
+		return castAll(root, cast, segment, hits, limit);
+	}
+
+	template<class BoundingVolumeClass>
+	bool CollisionQuery::sphereCast(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray,
+		real radius, RaycastHit *hit)
+	{
+		ShapeCast cast;
+		if (!makeCast(ray, &cast))
+			return false;
+
+		cast.type = CAST_SPHERE;
+		cast.radius = radius;
+		return castFirst(root, cast, ray.maxDistance, hit);
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::sphereCastAll(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray,
+		real radius, RaycastHit *hits, unsigned limit)
+	{
+		ShapeCast cast;
+		if (!root || !makeCast(ray, &cast))
+			return 0;
+
+		cast.type = CAST_SPHERE;
+		cast.radius = radius;
+
+		RaySegment segment(cast.origin, cast.direction, ray.maxDistance, cast.getExpansion());
+		return castAll(root, cast, segment, hits, limit);
+	}
+
+	template<class BoundingVolumeClass>
+	bool CollisionQuery::boxCast(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray,
+		const Quaternion &orientation, const Vector3 &halfSize, RaycastHit *hit)
+	{
+		ShapeCast cast;
+		if (!makeCast(ray, &cast))
+			return false;
+
+		cast.setBox(orientation, halfSize);
+		return castFirst(root, cast, ray.maxDistance, hit);
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::boxCastAll(const BVH_Node<BoundingVolumeClass> *root, const Ray &ray,
+		const Quaternion &orientation, const Vector3 &halfSize, RaycastHit *hits, unsigned limit)
+	{
+		ShapeCast cast;
+		if (!root || !makeCast(ray, &cast))
+			return 0;
+
+		cast.setBox(orientation, halfSize);
+
+		RaySegment segment(cast.origin, cast.direction, ray.maxDistance, cast.getExpansion());
+		return castAll(root, cast, segment, hits, limit);
+	}
+
+	template<class BoundingVolumeClass>
+	bool CollisionQuery::castFirst(const BVH_Node<BoundingVolumeClass> *root, const ShapeCast &cast,
+		real maxDistance, RaycastHit *hit)
+	{
+		if (!root)
+			return false;
+
+		RaySegment segment(cast.origin, cast.direction, maxDistance, cast.getExpansion());
+
+		real entry;
+		if (!root->volume.intersectsRay(segment, &entry))
+			return false;
+
+		// Each hit shortens the ray, so only nearer hits are looked for after it.
+		real best = maxDistance;
+		RaycastHit closest;
+		castFirstBelow(root, cast, segment, best, &closest);
+
+		if (!closest.primitive)
+			return false;
+
+		*hit = closest;
+		return true;
+	}
+
+	template<class BoundingVolumeClass>
+	void CollisionQuery::castFirstBelow(const BVH_Node<BoundingVolumeClass> *node, const ShapeCast &cast,
+		const RaySegment &segment, real &best, RaycastHit *hit)
+	{
+		if (node->isLeaf())
+		{
+			RaycastHit leafHit;
+			if (node->primitive && CastTests::cast(cast, *node->primitive, best, &leafHit))
+			{
+				best = leafHit.distance;
+				*hit = leafHit;
+			}
+			return;
+		}
+
+		/*
+			Visit the child the ray reaches first, so a hit there can rule
+			out the other child without going into it.
+		*/
+		real entries[2];
+		bool reached[2];
+		reached[0] = node->children[0]->volume.intersectsRay(segment, &entries[0]);
+		reached[1] = node->children[1]->volume.intersectsRay(segment, &entries[1]);
+
+		unsigned first = (reached[1] && (!reached[0] || entries[1] < entries[0])) ? 1 : 0;
+		for (unsigned i = 0; i < 2; i++)
+		{
+			unsigned child = i == 0 ? first : 1 - first;
+			if (reached[child] && entries[child] <= best)
+				castFirstBelow(node->children[child], cast, segment, best, hit);
+		}
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::castAll(const BVH_Node<BoundingVolumeClass> *node, const ShapeCast &cast,
+		const RaySegment &segment, RaycastHit *hits, unsigned limit)
+	{
+		real entry;
+		if (limit == 0 || !node->volume.intersectsRay(segment, &entry))
+			return 0;
+
+		if (node->isLeaf())
+		{
+			if (!node->primitive || !CastTests::cast(cast, *node->primitive, segment.length, hits))
+				return 0;
+
+			return 1;
+		}
+
+		unsigned count = castAll(node->children[0], cast, segment, hits, limit);
+		if (count < limit)
+			count += castAll(node->children[1], cast, segment, hits + count, limit - count);
+		return count;
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::raycastBatch(const BVH_Node<BoundingVolumeClass> *root, const Ray *rays,
+		unsigned count, RaycastHit *hits)
+	{
+		unsigned hitCount = 0;
+		for (unsigned start = 0; start < count; start += 4)
+		{
+			ShapeCast casts[4];
+			RayPacket packet;
+			unsigned mask = 0;
+
+			for (unsigned lane = 0; lane < 4; lane++)
+			{
+				/*
+					Unused lanes are still filled in, with an empty ray, so
+					the SIMD tests never read anything uninitialised.
+				*/
+				unsigned index = start + lane;
+				if (index < count)
+					hits[index] = RaycastHit();
+
+				if (index < count && root && makeCast(rays[index], &casts[lane]))
+				{
+					packet.set(lane, RaySegment(casts[lane].origin, casts[lane].direction, rays[index].maxDistance));
+					mask |= 1 << lane;
+				}
+				else
+				{
+					packet.set(lane, RaySegment(Vector3(), Vector3(1, 0, 0), 0));
+				}
+			}
+
+			if (mask)
+				castPacket(root, casts, packet, mask, hits + start);
+
+			for (unsigned lane = 0; lane < 4 && start + lane < count; lane++)
+			{
+				if (hits[start + lane].primitive)
+					hitCount++;
+			}
+		}
+		return hitCount;
+	}
+
+	template<class BoundingVolumeClass>
+	void CollisionQuery::castPacket(const BVH_Node<BoundingVolumeClass> *node, const ShapeCast *casts,
+		RayPacket &packet, unsigned mask, RaycastHit *hits)
+	{
+		mask = node->volume.intersectsRays(packet, mask);
+		if (!mask)
+			return;
+
+		if (node->isLeaf())
+		{
+			if (!node->primitive)
+				return;
+
+			for (unsigned lane = 0; lane < 4; lane++)
+			{
+				RaycastHit hit;
+				if ((mask & (1 << lane)) &&
+					CastTests::cast(casts[lane], *node->primitive, packet.length[lane], &hit))
+				{
+					// Shorten the ray, so anything further away is skipped.
+					hits[lane] = hit;
+					packet.length[lane] = hit.distance;
+				}
+			}
+			return;
+		}
+
+		castPacket(node->children[0], casts, packet, mask, hits);
+		castPacket(node->children[1], casts, packet, mask, hits);
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::overlapSphere(const BVH_Node<BoundingVolumeClass> *root, const Vector3 &center,
+		real radius, OverlapHit *hits, unsigned limit)
+	{
+		OverlapQuery query;
+		query.setSphere(center, radius);
+		return overlap(root, query, hits, limit);
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::overlapBox(const BVH_Node<BoundingVolumeClass> *root, const Vector3 &center,
+		const Quaternion &orientation, const Vector3 &halfSize, OverlapHit *hits, unsigned limit)
+	{
+		OverlapQuery query;
+		query.setBox(center, orientation, halfSize);
+		return overlap(root, query, hits, limit);
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::overlapAABB(const BVH_Node<BoundingVolumeClass> *root, const Vector3 &min,
+		const Vector3 &max, OverlapHit *hits, unsigned limit)
+	{
+		OverlapQuery query;
+		query.setAABB(min, max);
+		return overlap(root, query, hits, limit);
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::overlap(const BVH_Node<BoundingVolumeClass> *root, const OverlapQuery &query,
+		OverlapHit *hits, unsigned limit)
+	{
+		if (!root)
+			return 0;
+
+		RaySegment segment = query.getSegment();
+		unsigned count = 0;
+		overlapGroup(root, &query, &segment, 1, 0, hits, limit, count);
+		return count;
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::overlapBatch(const BVH_Node<BoundingVolumeClass> *root, const OverlapQuery *queries,
+		unsigned count, OverlapHit *hits, unsigned limit)
+	{
+		if (!root)
+			return 0;
+
+		unsigned hitCount = 0;
+		for (unsigned start = 0; start < count && hitCount < limit; start += overlapBatchSize)
+		{
+			unsigned size = count - start;
+			if (size > overlapBatchSize)
+				size = overlapBatchSize;
+
+			RaySegment segments[overlapBatchSize];
+			for (unsigned i = 0; i < size; i++)
+				segments[i] = queries[start + i].getSegment();
+
+			unsigned mask = size == overlapBatchSize ? ~0u : (1u << size) - 1;
+			overlapGroup(root, queries + start, segments, mask, start, hits, limit, hitCount);
+		}
+		return hitCount;
+	}
+
+	template<class BoundingVolumeClass>
+	void CollisionQuery::overlapGroup(const BVH_Node<BoundingVolumeClass> *node, const OverlapQuery *queries,
+		const RaySegment *segments, unsigned mask, unsigned first, OverlapHit *hits, unsigned limit,
+		unsigned &count)
+	{
+		real entry;
+		unsigned reached = 0;
+		for (unsigned i = 0; i < overlapBatchSize; i++)
+		{
+			if ((mask & (1u << i)) && node->volume.intersectsRay(segments[i], &entry))
+				reached |= 1u << i;
+		}
+
+		if (!reached)
+			return;
+
+		if (node->isLeaf())
+		{
+			if (!node->primitive)
+				return;
+
+			for (unsigned i = 0; i < overlapBatchSize && count < limit; i++)
+			{
+				if ((reached & (1u << i)) && overlapTest(queries[i], *node->primitive))
+					hits[count++] = OverlapHit(node->primitive, first + i);
+			}
+			return;
+		}
+
+		overlapGroup(node->children[0], queries, segments, reached, first, hits, limit, count);
+		if (count < limit)
+			overlapGroup(node->children[1], queries, segments, reached, first, hits, limit, count);
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::nearest(const BVH_Node<BoundingVolumeClass> *root, const Vector3 &point,
+		unsigned k, RaycastHit *hits, real maxDistance)
+	{
+		if (!root || k == 0)
+			return 0;
+
+		unsigned found = 0;
+		nearestBelow(root, point, k, hits, found, maxDistance);
+		return found;
+	}
+
+	template<class BoundingVolumeClass>
+	unsigned CollisionQuery::nearestBatch(const BVH_Node<BoundingVolumeClass> *root, const Vector3 *points,
+		unsigned count, unsigned k, RaycastHit *hits, unsigned *counts, real maxDistance)
+	{
+		unsigned total = 0;
+		for (unsigned i = 0; i < count; i++)
+		{
+			counts[i] = nearest(root, points[i], k, hits + i * k, maxDistance);
+			total += counts[i];
+		}
+		return total;
+	}
+
+	template<class BoundingVolumeClass>
+	void CollisionQuery::nearestBelow(const BVH_Node<BoundingVolumeClass> *node, const Vector3 &point,
+		unsigned k, RaycastHit *hits, unsigned &found, real maxDistance)
+	{
+		if (node->isLeaf())
+		{
+			if (!node->primitive)
+				return;
+
+			RaycastHit hit;
+			closestPoint(point, *node->primitive, &hit);
+
+			// Once the array is full, only something nearer than its last hit gets in.
+			if (found == k ? hit.distance >= hits[k - 1].distance : hit.distance > maxDistance)
+				return;
+
+			unsigned index = found < k ? found++ : k - 1;
+			for (; index > 0 && hits[index - 1].distance > hit.distance; index--)
+				hits[index] = hits[index - 1];
+			hits[index] = hit;
+			return;
+		}
+
+		/*
+			Visit the nearer child first, so the hits it finds can rule out
+			the other child without going into it.
+		*/
+		real distances[2];
+		distances[0] = node->children[0]->volume.getDistance(point);
+		distances[1] = node->children[1]->volume.getDistance(point);
+
+		unsigned first = distances[1] < distances[0] ? 1 : 0;
+		for (unsigned i = 0; i < 2; i++)
+		{
+			unsigned child = i == 0 ? first : 1 - first;
+			real furthest = found == k ? hits[k - 1].distance : maxDistance;
+			if (distances[child] <= furthest)
+				nearestBelow(node->children[child], point, k, hits, found, maxDistance);
+		}
+	}
+}
+#endif
\ No newline at end of file
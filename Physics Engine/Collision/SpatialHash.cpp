@@ -0,0 +1,135 @@
+#include "SpatialHash.h"
+#include "../World/profiler.h"
+#include <algorithm>
+#include <assert.h>
+
+using namespace Physics_Engine;
+
+SpatialHash::SpatialHash(real cellSize)
+	: tableSize(0)
+{
+	setCellSize(cellSize);
+}
+
+void SpatialHash::setCellSize(real cellSize)
+{
+	assert(cellSize > 0);
+	SpatialHash::cellSize = cellSize;
+	inverseCellSize = ((real)1.0) / cellSize;
+}
+
+real SpatialHash::getCellSize() const
+{
+	return cellSize;
+}
+
+unsigned SpatialHash::getCount() const
+{
+	return (unsigned)cellEntries.size();
+}
+
+inline int SpatialHash::cellCoord(real value) const
+{
+	return (int)floor(value * inverseCellSize);
+}
+
+inline unsigned SpatialHash::hashCell(int x, int y, int z) const
+{
+	// Large primes, the multiplication is done unsigned so it wraps.
+	unsigned h = ((unsigned)x * 92837111u) ^ ((unsigned)y * 689287499u) ^ ((unsigned)z * 283923481u);
+	return h % tableSize;
+}
+
+void SpatialHash::build(const Vector3 *positions, unsigned count)
+{
+	PROFILE_ZONE("SpatialHash::build");
+
+	/*
+		Twice as many buckets as points keeps the chains short without
+		wasting much memory.
+	*/
+	tableSize = 2 * count + 1;
+
+	cellStart.assign(tableSize + 1, 0);
+	cellEntries.resize(count);
+	pointBuckets.resize(count);
+
+	// Count the points in each bucket.
+	for (unsigned i = 0; i < count; i++)
+	{
+		const Vector3 &p = positions[i];
+		unsigned bucket = hashCell(cellCoord(p.x), cellCoord(p.y), cellCoord(p.z));
+
+		pointBuckets[i] = bucket;
+		cellStart[bucket]++;
+	}
+
+	// Turn the counts into the end of each bucket's range.
+	unsigned start = 0;
+	for (unsigned b = 0; b < tableSize; b++)
+	{
+		start += cellStart[b];
+		cellStart[b] = start;
+	}
+	cellStart[tableSize] = start;
+
+	/*
+		Fill the buckets from the back, which leaves cellStart holding
+		the start of each bucket's range.
+	*/
+	for (unsigned i = 0; i < count; i++)
+	{
+		cellEntries[--cellStart[pointBuckets[i]]] = i;
+	}
+}
+
+unsigned SpatialHash::query(const Vector3 &min, const Vector3 &max, std::vector<unsigned> &results) const
+{
+	results.clear();
+
+	if (cellEntries.empty())
+		return 0;
+
+	int x0 = cellCoord(min.x), x1 = cellCoord(max.x);
+	int y0 = cellCoord(min.y), y1 = cellCoord(max.y);
+	int z0 = cellCoord(min.z), z1 = cellCoord(max.z);
+
+	/*
+		If the box covers more cells than there are buckets, every bucket
+		is touched anyway, so just return all the points.
+	*/
+	double cells = (double)(x1 - x0 + 1) * (double)(y1 - y0 + 1) * (double)(z1 - z0 + 1);
+	if (cells >= (double)tableSize)
+	{
+		results.assign(cellEntries.begin(), cellEntries.end());
+		return (unsigned)results.size();
+	}
+
+	/*
+		Different cells can hash to the same bucket, so collect the
+		buckets first and only read each of them once.
+	*/
+	queryBuckets.clear();
+	for (int x = x0; x <= x1; x++)
+	{
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int z = z0; z <= z1; z++)
+			{
+				queryBuckets.push_back(hashCell(x, y, z));
+			}
+		}
+	}
+	std::sort(queryBuckets.begin(), queryBuckets.end());
+	std::vector<unsigned>::iterator last = std::unique(queryBuckets.begin(), queryBuckets.end());
+
+	for (std::vector<unsigned>::iterator b = queryBuckets.begin(); b != last; b++)
+	{
+		for (unsigned e = cellStart[*b]; e < cellStart[*b + 1]; e++)
+		{
+			results.push_back(cellEntries[e]);
+		}
+	}
+
+	return (unsigned)results.size();
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include "../Math/core.h"
+#include <vector>
+
+namespace Physics_Engine
+{
+	/*
+		A uniform grid of cells stored in a hash table, used to find the
+		points near a region without testing every pair of points. The
+		table is rebuilt from scratch with a counting sort each time the
+		points move, so both building and querying are linear in the
+		number of points involved (there is no O(n^2) pass anywhere).
+	*/
+	class SpatialHash
+	{
+	protected:
+		real cellSize;
+		real inverseCellSize;
+
+		// Holds the number of buckets in the hash table.
+		unsigned tableSize;
+
+		/*
+			Holds the first entry of each bucket in cellEntries. The
+			entries of bucket b are in the range [cellStart[b], cellStart[b + 1]),
+			so the array has one more element than there are buckets.
+		*/
+		std::vector<unsigned> cellStart;
+
+		// Holds the point indices sorted by bucket.
+		std::vector<unsigned> cellEntries;
+
+		// Holds the bucket of each point (kept to avoid rehashing in build).
+		std::vector<unsigned> pointBuckets;
+
+		// Holds the buckets touched by a query, so each is only read once.
+		mutable std::vector<unsigned> queryBuckets;
+
+	public:
+		SpatialHash(real cellSize = 1);
+
+		/*
+			Sets the size of a grid cell. This should be about the size of
+			the largest region that is queried, so a query only touches a
+			handful of cells. Takes effect on the next build.
+		*/
+		void setCellSize(real cellSize);
+		real getCellSize() const;
+
+		// Returns the number of points inserted by the last build.
+		unsigned getCount() const;
+
+		/*
+			Rebuilds the table from the given positions. The index of each
+			position in the array is what is returned by the queries.
+		*/
+		void build(const Vector3 *positions, unsigned count);
+
+		/*
+			Writes the indices of all the points in the cells overlapping
+			the given box into the results (which is cleared first). The
+			results may contain points outside the box, callers are expected
+			to do their own exact test. Returns the number of results.
+		*/
+		unsigned query(const Vector3 &min, const Vector3 &max, std::vector<unsigned> &results) const;
+
+	protected:
+		int cellCoord(real value) const;
+		unsigned hashCell(int x, int y, int z) const;
+	};
+}
+#endif
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "contacts.h"
+#include "../World/profiler.h"
 #include <assert.h>
+#include <limits.h>
+#include <algorithm>
 
 using namespace Physics_Engine;
 
@@ -224,7 +227,7 @@ inline Vector3 Contact::calculateFrictionlessImpulse(Matrix3X3 *inverseInertiaTe
 	return impulseContact;
 }
 
-inline Vector3 Contact::calculateFrictionImpulse(Matrix3X3 * inverseInertiaTensor)
+Vector3 Contact::calculateFrictionImpulse(Matrix3X3 * inverseInertiaTensor)
 {
 	Vector3 impulseContact;
 	real inverseMass = body[0]->getInverseMass();
@@ -476,13 +479,14 @@ void Contact::applyPositionChange(Vector3 linearChange[2], Vector3 angularChange
 			Vector3 pos;
 			body[i]->getPosition(&pos);
 			pos.addScaledVector(contactNormal, linearMove[i]);
-			body[i]->setPosition(pos);
 
 			// And the change in orientation.
 			Quaternion q;
 			body[i]->getOrientation(&q);
 			q.addScaledVector(angularChange[i], ((real)1.0));
-			body[i]->setOrientation(q);
+
+			// The body is still interpolated from where it started the step.
+			body[i]->moveTo(pos, q);
 
 			/*
 				We need to calculate the derived data for any body that is
@@ -499,12 +503,16 @@ void Contact::applyPositionChange(Vector3 linearChange[2], Vector3 angularChange
 
 
 ContactResolver::ContactResolver(unsigned iterations, real velocityEpsilon, real positionEpsilon)
+	: velocityIterationsUsed(0), positionIterationsUsed(0), residualPenetration(0),
+	residualVelocity(0), deterministic(false)
 {
 	setIterations(iterations, iterations);
 	setEpsilon(velocityEpsilon, positionEpsilon);
 }
 
 ContactResolver::ContactResolver(unsigned velocityIterations, unsigned positionIterations, real velocityEpsilon, real positionEpsilon)
+	: velocityIterationsUsed(0), positionIterationsUsed(0), residualPenetration(0),
+	residualVelocity(0), deterministic(false)
 {
 	setIterations(velocityIterations, positionIterations);
 	setEpsilon(velocityEpsilon, positionEpsilon);
@@ -527,6 +535,100 @@ void ContactResolver::setEpsilon(real velocityEpsilion, real positionEpsilon)
 	ContactResolver::positionEpsilon = positionEpsilon;
 }
 
+void ContactResolver::setDeterministic(bool deterministic)
+{
+	ContactResolver::deterministic = deterministic;
+}
+
+void ContactResolver::setTimeBudget(real microseconds)
+{
+	timeBudget.setBudget(microseconds);
+}
+
+real ContactResolver::getTimeBudget() const
+{
+	return timeBudget.getBudget();
+}
+
+bool ContactResolver::wasBudgetExhausted() const
+{
+	return timeBudget.wasExhausted();
+}
+
+bool ContactResolver::isDeterministic() const
+{
+	return deterministic;
+}
+
+// Gives contacts with the scenery an id after every body.
+static inline unsigned contactBodyId(const Contact &contact, unsigned index)
+{
+	return contact.body[index] ? contact.body[index]->getId() : UINT_MAX;
+}
+
+// Orders two vectors by their components in turn.
+static inline int compareVectors(const Vector3 &a, const Vector3 &b)
+{
+	for (unsigned i = 0; i < 3; i++)
+	{
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+	Orders contacts by the ids of their bodies, and contacts between the
+	same bodies by where they are, so contacts generated in any order end
+	up in the same order.
+*/
+static bool contactBefore(const Contact &a, const Contact &b)
+{
+	unsigned idA = contactBodyId(a, 0), idB = contactBodyId(b, 0);
+	if (idA != idB)
+		return idA < idB;
+
+	idA = contactBodyId(a, 1);
+	idB = contactBodyId(b, 1);
+	if (idA != idB)
+		return idA < idB;
+
+	int order = compareVectors(a.contactPoint, b.contactPoint);
+	if (order == 0)
+		order = compareVectors(a.contactNormal, b.contactNormal);
+	if (order != 0)
+		return order < 0;
+
+	return a.penetration < b.penetration;
+}
+
+void ContactResolver::sortContacts(Contact *contactArray, unsigned numContacts)
+{
+	/*
+		A pair can be generated either way round, so each contact is
+		turned to have the body with the lower id first. The scenery
+		counts as the highest id, so it always ends up second.
+	*/
+	for (unsigned i = 0; i < numContacts; i++)
+	{
+		if (contactBodyId(contactArray[i], 1) < contactBodyId(contactArray[i], 0))
+			contactArray[i].swapBodies();
+	}
+
+	std::stable_sort(contactArray, contactArray + numContacts, contactBefore);
+}
+
+/*
+	Checks if two contact bodies are the same body. Comparing addresses
+	for equality doesn't depend on where the bodies are in memory, and
+	works whatever ids the bodies have. The scenery (NULL) is never a
+	match.
+*/
+static inline bool sameBody(const RigidBody *one, const RigidBody *two)
+{
+	return one && one == two;
+}
+
 /*
 	********************************************************
 					The contact resolver.
@@ -534,6 +636,11 @@ void ContactResolver::setEpsilon(real velocityEpsilion, real positionEpsilon)
 */
 void ContactResolver::resolveContacts(Contact * contacts, unsigned numContacts, real duration)
 {
+	PROFILE_ZONE("ContactResolver::resolveContacts");
+
+	velocityIterationsUsed = positionIterationsUsed = 0;
+	residualPenetration = residualVelocity = 0;
+
 	// Make sure we have something to do.
 	if (numContacts == 0)
 		return;
@@ -541,6 +648,11 @@ void ContactResolver::resolveContacts(Contact * contacts, unsigned numContacts,
 	if (!isValid())
 		return;
 
+	if (deterministic)
+		sortContacts(contacts, numContacts);
+
+	timeBudget.begin();
+
 	// Prepare the contacts for processing.
 	prepareContacts(contacts, numContacts, duration);
 
@@ -549,10 +661,23 @@ void ContactResolver::resolveContacts(Contact * contacts, unsigned numContacts,
 
 	// Resolve the velocity problems with the contacts.
 	adjustVelocities(contacts, numContacts, duration);
+
+	timeBudget.end();
+
+	// Record how far from resolved the contacts were left.
+	for (unsigned i = 0; i < numContacts; i++)
+	{
+		if (contacts[i].penetration > residualPenetration)
+			residualPenetration = contacts[i].penetration;
+		if (contacts[i].desiredDeltaVelocity > residualVelocity)
+			residualVelocity = contacts[i].desiredDeltaVelocity;
+	}
 }
 
 void ContactResolver::prepareContacts(Contact* contacts, unsigned numContacts, real duration)
 {
+	PROFILE_ZONE("ContactResolver::prepareContacts");
+
 	// Generate contact velocity and axis information.
 	Contact* lastContact = contacts + numContacts;
 	for (Contact* contact = contacts; contact < lastContact; contact++)
@@ -564,6 +689,8 @@ void ContactResolver::prepareContacts(Contact* contacts, unsigned numContacts, r
 
 void ContactResolver::adjustVelocities(Contact *contacts, unsigned numContacts, real duration)
 {
+	PROFILE_ZONE("ContactResolver::adjustVelocities");
+
 	Vector3 velocityChange[2], rotationChange[2];
 	Vector3 deltaVelocity;
 
@@ -599,7 +726,7 @@ void ContactResolver::adjustVelocities(Contact *contacts, unsigned numContacts,
 		{
 			// Check each body in the contact.
 			for (unsigned bodyIndex = 0; bodyIndex < 2; bodyIndex++)
-				if(contacts[index].body[bodyIndex])
+				if(contacts[i].body[bodyIndex])
 			{
 				/*
 					Check for a math with each body in the 
@@ -607,7 +734,7 @@ void ContactResolver::adjustVelocities(Contact *contacts, unsigned numContacts,
 				*/
 				for (unsigned d = 0; d < 2; d++)
 				{
-					if (contacts[i].body[bodyIndex] == contacts[index].body[d])
+					if (sameBody(contacts[i].body[bodyIndex], contacts[index].body[d]))
 					{
 						deltaVelocity = velocityChange[d] + rotationChange[d].
 							vectorProduct(contacts[i].relativeContactPosition[bodyIndex]);
@@ -625,11 +752,17 @@ void ContactResolver::adjustVelocities(Contact *contacts, unsigned numContacts,
 			}
 		}
 		velocityIterationsUsed++;
+
+		// The clock is never looked at in deterministic mode.
+		if (!deterministic && timeBudget.hasExpired())
+			break;
 	}
 }
 
 void ContactResolver::adjustPositions(Contact *contacts, unsigned numContacts, real duration)
 {
+	PROFILE_ZONE("ContactResolver::adjustPositions");
+
 	unsigned i, index;
 	Vector3 linearChange[2], angularChange[2];
 	real max;
@@ -672,7 +805,7 @@ void ContactResolver::adjustPositions(Contact *contacts, unsigned numContacts, r
 				// Check for a match with each body in the newly resolved contact.
 				for (unsigned d = 0; d < 2; d++)
 				{
-					if (contacts[i].body[bodyIndex] == contacts[index].body[d])
+					if (sameBody(contacts[i].body[bodyIndex], contacts[index].body[d]))
 					{
 						deltaPosition = linearChange[d] + angularChange[d].vectorProduct(contacts[i].relativeContactPosition[bodyIndex]);
 
@@ -687,5 +820,9 @@ void ContactResolver::adjustPositions(Contact *contacts, unsigned numContacts, r
 			}
 		}
 		positionIterationsUsed++;
+
+		// Leave half the time for the velocities.
+		if (!deterministic && timeBudget.hasExpired((real)0.5))
+			break;
 	}
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "../Dynamics/body.h"
 #include "../Math/core.h"
+#include "../World/budget.h"
 
 namespace Physics_Engine
 {
@@ -74,10 +75,27 @@ namespace Physics_Engine
 		unsigned velocityIterationsUsed;
 		unsigned positionIterationsUsed;
 
+		/*
+			Holds the deepest penetration and the largest velocity change
+			still wanted by any contact after the last resolution. They
+			are below the epsilons unless the iterations ran out.
+		*/
+		real residualPenetration;
+		real residualVelocity;
+
 	private:
 		// Keeps track of whether the internal setting are valid.
 		bool validSettings;
 
+		/*
+			Holds whether the contacts are sorted before they are
+			resolved, see setDeterministic.
+		*/
+		bool deterministic;
+
+		// Holds the time each call to resolveContacts may take, see setTimeBudget.
+		TimeBudget timeBudget;
+
 	public:
 		ContactResolver(unsigned iterations, real velocityEpsilon = (real)0.01,
 			real positionEpsilon = (real)0.01);
@@ -96,6 +114,48 @@ namespace Physics_Engine
 		void setIterations(unsigned iterations);
 		void setEpsilon(real velocityEpsilion, real positionEpsilon);
 
+		/*
+			In deterministic mode the contacts are put in a fixed order
+			before they are resolved (see sortContacts), so the result
+			doesn't depend on the order the contacts were generated in (by
+			different threads, for example). The time budget is ignored in
+			this mode, as it would make the iterations depend on the clock.
+		*/
+		void setDeterministic(bool deterministic);
+		bool isDeterministic() const;
+
+		/*
+			Limits the time each call to resolveContacts may take, in
+			microseconds, or removes the limit if it is zero. The position
+			pass may use half the time, and the velocity pass the rest.
+
+			With a budget the resolver adapts to the load: the passes
+			still stop as soon as every contact is within the epsilons, so
+			a quiet scene is resolved fully, while in a busy one they stop
+			when the time runs out. The error left over stays in the
+			bodies, where it is found again by the next step's contacts
+			and, being the worst, resolved first. Setting the iterations
+			high (such as a few per contact) then leaves the budget and the
+			epsilons to decide when to stop.
+
+			The budget has no effect in deterministic mode, where the
+			iterations and epsilons alone decide when to stop.
+		*/
+		void setTimeBudget(real microseconds);
+		real getTimeBudget() const;
+
+		// Returns true if the last call to resolveContacts ran out of time.
+		bool wasBudgetExhausted() const;
+
+		/*
+			Sorts the contacts by the ids of their first and then second
+			bodies (contacts with the scenery last), after turning each
+			contact to have the lower id first. Contacts between the same
+			bodies are ordered by their points, normals and penetrations,
+			so the order doesn't depend on the order of generation.
+		*/
+		static void sortContacts(Contact *contactArray, unsigned numContacts);
+
 		/*
 			Resolves a set of contacts for both penetration and velocity.
 			Contacts that cannot interact with each other should be
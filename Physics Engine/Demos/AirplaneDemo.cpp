@@ -98,7 +98,7 @@ void AirplaneDemo::Update(float duration)
 	if (pos.y < 0.0f)
 	{
 		pos.y = 0.0f;
-		aircraft.setPosition(pos);
+		aircraft.moveTo(pos, aircraft.getOrientation());
 
 		if (aircraft.getVelocity().y < -10.0f)
 		{
@@ -3,22 +3,193 @@
 #include "../Dynamics/particle.h"
 #include "../Dynamics/constraint.h"
 #include "../Dynamics/cloth.h"
+#include "../Dynamics/softbody.h"
+#include "../Collision/Compound.h"
+#include "../DebugRender/DebugDrawManager.h"
 #include <iostream>
+#include <vector>
 
 #include <GL\glut.h>
 
 Cloth  cloth(10, 10, 50, 50);
 Sphere sphere(Vector3(7, -5, 0), 1.5f);
 
+/*
+	A crate on the ground for the cloth to fall onto. The crate is kept
+	in a hierarchy, which the cloth goes down to find what it touches.
+	The ground is level with the grid.
+*/
+RigidBody scenery;
+CollisionBox crate;
+CollisionPlane ground;
+BVH_Node<BoundingBox> *sceneryTree = NULL;
+
+/*
+	The same sheet simulated with XPBD by a soft body, which X switches
+	to and C switches back from. It is slightly stretchy, as a perfectly
+	stiff sheet has nowhere to go when it crumples on the ground.
+*/
+SoftBody softCloth;
+std::vector<unsigned> softClothTriangles;
+unsigned softClothColumns = 50;
+bool useSoftCloth = false;
+
+// The soft body collides with the ball through a primitive that follows it.
+RigidBody ball;
+CollisionSphere ballCollider;
+
+// The vertices of the cloth, written by it each frame for drawing.
+static std::vector<float> clothVertices;
+
+static void drawCloth(const Cloth &cloth)
+{
+	clothVertices.resize(cloth.getVertexCount() * CLOTH_VERTEX_SIZE);
+	cloth.writeVertices(&clothVertices[0], (unsigned)clothVertices.size());
+
+	GLsizei stride = CLOTH_VERTEX_SIZE * sizeof(float);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, stride, &clothVertices[0]);
+	glNormalPointer(GL_FLOAT, stride, &clothVertices[3]);
+
+	// Each column of triangles is drawn with one call in its own colour.
+	const unsigned *triangles = cloth.getTriangles();
+	unsigned columnIndices = (cloth.getRowCount() - 1) * 6;
+	for (unsigned x = 0; x < cloth.getColumnCount() - 1; x++)
+	{
+		if (x % 2)
+			glColor3d(0.3f, 0.3f, 0.3f);
+		else
+			glColor3d(0.2f, 0.4f, 0.9f);
+
+		glDrawElements(GL_TRIANGLES, columnIndices, GL_UNSIGNED_INT, &triangles[x * columnIndices]);
+	}
+
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+// Marks the corners the cloth hangs from, and draws the normal of each vertex.
+static void debugDrawCloth(const Cloth &cloth)
+{
+	clothVertices.resize(cloth.getVertexCount() * CLOTH_VERTEX_SIZE);
+	unsigned count = cloth.writeVertices(&clothVertices[0], (unsigned)clothVertices.size());
+
+	const float *first = &clothVertices[0];
+	const float *last = &clothVertices[(cloth.getColumnCount() - 1) * CLOTH_VERTEX_SIZE];
+	g_debugDrawManager.AddCross(Vector3(first[0], first[1], first[2]), Vector3(0.0f, 0.5f, 0.0f), 0.5f);
+	g_debugDrawManager.AddCross(Vector3(last[0], last[1], last[2]), Vector3(0.0f, 0.5f, 0.0f), 0.5f);
+
+	const Vector3 *normals = cloth.getNormals();
+	for (unsigned i = 0; i < count; i++)
+	{
+		const float *vertex = &clothVertices[i * CLOTH_VERTEX_SIZE];
+		Vector3 position(vertex[0], vertex[1], vertex[2]);
+		g_debugDrawManager.AddLine(position, normals[i] + position, Vector3(1, 0, 0), 0.04f);
+	}
+}
+
+// Pushes each triangle of the soft cloth along its normal, as for Cloth::addWindForce.
+static void addSoftClothWind(const Vector3 &wind)
+{
+	for (unsigned i = 0; i < softClothTriangles.size(); i += 3)
+	{
+		const unsigned *triangle = &softClothTriangles[i];
+		Vector3 a = softCloth.getPosition(triangle[0]);
+		Vector3 normal = (softCloth.getPosition(triangle[1]) - a) % (softCloth.getPosition(triangle[2]) - a);
+		normal.normalise();
+
+		Vector3 force = normal * (normal * wind * ((real)1.0 / 3));
+		softCloth.addForce(triangle[0], force);
+		softCloth.addForce(triangle[1], force);
+		softCloth.addForce(triangle[2], force);
+	}
+}
+
+static void drawSoftCloth()
+{
+	glBegin(GL_TRIANGLES);
+	for (unsigned i = 0; i < softClothTriangles.size(); i += 3)
+	{
+		// There are two triangles in each cell, and a row of cells between each row of particles.
+		if ((i / 6) % (softClothColumns - 1) % 2)
+			glColor3d(0.3f, 0.3f, 0.3f);
+		else
+			glColor3d(0.9f, 0.4f, 0.2f);
+
+		Vector3 a = softCloth.getPosition(softClothTriangles[i]);
+		Vector3 b = softCloth.getPosition(softClothTriangles[i + 1]);
+		Vector3 c = softCloth.getPosition(softClothTriangles[i + 2]);
+		Vector3 normal = (b - a) % (c - a);
+		normal.normalise();
+
+		glNormal3d(normal.x, normal.y, normal.z);
+		glVertex3d(a.x, a.y, a.z);
+		glVertex3d(b.x, b.y, b.z);
+		glVertex3d(c.x, c.y, c.z);
+	}
+	glEnd();
+}
+
+ClothDemo::ClothDemo()
+{
+	cloth.setSelfCollision(true, 0.05f);
+
+	scenery.setPosition(Vector3(9, -7, 3));
+	scenery.setOrientation(Quaternion(1, 0, 0, 0));
+	scenery.calculateDerivedData();
+	crate.body = &scenery;
+	crate.halfSize = Vector3(1.5f, 1, 1.5f);
+	crate.calculateInternals();
+
+	sceneryTree = new BVH_Node<BoundingBox>(NULL,
+		CollisionCompound::getPrimitiveBounds(crate), &scenery, &crate);
+
+	ground.normal = Vector3(0, 1, 0);
+	ground.offset = -8;
+
+	ball.setOrientation(Quaternion(1, 0, 0, 0));
+	ballCollider.body = &ball;
+	ballCollider.radius = sphere.radius;
+
+	unsigned first = softCloth.addSheet(Vector3(), 10, 10, softClothColumns, softClothColumns,
+		softClothTriangles, 1e-5f, 0.1f);
+	softCloth.setInverseMass(first, 0);
+	softCloth.setInverseMass(first + softClothColumns - 1, 0);
+	softCloth.setDamping(0.2f);
+	softCloth.addCollider(&ballCollider);
+	softCloth.addCollider(&crate);
+	softCloth.addCollider(&ground);
+}
+
+ClothDemo::~ClothDemo()
+{
+	delete sceneryTree;
+}
+
 void ClothDemo::Update(float duration)
 {
 	if (duration <= 0.0f)
 		return;
 
+	if (useSoftCloth)
+	{
+		ball.setPosition(sphere.pos);
+		ball.calculateDerivedData();
+		ballCollider.calculateInternals();
+
+		addSoftClothWind(Vector3(5, 0, 2));
+		softCloth.step(duration);
+		return;
+	}
+
 	cloth.addForce(Vector3(0.0, -0.02, 0.0));
 	cloth.addWindForce(Vector3(0.5, 0, 0.2));
 	cloth.timeStep(duration);
 	cloth.ballCollision(sphere);
+	cloth.collide(sceneryTree);
+	cloth.collide(ground);
+	cloth.updateNormals();
 }
 
 void ClothDemo::KeyInput(GLFWwindow *window)
@@ -31,6 +202,11 @@ void ClothDemo::KeyInput(GLFWwindow *window)
 		sphere.pos.x -= 0.2f * (0.5f * 0.5f);
 	if (keyPressed(window, GLFW_KEY_D))
 		sphere.pos.x += 0.2f * (0.5f * 0.5f);
+
+	if (keyPressed(window, GLFW_KEY_X))
+		useSoftCloth = true;
+	if (keyPressed(window, GLFW_KEY_C))
+		useSoftCloth = false;
 }
 
 bool ClothDemo::keyPressed(GLFWwindow *window, int key)
@@ -66,7 +242,17 @@ void ClothDemo::DrawGrid(Vector3 pos)
 
 void ClothDemo::DebugRender()
 {
-	cloth.debugDraw();
+	if (!useSoftCloth)
+	{
+		debugDrawCloth(cloth);
+		return;
+	}
+
+	for (unsigned i = 0; i < softCloth.getParticleCount(); i++)
+	{
+		if (softCloth.getInverseMass(i) <= 0)
+			g_debugDrawManager.AddCross(softCloth.getPosition(i), Vector3(0.0f, 0.5f, 0.0f), 0.5f);
+	}
 }
 
 void ClothDemo::Render()
@@ -76,7 +262,10 @@ void ClothDemo::Render()
 	glTranslatef(-2, 8, -2);
 	glRotatef(45, 0, 1, 0);
 
-	cloth.draw();
+	if (useSoftCloth)
+		drawSoftCloth();
+	else
+		drawCloth(cloth);
 
 	const static GLfloat lightPosition[] = { 0, 3, 8, 0 };
 
@@ -91,6 +280,13 @@ void ClothDemo::Render()
 	glColor3f(0.9f, 1.0f, 0.0f);
 	glutSolidSphere(sphere.radius - 0.1, 50, 50);
 	glPopMatrix();
+	glPushMatrix();
+	Vector3 cratePosition = scenery.getPosition();
+	glTranslatef(cratePosition.x, cratePosition.y, cratePosition.z);
+	glScalef(crate.halfSize.x * 2, crate.halfSize.y * 2, crate.halfSize.z * 2);
+	glColor3f(0.6f, 0.4f, 0.2f);
+	glutSolidCube(0.95f);
+	glPopMatrix();
 	glDisable(GL_COLOR_MATERIAL);
 	glDisable(GL_LIGHTING);
 	glDisable(GL_LIGHT0);
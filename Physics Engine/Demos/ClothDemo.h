@@ -10,6 +10,9 @@ class ClothDemo
 {
 
 public:
+	ClothDemo();
+	~ClothDemo();
+
 	void Update(float duration);
 	void Render();
 	void DebugRender();
@@ -1,23 +1,24 @@
 #include "CollisionTest.h"
+#include "../World/profiler.h"
 #include <GL\glut.h>
 
 using namespace Physics_Engine;
 
 Ball::Ball()
 {
-	body = new RigidBody();
+	body = NULL;
 }
 
 Ball::~Ball()
 {
-	delete body;
+
 }
 
-void Ball::render()
+void Ball::render(real alpha)
 {
 	// Get the OpenGL transformation.
 	GLfloat mat[16];
-	body->getGLTransform(mat);
+	body->getInterpolatedGLTransform(mat, alpha);
 
 	if (body->getAwake() == true)
 		glColor3f(1.0f, 0.7f, 0.7f);
@@ -31,11 +32,11 @@ void Ball::render()
 	glPopMatrix();
 }
 
-void Ball::renderShadow()
+void Ball::renderShadow(real alpha)
 {
 	// Get the OpenGL transformation.
 	GLfloat mat[16];
-	body->getGLTransform(mat);
+	body->getInterpolatedGLTransform(mat, alpha);
 
 	glPushMatrix();
 	glScalef(1.0f, 0, 1.0f);
@@ -73,19 +74,37 @@ void Ball::setState(Vector3 &position, Quaternion &orientation, real radius, Vec
 
 Box::Box()
 {
-	body = new RigidBody();
+	body = NULL;
+	isOverlapping = false;
+	occupants = 0;
 }
 
 Box::~Box()
 {
-	delete body;
+
 }
 
-void Box::render()
+void Box::render(real alpha)
 {
 	// Get the OpenGL transformation.
 	GLfloat mat[16];
-	body->getGLTransform(mat);
+	body->getInterpolatedGLTransform(mat, alpha);
+
+	// A trigger is drawn as an outline, which lights up while anything is inside it.
+	if (isTrigger)
+	{
+		if (occupants > 0)
+			glColor3f(1.0f, 0.9f, 0.2f);
+		else
+			glColor3f(0.7f, 1.0f, 0.7f);
+
+		glPushMatrix();
+		glMultMatrixf(mat);
+		glScalef(halfSize.x * 2, halfSize.y * 2, halfSize.z * 2);
+		glutWireCube(1.0f);
+		glPopMatrix();
+		return;
+	}
 
 	if (isOverlapping)
 		glColor3f(0.7f, 1.0f, 0.7f);
@@ -103,10 +122,13 @@ void Box::render()
 	glPopMatrix();
 }
 
-void Box::renderShadow()
+void Box::renderShadow(real alpha)
 {
+	if (isTrigger)
+		return;
+
 	GLfloat mat[16];
-	body->getGLTransform(mat);
+	body->getInterpolatedGLTransform(mat, alpha);
 
 	glPushMatrix();
 	glScalef(1.0f, 0, 1.0f);
@@ -143,6 +165,95 @@ void Box::setState(Vector3 &position, Quaternion &orientation, Vector3 &extents,
 }
 
 
+void Table::addParts()
+{
+	clearChildren();
+
+	// The top.
+	parts[0].halfSize = Vector3(1.5f, 0.1f, 1.0f);
+	parts[0].offset.setOrientationAndPos(Quaternion(1, 0, 0, 0), Vector3(0, 0.5f, 0));
+
+	// The legs, one under each corner of the top.
+	for (unsigned i = 1; i < partCount; i++)
+	{
+		Vector3 position((i & 1) ? 1.3f : -1.3f, -0.1f, (i & 2) ? 0.8f : -0.8f);
+		parts[i].halfSize = Vector3(0.1f, 0.5f, 0.1f);
+		parts[i].offset.setOrientationAndPos(Quaternion(1, 0, 0, 0), position);
+	}
+
+	for (unsigned i = 0; i < partCount; i++)
+		addChild(&parts[i]);
+}
+
+void Table::renderParts(real alpha)
+{
+	GLfloat mat[16];
+	body->getInterpolatedGLTransform(mat, alpha);
+
+	glPushMatrix();
+	glMultMatrixf(mat);
+	for (unsigned i = 0; i < partCount; i++)
+	{
+		Vector3 position = parts[i].offset.getAxisVector(3);
+		const Vector3 &halfSize = parts[i].halfSize;
+
+		glPushMatrix();
+		glTranslatef(position.x, position.y, position.z);
+		glScalef(halfSize.x * 2, halfSize.y * 2, halfSize.z * 2);
+		glutSolidCube(1.0f);
+		glPopMatrix();
+	}
+	glPopMatrix();
+}
+
+void Table::render(real alpha)
+{
+	glColor3f(0.6f, 0.4f, 0.2f);
+	renderParts(alpha);
+}
+
+void Table::renderShadow(real alpha)
+{
+	glPushMatrix();
+	glScalef(1.0f, 0, 1.0f);
+	renderParts(alpha);
+	glPopMatrix();
+}
+
+void Table::setState(const Vector3 &position)
+{
+	body->setPosition(position);
+	body->setOrientation(Quaternion(1, 0, 0, 0));
+	body->setVelocity(Vector3());
+	body->setRotation(Vector3());
+
+	// The parts have the same density as the boxes.
+	real mass = 0;
+	for (unsigned i = 0; i < partCount; i++)
+	{
+		const Vector3 &halfSize = parts[i].halfSize;
+		mass += halfSize.x * halfSize.y * halfSize.z * 8.0f;
+	}
+	body->setMass(mass);
+
+	// The inertia is taken as that of a block the size of the table.
+	Matrix3X3 tensor;
+	tensor.setBlockInertiaTensor((localBounds.max - localBounds.min) * 0.5f, mass);
+	body->setInertiaTensor(tensor);
+
+	body->setLinearDamping(0.95f);
+	body->setAngularDamping(0.8f);
+	body->clearAccumulators();
+	body->setAcceleration(0, -10.0f, 0);
+
+	body->setCanSleep(true);
+	body->setAwake();
+
+	body->calculateDerivedData();
+	calculateInternals();
+}
+
+
 CollisionTest::CollisionTest()
 	:
 	theta(0.0f),
@@ -151,67 +262,119 @@ CollisionTest::CollisionTest()
 	random(),
 	renderDebugInfo(true),
 	pauseSimulation(true),
-	autoPauseSimulation(false)
+	autoPauseSimulation(false),
+	bodies(boxes + balls + 1)
 {
-	collisionData.contactArray = contacts;
+	collisionData.presize(maxContacts);
+	resolver.setTimeBudget(resolverBudget);
+	contactEvents.setCapacity(maxTouchingPairs);
+
+	plane.normal = Vector3(0, 1, 0);
+	plane.offset = 0;
+
+	/*
+		The pool has room for every body, and none are removed, so the
+		pointers the primitives hold stay good.
+	*/
+	for (unsigned i = 0; i < boxes; i++)
+	{
+		boxData[i].body = bodies.get(bodies.add());
+		boxBodies[i] = boxData[i].body;
+	}
+
+	for (unsigned i = 0; i < balls; i++)
+		ballData[i].body = bodies.get(bodies.add());
+
+	// The table's parts go on its body, so it has to be set first.
+	table.body = bodies.get(bodies.add());
+	table.addParts();
+	boxBodies[boxes] = table.body;
+
 	reset();
 }
 
 void CollisionTest::reset()
 {
+	// The bodies are numbered afresh, so every reset gives the same results.
+	for (unsigned i = 0; i < boxes; i++)
+		boxData[i].body->setId(i);
+	for (unsigned i = 0; i < balls; i++)
+		ballData[i].body->setId(boxes + i);
+	table.body->setId(boxes + balls);
+
 	// Create the objects.
 	for (Box *box = boxData; box < boxData + boxes; box++)
 	{
 
 		box->setState(random.randomVec(Vector3(-13, 2, -11), Vector3(10, 20, -30)), Quaternion(1, 0, 0, 0), Vector3(1, 1, 1), Vector3(0, 0, 0));
+		box->isTrigger = false;
+		box->occupants = 0;
 	}
 
+	/*
+		The first box is a trigger over the table, which counts the
+		boxes falling through it without stopping them. It is held in
+		place, as nothing ever pushes it.
+	*/
+	Box &sensor = boxData[0];
+	Vector3 sensorPosition(-2, 3, -20), sensorExtents(2, 1.5f, 1.5f), still;
+	Quaternion upright(1, 0, 0, 0);
+	sensor.setState(sensorPosition, upright, sensorExtents, still);
+	sensor.isTrigger = true;
+	sensor.body->setInverseMass(0);
+	sensor.body->setAcceleration(0, 0, 0);
+
 	for (Ball *ball = ballData; ball < ballData + balls; ball++)
 	{
 		//ball->setState(random.randomVec(Vector3(-10, 0, -10), Vector3(5, 10, 15)), Quaternion(1, 0, 0, 0), 1.0f, Vector3(0, 0, 0));
 	}
 
+	// The table stands under where the boxes fall.
+	table.setState(Vector3(-2, 0.6f, -20));
+
 	// Reset the contacts.
 	collisionData.contactCount = 0;
+	contactEvents.clear();
 }
 
 void CollisionTest::generateContacts()
 {
+	PROFILE_ZONE("CollisionTest::generateContacts");
+
 	/*
-		Note that this method makes a lot of use of early returns to avoid
-		processing lots of potential contacts that it hasn't got room to store.
+		The contacts come from the arena, so the detectors never run
+		out of room and every pair can be checked.
 	*/
-	CollisionPlane plane;
-	plane.normal = Vector3(0, 1, 0);
-	plane.offset = 0;
-
 	// Set up the collision data structure.
-	collisionData.reset(maxContacts);
+	arena.reset();
+	collisionData.reset(&arena);
 	collisionData.friction = (real)0.9;
 	collisionData.restitution = (real)0.6;
 	collisionData.tolerance = (real)0.1;
 
-	// Perform exhaustive collision dectection
-	Matrix3X4 transform, otherTransform;
-	Vector3 position, otherPosition;
+	/*
+		Perform exhaustive collision dectection. Every pair goes through
+		the filter first, and only those it passes reach the detectors.
+		Pairs with a trigger are only checked for overlap. The pairs that
+		touch are passed on to the contact events.
+	*/
+	unsigned pairs = 0, filtered = 0;
+
+	/*
+		The table is tested as one primitive, and the detector only goes
+		down to the parts near the other primitive of the pair.
+	*/
+	checkPair(table, plane, pairs, filtered);
 
 	for (Box *box = boxData; box < boxData + boxes; box++)
 	{
 		// Check for collisions with the ground plane.
-		if (!collisionData.hasMoreContacts())
-			return;
-
-		CollisionDectector::boxAndHalfSpace(*box, plane, &collisionData);
+		checkPair(*box, plane, pairs, filtered);
 
 		// Check for collisions with each other box.
 		for (Box *other = box + 1; other < boxData + boxes; other++)
 		{
-			if (!collisionData.hasMoreContacts())
-				return;
-
-			CollisionDectector::boxAndBox(*box, *other, &collisionData);
-
-			if (IntersectionTests::boxAndBox(*box, *other))
+			if (checkPair(*box, *other, pairs, filtered))
 			{
 				box->isOverlapping = other->isOverlapping = true;
 			}
@@ -219,46 +382,90 @@ void CollisionTest::generateContacts()
 
 		// Check for collisions with each ball.
 		for (Ball *other = ballData; other < ballData + balls; other++)
-		{
-			if (!collisionData.hasMoreContacts())
-				return;
+			checkPair(*box, *other, pairs, filtered);
 
-			CollisionDectector::boxAndSphere(*box, *other, &collisionData);
-		}
+		// Check for collisions with the table.
+		checkPair(*box, table, pairs, filtered);
 	}
 
 	for (Ball *ball = ballData; ball < ballData + balls; ball++)
 	{
 		// Check for collisions with the ground plane.
-		if (!collisionData.hasMoreContacts())
-			return;
+		checkPair(*ball, plane, pairs, filtered);
 
-		CollisionDectector::sphereAndHalfSpace(*ball, plane, &collisionData);
+		for (Ball *other = ball + 1; other < ballData + balls; other++)
+			checkPair(*ball, *other, pairs, filtered);
+	}
 
-		for (Ball *other = ballData + 1; other < ballData + balls; other++)
-		{
-			if (!collisionData.hasMoreContacts())
-				return;
+	// Every pair counts as passing the broadphase, unless it was filtered out.
+	stats.broadphasePairs = pairs;
+	stats.filteredPairs = filtered;
 
-			CollisionDectector::sphereAndSphere(*ball, *other, &collisionData);
-		}
+	// Put any contacts that overflowed into one array for the resolver.
+	collisionData.gatherContacts();
+}
+
+bool CollisionTest::checkPair(CollisionPrimitive &one, CollisionPrimitive &two,
+	unsigned &pairs, unsigned &filtered)
+{
+	if (!filter.shouldCollide(one, two))
+	{
+		filtered++;
+		return false;
 	}
+	pairs++;
+
+	// A pair with a trigger only reports its overlap, and makes no contacts.
+	bool triggered = false;
+	bool touching = CollisionDectector::detect(one, two, &collisionData, &triggered) > 0;
+	if (!touching && !triggered)
+		return false;
+
+	contactEvents.addPair(&one, &two, triggered);
+	return true;
 }
 
 void CollisionTest::updateObjects(real duration)
 {
+	PROFILE_ZONE("CollisionTest::updateObjects");
+
+	StageTimer timer(stats);
+
+	contactEvents.beginStep();
 	generateContacts();
+	stats.addCollisionData(collisionData);
+	timer.lap(STAGE_NARROWPHASE);
 
+	/*
+		The iterations grow with the contacts, and the epsilons and the
+		time budget decide when the resolver actually stops.
+	*/
+	resolver.setIterations(collisionData.contactCount * 4);
 	resolver.resolveContacts(collisionData.contactArray, collisionData.contactCount, duration);
+	stats.addResolver(resolver);
+	timer.lap(STAGE_RESOLUTION);
 
 	// Update the physics of each box in turn.
-	for (Box *box = boxData; box < boxData + boxes; box++)
 	{
-		// Run the physics.
-		box->body->integrate(duration);
-		box->calculateInternals();
-		box->isOverlapping = false;
+		PROFILE_ZONE("CollisionTest::integrate");
+
+		for (Box *box = boxData; box < boxData + boxes; box++)
+		{
+			// Run the physics.
+			box->body->integrate(duration);
+			box->calculateInternals();
+			box->isOverlapping = false;
+		}
+
+		table.body->integrate(duration);
+		table.calculateInternals();
 	}
+	timer.lap(STAGE_INTEGRATION);
+
+	// Put settled piles of boxes to sleep, and wake any that were hit.
+	sleepSystem.update(boxBodies, boxes + 1, collisionData.contactArray, collisionData.contactCount, arena);
+	stats.addSleepSystem(sleepSystem);
+	timer.lap(STAGE_SLEEP);
 
 	// Update the physics of each ball in turn.
 	for (Ball *ball = ballData; ball < ballData + balls; ball++)
@@ -267,6 +474,32 @@ void CollisionTest::updateObjects(real duration)
 		//ball->body->integrate(duration);
 		//ball->calculateInternals();
 	}
+
+	// The events are ready for the game to read once the whole step is done.
+	contactEvents.endStep();
+
+	// The trigger boxes keep count of what is inside them from the events.
+	const ContactEvent *events = contactEvents.getEvents();
+	for (unsigned i = 0; i < contactEvents.getEventCount(); i++)
+	{
+		if (!events[i].trigger || events[i].type == CONTACT_PERSIST)
+			continue;
+
+		for (Box *box = boxData; box < boxData + boxes; box++)
+		{
+			if (!box->isTrigger || (events[i].primitives[0] != box && events[i].primitives[1] != box))
+				continue;
+
+			if (events[i].type == CONTACT_BEGIN)
+				box->occupants++;
+			else if (box->occupants > 0)
+				box->occupants--;
+		}
+	}
+
+	stats.bodies = boxes + balls + 1;
+	timer.finish();
+	statsChannel.publish(stats);
 }
 
 void CollisionTest::key(GLFWwindow *window)
@@ -308,7 +541,7 @@ void DrawGrid(Vector3 pos, unsigned w)
 	glEnd();
 }
 
-void CollisionTest::display()
+void CollisionTest::display(real alpha)
 {
 	const static GLfloat lightPosition[] = {1, -1, 0, 0};
 	const static GLfloat lightPositionMirror[] = { 1, 1, 0, 0 };
@@ -320,6 +553,8 @@ void CollisionTest::display()
 		box->isOverlapping = false;
 	}
 
+	table.calculateInternals();
+
 	// Update the transform matrices of each ball in turn.
 	for (Ball *ball = ballData; ball < ballData + balls; ball++)
 	{
@@ -346,12 +581,13 @@ void CollisionTest::display()
 	glEnable(GL_COLOR_MATERIAL);
 	for (Box *box = boxData; box < boxData + boxes; box++)
 	{
-		box->render();
+		box->render(alpha);
 	}
 	for (Ball *ball = ballData; ball < ballData + balls; ball++)
 	{
-		ball->render();
+		ball->render(alpha);
 	}
+	table.render(alpha);
 	glPopMatrix();
 	glDisable(GL_COLOR_MATERIAL);
 	glDisable(GL_LIGHTING);
@@ -366,12 +602,13 @@ void CollisionTest::display()
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	for (Box *box = boxData; box < boxData + boxes; box++)
 	{
-		box->renderShadow();
+		box->renderShadow(alpha);
 	}
 	for (Ball *ball = ballData; ball < ballData + balls; ball++)
 	{
-		ball->renderShadow();
+		ball->renderShadow(alpha);
 	}
+	table.renderShadow(alpha);
 	glDisable(GL_BLEND);
 	
 	// Render the boxes themselves
@@ -383,12 +620,13 @@ void CollisionTest::display()
 	glEnable(GL_COLOR_MATERIAL);
 	for (Box *box = boxData; box < boxData + boxes; box++)
 	{
-		box->render();
+		box->render(alpha);
 	}
 	for (Ball *ball = ballData; ball < ballData + balls; ball++)
 	{
-		ball->render();
+		ball->render(alpha);
 	}
+	table.render(alpha);
 	glDisable(GL_COLOR_MATERIAL);
 	glDisable(GL_LIGHTING);
 	glDisable(GL_LIGHT0);
@@ -412,15 +650,16 @@ void CollisionTest::drawDebug()
 	for (unsigned i = 0; i < collisionData.contactCount; i++)
 	{
 		// Interbody contacts are in green, floor contacts are red.
-		if (contacts[i].body[1])
+		const Contact &contact = collisionData.contactArray[i];
+		if (contact.body[1])
 			glColor3f(0, 1, 0);
 		else
 			glColor3f(1, 0, 0);
 
-		Vector3 vec = contacts[i].contactPoint;
+		Vector3 vec = contact.contactPoint;
 		glVertex3f(vec.x, vec.y, vec.z);
 
-		vec += contacts[i].contactNormal;
+		vec += contact.contactNormal;
 		glVertex3f(vec.x, vec.y, vec.z);
 	}
 	glEnd();
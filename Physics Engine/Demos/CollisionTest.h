@@ -2,6 +2,12 @@
 #define COLLISION_TEST
 
 #include "../Collision/NarrowPhase.h"
+#include "../Collision/Compound.h"
+#include "../World/sleep.h"
+#include "../World/arena.h"
+#include "../World/pool.h"
+#include "../World/stats.h"
+#include "../World/events.h"
 #include <GLFW\glfw3.h>
 #include "../Math/random.h"
 
@@ -16,8 +22,12 @@ namespace Physics_Engine
 		Ball();
 		~Ball();
 
-		void render();
-		void renderShadow();
+		/*
+			The alpha blends between the last two simulated states,
+			as given by FixedStepper::getAlpha.
+		*/
+		void render(real alpha = 1);
+		void renderShadow(real alpha = 1);
 		void setState(Vector3 &position, Quaternion &orientation, real radius, Vector3 &velocity);
 	};
 
@@ -29,11 +39,35 @@ namespace Physics_Engine
 
 		bool isOverlapping;
 
-		void render();
-		void renderShadow();
+		// Holds how many primitives are inside the box, when it is a trigger.
+		unsigned occupants;
+
+		void render(real alpha = 1);
+		void renderShadow(real alpha = 1);
 		void setState(Vector3 &position, Quaternion &orientation, Vector3 &extents, Vector3 &velocity);
 	};
 
+	/*
+		A table made of a top and four legs, all on one body, which
+		collides as a compound of its parts.
+	*/
+	class Table : public CollisionCompound
+	{
+	public:
+		const static unsigned partCount = 5;
+		CollisionBox parts[partCount];
+
+		// Adds the parts to the compound, once its body has been set.
+		void addParts();
+
+		void render(real alpha = 1);
+		void renderShadow(real alpha = 1);
+		void setState(const Vector3 &position);
+
+	protected:
+		void renderParts(real alpha);
+	};
+
 	class CollisionTest
 	{
 	public:
@@ -49,10 +83,35 @@ namespace Physics_Engine
 			0, 0, 0, 1
 		};
 
+		/*
+			Holds the data that only lasts for one step. It is reset
+			when the next step's contacts are generated, so the last
+			contacts can still be drawn.
+		*/
+		Arena arena;
+
+		// The number of contacts expected, so the first chunk is big enough.
 		const static unsigned maxContacts = 256;
-		Contact contacts[maxContacts];
+
+		// The time the resolver may take each step, in microseconds.
+		const static unsigned resolverBudget = 1000;
 		CollisionData collisionData;
 		ContactResolver resolver;
+		SleepSystem sleepSystem;
+
+		// Decides which pairs are tested, from the primitives' groups and masks.
+		CollisionFilter filter;
+
+		/*
+			Holds the pairs that began, kept or stopped touching in the
+			last step, and the most pairs that can be touching at once.
+		*/
+		ContactEvents contactEvents;
+		const static unsigned maxTouchingPairs = 256;
+
+		// Holds the stats of the last step, and passes them on to other threads.
+		StepStats stats;
+		StepStatsChannel statsChannel;
 		
 		// Holds the camera angle.
 		float theta;
@@ -70,8 +129,27 @@ namespace Physics_Engine
 		const static unsigned balls = OBJECTS;
 		Ball ballData[balls];
 
+		// Holds the bodies of the boxes and balls, packed together.
+		Pool<RigidBody> bodies;
+
+		Table table;
+
+		// The bodies of the boxes and the table, for the sleep system.
+		RigidBody *boxBodies[boxes + 1];
+
 		Random random;
 
+		// The ground, which is kept so its pairs are the same from step to step.
+		CollisionPlane plane;
+
+		/*
+			Tests a pair if the filter passes it, counting it as tested or
+			filtered. A pair that touches, or overlaps a trigger, is added
+			to the contact events and true is returned.
+		*/
+		bool checkPair(CollisionPrimitive &one, CollisionPrimitive &two,
+			unsigned &pairs, unsigned &filtered);
+
 	public:
 		void reset();
 		void generateContacts();
@@ -79,7 +157,7 @@ namespace Physics_Engine
 
 		CollisionTest();
 		void initGraphics();
-		void display();
+		void display(real alpha = 1);
 		void key(GLFWwindow *window);
 	};
 }
@@ -6,7 +6,8 @@ void PhysicsEngineDemo::Update()
 	Application::Update();
 
 	timer.Update();
-	float duration = timer.getTicks();
+	unsigned steps = stepper.advance(timer.getTicks());
+	real duration = stepper.getStepSize();
 
 	if (getDemo(0) && demos != Demos::airplane)
 	{
@@ -28,26 +29,32 @@ void PhysicsEngineDemo::Update()
 		collisionTestDemo.reset();
 	}
 	
+	// Input is read once per frame, the physics once per fixed step.
 	switch (demos)
 	{
 	case cloth:
-		clothDemo.Update(duration);
+		for (unsigned i = 0; i < steps; i++)
+			clothDemo.Update(duration);
 		clothDemo.KeyInput(getWindow());
 		break;
 	case airplane:
-		airplaneDemo.Update(duration);
+		for (unsigned i = 0; i < steps; i++)
+			airplaneDemo.Update(duration);
 		airplaneDemo.KeyInput(getWindow());
 		break;
 	case projectile:
-		projectileDemo.Update(duration);
+		for (unsigned i = 0; i < steps; i++)
+			projectileDemo.Update(duration);
 		projectileDemo.KeyInput(getWindow());
 		projectileDemo.MouseInput(getWindow());
 		break;
 	case bridge:
-		bridgeDemo.Update(duration);
+		for (unsigned i = 0; i < steps; i++)
+			bridgeDemo.Update(duration);
 		break;
 	case collisionTest:
-		collisionTestDemo.updateObjects(duration);
+		for (unsigned i = 0; i < steps; i++)
+			collisionTestDemo.updateObjects(duration);
 		collisionTestDemo.key(getWindow());
 		break;
 
@@ -82,7 +89,7 @@ void PhysicsEngineDemo::Render()
 		bridgeDemo.Render();
 		break;
 	case collisionTest:
-		collisionTestDemo.display();
+		collisionTestDemo.display(stepper.getAlpha());
 		break;
 	default:
 		break;
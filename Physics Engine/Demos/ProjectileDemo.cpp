@@ -2,34 +2,21 @@
 #include "ProjectileDemo.h"
 
 ProjectileDemo::ProjectileDemo()
-: currentShotType(ARTILLERY)
+: ammo(ammoRounds), currentShotType(ARTILLERY)
 {
-	// Make all shots unused 
-	for (AmmoRound *shot = ammo; shot < ammo + ammoRounds; shot++)
-	{
-		shot->type = UNUSED;
-	}
+
 }
 
 void ProjectileDemo::fire()
 {
-	// Find the first available round.
-	AmmoRound *shot;
-
-	for (shot = ammo; shot < ammo + ammoRounds; shot++)
-	{
-		if (shot->type == UNUSED)
-		{
-			break;
-		}
-	}
-
-	// If we didn't find a round, then exit - we can't fire
-	if (shot >= ammo + ammoRounds)
+	// If all the rounds are in flight, then exit - we can't fire
+	if (ammo.getCount() >= ammoRounds)
 	{
 		return;
 	}
 
+	AmmoRound *shot = ammo.get(ammo.add());
+
 	// Set the properties of the particle	---SI units---
 	switch (currentShotType)
 	{
@@ -74,21 +61,24 @@ void ProjectileDemo::Update(float duration)
 	if (duration <= 0.0f)
 		return;
 
-	// Update the physics of each particle in turn
-	for (AmmoRound *shot = ammo; shot < ammo + ammoRounds; shot++)
+	/*
+		Update the physics of each particle in turn. Removing a round
+		moves the last one into its place, so the rounds are gone
+		through backwards to visit each of them once.
+	*/
+	for (unsigned i = ammo.getCount(); i > 0; i--)
 	{
-		if (shot->type != UNUSED)
+		AmmoRound *shot = &ammo[i - 1];
+
+		// Run the physics
+		shot->particle.intergrate(duration);
+
+		// Check to see if the particle is now invalid
+		if (shot->particle.getPosition().y < 0.0f ||
+			shot->particle.getPosition().y > 50.0f ||
+			shot->particle.getPosition().z > 200.0f)
 		{
-			// Run the physics
-			shot->particle.intergrate(duration);
-
-			// Check to see if the particle is now invalid
-			if (shot->particle.getPosition().y < 0.0f ||
-				shot->particle.getPosition().y > 50.0f ||
-				shot->particle.getPosition().z > 200.0f)
-			{
-				shot->type = UNUSED;
-			}
+			ammo.remove(ammo.getHandle(i - 1));
 		}
 	}
 }
@@ -161,11 +151,8 @@ void ProjectileDemo::Render()
 	glEnd();
 
 	// Render each particle in turn
-	for (AmmoRound *shot = ammo; shot < ammo + ammoRounds; shot++)
+	for (unsigned i = 0; i < ammo.getCount(); i++)
 	{
-		if (shot->type != UNUSED)
-		{
-			shot->render();
-		}
+		ammo[i].render();
 	}
 }
\ No newline at end of file
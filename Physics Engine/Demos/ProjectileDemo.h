@@ -2,6 +2,7 @@
 #define PROJECTILE_DEMO_H
 
 #include "../Dynamics/particle.h"
+#include "../World/pool.h"
 #include <GLFW\glfw3.h>
 #include <GL\glut.h>
 
@@ -49,8 +50,11 @@ class ProjectileDemo
 	// Holds the maximum number of rounds that can be fired.
 	const static unsigned ammoRounds = 16;						// Why static???? ************************
 
-	// Holds the particle data
-	AmmoRound ammo[ammoRounds];
+	/*
+		Holds the rounds in flight. Rounds are removed as soon as they
+		land, so only live rounds are updated and drawn.
+	*/
+	Pool<AmmoRound> ammo;
 
 	// Holds the current shot type
 	shotType currentShotType;
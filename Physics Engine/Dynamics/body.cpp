@@ -4,10 +4,48 @@
 
 using namespace Physics_Engine;
 
+/*
+	The proportion of the average motion kept after one second. Lower
+	values let a body settle sooner but make it more likely to be put
+	to sleep while it is slowly rolling.
+*/
+static const real sleepBias = (real)0.5;
+
+RigidBody::RigidBody()
+	: id(0), inverseMass(0), linearDamping(0), angularDamping(0),
+	isDirty(true), transformVersion(0), isAwake(false), canSleep(false), motion(0), sleepTime(0), island(0)
+{
+
+}
+
+void RigidBody::setId(unsigned id)
+{
+	RigidBody::id = id;
+}
+
+unsigned RigidBody::getId() const
+{
+	return id;
+}
+
 void RigidBody::integrate(real duration)
 {
+	// Sleeping bodies are kept still when interpolated.
+	previousPosition = position;
+	previousOrientation = orientation;
+
 	if (!isAwake)
+	{
+		clearAccumulators();
 		return;
+	}
+
+	/*
+		The motion is measured before this step's acceleration is added,
+		so a body resting on the ground, which the contacts have just
+		brought to a stop, doesn't look like it is falling.
+	*/
+	real currentMotion = velocity * velocity + rotation * rotation;
 
 	// Calculate linear acceleration from force inputs.
 	lastFrameAcceleration = acceleration;
@@ -34,19 +72,27 @@ void RigidBody::integrate(real duration)
 	// Update angular position
 	orientation.addScaledVector(rotation, duration);
 
+	// A body that hasn't moved keeps the derived data it has.
+	if (velocity.squareMagnitude() > 0 || rotation.squareMagnitude() > 0)
+		isDirty = true;
+
 	// Normalize the orientation and update the matrices with the
 	// new position and orientation.
 	calculateDerivedData();
 
 	if (canSleep)
 	{
-		//	E_k = 1/2 mv^2
-		real kineticEnrgy = inverseMass * (velocity * velocity);
+		real bias = real_pow(sleepBias, duration);
+		motion = bias * motion + (1 - bias) * currentMotion;
+
+		// Capped, so a body that was moving quickly can still settle soon.
+		if (motion > 10 * sleepEpsolion)
+			motion = 10 * sleepEpsolion;
 
-		if (kineticEnrgy <= 0.00001)
-		{
-			setAwake(false);
-		}
+		if (motion < sleepEpsolion)
+			sleepTime += duration;
+		else
+			sleepTime = 0;
 	}
 
 	clearAccumulators();
@@ -58,6 +104,7 @@ void RigidBody::setAwake(const bool awake)
 	{
 		isAwake = true;
 		motion = sleepEpsolion * 2.0f;
+		sleepTime = 0;
 	}
 	else
 	{
@@ -75,6 +122,26 @@ void RigidBody::setCanSleep(const bool canSleep)
 		setAwake();
 }
 
+void RigidBody::setSleepEpsilon(const real sleepEpsilon)
+{
+	sleepEpsolion = sleepEpsilon;
+}
+
+real RigidBody::getSleepEpsilon() const
+{
+	return sleepEpsolion;
+}
+
+real RigidBody::getMotion() const
+{
+	return motion;
+}
+
+real RigidBody::getSleepTime() const
+{
+	return sleepTime;
+}
+
 void RigidBody::setMass(const real mass)
 {
 	assert(mass != 0);
@@ -104,6 +171,11 @@ real RigidBody::getMass() const
 		return ((real)1.0) / inverseMass;
 }
 
+void RigidBody::setInverseMass(const real inverseMass)
+{
+	RigidBody::inverseMass = inverseMass;
+}
+
 real RigidBody::getInverseMass() const
 {
 	return inverseMass;
@@ -112,6 +184,13 @@ real RigidBody::getInverseMass() const
 void RigidBody::setInertiaTensor(const Matrix3X3 &inertiaTensor)
 {
 	inverseInertiaTensor.setInverse(inertiaTensor);
+	isDirty = true;
+}
+
+void RigidBody::setInverseInertiaTensor(const Matrix3X3 &inverseInertiaTensor)
+{
+	RigidBody::inverseInertiaTensor = inverseInertiaTensor;
+	isDirty = true;
 }
 
 void RigidBody::getInverseIneritaTensor(Matrix3X3 *inverseInertiaTensor) const
@@ -137,7 +216,8 @@ Matrix3X3 RigidBody::getInverseInertiaTensorWorld() const
 void RigidBody::addForce(const Vector3 &force)
 {
 	forceAccum += force;
-	isAwake = true;
+	if (!isAwake)
+		setAwake();
 }
 
 void RigidBody::getTransform(Matrix3X4 *transform) const
@@ -191,7 +271,8 @@ void RigidBody::addForceAtPoint(const Vector3 &force, const Vector3 &point)
 	forceAccum += force;
 	torqueAccum += pt % force;
 
-	isAwake = true;
+	if (!isAwake)
+		setAwake();
 }
 
 void RigidBody::addForceAtBodyPoint(const Vector3 &force, const Vector3 &point)
@@ -204,7 +285,8 @@ void RigidBody::addForceAtBodyPoint(const Vector3 &force, const Vector3 &point)
 void RigidBody::addTorque(const Vector3 &torque)
 {
 	torqueAccum += torque;
-	isAwake = true;
+	if (!isAwake)
+		setAwake();
 }
 
 void RigidBody::setDamping(const real linearDamping, const real angularDamping)
@@ -236,6 +318,8 @@ real RigidBody::getAngularDamping() const
 void RigidBody::setPosition(const Vector3& position)
 {
 	RigidBody::position = position;
+	previousPosition = position;
+	isDirty = true;
 }
 
 void RigidBody::setPosition(const real x, const real y, const real z)
@@ -243,6 +327,8 @@ void RigidBody::setPosition(const real x, const real y, const real z)
 	position.x = x;
 	position.y = y;
 	position.z = z;
+	previousPosition = position;
+	isDirty = true;
 }
 
 void RigidBody::getPosition(Vector3 *position) const
@@ -259,6 +345,8 @@ void RigidBody::setOrientation(const Quaternion &orientation)
 {
 	RigidBody::orientation = orientation;
 	RigidBody::orientation.normalize();
+	previousOrientation = RigidBody::orientation;
+	isDirty = true;
 }
 
 void RigidBody::setOrientation(const real r, const real i, const real j, const real k)
@@ -269,6 +357,8 @@ void RigidBody::setOrientation(const real r, const real i, const real j, const r
 	orientation.k = k;
 
 	orientation.normalize();
+	previousOrientation = orientation;
+	isDirty = true;
 }
 
 void RigidBody::getOrientation(Quaternion *orientation) const
@@ -357,6 +447,14 @@ void RigidBody::addRotation(const Vector3 &deltaRotation)
 	rotation += deltaRotation;
 }
 
+void RigidBody::moveTo(const Vector3 &position, const Quaternion &orientation)
+{
+	RigidBody::position = position;
+	RigidBody::orientation = orientation;
+	RigidBody::orientation.normalize();
+	isDirty = true;
+}
+
 void RigidBody::clearAccumulators()
 {
 	forceAccum.clear();
@@ -456,6 +554,15 @@ static inline void _transformInertiaTensor(Matrix3X3 &iitWorld, const Quaternion
 
 void RigidBody::calculateDerivedData()
 {
+	if (!isDirty)
+		return;
+
+	isDirty = false;
+
+	// Zero is kept for primitives whose transform has never been calculated.
+	if (++transformVersion == 0)
+		transformVersion = 1;
+
 	orientation.normalize();
 
 	// Calculate the transform matrix for the body.
@@ -463,4 +570,25 @@ void RigidBody::calculateDerivedData()
 
 	// Calculate the inerita tensor in world space.
 	_transformInertiaTensor(inverseInertiaTensorWorld, orientation, inverseInertiaTensor, transformMatrix);
+}
+
+void RigidBody::getInterpolatedGLTransform(float matrix[16], real alpha) const
+{
+	Vector3 blendedPosition = previousPosition * (1 - alpha) + position * alpha;
+
+	// Blend the orientations the short way round.
+	real dot = previousOrientation.r * orientation.r + previousOrientation.i * orientation.i +
+		previousOrientation.j * orientation.j + previousOrientation.k * orientation.k;
+	real weight = (dot < 0) ? -alpha : alpha;
+
+	Quaternion blendedOrientation(
+		previousOrientation.r * (1 - alpha) + orientation.r * weight,
+		previousOrientation.i * (1 - alpha) + orientation.i * weight,
+		previousOrientation.j * (1 - alpha) + orientation.j * weight,
+		previousOrientation.k * (1 - alpha) + orientation.k * weight);
+	blendedOrientation.normalize();
+
+	Matrix3X4 transform;
+	_calculateTransformMatrix(transform, blendedPosition, blendedOrientation);
+	transform.fillGLArray(matrix);
 }
\ No newline at end of file
@@ -7,7 +7,18 @@ namespace Physics_Engine
 {
 	class RigidBody
 	{
+		// Snapshots save and restore the whole state of the body.
+		friend class Snapshot;
+		friend class SleepSystem;
+
 	protected:
+		/*
+			Holds a number identifying the body. Contacts are ordered by id
+			rather than by address, so a simulation gives the same results
+			wherever the bodies happen to be in memory.
+		*/
+		unsigned id;
+
 		real inverseMass;
 		Matrix3X3 inverseInertiaTensor;
 		real linearDamping;
@@ -18,27 +29,106 @@ namespace Physics_Engine
 		Vector3 rotation;
 
 		Matrix3X3 inverseInertiaTensorWorld;
+
+		/*
+			Holds whether the position, orientation or inertia tensor have
+			changed since the derived data (the transform and the world
+			inertia tensor) was last calculated. calculateDerivedData does
+			nothing unless it is set, so a body at rest costs nothing.
+		*/
+		bool isDirty;
+
+		/*
+			Counts the times the derived data has been calculated, so
+			primitives can tell whether their transforms are out of date.
+			It never goes back to zero.
+		*/
+		unsigned transformVersion;
+
 		bool isAwake;
 		bool canSleep;
+
+		/*
+			Holds a running average of the body's motion (the sum of its
+			squared linear and angular speeds). Averaging it means a body
+			only counts as still once it has settled, rather than when it
+			passes through rest for a single step.
+		*/
 		real motion;
 
-		real sleepEpsolion = 0.0000001;
+		/*
+			The motion below which the body counts as still. Resting
+			contacts leave a little jitter in the velocities, so this
+			can't be much smaller without stacks never settling.
+		*/
+		real sleepEpsolion = 0.3;
+
+		// Holds how long the body has been still for.
+		real sleepTime;
+
+		// Used by the sleep system while it is building islands.
+		unsigned island;
+
 		Matrix3X4 transformMatrix;
 		Vector3 forceAccum;
 		Vector3 torqueAccum;
 		Vector3 acceleration;
 		Vector3 lastFrameAcceleration;
 
+		/*
+			Holds the position and orientation at the start of the last
+			integration, for interpolating the rendered state.
+		*/
+		Vector3 previousPosition;
+		Quaternion previousOrientation;
+
 	public:
+		RigidBody();
+
+		/*
+			Sets the body's id, which starts at zero. Whatever holds the
+			bodies gives them their ids, usually their index, and should
+			give every body it steps together a different one.
+		*/
+		void setId(unsigned id);
+		unsigned getId() const;
+
+		/*
+			Recalculates the derived data, if anything it comes from has
+			changed. The setters mark the body as dirty, as does moving it
+			in integrate.
+		*/
 		void calculateDerivedData();
 		void integrate(real duration);
+
+		/*
+			Marks the derived data as out of date. This is only needed after
+			changing the body's state other than through its methods.
+		*/
+		void markDirty()
+		{
+			isDirty = true;
+		}
+
+		bool getDirty() const
+		{
+			return isDirty;
+		}
+
+		unsigned getTransformVersion() const
+		{
+			return transformVersion;
+		}
+
 		void setMass(const real mass);
 		real getMass() const;
+		void setInverseMass(const real inverseMass);
 		real getInverseMass() const;
 		bool hasFiniteMass() const;
 		Vector3 getLastFrameAcceleration() const;
 		void getLastFrameAcceleration(Vector3 *lastFrameAcceleration) const;
 		void setInertiaTensor(const Matrix3X3 &inertiaTensor);
+		void setInverseInertiaTensor(const Matrix3X3 &inverseInertiaTensor);
 		void getInverseIneritaTensor(Matrix3X3 *inverseInertiaTensor) const;
 		Matrix3X3 getInverseIneritaTensor() const;
 		void getInverseInertiaTensorWorld(Matrix3X3 *inverseInertiaTensor) const;
@@ -58,6 +148,10 @@ namespace Physics_Engine
 		void getVelocity(Vector3 *velocity) const;
 		Vector3 getVelocity() const;
 		void addVelocity(const Vector3 &deltaVelocity);
+		/*
+			Setting the position or orientation moves the body there at
+			once, so it isn't interpolated from where it was before.
+		*/
 		void setPosition(const Vector3 &position);
 		void setPosition(const real x, const real y, const real z);
 		void getPosition(Vector3 *position) const;
@@ -76,6 +170,13 @@ namespace Physics_Engine
 		Vector3 getRotation() const;
 		void addRotation(const Vector3 &deltaRotation);
 
+		/*
+			Moves the body as part of the step, such as when a contact
+			pushes it out of another body. Unlike the setters, the body
+			is still interpolated from its state before the step.
+		*/
+		void moveTo(const Vector3 &position, const Quaternion &orientation);
+
 		bool getAwake() const
 		{
 			return isAwake;
@@ -89,9 +190,26 @@ namespace Physics_Engine
 		}
 
 		void setCanSleep(const bool canSleep = true);
+
+		void setSleepEpsilon(const real sleepEpsilon);
+		real getSleepEpsilon() const;
+		real getMotion() const;
+
+		/*
+			Returns how long the body's motion has been below its sleep
+			epsilon. The sleep system puts a group of touching bodies to
+			sleep once all of them have been still for long enough.
+		*/
+		real getSleepTime() const;
 		void getTransform(Matrix3X4 *transform) const;
 		void getGLTransform(float matrix[16]) const;
 
+		/*
+			Fills the matrix with a transform between the state before
+			the last integration (alpha 0) and the current state (alpha 1).
+		*/
+		void getInterpolatedGLTransform(float matrix[16], real alpha) const;
+
 		Matrix3X4 getTransform() const;
 		Vector3 getPointInLocalSpace(const Vector3 &point) const;
 		Vector3 getPointInWorldSpace(const Vector3 &point) const;
@@ -1,27 +1,31 @@
-#include <windows.h> 
 #include "cloth.h"
+#include "../World/profiler.h"
 #include <stdio.h>
 #include <vector>
 #include <string>
 #include "particle.h"
 #include "../Math/core.h"
 #include "constraint.h"
-#include <GL/gl.h>
+#include "../Collision/Compound.h"
 #include <iostream>
-#include "../DebugRender/DebugDrawManager.h"
 
 using namespace Physics_Engine;
 
-Cloth::Cloth(real width, real height, int num_particles_width, int num_particles_height)
-: num_particles_width(num_particles_width), num_particles_height(num_particles_height)
+Cloth::Cloth(real width, real height, int num_particles_width, int num_particles_height,
+	const Vector3 &origin)
+: num_particles_width(num_particles_width), num_particles_height(num_particles_height),
+particleSpacing(width / (real)num_particles_width), selfCollisionEnabled(false)
 {
+	thickness = particleSpacing * 0.25f;
+	particleHash.setCellSize(particleSpacing);
+
 	particles.resize(num_particles_width*num_particles_height);
 
 	for (int x = 0; x < num_particles_width; x++)
 	{
 		for (int y = 0; y < num_particles_height; y++)
 		{
-			Vector3 pos = Vector3(width * (x / (real)num_particles_width),
+			Vector3 pos = origin + Vector3(width * (x / (real)num_particles_width),
 				0,
 				height * (y / (real)num_particles_height));
 
@@ -66,10 +70,22 @@ Cloth::Cloth(real width, real height, int num_particles_width, int num_particles
 		}
 	}
 
+	// The triangles are wound the same way as they are drawn.
+	for (int x = 0; x < num_particles_width - 1; x++)
+	{
+		for (int y = 0; y < num_particles_height - 1; y++)
+		{
+			makeTriangle(x + 1, y, x, y, x, y + 1);
+			makeTriangle(x + 1, y + 1, x + 1, y, x, y + 1);
+		}
+	}
+
 	// Constrain 2 point on the cloth.
 	getParticle(0, 0)->makeUnmovable();
 	getParticle(num_particles_width - 1, 0)->makeUnmovable();
 
+	updateSpatialHash();
+	updateNormals();
 }
 
 Particle* Cloth::getParticle(int x, int y)
@@ -82,142 +98,470 @@ void Cloth::makeConstraint(Particle *p1, Particle *p2)
 	constraints.push_back(Constraint(p1, p2));
 }
 
-Vector3 Cloth::calcTriangleNormal(Particle *p1, Particle *p2, Particle *p3)
+void Cloth::makeTriangle(int x1, int y1, int x2, int y2, int x3, int y3)
 {
-	Vector3 pos1 = p1->getPosition();
-	Vector3 pos2 = p2->getPosition();
-	Vector3 pos3 = p3->getPosition();
+	triangles.push_back(y1*num_particles_width + x1);
+	triangles.push_back(y2*num_particles_width + x2);
+	triangles.push_back(y3*num_particles_width + x3);
+}
 
-	Vector3 v1 = pos2 - pos1;
-	Vector3 v2 = pos3 - pos1;
+void Cloth::addWindToTriangle(unsigned triangle, const Vector3 &direction)
+{
+	const unsigned *index = &triangles[triangle * 3];
+	Vector3 normal = triangleNormals[triangle];
 
-	Vector3 norm = v1.vectorProduct(v2);
+	/*
+		The force pushes along the normal, scaled by the area of the
+		triangle facing the wind, and is shared by the three vertices.
+	*/
+	Vector3 d = normal;
+	d.normalise();
+	Vector3 force = normal * (d.scalarProduct(direction) * ((real)1.0 / 6));
 
-	return norm;
+	particles[index[0]].addForce(force);
+	particles[index[1]].addForce(force);
+	particles[index[2]].addForce(force);
 }
 
-void Cloth::addWindToTriangles(Particle *p1, Particle *p2, Particle *p3, const Vector3 &direction)
+void Cloth::timeStep(real duration)
 {
-	Vector3 normal = calcTriangleNormal(p1, p2, p2);
+	PROFILE_ZONE("Cloth::timeStep");
 
-	Vector3 d = normal.normalise();
-	Vector3 force = normal*(d.scalarProduct(direction));
+	constr constraint;
+	for (int i = 0; i<CONSTRAINT_ITERATIONS; i++)
+	{
+		for (constraint = constraints.begin(); constraint != constraints.end(); constraint++)
+		{
+			(*constraint).satisfyConstraint();
+		}
+	}
 
-	p1->addForce(force);
-	p2->addForce(force);
-	p3->addForce(force);
+	parts particle;
+	for (particle = particles.begin(); particle != particles.end(); particle++)
+	{
+		//(*particle).intergrate(duration);
+		(*particle).verletIntegrate(0.5);
+	}
+
+	updateSpatialHash();
+
+	if (selfCollisionEnabled)
+		selfCollision();
 }
 
-void Cloth::drawTriangle(Particle *p1, Particle *p2, Particle *p3, const Vector3& color)
+void Cloth::addForce(const Vector3 &direction)
 {
-	glColor3d(color.x, color.y, color.z);
-	glVertex3d(p1->getPosition().x, p1->getPosition().y, p1->getPosition().z);
-	glVertex3d(p2->getPosition().x, p2->getPosition().y, p2->getPosition().z);
-	glVertex3d(p3->getPosition().x, p3->getPosition().y, p3->getPosition().z);
+	parts particle;
+	for (particle = particles.begin(); particle != particles.end(); particle++)
+	{
+		(*particle).addForce(direction * 0.5 * 0.5);
+	}
+
 }
 
-void Cloth::debugDraw()
+void Cloth::addWindForce(const Vector3 direction)
 {
-	g_debugDrawManager.AddCross(Vector3(getParticle(0, 0)->getPosition()), Vector3(0.0f, 0.5f, 0.0f), 0.5f);
-	g_debugDrawManager.AddCross(Vector3(getParticle(num_particles_width - 1, 0)->getPosition()), Vector3(0.0f, 0.5f, 0.0f), 0.5f);
+	unsigned triangleCount = (unsigned)triangles.size() / 3;
+	for (unsigned i = 0; i < triangleCount; i++)
+	{
+		addWindToTriangle(i, direction);
+	}
+}
 
-	for (int x = 0; x < num_particles_width; x++)
+void Cloth::ballCollision(const Sphere& sphere)
+{
+	pushOutOfSphere(sphere.pos, sphere.radius);
+}
+
+void Cloth::updateSpatialHash()
+{
+	PROFILE_ZONE("Cloth::updateSpatialHash");
+
+	positions.resize(particles.size());
+
+	boundsMin = boundsMax = particles[0].getPosition();
+	for (unsigned i = 0; i < particles.size(); i++)
 	{
-		for (int y = 0; y < num_particles_height; y++)
-		{
-			g_debugDrawManager.AddLine(getParticle(x, y)->getPosition(), getParticle(x, y)->getNormal() + getParticle(x, y)->getPosition(), Vector3(1, 0, 0), 0.04f);
-		}
+		Vector3 pos = particles[i].getPosition();
+		positions[i] = pos;
+
+		if (pos.x < boundsMin.x) boundsMin.x = pos.x;
+		if (pos.y < boundsMin.y) boundsMin.y = pos.y;
+		if (pos.z < boundsMin.z) boundsMin.z = pos.z;
+		if (pos.x > boundsMax.x) boundsMax.x = pos.x;
+		if (pos.y > boundsMax.y) boundsMax.y = pos.y;
+		if (pos.z > boundsMax.z) boundsMax.z = pos.z;
 	}
+
+	// A triangle should only cover a few cells of the grid.
+	real cellSize = particleSpacing;
+	if (cellSize < thickness * 2)
+		cellSize = thickness * 2;
+	particleHash.setCellSize(cellSize);
+
+	particleHash.build(&positions[0], (unsigned)positions.size());
 }
 
-void Cloth::draw()
+BoundingBox Cloth::getBounds() const
 {
-	parts particle;
-	for (particle = particles.begin(); particle != particles.end(); particle++)
+	Vector3 margin(thickness, thickness, thickness);
+	return BoundingBox(boundsMin - margin, boundsMax + margin);
+}
+
+BoundingSphere Cloth::getBoundingSphere() const
+{
+	Vector3 center = (boundsMin + boundsMax) * 0.5f;
+	return BoundingSphere(center, (boundsMax - center).magnitude() + thickness);
+}
+
+void Cloth::setSelfCollision(bool enabled, real thickness)
+{
+	selfCollisionEnabled = enabled;
+	Cloth::thickness = thickness;
+}
+
+void Cloth::selfCollision()
+{
+	PROFILE_ZONE("Cloth::selfCollision");
+
+	unsigned triangleCount = (unsigned)triangles.size() / 3;
+	for (unsigned i = 0; i < triangleCount; i++)
 	{
-		(*particle).resetNormal();
+		collideTriangle(i);
 	}
+}
 
-	for (int x = 0; x < num_particles_width - 1; x++)
+void Cloth::collideTriangle(unsigned triangle)
+{
+	const unsigned *index = &triangles[triangle * 3];
+	Particle *vertex[3] = { &particles[index[0]], &particles[index[1]], &particles[index[2]] };
+
+	Vector3 a = vertex[0]->getPosition();
+	Vector3 b = vertex[1]->getPosition();
+	Vector3 c = vertex[2]->getPosition();
+
+	Vector3 edgeOne = b - a;
+	Vector3 edgeTwo = c - a;
+	Vector3 normal = edgeOne % edgeTwo;
+
+	// Skip triangles that have collapsed to a line.
+	real area = normal.magnitude();
+	if (area <= 0)
+		return;
+	normal *= ((real)1.0) / area;
+
+	// Find the particles near the triangle.
+	Vector3 min = a, max = a;
+	for (unsigned i = 1; i < 3; i++)
 	{
-		for (int y = 0; y < num_particles_height - 1; y++)
+		Vector3 p = (i == 1) ? b : c;
+		if (p.x < min.x) min.x = p.x;
+		if (p.y < min.y) min.y = p.y;
+		if (p.z < min.z) min.z = p.z;
+		if (p.x > max.x) max.x = p.x;
+		if (p.y > max.y) max.y = p.y;
+		if (p.z > max.z) max.z = p.z;
+	}
+	Vector3 margin(thickness, thickness, thickness);
+	particleHash.query(min - margin, max + margin, candidates);
+
+	real dotOneOne = edgeOne * edgeOne;
+	real dotOneTwo = edgeOne * edgeTwo;
+	real dotTwoTwo = edgeTwo * edgeTwo;
+	real denom = dotOneOne * dotTwoTwo - dotOneTwo * dotOneTwo;
+
+	for (unsigned i = 0; i < candidates.size(); i++)
+	{
+		unsigned candidate = candidates[i];
+
+		// A particle can't collide with its own triangle.
+		if (candidate == index[0] || candidate == index[1] || candidate == index[2])
+			continue;
+
+		Particle &particle = particles[candidate];
+		Vector3 pos = particle.getPosition();
+		Vector3 toParticle = pos - a;
+
+		real distance = toParticle * normal;
+		if (real_abs(distance) >= thickness)
+			continue;
+
+		/*
+			Work out the barycentric coordinates of the particle projected
+			onto the triangle's plane, to see if it is over the triangle.
+		*/
+		real dotOneP = edgeOne * toParticle;
+		real dotTwoP = edgeTwo * toParticle;
+		real v = (dotTwoTwo * dotOneP - dotOneTwo * dotTwoP) / denom;
+		real w = (dotOneOne * dotTwoP - dotOneTwo * dotOneP) / denom;
+		real u = 1 - v - w;
+
+		if (u < 0 || v < 0 || w < 0)
+			continue;
+
+		/*
+			Push the particle out to the thickness on the side it is
+			already on, and the triangle back by the same amount, spread
+			over its vertices by the barycentric weights.
+		*/
+		real sign = (distance < 0) ? (real)-1 : (real)1;
+		Vector3 move = normal * (sign * (thickness - real_abs(distance)) * 0.5f);
+
+		particle.offsetPos(move);
+
+		real weightScale = ((real)1.0) / (u * u + v * v + w * w);
+		vertex[0]->offsetPos(move * (-u * weightScale));
+		vertex[1]->offsetPos(move * (-v * weightScale));
+		vertex[2]->offsetPos(move * (-w * weightScale));
+	}
+}
+
+void Cloth::pushOutOfSphere(const Vector3 &center, real radius)
+{
+	Vector3 margin(radius, radius, radius);
+	particleHash.query(center - margin, center + margin, candidates);
+
+	for (unsigned i = 0; i < candidates.size(); i++)
+	{
+		Particle &particle = particles[candidates[i]];
+		Vector3 v = particle.getPosition() - center;
+
+		real l = v.magnitude();
+
+		if (l < radius && l > 0)
 		{
-			calcTriangleNormal(getParticle(x + 1, y), getParticle(x, y), getParticle(x, y + 1));
-			calcTriangleNormal(getParticle(x + 1, y + 1), getParticle(x + 1, y), getParticle(x, y + 1));
+			particle.offsetPos(v * ((radius - l) / l));
 		}
 	}
+}
 
-	glBegin(GL_TRIANGLES);
-	for (int x = 0; x < num_particles_width - 1; x++)
+void Cloth::collide(const CollisionSphere &sphere)
+{
+	BoundingBox sphereBounds = CollisionCompound::getPrimitiveBounds(sphere);
+	BoundingBox bounds = getBounds();
+	if (!bounds.overlaps(&sphereBounds))
+		return;
+
+	pushOutOfSphere(sphere.getAxis(3), sphere.radius);
+}
+
+void Cloth::collide(const CollisionBox &box)
+{
+	// The world aligned box around the primitive is also the region queried in the hash.
+	BoundingBox boxBounds = CollisionCompound::getPrimitiveBounds(box);
+	BoundingBox bounds = getBounds();
+	if (!bounds.overlaps(&boxBounds))
+		return;
+
+	particleHash.query(boxBounds.min, boxBounds.max, candidates);
+
+	const Matrix3X4 &transform = box.getTransform();
+	for (unsigned i = 0; i < candidates.size(); i++)
 	{
-		for (int y = 0; y < num_particles_height - 1; y++)
+		Particle &particle = particles[candidates[i]];
+		Vector3 pos = particle.getPosition();
+		Vector3 local = transform.transformInverse(pos);
+
+		/*
+			Find the face the particle is closest to, the particle is
+			moved out through that face.
+		*/
+		real smallest = REAL_MAX;
+		unsigned axis = 0;
+		for (unsigned a = 0; a < 3; a++)
 		{
-			Vector3 color(0.0, 0.0, 0.0);
-			if (x % 2)
-				color = Vector3(0.3f, 0.3f, 0.3f);
-			else
-				color = Vector3(0.2f, 0.4f, 0.9f);
-
-			drawTriangle(getParticle(x + 1, y), getParticle(x, y), getParticle(x, y + 1), color);
-			drawTriangle(getParticle(x + 1, y + 1), getParticle(x + 1, y), getParticle(x, y + 1), color);
+			real depth = box.halfSize[a] - real_abs(local[a]);
+			if (depth < smallest)
+			{
+				smallest = depth;
+				axis = a;
+			}
 		}
+
+		// The particle is outside the box.
+		if (smallest <= 0)
+			continue;
+
+		local[axis] = (local[axis] < 0) ? -box.halfSize[axis] : box.halfSize[axis];
+		particle.offsetPos(transform.transform(local) - pos);
 	}
-	glEnd();
 }
 
-void Cloth::timeStep(real duration)
+void Cloth::collide(const CollisionPlane &plane)
 {
-	constr constraint;
-	for (int i = 0; i<CONSTRAINT_ITERATIONS; i++)
+	BoundingBox bounds = getBounds();
+	Vector3 center = (bounds.min + bounds.max) * 0.5f;
+	Vector3 extent = bounds.max - center;
+
+	// The whole cloth is in front of the plane.
+	real reach = real_abs(plane.normal.x) * extent.x + real_abs(plane.normal.y) * extent.y +
+		real_abs(plane.normal.z) * extent.z;
+	if (plane.normal * center - plane.offset > reach)
+		return;
+
+	// A plane touches every cell, so every particle is tested.
+	for (parts particle = particles.begin(); particle != particles.end(); particle++)
 	{
-		for (constraint = constraints.begin(); constraint != constraints.end(); constraint++)
+		real distance = plane.normal * (*particle).getPosition() - plane.offset;
+
+		if (distance < 0)
 		{
-			(*constraint).satisfyConstraint();
+			(*particle).offsetPos(plane.normal * -distance);
 		}
 	}
+}
 
-	parts particle;
-	for (particle = particles.begin(); particle != particles.end(); particle++)
+void Cloth::collide(const CollisionPrimitive &primitive)
+{
+	switch (primitive.getType())
 	{
-		//(*particle).intergrate(duration);
-		(*particle).verletIntegrate(0.5);
+	case PRIMITIVE_SPHERE:
+		collide(static_cast<const CollisionSphere&>(primitive));
+		break;
+
+	case PRIMITIVE_BOX:
+		collide(static_cast<const CollisionBox&>(primitive));
+		break;
+
+	case PRIMITIVE_PLANE:
+		collide(static_cast<const CollisionPlane&>(primitive));
+		break;
+
+	case PRIMITIVE_COMPOUND:
+	{
+		const CollisionCompound &compound = static_cast<const CollisionCompound&>(primitive);
+		for (unsigned i = 0; i < compound.getChildCount(); i++)
+		{
+			CollisionPrimitive *child = compound.getChild(i);
+			child->calculateInternals();
+			collide(*child);
+		}
+		break;
+	}
+
+	default:
+		break;
 	}
 }
 
-void Cloth::addForce(const Vector3 &direction)
+void Cloth::collide(const BVH_Node<BoundingBox> *root)
 {
-	parts particle;
-	for (particle = particles.begin(); particle != particles.end(); particle++)
+	if (root)
+		collideBelow(root, getBounds());
+}
+
+void Cloth::collideBelow(const BVH_Node<BoundingBox> *node, const BoundingBox &bounds)
+{
+	if (!node->volume.overlaps(&bounds))
+		return;
+
+	if (node->isLeaf())
 	{
-		(*particle).addForce(direction * 0.5 * 0.5);
+		if (node->primitive)
+			collide(*node->primitive);
+		return;
 	}
 
+	collideBelow(node->children[0], bounds);
+	collideBelow(node->children[1], bounds);
 }
 
-void Cloth::addWindForce(const Vector3 direction)
+void Cloth::updateNormals()
 {
-	for (int x = 0; x < num_particles_width - 1; x++)
+	PROFILE_ZONE("Cloth::updateNormals");
+
+	unsigned count = (unsigned)particles.size();
+	unsigned triangleCount = (unsigned)triangles.size() / 3;
+
+	/*
+		The collisions may have moved the particles since they were
+		hashed, so the positions are gathered again first, and the
+		triangles then only read from the array.
+	*/
+	positions.resize(count);
+	for (unsigned i = 0; i < count; i++)
+		positions[i] = particles[i].getPosition();
+
+	/*
+		Each vertex normal is the sum of the normals of the triangles
+		around it. The triangle normals aren't normalised first, so
+		larger triangles count for more.
+	*/
+	normals.assign(count, Vector3());
+	triangleNormals.resize(triangleCount);
+
+	const Vector3 *position = count ? &positions[0] : NULL;
+	const unsigned *index = triangleCount ? &triangles[0] : NULL;
+	for (unsigned i = 0; i < triangleCount; i++, index += 3)
 	{
-		for (int y = 0; y < num_particles_height - 1; y++)
-		{
-			addWindToTriangles(getParticle(x + 1, y), getParticle(x, y), getParticle(x, y + 1), direction);
-			addWindToTriangles(getParticle(x + 1, y + 1), getParticle(x + 1, y), getParticle(x, y + 1), direction);
-		}
+		const Vector3 &a = position[index[0]];
+		Vector3 normal = (position[index[1]] - a) % (position[index[2]] - a);
+
+		triangleNormals[i] = normal;
+		normals[index[0]] += normal;
+		normals[index[1]] += normal;
+		normals[index[2]] += normal;
+	}
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		normals[i].normalise();
 	}
 }
 
-void Cloth::ballCollision(const Sphere& sphere)
+unsigned Cloth::getColumnCount() const
 {
-	parts particle;
-	for (particle = particles.begin(); particle != particles.end(); particle++)
-	{
-		Vector3 v = (*particle).getPosition() - sphere.pos;
+	return (unsigned)num_particles_width;
+}
 
-		real l = v.magnitude();
+unsigned Cloth::getRowCount() const
+{
+	return (unsigned)num_particles_height;
+}
 
-		if (v.magnitude() < sphere.radius)
-		{
-			(*particle).offsetPos(v.normalise()*(sphere.radius - l));
-		}
+unsigned Cloth::getVertexCount() const
+{
+	return (unsigned)particles.size();
+}
+
+unsigned Cloth::getConstraintCount() const
+{
+	return (unsigned)constraints.size();
+}
+
+unsigned Cloth::getTriangleCount() const
+{
+	return (unsigned)triangles.size() / 3;
+}
+
+const unsigned *Cloth::getTriangles() const
+{
+	return triangles.empty() ? NULL : &triangles[0];
+}
+
+const Vector3 *Cloth::getNormals() const
+{
+	return normals.empty() ? NULL : &normals[0];
+}
+
+unsigned Cloth::writeVertices(float *buffer, unsigned capacity) const
+{
+	unsigned count = (unsigned)particles.size();
+	if (count > capacity / CLOTH_VERTEX_SIZE)
+		count = capacity / CLOTH_VERTEX_SIZE;
+
+	for (unsigned i = 0; i < count; i++, buffer += CLOTH_VERTEX_SIZE)
+	{
+		Vector3 pos = particles[i].getPosition();
+		const Vector3 &normal = normals[i];
+
+		buffer[0] = (float)pos.x;
+		buffer[1] = (float)pos.y;
+		buffer[2] = (float)pos.z;
+		buffer[3] = (float)normal.x;
+		buffer[4] = (float)normal.y;
+		buffer[5] = (float)normal.z;
 	}
+
+	return count;
 }
\ No newline at end of file
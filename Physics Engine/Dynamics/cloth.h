@@ -6,11 +6,17 @@
 #include "particle.h"
 #include "../Math/core.h"
 #include "constraint.h"
+#include "../Collision/NarrowPhase.h"
+#include "../Collision/BroadPhase.h"
+#include "../Collision/SpatialHash.h"
 
 namespace Physics_Engine
 {
 #define CONSTRAINT_ITERATIONS 5
 
+// The number of floats written for each vertex by Cloth::writeVertices.
+#define CLOTH_VERTEX_SIZE 6
+
 	class Sphere
 	{
 	public:
@@ -27,6 +33,8 @@ namespace Physics_Engine
 
 	class Cloth
 	{
+		friend class Snapshot;
+
 	private:
 
 		typedef std::vector<Particle>::iterator parts;
@@ -36,21 +44,124 @@ namespace Physics_Engine
 		std::vector<Particle> particles;
 		std::vector<Constraint> constraints;
 
+		// Holds three particle indices for each triangle of the cloth.
+		std::vector<unsigned> triangles;
+
+		// The distance between neighbouring particles at rest.
+		real particleSpacing;
+
+		/*
+			Holds whether the cloth collides with itself, and how close
+			a particle may get to a triangle before they are pushed apart.
+		*/
+		bool selfCollisionEnabled;
+		real thickness;
+
+		/*
+			The particles are hashed into a grid once per step, so the
+			self collision and the collision with other objects only look
+			at the particles that are nearby. The positions are gathered
+			again after the collisions, for the normals.
+		*/
+		SpatialHash particleHash;
+		std::vector<Vector3> positions;
+		std::vector<unsigned> candidates;
+		Vector3 boundsMin, boundsMax;
+
+		/*
+			The normal of each vertex, and the area weighted normal of each
+			triangle. Both are worked out once per step (see updateNormals)
+			and shared by the wind and the rendering.
+		*/
+		std::vector<Vector3> normals;
+		std::vector<Vector3> triangleNormals;
+
 		Particle* getParticle(int x, int y);
 		void makeConstraint(Particle *p1, Particle *p2);
-		Vector3 calcTriangleNormal(Particle *p1, Particle *p2, Particle *p3);
-		void drawTriangle(Particle *p1, Particle *p2, Particle *p3, const Vector3& color);
+		void makeTriangle(int x1, int y1, int x2, int y2, int x3, int y3);
+		void updateSpatialHash();
+		void collideTriangle(unsigned triangle);
+		void pushOutOfSphere(const Vector3 &center, real radius);
+		void addWindToTriangle(unsigned triangle, const Vector3 &direction);
+		void collideBelow(const BVH_Node<BoundingBox> *node, const BoundingBox &bounds);
 
 	public:
 
-		Cloth(real width, real height, int num_particles_width, int num_particles_height);
-		void draw();
+		// The cloth is laid out flat in the XZ plane, starting at the origin given.
+		Cloth(real width, real height, int num_particles_width, int num_particles_height,
+			const Vector3 &origin = Vector3());
 		void timeStep(real duration);
 		void addForce(const Vector3& direction);
-		void addWindToTriangles(Particle *p1, Particle *p2, Particle *p3, const Vector3 &direction);
 		void addWindForce(const Vector3 direction);
 		void ballCollision(const Sphere& sphere);
-		void debugDraw();
+
+		/*
+			Turns collision of the cloth with itself on or off. The
+			thickness is the distance kept between a particle and any
+			triangle it is not part of.
+		*/
+		void setSelfCollision(bool enabled, real thickness);
+		void selfCollision();
+
+		// Returns a box or sphere enclosing the cloth as of the last step.
+		BoundingBox getBounds() const;
+		BoundingSphere getBoundingSphere() const;
+
+		/*
+			Pushes the particles out of the given primitive. The bounds
+			of the cloth are checked first, and only the particles hashed
+			near the primitive are tested (all of them for a plane). A
+			compound's children are each pushed out of in turn.
+		*/
+		void collide(const CollisionPrimitive &primitive);
+		void collide(const CollisionSphere &sphere);
+		void collide(const CollisionBox &box);
+		void collide(const CollisionPlane &plane);
+
+		/*
+			Pushes the particles out of the primitives in a hierarchy (as
+			used by CollisionQuery), only going down the branches whose
+			bounds meet the cloth's. Leaves without a primitive are skipped.
+		*/
+		void collide(const BVH_Node<BoundingBox> *root);
+
+		/*
+			Works out the normals from the particles as they are now. It
+			should be called once a step, after all the collisions, as
+			the wind and writeVertices use the normals.
+		*/
+		void updateNormals();
+
+		/*
+			Returns the number of particles across and down the cloth. The
+			vertex of the particle at (x, y) is y * getColumnCount() + x.
+		*/
+		unsigned getColumnCount() const;
+		unsigned getRowCount() const;
+
+		unsigned getVertexCount() const;
+		unsigned getTriangleCount() const;
+
+		// Returns the number of distance constraints, each satisfied CONSTRAINT_ITERATIONS times a step.
+		unsigned getConstraintCount() const;
+
+		/*
+			Returns three vertex indices for each triangle. The triangles
+			are stored a column at a time, with (getRowCount() - 1) * 2
+			triangles in each column.
+		*/
+		const unsigned *getTriangles() const;
+
+		// Returns the normal of each vertex as of the last updateNormals.
+		const Vector3 *getNormals() const;
+
+		/*
+			Writes the position and then the normal of each vertex, as
+			CLOTH_VERTEX_SIZE floats, into the given buffer. The capacity
+			is in floats. Returns the number of vertices written, which is
+			less than getVertexCount() if the buffer is too small.
+		*/
+		unsigned writeVertices(float *buffer, unsigned capacity) const;
 	};
 }
 #endif
\ No newline at end of file
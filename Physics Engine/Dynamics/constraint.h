@@ -9,6 +9,8 @@ namespace Physics_Engine
 {
 	class Constraint
 	{
+		friend class Snapshot;
+
 	private:
 		real rest_distance;
 
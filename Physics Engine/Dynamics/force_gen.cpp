@@ -2,6 +2,12 @@
 
 using namespace Physics_Engine;
 
+Gravity::Gravity(const Vector3 &gravity)
+	: gravity(gravity)
+{
+
+}
+
 void Gravity::updateForce(RigidBody *body, real duration)
 {
 	// Check that we do not have infinite mass.
@@ -12,6 +18,14 @@ void Gravity::updateForce(RigidBody *body, real duration)
 	body->addForce(gravity * body->getMass());
 }
 
+Spring::Spring(const Vector3 &localConnectionPt, RigidBody *other, const Vector3 &otherConnectionPt,
+	real springConstant, real restLength)
+	: connectionPoint(localConnectionPt), otherConnectionPoint(otherConnectionPt), other(other),
+	springConstant(springConstant), restLength(restLength)
+{
+
+}
+
 void Spring::updateForce(RigidBody *body, real duration)
 {
 	// Calculate the two ends in world space
@@ -156,6 +170,14 @@ void ForceRegistry::updateForces(real duration)
 	ForceRegistations::iterator i = registations.begin();
 	for (; i != registations.end(); i++)
 	{
+		/*
+			Sleeping bodies are skipped, as a force would wake them. A
+			body that should be woken by a force (such as a spring to a
+			moving body) must be woken, or kept from sleeping, by hand.
+		*/
+		if (!i->body->getAwake())
+			continue;
+
 		i->forceGen->updateForce(i->body, duration);
 	}
 }
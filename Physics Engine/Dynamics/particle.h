@@ -7,6 +7,9 @@ namespace Physics_Engine
 {
 	class Particle
 	{
+		// Snapshots save and restore the whole state of the particle.
+		friend class Snapshot;
+
 	protected:
 		Vector3 position;
 		Vector3 oldPosition;	// For verlet integration.
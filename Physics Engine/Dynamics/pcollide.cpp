@@ -0,0 +1,253 @@
+#include "pcollide.h"
+
+using namespace Physics_Engine;
+
+ParticleCollider::ParticleCollider()
+	: particles(0), radius(0), radii(0), restitution(0)
+{
+
+}
+
+void ParticleCollider::init(ParticleWorld::Particles *particles, real radius, real restitution)
+{
+	ParticleCollider::particles = particles;
+	ParticleCollider::radius = radius;
+	ParticleCollider::restitution = restitution;
+}
+
+inline real ParticleCollider::getRadius(unsigned index) const
+{
+	return radii ? radii[index] : radius;
+}
+
+unsigned ParticlePlaneContacts::addContact(ParticleContact *contact, unsigned limit) const
+{
+	unsigned count = 0;
+	unsigned particleCount = (unsigned)particles->size();
+
+	for (unsigned i = 0; i < particleCount && count < limit; i++)
+	{
+		Particle *particle = (*particles)[i];
+		if (particle->getInverseMass() <= 0)
+			continue;
+
+		real distance = plane->normal * particle->getPosition() - plane->offset - getRadius(i);
+		if (distance >= 0)
+			continue;
+
+		contact->particle[0] = particle;
+		contact->particle[1] = 0;
+		contact->contactNormal = plane->normal;
+		contact->penetration = -distance;
+		contact->restitution = restitution;
+
+		contact++;
+		count++;
+	}
+
+	return count;
+}
+
+unsigned ParticleSphereContacts::addContact(ParticleContact *contact, unsigned limit) const
+{
+	unsigned count = 0;
+	unsigned particleCount = (unsigned)particles->size();
+	Vector3 center = sphere->getAxis(3);
+
+	for (unsigned i = 0; i < particleCount && count < limit; i++)
+	{
+		Particle *particle = (*particles)[i];
+		if (particle->getInverseMass() <= 0)
+			continue;
+
+		Vector3 midline = particle->getPosition() - center;
+		real reach = sphere->radius + getRadius(i);
+
+		// Check the square distance first to avoid the square root.
+		real squareDistance = midline.squareMagnitude();
+		if (squareDistance >= reach * reach)
+			continue;
+
+		/*
+			A particle right at the centre has no direction to be
+			pushed in, so it is sent straight up.
+		*/
+		real distance = real_sqrt(squareDistance);
+		Vector3 normal = (distance > 0) ? midline * (((real)1.0) / distance) : Vector3(0, 1, 0);
+
+		contact->particle[0] = particle;
+		contact->particle[1] = 0;
+		contact->contactNormal = normal;
+		contact->penetration = reach - distance;
+		contact->restitution = restitution;
+
+		contact++;
+		count++;
+	}
+
+	return count;
+}
+
+unsigned ParticleBoxContacts::addContact(ParticleContact *contact, unsigned limit) const
+{
+	unsigned count = 0;
+	unsigned particleCount = (unsigned)particles->size();
+	const Matrix3X4 &transform = box->getTransform();
+
+	for (unsigned i = 0; i < particleCount && count < limit; i++)
+	{
+		Particle *particle = (*particles)[i];
+		if (particle->getInverseMass() <= 0)
+			continue;
+
+		real particleRadius = getRadius(i);
+		Vector3 pos = particle->getPosition();
+		Vector3 local = transform.transformInverse(pos);
+
+		// Early out if the particle is clearly outside the box.
+		if (real_abs(local.x) - particleRadius >= box->halfSize.x ||
+			real_abs(local.y) - particleRadius >= box->halfSize.y ||
+			real_abs(local.z) - particleRadius >= box->halfSize.z)
+			continue;
+
+		// Clamp the particle to the box to find the closest point.
+		Vector3 closest = local;
+		bool inside = true;
+		for (unsigned a = 0; a < 3; a++)
+		{
+			if (closest[a] > box->halfSize[a])
+			{
+				closest[a] = box->halfSize[a];
+				inside = false;
+			}
+			else if (closest[a] < -box->halfSize[a])
+			{
+				closest[a] = -box->halfSize[a];
+				inside = false;
+			}
+		}
+
+		Vector3 normal;
+		real penetration;
+		if (inside)
+		{
+			/*
+				The centre of the particle is inside the box, so it is
+				pushed out through the nearest face.
+			*/
+			real smallest = REAL_MAX;
+			unsigned axis = 0;
+			for (unsigned a = 0; a < 3; a++)
+			{
+				real depth = box->halfSize[a] - real_abs(local[a]);
+				if (depth < smallest)
+				{
+					smallest = depth;
+					axis = a;
+				}
+			}
+
+			normal = box->getAxis(axis);
+			if (local[axis] < 0)
+				normal.invert();
+			penetration = smallest + particleRadius;
+		}
+		else
+		{
+			Vector3 closestWorld = transform.transform(closest);
+			normal = pos - closestWorld;
+
+			real squareDistance = normal.squareMagnitude();
+			if (squareDistance >= particleRadius * particleRadius)
+				continue;
+
+			real distance = real_sqrt(squareDistance);
+			normal *= ((real)1.0) / distance;
+			penetration = particleRadius - distance;
+		}
+
+		contact->particle[0] = particle;
+		contact->particle[1] = 0;
+		contact->contactNormal = normal;
+		contact->penetration = penetration;
+		contact->restitution = restitution;
+
+		contact++;
+		count++;
+	}
+
+	return count;
+}
+
+unsigned ParticleParticleContacts::addContact(ParticleContact *contact, unsigned limit) const
+{
+	unsigned particleCount = (unsigned)particles->size();
+	if (particleCount < 2 || limit == 0)
+		return 0;
+
+	positions.resize(particleCount);
+	real maxRadius = radius;
+	for (unsigned i = 0; i < particleCount; i++)
+	{
+		positions[i] = (*particles)[i]->getPosition();
+
+		real r = getRadius(i);
+		if (r > maxRadius)
+			maxRadius = r;
+	}
+
+	if (maxRadius <= 0)
+		return 0;
+
+	/*
+		With cells as wide as the largest particle, each query only
+		covers a few cells in each direction.
+	*/
+	hash.setCellSize(maxRadius * 2);
+	hash.build(&positions[0], particleCount);
+
+	unsigned count = 0;
+	for (unsigned i = 0; i < particleCount && count < limit; i++)
+	{
+		Particle *first = (*particles)[i];
+		real firstRadius = getRadius(i);
+		real reach = firstRadius + maxRadius;
+		Vector3 margin(reach, reach, reach);
+
+		hash.query(positions[i] - margin, positions[i] + margin, candidates);
+
+		for (unsigned c = 0; c < candidates.size() && count < limit; c++)
+		{
+			// Each pair is only tested from its lower index.
+			unsigned j = candidates[c];
+			if (j <= i)
+				continue;
+
+			Particle *second = (*particles)[j];
+			if (first->getInverseMass() <= 0 && second->getInverseMass() <= 0)
+				continue;
+
+			Vector3 midline = positions[i] - positions[j];
+			real touching = firstRadius + getRadius(j);
+
+			real squareDistance = midline.squareMagnitude();
+			if (squareDistance >= touching * touching)
+				continue;
+
+			// Particles in exactly the same place are pushed apart vertically.
+			real distance = real_sqrt(squareDistance);
+			Vector3 normal = (distance > 0) ? midline * (((real)1.0) / distance) : Vector3(0, 1, 0);
+
+			contact->particle[0] = first;
+			contact->particle[1] = second;
+			contact->contactNormal = normal;
+			contact->penetration = touching - distance;
+			contact->restitution = restitution;
+
+			contact++;
+			count++;
+		}
+	}
+
+	return count;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef PCOLLIDE_H
+#define PCOLLIDE_H
+
+#include "pworld.h"
+#include "../Collision/NarrowPhase.h"
+#include "../Collision/SpatialHash.h"
+
+namespace Physics_Engine
+{
+	/*
+		The base class for contact generators that treat a set of
+		particles as small spheres. All the particles can share one
+		radius, or a radius can be given for each of them.
+	*/
+	class ParticleCollider : public ParticleContactGenerator
+	{
+	public:
+		// Holds the particles that collide.
+		ParticleWorld::Particles *particles;
+
+		// Holds the radius used when no radii are given.
+		real radius;
+
+		/*
+			Holds the radius of each particle, in the same order as the
+			particles. May be NULL.
+		*/
+		const real *radii;
+
+		real restitution;
+
+	public:
+		ParticleCollider();
+
+		void init(ParticleWorld::Particles *particles, real radius, real restitution = 0);
+
+	protected:
+		real getRadius(unsigned index) const;
+	};
+
+	/*
+		Generates contacts between the particles and a plane. The
+		plane is treated as a half space, so particles behind it are
+		pushed back out.
+	*/
+	class ParticlePlaneContacts : public ParticleCollider
+	{
+	public:
+		const CollisionPlane *plane;
+
+	public:
+		virtual unsigned addContact(ParticleContact *contact, unsigned limit) const;
+	};
+
+	/*
+		Generates contacts between the particles and a sphere. The
+		sphere is treated as immovable, even if it has a rigid body.
+	*/
+	class ParticleSphereContacts : public ParticleCollider
+	{
+	public:
+		const CollisionSphere *sphere;
+
+	public:
+		virtual unsigned addContact(ParticleContact *contact, unsigned limit) const;
+	};
+
+	/*
+		Generates contacts between the particles and a box. The box is
+		treated as immovable, even if it has a rigid body.
+	*/
+	class ParticleBoxContacts : public ParticleCollider
+	{
+	public:
+		const CollisionBox *box;
+
+	public:
+		virtual unsigned addContact(ParticleContact *contact, unsigned limit) const;
+	};
+
+	/*
+		Generates contacts between every pair of touching particles.
+		The particles are put into a spatial hash each time contacts
+		are generated, so only nearby pairs are ever tested.
+	*/
+	class ParticleParticleContacts : public ParticleCollider
+	{
+	protected:
+		mutable SpatialHash hash;
+		mutable std::vector<Vector3> positions;
+		mutable std::vector<unsigned> candidates;
+
+	public:
+		virtual unsigned addContact(ParticleContact *contact, unsigned limit) const;
+	};
+}
+
+#endif	// PCOLLIDE_H
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "pcontacts.h"
+#include "../World/profiler.h"
+#include <algorithm>
 
 using namespace Physics_Engine;
 
@@ -71,6 +73,15 @@ void ParticleContact::resolveVelocity(real duration)
 
 void ParticleContact::resolveInterpenetration(real duration)
 {
+	/*
+		The resolver reads the movement after every contact, so it is
+		cleared first for the cases that move nothing. The contacts
+		come from uninitialised memory, and may be resolved more than
+		once.
+	*/
+	particleMovement[0].clear();
+	particleMovement[1].clear();
+
 	if (penetration <= 0)
 		return;
 
@@ -87,8 +98,6 @@ void ParticleContact::resolveInterpenetration(real duration)
 
 	if (particle[1])
 		particleMovement[1] = movePerIMass * -particle[1]->getInverseMass();
-	else
-		particleMovement[1].clear();
 
 	particle[0]->setPosition(particle[0]->getPosition() + particleMovement[0]);
 
@@ -97,65 +106,265 @@ void ParticleContact::resolveInterpenetration(real duration)
 }
 
 ParticleContactResolver::ParticleContactResolver(unsigned iterations)
+	: iterationsUsed(0), residualPenetration(0), residualVelocity(0),
+	velocityTolerance(0), penetrationTolerance(0)
 {
 	ParticleContactResolver::iterations = iterations;
 }
 
+unsigned ParticleContactResolver::getIterationsUsed() const
+{
+	return iterationsUsed;
+}
+
+real ParticleContactResolver::getResidualPenetration() const
+{
+	return residualPenetration;
+}
+
+real ParticleContactResolver::getResidualVelocity() const
+{
+	return residualVelocity;
+}
+
 void ParticleContactResolver::setIterations(unsigned iterations)
 {
 	ParticleContactResolver::iterations = iterations;
 }
 
-void ParticleContactResolver::resolveContacts(ParticleContact *contactArray, unsigned numContacts, real duration)
+void ParticleContactResolver::setTolerance(real velocityTolerance, real penetrationTolerance)
 {
-	unsigned i;
+	ParticleContactResolver::velocityTolerance = velocityTolerance;
+	ParticleContactResolver::penetrationTolerance = penetrationTolerance;
+}
 
-	iterationsUsed = 0;
-	while (iterationsUsed < iterations)
+void ParticleContactResolver::setTimeBudget(real microseconds)
+{
+	timeBudget.setBudget(microseconds);
+}
+
+real ParticleContactResolver::getTimeBudget() const
+{
+	return timeBudget.getBudget();
+}
+
+bool ParticleContactResolver::wasBudgetExhausted() const
+{
+	return timeBudget.wasExhausted();
+}
+
+/*
+	Orders the contact sides by particle, then by contact so the order
+	doesn't depend on the sort.
+*/
+bool ParticleContactResolver::sideBefore(const ContactSide &a, const ContactSide &b)
+{
+	if (a.particle != b.particle)
+		return std::less<Particle*>()(a.particle, b.particle);
+
+	return a.contact < b.contact;
+}
+
+void ParticleContactResolver::buildAdjacency(const ParticleContact *contactArray, unsigned numContacts)
+{
+	sides.clear();
+	for (unsigned i = 0; i < numContacts; i++)
 	{
-		real max = REAL_MAX;
-		unsigned maxIndex = numContacts;
-		for (int i = 0; i < numContacts; i++)
+		for (unsigned s = 0; s < 2; s++)
 		{
-			real sepVelocity = contactArray[i].calculateSeparatingVelocity();
+			if (!contactArray[i].particle[s])
+				continue;
+
+			ContactSide side;
+			side.particle = contactArray[i].particle[s];
+			side.contact = i;
+			side.side = s;
+			sides.push_back(side);
+		}
+	}
 
-			if (sepVelocity < max && 
-				(sepVelocity < 0 || contactArray[i].penetration > 0))
-			{
-				max = sepVelocity;
-				maxIndex = i;
-			}
+	std::sort(sides.begin(), sides.end(), sideBefore);
+
+	/*
+		A contact side without a particle has nothing shared with it,
+		so it is given an empty range.
+	*/
+	sharedStart.assign(numContacts * 2, 0);
+	sharedEnd.assign(numContacts * 2, 0);
+
+	unsigned count = (unsigned)sides.size();
+	unsigned start = 0;
+	while (start < count)
+	{
+		unsigned end = start + 1;
+		while (end < count && sides[end].particle == sides[start].particle)
+			end++;
+
+		for (unsigned i = start; i < end; i++)
+		{
+			unsigned index = sides[i].contact * 2 + sides[i].side;
+			sharedStart[index] = start;
+			sharedEnd[index] = end;
 		}
 
-		if (maxIndex == numContacts)
+		start = end;
+	}
+}
+
+real ParticleContactResolver::calculatePriority(const ParticleContact &contact) const
+{
+	real sepVelocity = contact.calculateSeparatingVelocity();
+
+	// Only contacts that are closing or interpenetrating (by more than the tolerance) need resolving.
+	if (sepVelocity < -velocityTolerance || contact.penetration > penetrationTolerance)
+		return sepVelocity;
+
+	return REAL_MAX;
+}
+
+inline bool ParticleContactResolver::moreSevere(unsigned a, unsigned b) const
+{
+	// Ties go to the first contact in the array.
+	if (priorities[a] != priorities[b])
+		return priorities[a] < priorities[b];
+
+	return a < b;
+}
+
+inline void ParticleContactResolver::swapHeap(unsigned a, unsigned b)
+{
+	unsigned contact = heap[a];
+	heap[a] = heap[b];
+	heap[b] = contact;
+
+	heapPositions[heap[a]] = a;
+	heapPositions[heap[b]] = b;
+}
+
+void ParticleContactResolver::buildHeap(unsigned numContacts)
+{
+	heap.resize(numContacts);
+	heapPositions.resize(numContacts);
+	for (unsigned i = 0; i < numContacts; i++)
+	{
+		heap[i] = i;
+		heapPositions[i] = i;
+	}
+
+	// Sift down every parent, starting at the last.
+	for (unsigned i = numContacts / 2; i-- > 0;)
+	{
+		updateHeap(heap[i]);
+	}
+}
+
+void ParticleContactResolver::updateHeap(unsigned contact)
+{
+	unsigned position = heapPositions[contact];
+
+	// Move up while the contact is more severe than its parent.
+	while (position > 0)
+	{
+		unsigned parent = (position - 1) / 2;
+		if (!moreSevere(contact, heap[parent]))
+			break;
+
+		swapHeap(position, parent);
+		position = parent;
+	}
+
+	// Move down while a child is more severe.
+	unsigned size = (unsigned)heap.size();
+	for (;;)
+	{
+		unsigned child = position * 2 + 1;
+		if (child >= size)
+			break;
+
+		if (child + 1 < size && moreSevere(heap[child + 1], heap[child]))
+			child++;
+
+		if (!moreSevere(heap[child], contact))
+			break;
+
+		swapHeap(position, child);
+		position = child;
+	}
+}
+
+void ParticleContactResolver::resolveContacts(ParticleContact *contactArray, unsigned numContacts, real duration)
+{
+	PROFILE_ZONE("ParticleContactResolver::resolveContacts");
+
+	iterationsUsed = 0;
+	residualPenetration = residualVelocity = 0;
+	if (numContacts == 0)
+		return;
+
+	buildAdjacency(contactArray, numContacts);
+
+	priorities.resize(numContacts);
+	for (unsigned i = 0; i < numContacts; i++)
+	{
+		priorities[i] = calculatePriority(contactArray[i]);
+	}
+	buildHeap(numContacts);
+
+	timeBudget.begin();
+	while (iterationsUsed < iterations)
+	{
+		// The most severe contact is at the top of the heap.
+		unsigned maxIndex = heap[0];
+		if (priorities[maxIndex] == REAL_MAX)
 			break;
 
-		contactArray[maxIndex].resolve(duration);
+		ParticleContact &resolved = contactArray[maxIndex];
+		resolved.resolve(duration);
 
-		Vector3 *move = contactArray[maxIndex].particleMovement;
-		for (i = 0; i < numContacts; i++)
+		/*
+			Only the contacts sharing a particle with the resolved contact
+			(including itself) have had their particles moved or their
+			velocities changed, so only they are updated.
+		*/
+		Vector3 *move = resolved.particleMovement;
+		for (unsigned s = 0; s < 2; s++)
 		{
-			if (contactArray[i].particle[0] == contactArray[maxIndex].particle[0])
-			{
-				contactArray[i].penetration -= move[0] * contactArray[i].contactNormal;
-			}
-			else if (contactArray[i].particle[0] == contactArray[maxIndex].particle[1])
-			{
-				contactArray[i].penetration -= move[1] * contactArray[i].contactNormal;
-			}
-			if (contactArray[i].particle[1])
+			unsigned index = maxIndex * 2 + s;
+			for (unsigned i = sharedStart[index]; i < sharedEnd[index]; i++)
 			{
-				if (contactArray[i].particle[1] == contactArray[maxIndex].particle[0])
-				{
-					contactArray[i].penetration += move[0] * contactArray[i].contactNormal;
-				}
-				else if (contactArray[i].particle[1] == contactArray[maxIndex].particle[1])
-				{
-					contactArray[i].penetration += move[1] * contactArray[i].contactNormal;
-				}
+				ParticleContact &contact = contactArray[sides[i].contact];
+
+				if (sides[i].side == 0)
+					contact.penetration -= move[s] * contact.contactNormal;
+				else
+					contact.penetration += move[s] * contact.contactNormal;
+
+				priorities[sides[i].contact] = calculatePriority(contact);
+				updateHeap(sides[i].contact);
 			}
 		}
 
 		iterationsUsed++;
+
+		if (timeBudget.hasExpired())
+			break;
+	}
+	timeBudget.end();
+
+	/*
+		The priorities are up to date, and hold the separating velocities
+		of the contacts outside the tolerance. Those inside it may still
+		be closing a little.
+	*/
+	for (unsigned i = 0; i < numContacts; i++)
+	{
+		real velocity = priorities[i];
+		if (velocity == REAL_MAX)
+			velocity = contactArray[i].calculateSeparatingVelocity();
+
+		if (contactArray[i].penetration > residualPenetration)
+			residualPenetration = contactArray[i].penetration;
+		if (velocity < 0 && -velocity > residualVelocity)
+			residualVelocity = -velocity;
 	}
 }
\ No newline at end of file
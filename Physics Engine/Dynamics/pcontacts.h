@@ -2,6 +2,8 @@
 #define PCONTACTS_H
 
 #include "particle.h"
+#include "../World/budget.h"
+#include <vector>
 
 namespace Physics_Engine
 {
@@ -29,16 +31,107 @@ namespace Physics_Engine
 		void resolveInterpenetration(real duration);
 	};
 
+	/*
+		Resolves a set of particle contacts, always the most severe one
+		first. The contacts are kept in a heap ordered by their separating
+		velocity, and each particle keeps a list of the contacts it is in,
+		so resolving a contact only updates the contacts sharing one of
+		its particles rather than every contact in the array.
+	*/
 	class ParticleContactResolver
 	{
 	protected:
 		unsigned iterations;
 		unsigned iterationsUsed;
 
+		/*
+			Holds the deepest penetration and the fastest closing velocity
+			of any contact after the last resolution.
+		*/
+		real residualPenetration;
+		real residualVelocity;
+
+		/*
+			Holds the closing velocity and penetration a contact can have
+			and still be left alone, see setTolerance.
+		*/
+		real velocityTolerance;
+		real penetrationTolerance;
+
+		// Holds the time each call to resolveContacts may take.
+		TimeBudget timeBudget;
+
+		// One of the two particles of a contact.
+		struct ContactSide
+		{
+			Particle *particle;
+			unsigned contact;
+			unsigned side;
+		};
+
+		/*
+			Holds the sides of all the contacts sorted by particle, so the
+			contacts sharing a particle are next to each other.
+		*/
+		std::vector<ContactSide> sides;
+
+		/*
+			Holds the range in sides of the contacts sharing each side of
+			each contact (two ranges per contact).
+		*/
+		std::vector<unsigned> sharedStart;
+		std::vector<unsigned> sharedEnd;
+
+		/*
+			Holds the separating velocity of each contact, or REAL_MAX if it
+			doesn't need resolving, and a heap of contact indices ordered by it.
+			heapPositions holds where each contact is in the heap.
+		*/
+		std::vector<real> priorities;
+		std::vector<unsigned> heap;
+		std::vector<unsigned> heapPositions;
+
 	public:
 		ParticleContactResolver(unsigned iterations);
 		void setIterations(unsigned iterations);
+
+		// Returns the number of iterations the last call to resolveContacts took.
+		unsigned getIterationsUsed() const;
+
+		real getResidualPenetration() const;
+		real getResidualVelocity() const;
+
+		/*
+			Sets how close to resolved the contacts have to be for the
+			resolver to stop early. By default both are zero, so every
+			closing or interpenetrating contact is resolved.
+		*/
+		void setTolerance(real velocityTolerance, real penetrationTolerance);
+
+		/*
+			Limits the time each call to resolveContacts may take, in
+			microseconds, or removes the limit if it is zero. The resolver
+			stops when the contacts are within the tolerance, when the
+			iterations run out or when the time does, whichever is first.
+			Whatever is left unresolved stays in the particles, to be
+			picked up by the next step's contacts.
+		*/
+		void setTimeBudget(real microseconds);
+		real getTimeBudget() const;
+
+		// Returns true if the last call to resolveContacts ran out of time.
+		bool wasBudgetExhausted() const;
+
 		void resolveContacts(ParticleContact *contactArray, unsigned numContacts, real duration);
+
+	protected:
+		static bool sideBefore(const ContactSide &a, const ContactSide &b);
+		void buildAdjacency(const ParticleContact *contactArray, unsigned numContacts);
+		real calculatePriority(const ParticleContact &contact) const;
+		bool moreSevere(unsigned a, unsigned b) const;
+		void buildHeap(unsigned numContacts);
+		void updateHeap(unsigned contact);
+		void swapHeap(unsigned a, unsigned b);
 	};
 
 	/*
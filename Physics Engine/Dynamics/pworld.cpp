@@ -1,17 +1,19 @@
 #include "pworld.h"
+#include "../World/profiler.h"
 
 using namespace Physics_Engine;
 
 ParticleWorld::ParticleWorld(unsigned maxContacts, unsigned iterations)
-: resolver(iterations), maxContacts(maxContacts)
+: resolver(iterations), arena(maxContacts * sizeof(ParticleContact)),
+contacts(0), maxContacts(maxContacts), contactCount(0), contactHighWaterMark(0),
+contactOverflows(0), totalContactOverflows(0)
 {
-	contacts = new ParticleContact[maxContacts];
 	b_calculateIterations = (iterations == 0);
 }
 
 ParticleWorld::~ParticleWorld()
 {
-	delete[] contacts;
+
 }
 
 void ParticleWorld::startFrame()
@@ -25,30 +27,53 @@ void ParticleWorld::startFrame()
 
 unsigned ParticleWorld::generateContacts()
 {
-	unsigned limit = maxContacts;
-	ParticleContact *nextContact = contacts;
+	PROFILE_ZONE("ParticleWorld::generateContacts");
+
+	// The array has one spare slot past the room for contacts.
+	contacts = arena.allocateArray<ParticleContact>(maxContacts + 1);
+	contactOverflows = 0;
+	unsigned used = 0;
 
 	for (ContactGenerators::iterator g = contactGenerators.begin();
 		g != contactGenerators.end(); g++)
 	{
-		unsigned used = (*g)->addContact(nextContact, limit);
-		limit -= used;
-		nextContact += used;
+		unsigned room = maxContacts - used;
+		unsigned added = (*g)->addContact(contacts + used, room + 1);
 
 		/*
-			We have run out of contacts to fill. This means we are
-			missing contacts
+			Each generator may also write into the spare slot, so one
+			that does had more contacts than there was room for. Only
+			then is the array grown and the generator asked again, one
+			that exactly fills the room is kept as it is. Generators
+			don't change anything when they add contacts, so asking
+			again gives the same ones.
 		*/
-		if (limit <= 0)
-			break;
+		while (added > room)
+		{
+			unsigned capacity = maxContacts > 0 ? maxContacts * 2 : 16;
+			contacts = arena.reallocateArray(contacts, used, capacity + 1);
+			maxContacts = capacity;
+			contactOverflows++;
+			totalContactOverflows++;
+
+			room = maxContacts - used;
+			added = (*g)->addContact(contacts + used, room + 1);
+		}
+
+		used += added;
 	}
 
+	if (used > contactHighWaterMark)
+		contactHighWaterMark = used;
+
 	// Return the number of contacts used
-	return maxContacts - limit;
+	return used;
 }
 
 void ParticleWorld::intergrate(real duration)
 {
+	PROFILE_ZONE("ParticleWorld::intergrate");
+
 	for (Particles::iterator p = particles.begin(); p != particles.end(); p++)
 	{
 		// Intergrate the particle by the given duration
@@ -58,14 +83,21 @@ void ParticleWorld::intergrate(real duration)
 
 void ParticleWorld::runPhysics(real duration)
 {
+	PROFILE_ZONE("ParticleWorld::runPhysics");
+
+	StageTimer timer(stats);
+
 	// First apply the force generators
 	registry.updateForces(duration);
 
 	// Then we integrate the objects
 	intergrate(duration);
+	timer.lap(STAGE_INTEGRATION);
 
 	// Generate contacts
 	unsigned usedContacts = generateContacts();
+	contactCount = usedContacts;
+	timer.lap(STAGE_NARROWPHASE);
 
 	if (usedContacts)
 	{
@@ -73,7 +105,18 @@ void ParticleWorld::runPhysics(real duration)
 			resolver.setIterations(usedContacts * 2);
 
 		resolver.resolveContacts(contacts, usedContacts, duration);
+		stats.addResolver(resolver);
 	}
+	timer.lap(STAGE_RESOLUTION);
+
+	// The contacts are finished with, so free them all at once.
+	arena.reset();
+
+	// The contact array grows rather than dropping contacts.
+	stats.bodies = (unsigned)particles.size();
+	stats.contactsGenerated = usedContacts;
+	timer.finish();
+	statsChannel.publish(stats);
 }
 
 // List of particles ... Method to implement
@@ -90,4 +133,61 @@ ParticleWorld::ContactGenerators& ParticleWorld::getContactGenerators()
 ParticleForceRegistry& ParticleWorld::getForceRegistry()
 {
 	return registry;
+}
+
+ParticleContactResolver& ParticleWorld::getResolver()
+{
+	return resolver;
+}
+
+unsigned ParticleWorld::getMaxContacts() const
+{
+	return maxContacts;
+}
+
+unsigned ParticleWorld::getContactCount() const
+{
+	return contactCount;
+}
+
+unsigned ParticleWorld::getIterationsUsed() const
+{
+	// The resolver isn't run when there are no contacts.
+	return contactCount > 0 ? resolver.getIterationsUsed() : 0;
+}
+
+unsigned ParticleWorld::getContactHighWaterMark() const
+{
+	return contactHighWaterMark;
+}
+
+unsigned ParticleWorld::getContactOverflows() const
+{
+	return contactOverflows;
+}
+
+unsigned ParticleWorld::getTotalContactOverflows() const
+{
+	return totalContactOverflows;
+}
+
+const StepStats& ParticleWorld::getStats() const
+{
+	return stats;
+}
+
+const StepStatsChannel& ParticleWorld::getStatsChannel() const
+{
+	return statsChannel;
+}
+
+void ParticleWorld::presizeContacts(unsigned contacts)
+{
+	if (contacts > maxContacts)
+		maxContacts = contacts;
+}
+
+Arena& ParticleWorld::getArena()
+{
+	return arena;
 }
\ No newline at end of file
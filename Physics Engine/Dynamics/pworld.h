@@ -3,6 +3,8 @@
 
 #include "../Dynamics/plinks.h"
 #include "../Dynamics/pfGen.h"
+#include "../World/arena.h"
+#include "../World/stats.h"
 
 namespace Physics_Engine
 {
@@ -35,19 +37,47 @@ namespace Physics_Engine
 		// Contact generators
 		ContactGenerators contactGenerators;
 
+		/*
+			Holds the data that only lasts for one step, such as the
+			contacts. It is reset at the end of each step.
+		*/
+		Arena arena;
+
 		// Holds the list of contacts
 		ParticleContact *contacts;
 
-		// Holds the maximum number of contacts allowed (Size of the contacts array)
+		/*
+			Holds the number of contacts there is room for. It grows
+			whenever a generator has more contacts than there is room
+			left, and stays grown, so the array settles at the size the
+			world needs.
+		*/
 		unsigned maxContacts;
 
+		// Holds the number of contacts generated in the last step.
+		unsigned contactCount;
+
+		// Holds the most contacts generated in a single step.
+		unsigned contactHighWaterMark;
+
+		/*
+			Holds the number of times the contact array had to grow
+			during the last step, and over all the steps so far.
+		*/
+		unsigned contactOverflows;
+		unsigned totalContactOverflows;
+
+		// Holds the stats of the last step, and passes them on to other threads.
+		StepStats stats;
+		StepStatsChannel statsChannel;
+
 	public:
 		/*
-			Creates a new particle simulator that can handle up to the
-			given number of contacts per frame. You can also optionally
-			give a number of contact-resolution iterations to use. 
-			If you don't give a number of iterations, then twice the 
-			number of contacts will be used.
+			Creates a new particle simulator with room for the given
+			number of contacts per frame, which grows if more are found.
+			You can also optionally give a number of contact-resolution
+			iterations to use. If you don't give a number of iterations,
+			then twice the number of contacts will be used.
 		*/
 		ParticleWorld(unsigned maxContacts, unsigned iteration = 0);
 
@@ -82,6 +112,45 @@ namespace Physics_Engine
 
 		// Returns the force registry
 		ParticleForceRegistry& getForceRegistry();
+
+		/*
+			Returns the contact resolver, to set its tolerance and time
+			budget. When the world calculates the iterations, they are
+			only a ceiling on what the tolerance and budget allow.
+		*/
+		ParticleContactResolver& getResolver();
+
+		unsigned getMaxContacts() const;
+
+		/*
+			Returns the number of contacts generated in the last step, and
+			the number of iterations the resolver took over them.
+		*/
+		unsigned getContactCount() const;
+		unsigned getIterationsUsed() const;
+
+		unsigned getContactHighWaterMark() const;
+		unsigned getContactOverflows() const;
+		unsigned getTotalContactOverflows() const;
+
+		/*
+			Returns the stats of the last step. They can be read from
+			other threads through the channel while the world runs.
+		*/
+		const StepStats& getStats() const;
+		const StepStatsChannel& getStatsChannel() const;
+
+		/*
+			Makes room for the given number of contacts, to avoid the
+			array growing during the first steps.
+		*/
+		void presizeContacts(unsigned contacts);
+
+		/*
+			Returns the arena for the current step, which contact
+			generators can use for their own scratch space.
+		*/
+		Arena& getArena();
 	};
 }
 #endif
\ No newline at end of file
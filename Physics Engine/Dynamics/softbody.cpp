@@ -0,0 +1,643 @@
+#include "softbody.h"
+#include "../World/profiler.h"
+#include "../Collision/Compound.h"
+#include <assert.h>
+#include <algorithm>
+
+using namespace Physics_Engine;
+
+SoftBody::SoftBody(unsigned substeps, unsigned iterations)
+	: gravity(0, -9.81f, 0), damping(1), substeps(substeps), iterations(iterations)
+{
+
+}
+
+unsigned SoftBody::addParticle(const Vector3 &position, real inverseMass)
+{
+	positions.push_back(position);
+	previousPositions.push_back(position);
+	velocities.push_back(Vector3());
+	forceAccums.push_back(Vector3());
+	inverseMasses.push_back(inverseMass);
+
+	return (unsigned)positions.size() - 1;
+}
+
+void SoftBody::addDistanceConstraint(unsigned a, unsigned b, real compliance)
+{
+	DistanceConstraint constraint;
+	constraint.particle[0] = a;
+	constraint.particle[1] = b;
+	constraint.restLength = (positions[a] - positions[b]).magnitude();
+	constraint.compliance = compliance;
+	constraint.lambda = 0;
+
+	distanceConstraints.push_back(constraint);
+}
+
+void SoftBody::addBendingConstraint(unsigned edgeA, unsigned edgeB, unsigned oppositeA, unsigned oppositeB, real compliance)
+{
+	BendingConstraint constraint;
+	constraint.particle[0] = edgeA;
+	constraint.particle[1] = edgeB;
+	constraint.particle[2] = oppositeA;
+	constraint.particle[3] = oppositeB;
+	constraint.restLength = (positions[oppositeA] - positions[oppositeB]).magnitude();
+	constraint.compliance = compliance;
+	constraint.lambda = 0;
+
+	bendingConstraints.push_back(constraint);
+}
+
+void SoftBody::addTetrahedralConstraint(unsigned a, unsigned b, unsigned c, unsigned d, real compliance)
+{
+	TetrahedralConstraint constraint;
+	constraint.particle[0] = a;
+	constraint.particle[1] = b;
+	constraint.particle[2] = c;
+	constraint.particle[3] = d;
+	constraint.restVolume = tetrahedronVolume(a, b, c, d);
+	constraint.compliance = compliance;
+	constraint.lambda = 0;
+
+	tetrahedralConstraints.push_back(constraint);
+}
+
+void SoftBody::addVolumeConstraint(const unsigned *triangles, unsigned triangleCount,
+	real compliance, real pressure)
+{
+	VolumeConstraint constraint;
+	constraint.firstTriangle = (unsigned)volumeTriangles.size() / 3;
+	constraint.triangleCount = triangleCount;
+	constraint.firstParticle = (unsigned)volumeParticles.size();
+	constraint.compliance = compliance;
+	constraint.pressure = pressure;
+	constraint.lambda = 0;
+
+	volumeTriangles.insert(volumeTriangles.end(), triangles, triangles + triangleCount * 3);
+
+	// Keep each particle of the mesh once, so it is only moved once.
+	std::vector<bool> used(positions.size(), false);
+	for (unsigned i = 0; i < triangleCount * 3; i++)
+	{
+		if (!used[triangles[i]])
+		{
+			used[triangles[i]] = true;
+			volumeParticles.push_back(triangles[i]);
+		}
+	}
+	constraint.particleCount = (unsigned)volumeParticles.size() - constraint.firstParticle;
+
+	constraint.restVolume = meshVolume(constraint);
+	volumeConstraints.push_back(constraint);
+}
+
+// An edge of a triangle, with its lower index first.
+struct TriangleEdge
+{
+	unsigned particle[2];
+	unsigned opposite;
+};
+
+static inline bool edgeBefore(const TriangleEdge &one, const TriangleEdge &two)
+{
+	if (one.particle[0] != two.particle[0])
+		return one.particle[0] < two.particle[0];
+	return one.particle[1] < two.particle[1];
+}
+
+static inline bool sameEdge(const TriangleEdge &one, const TriangleEdge &two)
+{
+	return one.particle[0] == two.particle[0] && one.particle[1] == two.particle[1];
+}
+
+void SoftBody::addBendingConstraints(const unsigned *triangles, unsigned triangleCount,
+	real compliance)
+{
+	std::vector<TriangleEdge> edges;
+	edges.reserve(triangleCount * 3);
+
+	for (unsigned i = 0; i < triangleCount; i++)
+	{
+		const unsigned *triangle = &triangles[i * 3];
+		for (unsigned j = 0; j < 3; j++)
+		{
+			unsigned a = triangle[j];
+			unsigned b = triangle[(j + 1) % 3];
+
+			TriangleEdge edge;
+			edge.particle[0] = a < b ? a : b;
+			edge.particle[1] = a < b ? b : a;
+			edge.opposite = triangle[(j + 2) % 3];
+			edges.push_back(edge);
+		}
+	}
+
+	// Sorting puts the two sides of a shared edge next to each other.
+	std::sort(edges.begin(), edges.end(), edgeBefore);
+
+	for (unsigned i = 0; i + 1 < edges.size(); i++)
+	{
+		if (!sameEdge(edges[i], edges[i + 1]))
+			continue;
+
+		addBendingConstraint(edges[i].particle[0], edges[i].particle[1],
+			edges[i].opposite, edges[i + 1].opposite, compliance);
+		i++;
+	}
+}
+
+unsigned SoftBody::addSheet(const Vector3 &origin, real width, real height,
+	unsigned columns, unsigned rows, std::vector<unsigned> &triangles,
+	real compliance, real bendingCompliance)
+{
+	assert(columns > 1 && rows > 1);
+
+	unsigned first = (unsigned)positions.size();
+	for (unsigned y = 0; y < rows; y++)
+	{
+		for (unsigned x = 0; x < columns; x++)
+		{
+			addParticle(origin + Vector3(width * x / (columns - 1), 0, height * y / (rows - 1)));
+		}
+	}
+
+	unsigned firstTriangle = (unsigned)triangles.size();
+	for (unsigned y = 0; y < rows; y++)
+	{
+		for (unsigned x = 0; x < columns; x++)
+		{
+			unsigned index = first + y * columns + x;
+
+			if (x + 1 < columns)
+				addDistanceConstraint(index, index + 1, compliance);
+			if (y + 1 < rows)
+				addDistanceConstraint(index, index + columns, compliance);
+
+			if (x + 1 < columns && y + 1 < rows)
+			{
+				addDistanceConstraint(index, index + columns + 1, compliance);
+				addDistanceConstraint(index + 1, index + columns, compliance);
+
+				unsigned cell[6] = { index, index + columns, index + 1,
+					index + 1, index + columns, index + columns + 1 };
+				triangles.insert(triangles.end(), cell, cell + 6);
+			}
+		}
+	}
+
+	addBendingConstraints(&triangles[firstTriangle],
+		((unsigned)triangles.size() - firstTriangle) / 3, bendingCompliance);
+
+	return first;
+}
+
+void SoftBody::clear()
+{
+	positions.clear();
+	previousPositions.clear();
+	velocities.clear();
+	forceAccums.clear();
+	inverseMasses.clear();
+
+	distanceConstraints.clear();
+	bendingConstraints.clear();
+	tetrahedralConstraints.clear();
+	volumeConstraints.clear();
+	volumeTriangles.clear();
+	volumeParticles.clear();
+}
+
+unsigned SoftBody::getConstraintCount() const
+{
+	return (unsigned)(distanceConstraints.size() + bendingConstraints.size() +
+		tetrahedralConstraints.size() + volumeConstraints.size());
+}
+
+void SoftBody::addCollider(const CollisionPrimitive *primitive)
+{
+	if (primitive)
+		colliders.push_back(primitive);
+}
+
+void SoftBody::clearColliders()
+{
+	colliders.clear();
+}
+
+void SoftBody::setSubsteps(unsigned substeps)
+{
+	assert(substeps > 0);
+	SoftBody::substeps = substeps;
+}
+
+unsigned SoftBody::getSubsteps() const
+{
+	return substeps;
+}
+
+void SoftBody::setIterations(unsigned iterations)
+{
+	assert(iterations > 0);
+	SoftBody::iterations = iterations;
+}
+
+unsigned SoftBody::getIterations() const
+{
+	return iterations;
+}
+
+void SoftBody::setGravity(const Vector3 &gravity)
+{
+	SoftBody::gravity = gravity;
+}
+
+void SoftBody::setDamping(real damping)
+{
+	SoftBody::damping = damping;
+}
+
+unsigned SoftBody::getParticleCount() const
+{
+	return (unsigned)positions.size();
+}
+
+void SoftBody::setPosition(unsigned index, const Vector3 &position)
+{
+	positions[index] = position;
+	previousPositions[index] = position;
+}
+
+Vector3 SoftBody::getPosition(unsigned index) const
+{
+	return positions[index];
+}
+
+const Vector3 *SoftBody::getPositions() const
+{
+	return positions.empty() ? NULL : &positions[0];
+}
+
+void SoftBody::setVelocity(unsigned index, const Vector3 &velocity)
+{
+	velocities[index] = velocity;
+}
+
+Vector3 SoftBody::getVelocity(unsigned index) const
+{
+	return velocities[index];
+}
+
+void SoftBody::setInverseMass(unsigned index, real inverseMass)
+{
+	inverseMasses[index] = inverseMass;
+}
+
+real SoftBody::getInverseMass(unsigned index) const
+{
+	return inverseMasses[index];
+}
+
+void SoftBody::addForce(unsigned index, const Vector3 &force)
+{
+	forceAccums[index] += force;
+}
+
+void SoftBody::step(real duration)
+{
+	PROFILE_ZONE("SoftBody::step");
+
+	if (duration <= 0 || positions.empty())
+		return;
+
+	real substep = duration / substeps;
+
+	/*
+		The compliance is scaled by the inverse square of the time step,
+		this is what makes the stiffness independent of the step size.
+	*/
+	real alphaScale = ((real)1.0) / (substep * substep);
+
+	for (unsigned s = 0; s < substeps; s++)
+	{
+		integrate(substep);
+
+		// The multipliers are accumulated over the iterations of one substep.
+		for (unsigned i = 0; i < distanceConstraints.size(); i++)
+			distanceConstraints[i].lambda = 0;
+		for (unsigned i = 0; i < bendingConstraints.size(); i++)
+			bendingConstraints[i].lambda = 0;
+		for (unsigned i = 0; i < tetrahedralConstraints.size(); i++)
+			tetrahedralConstraints[i].lambda = 0;
+		for (unsigned i = 0; i < volumeConstraints.size(); i++)
+			volumeConstraints[i].lambda = 0;
+
+		for (unsigned i = 0; i < iterations; i++)
+		{
+			solveDistances(alphaScale);
+			solveBending(alphaScale);
+			solveTetrahedra(alphaScale);
+			solveVolumes(alphaScale);
+		}
+
+		solveCollisions();
+		updateVelocities(substep);
+	}
+
+	for (unsigned i = 0; i < forceAccums.size(); i++)
+		forceAccums[i].clear();
+}
+
+void SoftBody::integrate(real duration)
+{
+	unsigned count = (unsigned)positions.size();
+	for (unsigned i = 0; i < count; i++)
+	{
+		previousPositions[i] = positions[i];
+
+		if (inverseMasses[i] <= 0)
+			continue;
+
+		velocities[i].addScaledVector(gravity, duration);
+		velocities[i].addScaledVector(forceAccums[i], inverseMasses[i] * duration);
+		positions[i].addScaledVector(velocities[i], duration);
+	}
+}
+
+void SoftBody::updateVelocities(real duration)
+{
+	real inverseDuration = ((real)1.0) / duration;
+	real drag = real_pow(damping, duration);
+
+	unsigned count = (unsigned)positions.size();
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (inverseMasses[i] <= 0)
+			continue;
+
+		velocities[i] = (positions[i] - previousPositions[i]) * (inverseDuration * drag);
+	}
+}
+
+real SoftBody::solveDistance(unsigned a, unsigned b, real restLength, real compliance,
+	real lambda, real alphaScale)
+{
+	real w = inverseMasses[a] + inverseMasses[b];
+	if (w <= 0)
+		return lambda;
+
+	Vector3 delta = positions[a] - positions[b];
+	real length = delta.magnitude();
+	if (length <= 0)
+		return lambda;
+
+	// The gradient of the constraint is the unit direction between the particles.
+	Vector3 gradient = delta * (((real)1.0) / length);
+	real c = length - restLength;
+	real alpha = compliance * alphaScale;
+
+	real deltaLambda = (-c - alpha * lambda) / (w + alpha);
+
+	positions[a].addScaledVector(gradient, deltaLambda * inverseMasses[a]);
+	positions[b].addScaledVector(gradient, -deltaLambda * inverseMasses[b]);
+
+	return lambda + deltaLambda;
+}
+
+void SoftBody::solveDistances(real alphaScale)
+{
+	for (unsigned i = 0; i < distanceConstraints.size(); i++)
+	{
+		DistanceConstraint &constraint = distanceConstraints[i];
+		constraint.lambda = solveDistance(constraint.particle[0], constraint.particle[1],
+			constraint.restLength, constraint.compliance, constraint.lambda, alphaScale);
+	}
+}
+
+void SoftBody::solveBending(real alphaScale)
+{
+	for (unsigned i = 0; i < bendingConstraints.size(); i++)
+	{
+		BendingConstraint &constraint = bendingConstraints[i];
+		constraint.lambda = solveDistance(constraint.particle[2], constraint.particle[3],
+			constraint.restLength, constraint.compliance, constraint.lambda, alphaScale);
+	}
+}
+
+real SoftBody::tetrahedronVolume(unsigned a, unsigned b, unsigned c, unsigned d) const
+{
+	Vector3 ab = positions[b] - positions[a];
+	Vector3 ac = positions[c] - positions[a];
+	Vector3 ad = positions[d] - positions[a];
+
+	return (ab % ac) * ad / 6;
+}
+
+void SoftBody::solveTetrahedra(real alphaScale)
+{
+	/*
+		The gradient of the volume with respect to each corner is the
+		normal of the opposite face, scaled by its area (over three).
+		Each row lists the other corners in the order that gives an
+		outward gradient for a positively oriented tetrahedron.
+	*/
+	static const unsigned faces[4][3] = { { 1, 3, 2 }, { 0, 2, 3 }, { 0, 3, 1 }, { 0, 1, 2 } };
+
+	for (unsigned i = 0; i < tetrahedralConstraints.size(); i++)
+	{
+		TetrahedralConstraint &constraint = tetrahedralConstraints[i];
+		const unsigned *p = constraint.particle;
+
+		Vector3 gradient[4];
+		real w = 0;
+		for (unsigned j = 0; j < 4; j++)
+		{
+			const Vector3 &x0 = positions[p[faces[j][0]]];
+			const Vector3 &x1 = positions[p[faces[j][1]]];
+			const Vector3 &x2 = positions[p[faces[j][2]]];
+
+			gradient[j] = ((x1 - x0) % (x2 - x0)) * (((real)1.0) / 6);
+			w += inverseMasses[p[j]] * gradient[j].squareMagnitude();
+		}
+
+		if (w <= 0)
+			continue;
+
+		real c = tetrahedronVolume(p[0], p[1], p[2], p[3]) - constraint.restVolume;
+		real alpha = constraint.compliance * alphaScale;
+		real deltaLambda = (-c - alpha * constraint.lambda) / (w + alpha);
+		constraint.lambda += deltaLambda;
+
+		for (unsigned j = 0; j < 4; j++)
+		{
+			positions[p[j]].addScaledVector(gradient[j], deltaLambda * inverseMasses[p[j]]);
+		}
+	}
+}
+
+real SoftBody::meshVolume(const VolumeConstraint &constraint) const
+{
+	real volume = 0;
+	const unsigned *triangle = &volumeTriangles[constraint.firstTriangle * 3];
+
+	for (unsigned i = 0; i < constraint.triangleCount; i++, triangle += 3)
+	{
+		volume += (positions[triangle[0]] % positions[triangle[1]]) * positions[triangle[2]];
+	}
+
+	return volume / 6;
+}
+
+real SoftBody::getVolume(unsigned volumeConstraint) const
+{
+	return meshVolume(volumeConstraints[volumeConstraint]);
+}
+
+void SoftBody::solveVolumes(real alphaScale)
+{
+	gradients.resize(positions.size());
+
+	for (unsigned i = 0; i < volumeConstraints.size(); i++)
+	{
+		VolumeConstraint &constraint = volumeConstraints[i];
+		const unsigned *particle = &volumeParticles[constraint.firstParticle];
+
+		for (unsigned j = 0; j < constraint.particleCount; j++)
+			gradients[particle[j]].clear();
+
+		/*
+			Each triangle adds the cross product of its other two
+			corners to the gradient of each corner.
+		*/
+		const unsigned *triangle = &volumeTriangles[constraint.firstTriangle * 3];
+		for (unsigned j = 0; j < constraint.triangleCount; j++, triangle += 3)
+		{
+			const Vector3 &x0 = positions[triangle[0]];
+			const Vector3 &x1 = positions[triangle[1]];
+			const Vector3 &x2 = positions[triangle[2]];
+
+			gradients[triangle[0]] += (x1 % x2) * (((real)1.0) / 6);
+			gradients[triangle[1]] += (x2 % x0) * (((real)1.0) / 6);
+			gradients[triangle[2]] += (x0 % x1) * (((real)1.0) / 6);
+		}
+
+		real w = 0;
+		for (unsigned j = 0; j < constraint.particleCount; j++)
+			w += inverseMasses[particle[j]] * gradients[particle[j]].squareMagnitude();
+
+		if (w <= 0)
+			continue;
+
+		real c = meshVolume(constraint) - constraint.restVolume * constraint.pressure;
+		real alpha = constraint.compliance * alphaScale;
+		real deltaLambda = (-c - alpha * constraint.lambda) / (w + alpha);
+		constraint.lambda += deltaLambda;
+
+		for (unsigned j = 0; j < constraint.particleCount; j++)
+		{
+			unsigned index = particle[j];
+			positions[index].addScaledVector(gradients[index], deltaLambda * inverseMasses[index]);
+		}
+	}
+}
+
+void SoftBody::solveCollisions()
+{
+	for (unsigned i = 0; i < colliders.size(); i++)
+		solveCollision(*colliders[i]);
+}
+
+void SoftBody::solveCollision(const CollisionPrimitive &primitive)
+{
+	/*
+		Particles inside the primitive are moved to its surface. The
+		velocity is found from the change in position afterwards, so
+		the contact is inelastic and without friction.
+	*/
+	unsigned count = (unsigned)positions.size();
+
+	switch (primitive.getType())
+	{
+	case PRIMITIVE_SPHERE:
+	{
+		const CollisionSphere &sphere = static_cast<const CollisionSphere&>(primitive);
+		Vector3 center = sphere.getAxis(3);
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			if (inverseMasses[i] <= 0)
+				continue;
+
+			Vector3 offset = positions[i] - center;
+			real distance = offset.magnitude();
+			if (distance < sphere.radius && distance > 0)
+				positions[i].addScaledVector(offset, (sphere.radius - distance) / distance);
+		}
+		break;
+	}
+
+	case PRIMITIVE_BOX:
+	{
+		const CollisionBox &box = static_cast<const CollisionBox&>(primitive);
+		const Matrix3X4 &transform = box.getTransform();
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			if (inverseMasses[i] <= 0)
+				continue;
+
+			// The particle leaves through the face it is closest to.
+			Vector3 local = transform.transformInverse(positions[i]);
+			real smallest = REAL_MAX;
+			unsigned axis = 0;
+			for (unsigned a = 0; a < 3; a++)
+			{
+				real depth = box.halfSize[a] - real_abs(local[a]);
+				if (depth < smallest)
+				{
+					smallest = depth;
+					axis = a;
+				}
+			}
+
+			if (smallest <= 0)
+				continue;
+
+			local[axis] = (local[axis] < 0) ? -box.halfSize[axis] : box.halfSize[axis];
+			positions[i] = transform.transform(local);
+		}
+		break;
+	}
+
+	case PRIMITIVE_PLANE:
+	{
+		const CollisionPlane &plane = static_cast<const CollisionPlane&>(primitive);
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			if (inverseMasses[i] <= 0)
+				continue;
+
+			real distance = plane.normal * positions[i] - plane.offset;
+			if (distance < 0)
+				positions[i].addScaledVector(plane.normal, -distance);
+		}
+		break;
+	}
+
+	case PRIMITIVE_COMPOUND:
+	{
+		const CollisionCompound &compound = static_cast<const CollisionCompound&>(primitive);
+		for (unsigned i = 0; i < compound.getChildCount(); i++)
+		{
+			CollisionPrimitive *child = compound.getChild(i);
+			child->calculateInternals();
+			solveCollision(*child);
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+}
\ No newline at end of file
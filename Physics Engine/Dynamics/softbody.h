@@ -0,0 +1,212 @@
+#ifndef SOFTBODY_H
+#define SOFTBODY_H
+
+#include "../Math/core.h"
+#include "../Collision/NarrowPhase.h"
+#include <vector>
+
+namespace Physics_Engine
+{
+	/*
+		A soft body simulated with extended position based dynamics (XPBD).
+		The body is a set of particles joined by any number of constraints,
+		so it can represent cloth, ropes, shells or tetrahedral volumes.
+
+		Each constraint has a compliance (the inverse of its stiffness, in
+		SI units) rather than a stiffness factor per iteration. The solver
+		keeps a Lagrange multiplier for each constraint, which makes the
+		material behaviour independent of the number of iterations and of
+		the time step. Stability and accuracy come from substepping:
+		several small steps with one iteration each is usually better
+		than one large step with many iterations.
+	*/
+	class SoftBody
+	{
+	protected:
+		struct DistanceConstraint
+		{
+			unsigned particle[2];
+			real restLength;
+			real compliance;
+			real lambda;
+		};
+
+		/*
+			Bending between the two triangles (p0, p1, p2) and (p0, p1, p3)
+			sharing the edge p0-p1. It is constrained through the distance
+			between the two vertices opposite the shared edge, which, unlike
+			the dihedral angle, is still well behaved when the rest state is
+			flat.
+		*/
+		struct BendingConstraint
+		{
+			unsigned particle[4];
+			real restLength;
+			real compliance;
+			real lambda;
+		};
+
+		// Keeps the volume of a single tetrahedron.
+		struct TetrahedralConstraint
+		{
+			unsigned particle[4];
+			real restVolume;
+			real compliance;
+			real lambda;
+		};
+
+		/*
+			Keeps the volume enclosed by a closed triangle mesh. The
+			triangles and the particles they use are stored in the shared
+			arrays below, this holds the range of each.
+		*/
+		struct VolumeConstraint
+		{
+			unsigned firstTriangle, triangleCount;
+			unsigned firstParticle, particleCount;
+			real restVolume;
+			real pressure;
+			real compliance;
+			real lambda;
+		};
+
+		// The particle data is stored as separate arrays.
+		std::vector<Vector3> positions;
+		std::vector<Vector3> previousPositions;
+		std::vector<Vector3> velocities;
+		std::vector<Vector3> forceAccums;
+		std::vector<real> inverseMasses;
+
+		std::vector<DistanceConstraint> distanceConstraints;
+		std::vector<BendingConstraint> bendingConstraints;
+		std::vector<TetrahedralConstraint> tetrahedralConstraints;
+		std::vector<VolumeConstraint> volumeConstraints;
+
+		// Three particle indices per triangle, used by the volume constraints.
+		std::vector<unsigned> volumeTriangles;
+		std::vector<unsigned> volumeParticles;
+
+		// Scratch space for the gradients of a volume constraint.
+		std::vector<Vector3> gradients;
+
+		// The primitives the particles are kept out of.
+		std::vector<const CollisionPrimitive*> colliders;
+
+		Vector3 gravity;
+		real damping;
+		unsigned substeps;
+		unsigned iterations;
+
+	public:
+		SoftBody(unsigned substeps = 10, unsigned iterations = 1);
+
+		/*
+			Adds a particle and returns its index. An inverse mass of
+			zero makes the particle fixed in place.
+		*/
+		unsigned addParticle(const Vector3 &position, real inverseMass = 1);
+
+		/*
+			Each of these adds a constraint using the current positions
+			of the particles as the rest state. A compliance of zero gives
+			an infinitely stiff constraint.
+		*/
+		void addDistanceConstraint(unsigned a, unsigned b, real compliance = 0);
+		void addBendingConstraint(unsigned edgeA, unsigned edgeB, unsigned oppositeA, unsigned oppositeB, real compliance = 0);
+		void addTetrahedralConstraint(unsigned a, unsigned b, unsigned c, unsigned d, real compliance = 0);
+
+		/*
+			Adds a constraint on the volume of the closed mesh given by
+			the triangles (three indices each, wound counter clockwise when
+			seen from outside). The pressure scales the rest volume, so
+			values above one inflate the mesh.
+		*/
+		void addVolumeConstraint(const unsigned *triangles, unsigned triangleCount,
+			real compliance = 0, real pressure = 1);
+
+		/*
+			Adds a bending constraint across every edge shared by two of
+			the given triangles (three indices each).
+		*/
+		void addBendingConstraints(const unsigned *triangles, unsigned triangleCount,
+			real compliance = 0);
+
+		/*
+			Adds a sheet of cloth lying in the XZ plane and returns the
+			index of its first particle. The particle in column x and row y
+			is at that index plus y * columns + x. Distance constraints join
+			the corners of each cell along its sides and across it, and the
+			sheet is bent through the edges of its triangles, which are
+			appended to the given array (three indices each, facing up).
+		*/
+		unsigned addSheet(const Vector3 &origin, real width, real height,
+			unsigned columns, unsigned rows, std::vector<unsigned> &triangles,
+			real compliance = 0, real bendingCompliance = 0);
+
+		// Removes all the particles and constraints.
+		void clear();
+
+		unsigned getConstraintCount() const;
+
+		/*
+			Adds a primitive the particles are kept out of. Contact is
+			resolved in every substep, as another constraint, so the
+			primitive is only read and must outlive the soft body or be
+			removed with clearColliders. Its internals must be up to date.
+		*/
+		void addCollider(const CollisionPrimitive *primitive);
+		void clearColliders();
+
+		void setSubsteps(unsigned substeps);
+		unsigned getSubsteps() const;
+		void setIterations(unsigned iterations);
+		unsigned getIterations() const;
+
+		void setGravity(const Vector3 &gravity);
+
+		/*
+			Sets the proportion of velocity kept after one second, as for
+			the damping of a Particle.
+		*/
+		void setDamping(real damping);
+
+		unsigned getParticleCount() const;
+		void setPosition(unsigned index, const Vector3 &position);
+		Vector3 getPosition(unsigned index) const;
+		const Vector3 *getPositions() const;
+		void setVelocity(unsigned index, const Vector3 &velocity);
+		Vector3 getVelocity(unsigned index) const;
+		void setInverseMass(unsigned index, real inverseMass);
+		real getInverseMass(unsigned index) const;
+
+		// Adds a force to a particle for the next step only.
+		void addForce(unsigned index, const Vector3 &force);
+
+		// Advances the simulation by the given duration.
+		void step(real duration);
+
+		// Returns the current volume of the mesh of the given volume constraint.
+		real getVolume(unsigned volumeConstraint) const;
+
+	protected:
+		void integrate(real duration);
+		void updateVelocities(real duration);
+		void solveDistances(real alphaScale);
+		void solveBending(real alphaScale);
+		void solveTetrahedra(real alphaScale);
+		void solveVolumes(real alphaScale);
+		void solveCollisions();
+		void solveCollision(const CollisionPrimitive &primitive);
+
+		real tetrahedronVolume(unsigned a, unsigned b, unsigned c, unsigned d) const;
+		real meshVolume(const VolumeConstraint &constraint) const;
+
+		/*
+			Applies one XPBD update to a pair of particles constrained to
+			the given rest distance, returning the new multiplier.
+		*/
+		real solveDistance(unsigned a, unsigned b, real restLength, real compliance,
+			real lambda, real alphaScale);
+	};
+}
+#endif
\ No newline at end of file
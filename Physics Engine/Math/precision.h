@@ -1,6 +1,27 @@
 #include "math.h"
 #include <float.h>
 
+/*
+	Results have to be the same on every machine for lockstep and replays,
+	so the compiler mustn't fuse a multiply and an add into one instruction
+	(which rounds differently). GCC ignores the pragma, so builds with GCC
+	need -ffp-contract=off.
+*/
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+/*
+	SIMD versions of some routines are used where the target has SSE2
+	(every x64 target does). Defining PHYSICS_NO_SIMD leaves just the
+	scalar versions.
+*/
+#if !defined(PHYSICS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PHYSICS_SSE2
+#endif
+
 namespace Physics_Engine
 {
 	/*
@@ -13,7 +34,7 @@ namespace Physics_Engine
 #define real_sqrt sqrt
 #define real_pow pow	
 #define REAL_MAX DBL_MAX
-#define real_abs fabsf
+#define real_abs fabs
 #define real_fmod fmod
 #define R_PI 3.14159265358979
 }
\ No newline at end of file
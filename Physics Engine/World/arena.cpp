@@ -0,0 +1,122 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Physics_Engine;
+
+Arena::Arena(size_t capacity)
+	: capacity(capacity), offset(0), last(0), used(0), highWaterMark(0)
+{
+	block = (unsigned char*)malloc(capacity);
+	current = block;
+	currentSize = capacity;
+}
+
+Arena::~Arena()
+{
+	reset();
+	free(block);
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+	size_t address = (size_t)(current + offset);
+	size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+
+	if (offset + padding + size > currentSize)
+	{
+		addBlock(size + alignment);
+
+		address = (size_t)current;
+		padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+	}
+
+	last = current + offset + padding;
+	offset += padding + size;
+	used += padding + size;
+
+	return last;
+}
+
+void* Arena::reallocate(void *memory, size_t oldSize, size_t newSize, size_t alignment)
+{
+	if (!memory)
+		return allocate(newSize, alignment);
+
+	if (newSize <= oldSize)
+		return memory;
+
+	unsigned char *start = (unsigned char*)memory;
+	if (start == last && (size_t)(start - current) + newSize <= currentSize)
+	{
+		size_t end = (size_t)(start - current) + newSize;
+		if (end > offset)
+		{
+			used += end - offset;
+			offset = end;
+		}
+		return memory;
+	}
+
+	void *moved = allocate(newSize, alignment);
+	memcpy(moved, memory, oldSize);
+	return moved;
+}
+
+void Arena::addBlock(size_t minimumSize)
+{
+	/*
+		Each new block is at least as big as everything used so far,
+		so a step that overflows badly only takes a few of them.
+	*/
+	size_t size = used > capacity ? used : capacity;
+	if (size < minimumSize)
+		size = minimumSize;
+
+	current = (unsigned char*)malloc(size);
+	currentSize = size;
+	offset = 0;
+	overflowBlocks.push_back(current);
+}
+
+void Arena::reset()
+{
+	if (used > highWaterMark)
+		highWaterMark = used;
+
+	if (!overflowBlocks.empty())
+	{
+		for (unsigned i = 0; i < overflowBlocks.size(); i++)
+			free(overflowBlocks[i]);
+		overflowBlocks.clear();
+
+		// Make room for the whole of that step in one block next time.
+		if (used > capacity)
+		{
+			capacity = used + used / 2;
+			free(block);
+			block = (unsigned char*)malloc(capacity);
+		}
+	}
+
+	current = block;
+	currentSize = capacity;
+	offset = 0;
+	last = 0;
+	used = 0;
+}
+
+size_t Arena::getCapacity() const
+{
+	return capacity;
+}
+
+size_t Arena::getUsed() const
+{
+	return used;
+}
+
+size_t Arena::getHighWaterMark() const
+{
+	return used > highWaterMark ? used : highWaterMark;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace Physics_Engine
+{
+	/*
+		A linear allocator for the data that only lives for one step,
+		such as contacts and the scratch space of the sleep system.
+		Allocating moves a pointer along a block of memory, and reset()
+		makes the whole block free again at once, so there is no
+		per-object freeing and no heap traffic while the step fits.
+
+		When a step needs more than the block holds, further blocks are
+		taken from the heap rather than failing. They are freed at the
+		next reset, and the main block is replaced by one large enough
+		for that step, so the arena settles at the size the simulation
+		needs.
+
+		The memory isn't constructed and nothing is ever destroyed, so
+		it should only hold plain data that is filled in before it is
+		read.
+	*/
+	class Arena
+	{
+	protected:
+		// The block that each step starts allocating from.
+		unsigned char *block;
+		size_t capacity;
+
+		// The block being allocated from, and how much of it is used.
+		unsigned char *current;
+		size_t currentSize;
+		size_t offset;
+
+		// Blocks taken from the heap since the last reset.
+		std::vector<unsigned char*> overflowBlocks;
+
+		// The start of the last allocation, so it can grow in place.
+		unsigned char *last;
+
+		// The bytes handed out since the last reset, and the most ever.
+		size_t used;
+		size_t highWaterMark;
+
+	public:
+		Arena(size_t capacity = 64 * 1024);
+		~Arena();
+
+		/*
+			Returns memory for the given number of bytes, aligned to the
+			given power of two. Never returns NULL.
+		*/
+		void* allocate(size_t size, size_t alignment = 16);
+
+		/*
+			Makes an allocation larger, keeping the first oldSize bytes
+			of its contents. If it was the last thing allocated and there
+			is room after it, it is grown where it is, otherwise it is
+			copied to a new place (and the old memory isn't reused until
+			the reset).
+		*/
+		void* reallocate(void *memory, size_t oldSize, size_t newSize, size_t alignment = 16);
+
+		template <class T>
+		T* allocateArray(unsigned count)
+		{
+			return (T*)allocate(sizeof(T) * count, alignof(T));
+		}
+
+		template <class T>
+		T* reallocateArray(T *array, unsigned oldCount, unsigned newCount)
+		{
+			return (T*)reallocate(array, sizeof(T) * oldCount, sizeof(T) * newCount, alignof(T));
+		}
+
+		/*
+			Frees everything allocated since the last reset. This should
+			be called once per step, when the step's data is finished
+			with.
+		*/
+		void reset();
+
+		size_t getCapacity() const;
+		size_t getUsed() const;
+		size_t getHighWaterMark() const;
+
+	protected:
+		void addBlock(size_t minimumSize);
+
+	private:
+		Arena(const Arena &);
+		Arena& operator=(const Arena &);
+	};
+}
+#endif
\ No newline at end of file
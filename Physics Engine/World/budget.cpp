@@ -0,0 +1,74 @@
+#include "budget.h"
+#include "profiler.h"
+
+using namespace Physics_Engine;
+
+TimeBudget::TimeBudget()
+	: budget(0), debt(0), start(0), deadline(0), exhausted(false)
+{
+
+}
+
+void TimeBudget::setBudget(real microseconds)
+{
+	budget = microseconds > 0 ? (uint64_t)(microseconds * 1000) : 0;
+	debt = 0;
+}
+
+real TimeBudget::getBudget() const
+{
+	return (real)budget * (real)0.001;
+}
+
+bool TimeBudget::isLimited() const
+{
+	return budget > 0;
+}
+
+void TimeBudget::begin()
+{
+	exhausted = false;
+	if (!budget)
+		return;
+
+	start = Profiler::now();
+	deadline = start + budget - debt;
+}
+
+bool TimeBudget::hasExpired(real fraction)
+{
+	if (!budget)
+		return false;
+
+	uint64_t limit = start + (uint64_t)((deadline - start) * fraction);
+	if (Profiler::now() < limit)
+		return false;
+
+	exhausted = true;
+	return true;
+}
+
+void TimeBudget::end()
+{
+	if (!budget)
+		return;
+
+	/*
+		Only the overrun is carried, time left over isn't saved up. The
+		debt is kept below the budget, so every step gets some time.
+	*/
+	uint64_t now = Profiler::now();
+	debt = now > deadline ? now - deadline : 0;
+	if (debt > budget / 2)
+		debt = budget / 2;
+}
+
+bool TimeBudget::wasExhausted() const
+{
+	return exhausted;
+}
+
+real TimeBudget::getDebt() const
+{
+	return (real)debt * (real)0.001;
+}
\ No newline at end of file
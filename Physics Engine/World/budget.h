@@ -0,0 +1,59 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include "../Math/core.h"
+#include <stdint.h>
+
+namespace Physics_Engine
+{
+	/*
+		A limit on the time an iterative routine (such as a contact
+		resolver) may take in a step. The routine calls begin at the
+		start of the step, checks hasExpired between iterations and
+		calls end when it stops.
+
+		An iteration can't be cut short, so a step can run a little
+		over. The overrun is taken off the next step's budget, so the
+		time spent over a run of steps stays within the budget.
+
+		A budget of zero means no limit.
+	*/
+	class TimeBudget
+	{
+	protected:
+		// Holds the budget, and the overrun carried from the last step, in nanoseconds.
+		uint64_t budget;
+		uint64_t debt;
+
+		// Holds the time the current step started, and when it has to stop.
+		uint64_t start;
+		uint64_t deadline;
+
+		bool exhausted;
+
+	public:
+		TimeBudget();
+
+		void setBudget(real microseconds);
+		real getBudget() const;
+		bool isLimited() const;
+
+		void begin();
+
+		/*
+			Returns true if the given fraction of the step's budget has
+			been used. This lets a routine with more than one pass leave
+			time for the later ones.
+		*/
+		bool hasExpired(real fraction = 1);
+
+		void end();
+
+		// Returns true if the last step stopped because it ran out of time.
+		bool wasExhausted() const;
+
+		// Returns the overrun to be taken off the next step, in microseconds.
+		real getDebt() const;
+	};
+}
+#endif
\ No newline at end of file
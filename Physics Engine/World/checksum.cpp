@@ -0,0 +1,80 @@
+#include "checksum.h"
+#include <vector>
+#include <algorithm>
+
+using namespace Physics_Engine;
+
+Checksum::Checksum()
+	: value(14695981039346656037ULL)
+{
+
+}
+
+void Checksum::add(const void *data, unsigned size)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	for (unsigned i = 0; i < size; i++)
+	{
+		value ^= bytes[i];
+		value *= 1099511628211ULL;
+	}
+}
+
+void Checksum::add(real number)
+{
+	add(&number, sizeof(number));
+}
+
+void Checksum::add(unsigned number)
+{
+	add(&number, sizeof(number));
+}
+
+void Checksum::add(const Vector3 &vector)
+{
+	// The padding is left out, it isn't part of the value.
+	add(vector.x);
+	add(vector.y);
+	add(vector.z);
+}
+
+void Checksum::add(const Quaternion &quaternion)
+{
+	add(quaternion.r);
+	add(quaternion.i);
+	add(quaternion.j);
+	add(quaternion.k);
+}
+
+void Checksum::add(const RigidBody &body)
+{
+	add(body.getPosition());
+	add(body.getOrientation());
+	add(body.getVelocity());
+	add(body.getRotation());
+	add((unsigned)body.getAwake());
+}
+
+unsigned long long Checksum::getValue() const
+{
+	return value;
+}
+
+static bool bodyBefore(const RigidBody *a, const RigidBody *b)
+{
+	return a->getId() < b->getId();
+}
+
+unsigned long long Checksum::ofBodies(RigidBody *const *bodies, unsigned count)
+{
+	std::vector<RigidBody*> sorted(bodies, bodies + count);
+	std::stable_sort(sorted.begin(), sorted.end(), bodyBefore);
+
+	Checksum checksum;
+	for (unsigned i = 0; i < count; i++)
+	{
+		checksum.add(*sorted[i]);
+	}
+
+	return checksum.getValue();
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "../Dynamics/body.h"
+
+namespace Physics_Engine
+{
+	/*
+		Builds a 64 bit hash (FNV-1a) of simulation state, for checking
+		that runs on different machines, or with different numbers of
+		threads, have stayed exactly in step. Values are hashed by their
+		bits, so any difference at all changes the checksum.
+	*/
+	class Checksum
+	{
+	protected:
+		unsigned long long value;
+
+	public:
+		Checksum();
+
+		void add(const void *data, unsigned size);
+		void add(real number);
+		void add(unsigned number);
+		void add(const Vector3 &vector);
+		void add(const Quaternion &quaternion);
+
+		/*
+			Adds the position, orientation, velocities and awake state.
+			The id is left out, so it is only the state that is compared.
+		*/
+		void add(const RigidBody &body);
+
+		unsigned long long getValue() const;
+
+		/*
+			Returns the checksum of the given bodies. They are taken in
+			order of id, so the order of the array doesn't matter as long
+			as the ids are different.
+		*/
+		static unsigned long long ofBodies(RigidBody *const *bodies, unsigned count);
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#include "clock.h"
+
+using namespace Physics_Engine;
+
+Clock::Clock()
+{
+	reset();
+}
+
+void Clock::reset()
+{
+	startTime = SteadyClock::now();
+	lastTick = startTime;
+}
+
+double Clock::getTime() const
+{
+	std::chrono::duration<double> elapsed = SteadyClock::now() - startTime;
+	return elapsed.count();
+}
+
+double Clock::tick()
+{
+	SteadyClock::time_point now = SteadyClock::now();
+	std::chrono::duration<double> elapsed = now - lastTick;
+	lastTick = now;
+
+	return elapsed.count();
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <chrono>
+
+namespace Physics_Engine
+{
+	/*
+		A monotonic clock for driving the simulation. It never goes
+		backwards and doesn't depend on the windowing library, so it
+		can be used by headless tools as well as the demos.
+	*/
+	class Clock
+	{
+	private:
+		typedef std::chrono::steady_clock SteadyClock;
+
+		SteadyClock::time_point startTime;
+		SteadyClock::time_point lastTick;
+
+	public:
+		Clock();
+
+		// Restarts the clock from zero.
+		void reset();
+
+		// Returns the number of seconds since the clock was started.
+		double getTime() const;
+
+		/*
+			Returns the number of seconds since the last call to tick
+			(or since the clock was started).
+		*/
+		double tick();
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "events.h"
+
+using namespace Physics_Engine;
+
+ContactEvents::ContactEvents(unsigned capacity)
+	: current(0), eventCount(0), capacity(0), droppedPairs(0)
+{
+	setCapacity(capacity);
+}
+
+void ContactEvents::setCapacity(unsigned capacity)
+{
+	ContactEvents::capacity = capacity;
+
+	// The tables are kept at most half full, so a search soon finds an empty slot.
+	unsigned tableSize = 1;
+	while (tableSize < capacity * 2)
+		tableSize <<= 1;
+
+	for (unsigned i = 0; i < 2; i++)
+	{
+		sets[i].pairs.resize(capacity);
+		sets[i].slots.assign(tableSize, 0);
+		sets[i].slotStamps.assign(tableSize, 0);
+		sets[i].stamp = 1;
+		sets[i].count = 0;
+	}
+
+	// Every pair of both steps can make one event.
+	events.resize(capacity * 2);
+	eventCount = 0;
+}
+
+unsigned ContactEvents::getCapacity() const
+{
+	return capacity;
+}
+
+void ContactEvents::emptySet(PairSet &set)
+{
+	set.count = 0;
+	set.stamp++;
+
+	// The stamps have come back round, so the old ones have to be wiped out.
+	if (set.stamp == 0)
+	{
+		set.slotStamps.assign(set.slotStamps.size(), 0);
+		set.stamp = 1;
+	}
+}
+
+void ContactEvents::beginStep()
+{
+	current = 1 - current;
+	emptySet(sets[current]);
+	droppedPairs = 0;
+}
+
+unsigned ContactEvents::getSlot(const CollisionPrimitive *one, const CollisionPrimitive *two) const
+{
+	uint64_t hash = (uint64_t)(uintptr_t)one * 0x9E3779B97F4A7C15ull ^
+		(uint64_t)(uintptr_t)two * 0xC2B2AE3D27D4EB4Full;
+
+	// The table size is a power of two, so the top bits are used.
+	return (unsigned)(hash >> 32) & ((unsigned)sets[0].slots.size() - 1);
+}
+
+int ContactEvents::find(const PairSet &set, const CollisionPrimitive *one, const CollisionPrimitive *two) const
+{
+	if (one > two)
+	{
+		const CollisionPrimitive *swap = one;
+		one = two;
+		two = swap;
+	}
+
+	unsigned mask = (unsigned)set.slots.size() - 1;
+	for (unsigned slot = getSlot(one, two); set.slotStamps[slot] == set.stamp; slot = (slot + 1) & mask)
+	{
+		const Pair &pair = set.pairs[set.slots[slot]];
+		if (pair.primitives[0] == one && pair.primitives[1] == two)
+			return (int)set.slots[slot];
+	}
+	return -1;
+}
+
+bool ContactEvents::insert(PairSet &set, CollisionPrimitive *one, CollisionPrimitive *two, bool trigger)
+{
+	if (one > two)
+	{
+		CollisionPrimitive *swap = one;
+		one = two;
+		two = swap;
+	}
+
+	unsigned mask = (unsigned)set.slots.size() - 1;
+	unsigned slot = getSlot(one, two);
+	for (; set.slotStamps[slot] == set.stamp; slot = (slot + 1) & mask)
+	{
+		const Pair &pair = set.pairs[set.slots[slot]];
+		if (pair.primitives[0] == one && pair.primitives[1] == two)
+			return true;
+	}
+
+	if (set.count == capacity)
+	{
+		droppedPairs++;
+		return false;
+	}
+
+	Pair &pair = set.pairs[set.count];
+	pair.primitives[0] = one;
+	pair.primitives[1] = two;
+	pair.trigger = trigger;
+
+	set.slots[slot] = set.count++;
+	set.slotStamps[slot] = set.stamp;
+	return true;
+}
+
+void ContactEvents::addPair(CollisionPrimitive *one, CollisionPrimitive *two, bool trigger)
+{
+	insert(sets[current], one, two, trigger);
+}
+
+void ContactEvents::addEvent(ContactEventType type, const Pair &pair)
+{
+	ContactEvent &event = events[eventCount++];
+	event.type = type;
+	event.primitives[0] = pair.primitives[0];
+	event.primitives[1] = pair.primitives[1];
+	event.trigger = pair.trigger;
+}
+
+// Checks whether a primitive's body can't be moving, because it is asleep (or it has none).
+static inline bool isResting(const CollisionPrimitive *primitive)
+{
+	return !primitive->body || !primitive->body->getAwake();
+}
+
+void ContactEvents::endStep()
+{
+	PairSet &now = sets[current];
+	const PairSet &last = sets[1 - current];
+	eventCount = 0;
+
+	/*
+		Pairs that have gone to sleep weren't tested, so are carried on
+		from the last step. They are added to this step's pairs first,
+		so they get an event in the loop below like any other.
+	*/
+	for (unsigned i = 0; i < last.count; i++)
+	{
+		const Pair &pair = last.pairs[i];
+		if (isResting(pair.primitives[0]) && isResting(pair.primitives[1]))
+			insert(now, pair.primitives[0], pair.primitives[1], pair.trigger);
+	}
+
+	for (unsigned i = 0; i < now.count; i++)
+	{
+		const Pair &pair = now.pairs[i];
+		bool touching = find(last, pair.primitives[0], pair.primitives[1]) >= 0;
+		addEvent(touching ? CONTACT_PERSIST : CONTACT_BEGIN, now.pairs[i]);
+	}
+
+	for (unsigned i = 0; i < last.count; i++)
+	{
+		const Pair &pair = last.pairs[i];
+		if (find(now, pair.primitives[0], pair.primitives[1]) < 0)
+			addEvent(CONTACT_END, pair);
+	}
+}
+
+void ContactEvents::clear()
+{
+	emptySet(sets[0]);
+	emptySet(sets[1]);
+	eventCount = 0;
+}
+
+const ContactEvent *ContactEvents::getEvents() const
+{
+	return eventCount ? &events[0] : NULL;
+}
+
+unsigned ContactEvents::getEventCount() const
+{
+	return eventCount;
+}
+
+unsigned ContactEvents::getDroppedPairs() const
+{
+	return droppedPairs;
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "../Collision/NarrowPhase.h"
+#include <stdint.h>
+#include <vector>
+
+namespace Physics_Engine
+{
+	enum ContactEventType
+	{
+		// The pair started touching this step.
+		CONTACT_BEGIN,
+
+		// The pair was touching last step, and still is.
+		CONTACT_PERSIST,
+
+		// The pair was touching last step, and isn't any more.
+		CONTACT_END
+	};
+
+	struct ContactEvent
+	{
+		ContactEventType type;
+		CollisionPrimitive *primitives[2];
+
+		// Holds whether either primitive is a trigger, so no contacts were made.
+		bool trigger;
+	};
+
+	/*
+		Turns the pairs of primitives found touching each step into
+		begin, persist and end events, by comparing them with the pairs
+		of the step before. The events of a step are all written to one
+		buffer when it ends, to be read until the next step ends, so
+		nothing is called back for each pair.
+
+		The pairs are kept in two hash tables of a fixed capacity, one
+		for this step and one for the last, keyed on the addresses of
+		the two primitives, lower first. Nothing is allocated after
+		setCapacity, and a table is emptied by moving on its stamp
+		rather than by clearing it. Pairs beyond the capacity are
+		dropped (and counted), so setCapacity should be given the most
+		pairs expected to touch at once.
+
+		A pair whose bodies are both asleep stops being tested, so it
+		can't be found again. Such pairs are kept (and reported as
+		persisting) until one of the bodies wakes up.
+	*/
+	class ContactEvents
+	{
+	protected:
+		struct Pair
+		{
+			CollisionPrimitive *primitives[2];
+			bool trigger;
+		};
+
+		struct PairSet
+		{
+			// Holds the pairs in the order they were added.
+			std::vector<Pair> pairs;
+			unsigned count;
+
+			/*
+				Holds the hash table, with the index of a pair in each
+				slot. A slot is only in use if its stamp matches the
+				set's stamp.
+			*/
+			std::vector<unsigned> slots;
+			std::vector<unsigned> slotStamps;
+			unsigned stamp;
+		};
+
+		PairSet sets[2];
+
+		// Holds the index of the set for this step; the other is the last step's.
+		unsigned current;
+
+		std::vector<ContactEvent> events;
+		unsigned eventCount;
+
+		unsigned capacity;
+		unsigned droppedPairs;
+
+	public:
+		ContactEvents(unsigned capacity = 0);
+
+		/*
+			Sets the most pairs that can be touching in a step, and makes
+			the room for them. This forgets the pairs of the last step.
+		*/
+		void setCapacity(unsigned capacity);
+		unsigned getCapacity() const;
+
+		// Starts a step, making the pairs of the last one the ones to compare with.
+		void beginStep();
+
+		/*
+			Records that the primitives are touching in this step. The
+			same pair can be added more than once, in either order.
+		*/
+		void addPair(CollisionPrimitive *one, CollisionPrimitive *two, bool trigger = false);
+
+		// Ends the step, writing its events.
+		void endStep();
+
+		// Forgets every pair, so no end events are reported for them.
+		void clear();
+
+		/*
+			Returns the events of the last step that ended. Those for
+			pairs still touching (begin and persist) come first, in the
+			order the pairs were added, then those that ended.
+		*/
+		const ContactEvent *getEvents() const;
+		unsigned getEventCount() const;
+
+		// Returns the number of pairs that didn't fit in the last step.
+		unsigned getDroppedPairs() const;
+
+	protected:
+		// Returns the index of the pair in the set, or -1 if it isn't there.
+		int find(const PairSet &set, const CollisionPrimitive *one, const CollisionPrimitive *two) const;
+
+		// Adds a pair (lower address first) to the set, unless it is already there.
+		bool insert(PairSet &set, CollisionPrimitive *one, CollisionPrimitive *two, bool trigger);
+
+		unsigned getSlot(const CollisionPrimitive *one, const CollisionPrimitive *two) const;
+		void emptySet(PairSet &set);
+		void addEvent(ContactEventType type, const Pair &pair);
+	};
+}
+#endif
\ No newline at end of file
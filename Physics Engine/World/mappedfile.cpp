@@ -0,0 +1,199 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Physics_Engine;
+
+#ifdef _WIN32
+static const HANDLE noFile = INVALID_HANDLE_VALUE;
+#else
+static const int noFile = -1;
+#endif
+
+MappedFile::MappedFile()
+	: data(0), size(0), writable(false), file(noFile)
+#ifdef _WIN32
+	, mapping(0)
+#endif
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::create(const char *filename, size_t size)
+{
+	close();
+	writable = true;
+
+#ifdef _WIN32
+	file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, 0,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+#else
+	file = ::open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+#endif
+
+	if (file == noFile)
+		return false;
+
+	if (!resize(size))
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+bool MappedFile::open(const char *filename)
+{
+	close();
+	writable = false;
+
+#ifdef _WIN32
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == noFile)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+#else
+	file = ::open(filename, O_RDONLY);
+	if (file == noFile)
+		return false;
+
+	struct stat status;
+	if (fstat(file, &status) != 0)
+	{
+		close();
+		return false;
+	}
+	size = (size_t)status.st_size;
+#endif
+
+	if (!map())
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+bool MappedFile::resize(size_t size)
+{
+	if (file == noFile || !writable)
+		return false;
+
+	unmap();
+
+#ifdef _WIN32
+	LARGE_INTEGER fileSize;
+	fileSize.QuadPart = (LONGLONG)size;
+	if (!SetFilePointerEx(file, fileSize, 0, FILE_BEGIN) || !SetEndOfFile(file))
+		return false;
+#else
+	if (ftruncate(file, (off_t)size) != 0)
+		return false;
+#endif
+
+	MappedFile::size = size;
+	return map();
+}
+
+void MappedFile::close()
+{
+	unmap();
+
+	if (file != noFile)
+	{
+#ifdef _WIN32
+		CloseHandle(file);
+#else
+		::close(file);
+#endif
+		file = noFile;
+	}
+
+	size = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+	return file != noFile;
+}
+
+unsigned char* MappedFile::getData() const
+{
+	return data;
+}
+
+size_t MappedFile::getSize() const
+{
+	return size;
+}
+
+bool MappedFile::map()
+{
+	// An empty file can't be mapped, but there is nothing to map anyway.
+	if (size == 0)
+		return true;
+
+#ifdef _WIN32
+	LARGE_INTEGER mapSize;
+	mapSize.QuadPart = (LONGLONG)size;
+	mapping = CreateFileMappingA(file, 0, writable ? PAGE_READWRITE : PAGE_READONLY,
+		mapSize.HighPart, mapSize.LowPart, 0);
+	if (!mapping)
+		return false;
+
+	data = (unsigned char *)MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		mapping = 0;
+		return false;
+	}
+#else
+	void *view = mmap(0, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+	if (view == MAP_FAILED)
+		return false;
+
+	data = (unsigned char *)view;
+#endif
+
+	return true;
+}
+
+void MappedFile::unmap()
+{
+	if (!data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+	mapping = 0;
+#else
+	munmap(data, size);
+#endif
+
+	data = 0;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+
+namespace Physics_Engine
+{
+	/*
+		A file mapped into memory, so it can be read and written like
+		an array while the operating system pages it in and out. A
+		writable file can be grown or shrunk, which maps it again and
+		so moves the data.
+	*/
+	class MappedFile
+	{
+	protected:
+		unsigned char *data;
+		size_t size;
+		bool writable;
+
+#ifdef _WIN32
+		void *file;
+		void *mapping;
+#else
+		int file;
+#endif
+
+	public:
+		MappedFile();
+		~MappedFile();
+
+		/*
+			Creates (or empties) a file of the given size and maps it
+			for writing. Returns false if the file can't be created.
+		*/
+		bool create(const char *filename, size_t size);
+
+		// Maps an existing file for reading only.
+		bool open(const char *filename);
+
+		/*
+			Changes the size of a file opened for writing. The data is
+			kept but may move, so pointers into it must be got again.
+		*/
+		bool resize(size_t size);
+
+		void close();
+
+		bool isOpen() const;
+		unsigned char* getData() const;
+		size_t getSize() const;
+
+	protected:
+		bool map();
+		void unmap();
+
+	private:
+		// A mapping can't be shared, so it can't be copied.
+		MappedFile(const MappedFile &);
+		MappedFile& operator=(const MappedFile &);
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,248 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <vector>
+
+namespace Physics_Engine
+{
+	/*
+		Refers to an object in a pool. The index picks a slot in the
+		pool, and the generation says which of the objects that have
+		used that slot is meant, so a handle to an object that has been
+		removed is recognised as stale, even if its slot has been used
+		again since.
+
+		A default handle never refers to anything.
+	*/
+	struct PoolHandle
+	{
+		unsigned index;
+		unsigned generation;
+
+		PoolHandle()
+			: index(0), generation(0)
+		{
+
+		}
+
+		bool operator==(const PoolHandle &other) const
+		{
+			return index == other.index && generation == other.generation;
+		}
+
+		bool operator!=(const PoolHandle &other) const
+		{
+			return !(*this == other);
+		}
+	};
+
+	/*
+		Holds objects of one type packed together in an array, so going
+		through all of them reads memory in order. Removing an object
+		moves the last one into its place, so the array never has gaps.
+
+		Because objects move, a pointer to one is only good until the
+		next object is removed (or until the array grows, if objects are
+		added past the reserved size). Handles stay good for as long as
+		their object is in the pool, and get() turns them back into
+		pointers.
+
+		Once the pool has reserved enough room, adding and removing
+		objects doesn't touch the heap, so short lived objects such as
+		projectiles can be created and destroyed freely.
+	*/
+	template<class T>
+	class Pool
+	{
+	protected:
+		struct Slot
+		{
+			// The index of the object, or the next free slot if unused.
+			unsigned dense;
+			unsigned generation;
+		};
+
+		// Holds the objects, with no gaps.
+		std::vector<T> objects;
+
+		// Holds the slot of each object, in the same order.
+		std::vector<unsigned> objectSlots;
+
+		std::vector<Slot> slots;
+
+		// Holds the first unused slot, or noSlot if there isn't one.
+		unsigned firstFree;
+
+		static const unsigned noSlot = 0xffffffff;
+
+	public:
+		Pool(unsigned capacity = 0);
+
+		// Makes room for the given number of objects.
+		void reserve(unsigned capacity);
+
+		// Adds a copy of the object, and returns its handle.
+		PoolHandle add(const T &object = T());
+
+		/*
+			Removes the object, moving the last object into its place.
+			Returns false if the handle is stale.
+		*/
+		bool remove(PoolHandle handle);
+
+		// Removes all the objects, making every handle stale.
+		void clear();
+
+		// Returns the object, or NULL if the handle is stale.
+		T* get(PoolHandle handle);
+		const T* get(PoolHandle handle) const;
+
+		bool isValid(PoolHandle handle) const;
+
+		// Returns the handle of the object at the given position in the array.
+		PoolHandle getHandle(unsigned index) const;
+
+		unsigned getCount() const
+		{
+			return (unsigned)objects.size();
+		}
+
+		// Returns the packed array of objects, getCount() long.
+		T* getObjects()
+		{
+			return objects.empty() ? 0 : &objects[0];
+		}
+
+		T& operator[](unsigned index)
+		{
+			return objects[index];
+		}
+
+		const T& operator[](unsigned index) const
+		{
+			return objects[index];
+		}
+	};
+
+	template<class T>
+	Pool<T>::Pool(unsigned capacity)
+		: firstFree(noSlot)
+	{
+		reserve(capacity);
+	}
+
+	template<class T>
+	void Pool<T>::reserve(unsigned capacity)
+	{
+		objects.reserve(capacity);
+		objectSlots.reserve(capacity);
+		slots.reserve(capacity);
+	}
+
+	template<class T>
+	PoolHandle Pool<T>::add(const T &object)
+	{
+		unsigned slot;
+		if (firstFree != noSlot)
+		{
+			slot = firstFree;
+			firstFree = slots[slot].dense;
+		}
+		else
+		{
+			// Generations start at one, so a default handle is never valid.
+			slot = (unsigned)slots.size();
+			slots.push_back(Slot());
+			slots[slot].generation = 1;
+		}
+
+		slots[slot].dense = (unsigned)objects.size();
+		objects.push_back(object);
+		objectSlots.push_back(slot);
+
+		PoolHandle handle;
+		handle.index = slot;
+		handle.generation = slots[slot].generation;
+		return handle;
+	}
+
+	template<class T>
+	bool Pool<T>::remove(PoolHandle handle)
+	{
+		if (!isValid(handle))
+			return false;
+
+		unsigned dense = slots[handle.index].dense;
+		unsigned last = (unsigned)objects.size() - 1;
+
+		// Fill the gap with the last object.
+		if (dense != last)
+		{
+			objects[dense] = objects[last];
+			objectSlots[dense] = objectSlots[last];
+			slots[objectSlots[dense]].dense = dense;
+		}
+
+		objects.pop_back();
+		objectSlots.pop_back();
+
+		// Put the slot on the free list, and make old handles to it stale.
+		slots[handle.index].generation++;
+		if (slots[handle.index].generation == 0)
+			slots[handle.index].generation = 1;
+		slots[handle.index].dense = firstFree;
+		firstFree = handle.index;
+
+		return true;
+	}
+
+	template<class T>
+	void Pool<T>::clear()
+	{
+		for (unsigned i = 0; i < objectSlots.size(); i++)
+		{
+			unsigned slot = objectSlots[i];
+			slots[slot].generation++;
+			if (slots[slot].generation == 0)
+				slots[slot].generation = 1;
+			slots[slot].dense = firstFree;
+			firstFree = slot;
+		}
+
+		objects.clear();
+		objectSlots.clear();
+	}
+
+	template<class T>
+	T* Pool<T>::get(PoolHandle handle)
+	{
+		return isValid(handle) ? &objects[slots[handle.index].dense] : 0;
+	}
+
+	template<class T>
+	const T* Pool<T>::get(PoolHandle handle) const
+	{
+		return isValid(handle) ? &objects[slots[handle.index].dense] : 0;
+	}
+
+	template<class T>
+	bool Pool<T>::isValid(PoolHandle handle) const
+	{
+		/*
+			A slot on the free list has already had its generation moved
+			on, so only the handle of the object in it can match.
+		*/
+		return handle.index < slots.size() &&
+			slots[handle.index].generation == handle.generation;
+	}
+
+	template<class T>
+	PoolHandle Pool<T>::getHandle(unsigned index) const
+	{
+		PoolHandle handle;
+		handle.index = objectSlots[index];
+		handle.generation = slots[handle.index].generation;
+		return handle;
+	}
+}
+#endif
\ No newline at end of file
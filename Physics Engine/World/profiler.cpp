@@ -0,0 +1,245 @@
+#include "profiler.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <stdio.h>
+
+using namespace Physics_Engine;
+
+// The number of zones each thread keeps, which must be a power of two.
+static const unsigned bufferSize = 1 << 16;
+
+struct ProfileBuffer
+{
+	ProfileEvent events[bufferSize];
+
+	// Holds the number of zones ever recorded, the oldest are overwritten.
+	uint64_t count;
+
+	unsigned depth;
+	unsigned thread;
+};
+
+struct ProfilerState
+{
+	std::chrono::steady_clock::time_point epoch;
+
+	// Guards the lists of buffers and sites, which only change rarely.
+	std::mutex mutex;
+	std::vector<ProfileBuffer*> buffers;
+	ProfileSite *firstSite;
+	ProfileSite *lastSite;
+
+	bool enabled;
+	double smoothing;
+
+	ProfilerState()
+		: epoch(std::chrono::steady_clock::now()), firstSite(0), lastSite(0),
+		enabled(true), smoothing(0.05)
+	{
+
+	}
+
+	~ProfilerState()
+	{
+		for (unsigned i = 0; i < buffers.size(); i++)
+			delete buffers[i];
+	}
+};
+
+/*
+	The state is made the first time it is used, so sites made during
+	static initialisation still find it there.
+*/
+static ProfilerState& getState()
+{
+	static ProfilerState state;
+	return state;
+}
+
+static thread_local ProfileBuffer *threadBuffer = 0;
+
+static ProfileBuffer* getBuffer()
+{
+	if (!threadBuffer)
+	{
+		ProfileBuffer *buffer = new ProfileBuffer();
+		buffer->count = 0;
+		buffer->depth = 0;
+
+		ProfilerState &state = getState();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		buffer->thread = (unsigned)state.buffers.size();
+		state.buffers.push_back(buffer);
+
+		threadBuffer = buffer;
+	}
+
+	return threadBuffer;
+}
+
+ProfileSite::ProfileSite(const char *name)
+	: name(name), frameTime(0), frameCalls(0), lastTime(0), lastCalls(0),
+	averageTime(0), averageCalls(0), maxTime(0), next(0)
+{
+	ProfilerState &state = getState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	if (state.lastSite)
+		state.lastSite->next = this;
+	else
+		state.firstSite = this;
+	state.lastSite = this;
+}
+
+uint64_t Profiler::now()
+{
+	std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - getState().epoch;
+	return (uint64_t)elapsed.count();
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+	getState().enabled = enabled;
+}
+
+bool Profiler::isEnabled()
+{
+	return getState().enabled;
+}
+
+void Profiler::setSmoothing(double smoothing)
+{
+	getState().smoothing = smoothing;
+}
+
+unsigned Profiler::enter()
+{
+	return getBuffer()->depth++;
+}
+
+void Profiler::leave()
+{
+	getBuffer()->depth--;
+}
+
+void Profiler::record(ProfileSite *site, uint64_t start, uint64_t end)
+{
+	if (!getState().enabled)
+		return;
+
+	site->frameTime.fetch_add(end - start, std::memory_order_relaxed);
+	site->frameCalls.fetch_add(1, std::memory_order_relaxed);
+
+	ProfileBuffer *buffer = getBuffer();
+	ProfileEvent &event = buffer->events[buffer->count & (bufferSize - 1)];
+	event.name = site->name;
+	event.start = start;
+	event.end = end;
+
+	// The zone is still entered while it is recorded.
+	event.depth = buffer->depth - 1;
+
+	buffer->count++;
+}
+
+void Profiler::endFrame()
+{
+	ProfilerState &state = getState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	for (ProfileSite *site = state.firstSite; site; site = site->next)
+	{
+		double time = site->frameTime.exchange(0) * 1e-9;
+		unsigned calls = site->frameCalls.exchange(0);
+
+		// The first frame starts the averages off, rather than zero.
+		if (site->lastCalls == 0 && site->averageCalls == 0)
+		{
+			site->averageTime = time;
+			site->averageCalls = calls;
+		}
+		else
+		{
+			site->averageTime += (time - site->averageTime) * state.smoothing;
+			site->averageCalls += (calls - site->averageCalls) * state.smoothing;
+		}
+
+		site->lastTime = time;
+		site->lastCalls = calls;
+		if (time > site->maxTime)
+			site->maxTime = time;
+	}
+}
+
+void Profiler::clear()
+{
+	ProfilerState &state = getState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	for (unsigned i = 0; i < state.buffers.size(); i++)
+		state.buffers[i]->count = 0;
+
+	for (ProfileSite *site = state.firstSite; site; site = site->next)
+	{
+		site->frameTime = 0;
+		site->frameCalls = 0;
+		site->lastTime = site->averageTime = site->maxTime = 0;
+		site->lastCalls = 0;
+		site->averageCalls = 0;
+	}
+}
+
+ProfileSite* Profiler::getSites()
+{
+	return getState().firstSite;
+}
+
+// Writes a zone name as a JSON string.
+static void writeName(FILE *file, const char *name)
+{
+	fputc('"', file);
+	for (const char *c = name; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+		fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+bool Profiler::writeChromeTrace(const char *filename)
+{
+	FILE *file = fopen(filename, "w");
+	if (!file)
+		return false;
+
+	ProfilerState &state = getState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	fputs("{\"traceEvents\":[\n", file);
+	bool first = true;
+	for (unsigned b = 0; b < state.buffers.size(); b++)
+	{
+		const ProfileBuffer *buffer = state.buffers[b];
+
+		// Once the ring has wrapped, the oldest zone is the next to be overwritten.
+		uint64_t begin = buffer->count > bufferSize ? buffer->count - bufferSize : 0;
+		for (uint64_t i = begin; i < buffer->count; i++)
+		{
+			const ProfileEvent &event = buffer->events[i & (bufferSize - 1)];
+
+			fputs(first ? "" : ",\n", file);
+			fputs("{\"name\":", file);
+			writeName(file, event.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%u}}",
+				buffer->thread, event.start * 1e-3, (event.end - event.start) * 1e-3, event.depth);
+			first = false;
+		}
+	}
+	fputs("\n],\"displayTimeUnit\":\"ns\"}\n", file);
+
+	bool written = !ferror(file);
+	fclose(file);
+	return written;
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <atomic>
+
+namespace Physics_Engine
+{
+	/*
+		A light profiler for finding where the time of a step goes.
+		Placing PROFILE_ZONE("name") at the top of a block times it
+		until the end of the block. Zones can be nested, and the time
+		of each zone includes the zones inside it.
+
+		Each thread records its zones into its own ring buffer, which
+		keeps the most recent ones, so recording needs no locks. The
+		buffers can be written out in the Chrome trace format, to be
+		looked at in chrome://tracing or Perfetto. Each place a zone is
+		marked also keeps rolling statistics (per frame totals, call
+		counts and their averages), which are brought up to date by
+		PROFILE_END_FRAME().
+
+		The profiler is only compiled in when PHYSICS_PROFILE is
+		defined. Otherwise the macros expand to nothing and cost nothing.
+	*/
+
+	// A zone as recorded in a thread's ring buffer.
+	struct ProfileEvent
+	{
+		const char *name;
+
+		// The times are in nanoseconds since the profiler started.
+		uint64_t start;
+		uint64_t end;
+		unsigned depth;
+	};
+
+	/*
+		Holds the statistics of one place a zone is marked. Sites are
+		made once, the first time their zone is entered, and then live
+		for as long as the program.
+	*/
+	class ProfileSite
+	{
+	public:
+		const char *name;
+
+		// Holds the totals for the current frame, which any thread can add to.
+		std::atomic<uint64_t> frameTime;
+		std::atomic<unsigned> frameCalls;
+
+		// Holds the time (in seconds) and calls in the last finished frame.
+		double lastTime;
+		unsigned lastCalls;
+
+		// Holds the running averages of the time and calls per frame.
+		double averageTime;
+		double averageCalls;
+
+		// Holds the longest a frame has spent in this zone.
+		double maxTime;
+
+		// Holds the next site, in the order they were first entered.
+		ProfileSite *next;
+
+	public:
+		ProfileSite(const char *name);
+	};
+
+	class Profiler
+	{
+	public:
+		// Returns the time in nanoseconds since the profiler started.
+		static uint64_t now();
+
+		static void setEnabled(bool enabled);
+		static bool isEnabled();
+
+		/*
+			Sets how quickly the averages follow the latest frame, from
+			0 (never) to 1 (straight away).
+		*/
+		static void setSmoothing(double smoothing);
+
+		// Records a zone. This is called by ProfileZone.
+		static void record(ProfileSite *site, uint64_t start, uint64_t end);
+
+		/*
+			Ends the current frame, moving the totals of each site into
+			its statistics.
+		*/
+		static void endFrame();
+
+		// Clears the buffers and the statistics of every site.
+		static void clear();
+
+		// Returns the first site, the rest follow on from ProfileSite::next.
+		static ProfileSite* getSites();
+
+		/*
+			Writes the zones held in the buffers as a Chrome trace. This
+			should be called between steps, while no zones are being
+			recorded. Returns false if the file can't be written.
+		*/
+		static bool writeChromeTrace(const char *filename);
+
+		// Increases and decreases the nesting depth of the current thread.
+		static unsigned enter();
+		static void leave();
+	};
+
+	// Times the block it is declared in, see PROFILE_ZONE.
+	class ProfileZone
+	{
+	protected:
+		ProfileSite *site;
+		uint64_t start;
+
+	public:
+		ProfileZone(ProfileSite *site)
+			: site(site)
+		{
+			Profiler::enter();
+			start = Profiler::now();
+		}
+
+		~ProfileZone()
+		{
+			Profiler::record(site, start, Profiler::now());
+			Profiler::leave();
+		}
+	};
+}
+
+#ifdef PHYSICS_PROFILE
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+#define PROFILE_ZONE(name) \
+	static Physics_Engine::ProfileSite PROFILE_JOIN(profileSite, __LINE__)(name); \
+	Physics_Engine::ProfileZone PROFILE_JOIN(profileZone, __LINE__)(&PROFILE_JOIN(profileSite, __LINE__))
+#define PROFILE_END_FRAME() Physics_Engine::Profiler::endFrame()
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_END_FRAME()
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,368 @@
+#include "replay.h"
+#include <string.h>
+
+using namespace Physics_Engine;
+
+// The characters PERP (Physics Engine RePlay).
+static const unsigned replayMagic = 0x50524550;
+
+/*
+	The layout of a body in a keyframe and in the other frames. The
+	records are copied in and out with memcpy, so the file has no
+	alignment requirements.
+*/
+struct KeyRecord
+{
+	double position[3];
+	double orientation[4];
+};
+
+struct DeltaRecord
+{
+	int offset[3];
+	unsigned orientation[2];
+};
+
+static const unsigned componentBits = 20;
+static const unsigned componentMax = (1 << componentBits) - 1;
+
+/*
+	The three components other than the largest are all within
+	plus or minus one over root two.
+*/
+static const real componentRange = (real)0.70710678118654752440;
+
+static size_t frameOffset(const ReplayHeader &header, unsigned frame)
+{
+	size_t keySize = sizeof(KeyRecord) * header.bodyCount;
+	size_t deltaSize = sizeof(DeltaRecord) * header.bodyCount;
+	size_t blockSize = keySize + deltaSize * (header.keyframeInterval - 1);
+
+	unsigned block = frame / header.keyframeInterval;
+	unsigned index = frame % header.keyframeInterval;
+
+	size_t offset = sizeof(ReplayHeader) + blockSize * block;
+	if (index > 0)
+		offset += keySize + deltaSize * (index - 1);
+	return offset;
+}
+
+/*
+	Packs a unit quaternion as the index of its largest component and
+	the other three. The quaternion is flipped so the largest is
+	positive, which gives the same rotation, so it can be worked out
+	again from the other three.
+*/
+static void packOrientation(const Quaternion &orientation, unsigned packed[2])
+{
+	Quaternion q = orientation;
+	q.normalize();
+
+	unsigned largest = 0;
+	for (unsigned c = 1; c < 4; c++)
+	{
+		if (real_abs(q.data[c]) > real_abs(q.data[largest]))
+			largest = c;
+	}
+	real sign = q.data[largest] < 0 ? -1 : 1;
+
+	unsigned long long bits = largest;
+	unsigned shift = 2;
+	for (unsigned c = 0; c < 4; c++)
+	{
+		if (c == largest)
+			continue;
+
+		real value = (q.data[c] * sign / componentRange + 1) * (real)0.5;
+		if (value < 0) value = 0;
+		if (value > 1) value = 1;
+
+		bits |= (unsigned long long)(value * componentMax + (real)0.5) << shift;
+		shift += componentBits;
+	}
+
+	packed[0] = (unsigned)bits;
+	packed[1] = (unsigned)(bits >> 32);
+}
+
+static Quaternion unpackOrientation(const unsigned packed[2])
+{
+	unsigned long long bits = packed[0] | ((unsigned long long)packed[1] << 32);
+	unsigned largest = (unsigned)(bits & 3);
+
+	Quaternion q;
+	real sum = 0;
+	unsigned shift = 2;
+	for (unsigned c = 0; c < 4; c++)
+	{
+		if (c == largest)
+			continue;
+
+		unsigned value = (unsigned)(bits >> shift) & componentMax;
+		q.data[c] = ((real)value / componentMax * 2 - 1) * componentRange;
+		sum += q.data[c] * q.data[c];
+		shift += componentBits;
+	}
+
+	q.data[largest] = sum < 1 ? real_sqrt(1 - sum) : 0;
+	return q;
+}
+
+static int quantize(real value)
+{
+	// Rounded to the nearest step, and held within the range of an int.
+	if (value >= 2147483647.0) return 2147483647;
+	if (value <= -2147483647.0) return -2147483647;
+	return (int)(value < 0 ? value - (real)0.5 : value + (real)0.5);
+}
+
+ReplayRecorder::ReplayRecorder()
+	: inverseResolution(0), keyframe(false)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+ReplayRecorder::~ReplayRecorder()
+{
+	close();
+}
+
+bool ReplayRecorder::open(const char *filename, unsigned bodyCount, real stepSize,
+	unsigned keyframeInterval, real resolution)
+{
+	close();
+
+	if (keyframeInterval == 0 || resolution <= 0)
+		return false;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = replayMagic;
+	header.version = REPLAY_VERSION;
+	header.bodyCount = bodyCount;
+	header.keyframeInterval = keyframeInterval;
+	header.stepSize = stepSize;
+	header.resolution = resolution;
+
+	inverseResolution = ((real)1.0) / resolution;
+	keyPositions.resize(bodyCount);
+
+	// Start with room for a few blocks, the file grows as it fills.
+	if (!file.create(filename, frameOffset(header, keyframeInterval * 4)))
+		return false;
+
+	memcpy(file.getData(), &header, sizeof(header));
+	return true;
+}
+
+void ReplayRecorder::close()
+{
+	if (!file.isOpen())
+		return;
+
+	file.resize(frameOffset(header, header.frameCount));
+	file.close();
+}
+
+bool ReplayRecorder::isOpen() const
+{
+	return file.isOpen();
+}
+
+unsigned ReplayRecorder::getFrameCount() const
+{
+	return header.frameCount;
+}
+
+bool ReplayRecorder::reserve(size_t size)
+{
+	if (size <= file.getSize())
+		return true;
+
+	// Doubling the file keeps the number of remappings small.
+	size_t newSize = file.getSize() * 2;
+	if (newSize < size)
+		newSize = size;
+	return file.resize(newSize);
+}
+
+unsigned char* ReplayRecorder::beginFrame()
+{
+	if (!file.isOpen())
+		return 0;
+
+	unsigned frame = header.frameCount;
+	keyframe = (frame % header.keyframeInterval) == 0;
+
+	// Make sure the whole block fits when it is started.
+	if (keyframe && !reserve(frameOffset(header, frame + header.keyframeInterval)))
+		return 0;
+
+	return file.getData() + frameOffset(header, frame);
+}
+
+unsigned char* ReplayRecorder::writeTransform(unsigned char *out, unsigned body,
+	const Vector3 &position, const Quaternion &orientation)
+{
+	if (keyframe)
+	{
+		KeyRecord record;
+		for (unsigned c = 0; c < 3; c++)
+			record.position[c] = position[c];
+		for (unsigned c = 0; c < 4; c++)
+			record.orientation[c] = orientation.data[c];
+
+		memcpy(out, &record, sizeof(record));
+		keyPositions[body] = position;
+		return out + sizeof(record);
+	}
+	else
+	{
+		DeltaRecord record;
+		Vector3 offset = (position - keyPositions[body]) * inverseResolution;
+		for (unsigned c = 0; c < 3; c++)
+			record.offset[c] = quantize(offset[c]);
+		packOrientation(orientation, record.orientation);
+
+		memcpy(out, &record, sizeof(record));
+		return out + sizeof(record);
+	}
+}
+
+void ReplayRecorder::endFrame()
+{
+	/*
+		The count is only updated once the frame is complete, so a
+		reader never sees a half written frame.
+	*/
+	header.frameCount++;
+	memcpy(file.getData(), &header, sizeof(header));
+}
+
+bool ReplayRecorder::record(RigidBody *const *bodies)
+{
+	unsigned char *out = beginFrame();
+	if (!out)
+		return false;
+
+	for (unsigned b = 0; b < header.bodyCount; b++)
+		out = writeTransform(out, b, bodies[b]->getPosition(), bodies[b]->getOrientation());
+
+	endFrame();
+	return true;
+}
+
+bool ReplayRecorder::record(const Vector3 *positions, const Quaternion *orientations)
+{
+	unsigned char *out = beginFrame();
+	if (!out)
+		return false;
+
+	for (unsigned b = 0; b < header.bodyCount; b++)
+		out = writeTransform(out, b, positions[b], orientations[b]);
+
+	endFrame();
+	return true;
+}
+
+ReplayPlayer::ReplayPlayer()
+{
+	memset(&header, 0, sizeof(header));
+}
+
+bool ReplayPlayer::open(const char *filename)
+{
+	close();
+
+	if (!file.open(filename))
+		return false;
+
+	if (file.getSize() < sizeof(header))
+	{
+		close();
+		return false;
+	}
+	memcpy(&header, file.getData(), sizeof(header));
+
+	if (header.magic != replayMagic || header.version != REPLAY_VERSION || header.keyframeInterval == 0)
+	{
+		close();
+		return false;
+	}
+
+	// Only play the frames that are entirely in the file.
+	while (header.frameCount > 0 && frameOffset(header, header.frameCount) > file.getSize())
+		header.frameCount--;
+
+	return true;
+}
+
+void ReplayPlayer::close()
+{
+	file.close();
+	memset(&header, 0, sizeof(header));
+}
+
+bool ReplayPlayer::isOpen() const
+{
+	return file.isOpen();
+}
+
+unsigned ReplayPlayer::getFrameCount() const
+{
+	return header.frameCount;
+}
+
+unsigned ReplayPlayer::getBodyCount() const
+{
+	return header.bodyCount;
+}
+
+real ReplayPlayer::getStepSize() const
+{
+	return (real)header.stepSize;
+}
+
+bool ReplayPlayer::isKeyframe(unsigned frame) const
+{
+	return header.keyframeInterval > 0 && (frame % header.keyframeInterval) == 0;
+}
+
+bool ReplayPlayer::readFrame(unsigned frame, Vector3 *positions, Quaternion *orientations) const
+{
+	if (frame >= header.frameCount)
+		return false;
+
+	// Every frame needs the positions from its keyframe.
+	unsigned key = frame - frame % header.keyframeInterval;
+	const unsigned char *in = file.getData() + frameOffset(header, key);
+
+	for (unsigned b = 0; b < header.bodyCount; b++)
+	{
+		KeyRecord record;
+		memcpy(&record, in, sizeof(record));
+		in += sizeof(record);
+
+		positions[b] = Vector3((real)record.position[0], (real)record.position[1], (real)record.position[2]);
+		orientations[b] = Quaternion((real)record.orientation[0], (real)record.orientation[1],
+			(real)record.orientation[2], (real)record.orientation[3]);
+	}
+
+	if (frame == key)
+		return true;
+
+	in = file.getData() + frameOffset(header, frame);
+	real resolution = (real)header.resolution;
+
+	for (unsigned b = 0; b < header.bodyCount; b++)
+	{
+		DeltaRecord record;
+		memcpy(&record, in, sizeof(record));
+		in += sizeof(record);
+
+		positions[b] += Vector3(record.offset[0] * resolution, record.offset[1] * resolution,
+			record.offset[2] * resolution);
+		orientations[b] = unpackOrientation(record.orientation);
+	}
+
+	return true;
+}
\ No newline at end of file
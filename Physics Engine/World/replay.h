@@ -0,0 +1,130 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "mappedfile.h"
+#include "../Dynamics/body.h"
+#include <vector>
+
+namespace Physics_Engine
+{
+	// Changes whenever the layout of a replay file changes.
+#define REPLAY_VERSION 1
+
+	/*
+		A replay file holds the position and orientation of a fixed set
+		of bodies for every step. Every frame of the file has the same
+		size, so any frame can be found without reading the ones before
+		it.
+
+		Frames come in blocks. The first frame of each block is a
+		keyframe holding the transforms at full precision. The rest of
+		the block holds each position as a whole number of steps of the
+		file's resolution away from its keyframe, and each orientation
+		as its three smallest components in 20 bits each. A frame can
+		be decoded from itself and its keyframe alone.
+	*/
+	struct ReplayHeader
+	{
+		unsigned magic;
+		unsigned version;
+		unsigned bodyCount;
+		unsigned keyframeInterval;
+
+		/*
+			The number of frames written so far, updated after each frame
+			so a recording cut short can still be played back.
+		*/
+		unsigned frameCount;
+		unsigned padding;
+
+		// The time between frames and the size of a position step.
+		double stepSize;
+		double resolution;
+	};
+
+	// Records the bodies' transforms into a memory mapped replay file.
+	class ReplayRecorder
+	{
+	protected:
+		MappedFile file;
+		ReplayHeader header;
+
+		// The positions in the keyframe of the current block.
+		std::vector<Vector3> keyPositions;
+		real inverseResolution;
+
+		// Holds whether the frame being written is a keyframe.
+		bool keyframe;
+
+	public:
+		ReplayRecorder();
+		~ReplayRecorder();
+
+		/*
+			Creates the file and starts a recording of the given number
+			of bodies. Positions between keyframes are stored to the
+			nearest multiple of the resolution.
+		*/
+		bool open(const char *filename, unsigned bodyCount, real stepSize,
+			unsigned keyframeInterval = 30, real resolution = 0.0001);
+
+		// Finishes the recording, trimming the file to the frames written.
+		void close();
+
+		bool isOpen() const;
+		unsigned getFrameCount() const;
+
+		/*
+			Adds a frame holding the current transform of each body. The
+			bodies must be given in the same order every frame.
+		*/
+		bool record(RigidBody *const *bodies);
+
+		// Adds a frame from arrays of positions and orientations.
+		bool record(const Vector3 *positions, const Quaternion *orientations);
+
+	protected:
+		bool reserve(size_t size);
+
+		/*
+			Returns where the next frame goes, growing the file when a
+			new block is started, or NULL if the file can't grow.
+		*/
+		unsigned char* beginFrame();
+		unsigned char* writeTransform(unsigned char *out, unsigned body,
+			const Vector3 &position, const Quaternion &orientation);
+		void endFrame();
+	};
+
+	/*
+		Plays back a replay file. The file is mapped rather than read,
+		so only the frames that are asked for are loaded.
+	*/
+	class ReplayPlayer
+	{
+	protected:
+		MappedFile file;
+		ReplayHeader header;
+
+	public:
+		ReplayPlayer();
+
+		bool open(const char *filename);
+		void close();
+
+		bool isOpen() const;
+		unsigned getFrameCount() const;
+		unsigned getBodyCount() const;
+		real getStepSize() const;
+
+		/*
+			Decodes a frame into arrays with room for every body. Returns
+			false if there is no such frame.
+		*/
+		bool readFrame(unsigned frame, Vector3 *positions, Quaternion *orientations) const;
+
+		// Returns whether the frame was stored at full precision.
+		bool isKeyframe(unsigned frame) const;
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,430 @@
+#include "scene.h"
+#include "mappedfile.h"
+#include <stdio.h>
+
+using namespace Physics_Engine;
+
+static Vector3 toVector(const double *values)
+{
+	return Vector3((real)values[0], (real)values[1], (real)values[2]);
+}
+
+static Quaternion toQuaternion(const double *values)
+{
+	Quaternion q((real)values[0], (real)values[1], (real)values[2], (real)values[3]);
+	q.normalize();
+	return q;
+}
+
+static Matrix3X3 toMatrix(const double *values)
+{
+	return Matrix3X3((real)values[0], (real)values[1], (real)values[2],
+		(real)values[3], (real)values[4], (real)values[5],
+		(real)values[6], (real)values[7], (real)values[8]);
+}
+
+Scene::Scene()
+{
+
+}
+
+Scene::~Scene()
+{
+	clear();
+}
+
+void Scene::clear()
+{
+	registry.clear();
+
+	bodies.clear();
+	spheres.clear();
+	boxes.clear();
+	planes.clear();
+	gravities.clear();
+	springs.clear();
+	buoyancies.clear();
+	aeros.clear();
+	particles.clear();
+	cables.clear();
+	rods.clear();
+	cableConstraints.clear();
+	rodConstraints.clear();
+
+	for (unsigned i = 0; i < cloths.size(); i++)
+		delete cloths[i];
+	cloths.clear();
+}
+
+const char* Scene::getError() const
+{
+	return error.c_str();
+}
+
+bool Scene::fail(const char *kind, unsigned index)
+{
+	char message[128];
+	snprintf(message, sizeof(message), "%s %u refers to something that isn't in the scene", kind, index);
+	error = message;
+
+	clear();
+	return false;
+}
+
+bool Scene::load(const char *filename)
+{
+	clear();
+	error.clear();
+
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		error = std::string("Can't open ") + filename;
+		return false;
+	}
+
+	/*
+		A binary file is built straight from the mapped records. A text
+		file has to be parsed into records first.
+	*/
+	SceneData data;
+	if (SceneDescription::isBinary(file.getData(), file.getSize()))
+	{
+		if (!SceneDescription::readBinary(file.getData(), file.getSize(), &data))
+		{
+			error = std::string(filename) + " is not a complete scene file of this version";
+			return false;
+		}
+
+		return build(data);
+	}
+
+	SceneDescription description;
+	if (!description.parseText((const char *)file.getData(), file.getSize()))
+	{
+		error = description.getError();
+		return false;
+	}
+
+	return build(description.getData());
+}
+
+bool Scene::build(const SceneData &data)
+{
+	clear();
+	error.clear();
+
+	const SceneHeader &header = data.header;
+
+	/*
+		Count each kind of primitive, force and link, so every array
+		can be allocated once. Nothing is allocated after this, so
+		pointers into the arrays can be taken as objects are created.
+	*/
+	unsigned primitiveCounts[3] = { 0, 0, 0 };
+	for (unsigned i = 0; i < header.primitiveCount; i++)
+	{
+		if (data.primitives[i].type > SCENE_PLANE)
+			return fail("Primitive", i);
+		primitiveCounts[data.primitives[i].type]++;
+	}
+
+	unsigned forceCounts[4] = { 0, 0, 0, 0 };
+	for (unsigned i = 0; i < header.forceCount; i++)
+	{
+		if (data.forces[i].type > SCENE_AERO)
+			return fail("Force", i);
+		forceCounts[data.forces[i].type]++;
+	}
+
+	unsigned linkCounts[4] = { 0, 0, 0, 0 };
+	for (unsigned i = 0; i < header.linkCount; i++)
+	{
+		if (data.links[i].type > SCENE_ROD_CONSTRAINT)
+			return fail("Link", i);
+		linkCounts[data.links[i].type]++;
+	}
+
+	bodies.resize(header.bodyCount);
+	spheres.resize(primitiveCounts[SCENE_SPHERE]);
+	boxes.resize(primitiveCounts[SCENE_BOX]);
+	planes.resize(primitiveCounts[SCENE_PLANE]);
+	gravities.reserve(forceCounts[SCENE_GRAVITY]);
+	springs.reserve(forceCounts[SCENE_SPRING]);
+	buoyancies.reserve(forceCounts[SCENE_BUOYANCY]);
+	aeros.reserve(forceCounts[SCENE_AERO]);
+	particles.resize(header.particleCount);
+	cables.resize(linkCounts[SCENE_CABLE]);
+	rods.resize(linkCounts[SCENE_ROD]);
+	cableConstraints.resize(linkCounts[SCENE_CABLE_CONSTRAINT]);
+	rodConstraints.resize(linkCounts[SCENE_ROD_CONSTRAINT]);
+	cloths.reserve(header.clothCount);
+
+	for (unsigned i = 0; i < header.bodyCount; i++)
+	{
+		const SceneBody &record = data.bodies[i];
+		RigidBody &body = bodies[i];
+
+		body.setId(i);
+		body.setInverseMass((real)record.inverseMass);
+		body.setInverseInertiaTensor(toMatrix(record.inverseInertiaTensor));
+		body.setPosition(toVector(record.position));
+		body.setOrientation(toQuaternion(record.orientation));
+		body.setVelocity(toVector(record.velocity));
+		body.setRotation(toVector(record.rotation));
+		body.setAcceleration(toVector(record.acceleration));
+		body.setDamping((real)record.linearDamping, (real)record.angularDamping);
+		body.setCanSleep(record.canSleep != 0);
+		body.setAwake(record.awake != 0);
+		body.calculateDerivedData();
+	}
+
+	unsigned primitiveIndex[3] = { 0, 0, 0 };
+	for (unsigned i = 0; i < header.primitiveCount; i++)
+	{
+		const ScenePrimitive &record = data.primitives[i];
+
+		if (record.type == SCENE_PLANE)
+		{
+			CollisionPlane &plane = planes[primitiveIndex[SCENE_PLANE]++];
+			plane.body = 0;
+			plane.normal = toVector(record.size);
+			plane.normal.normalise();
+			plane.offset = (real)record.size[3];
+			continue;
+		}
+
+		// Spheres and boxes take their transform from a body.
+		if (record.body >= header.bodyCount)
+			return fail("Primitive", i);
+
+		CollisionPrimitive *primitive;
+		if (record.type == SCENE_SPHERE)
+		{
+			CollisionSphere &sphere = spheres[primitiveIndex[SCENE_SPHERE]++];
+			sphere.radius = (real)record.size[0];
+			primitive = &sphere;
+		}
+		else
+		{
+			CollisionBox &box = boxes[primitiveIndex[SCENE_BOX]++];
+			box.halfSize = toVector(record.size);
+			primitive = &box;
+		}
+
+		primitive->body = &bodies[record.body];
+		primitive->offset.setOrientationAndPos(toQuaternion(record.orientation), toVector(record.position));
+		primitive->calculateInternals();
+	}
+
+	for (unsigned i = 0; i < header.forceCount; i++)
+	{
+		const SceneForce &record = data.forces[i];
+		if (record.body >= header.bodyCount)
+			return fail("Force", i);
+
+		ForceGenerator *generator;
+		switch (record.type)
+		{
+		case SCENE_GRAVITY:
+			gravities.push_back(Gravity(toVector(record.point)));
+			generator = &gravities.back();
+			break;
+
+		case SCENE_SPRING:
+			if (record.other >= header.bodyCount)
+				return fail("Force", i);
+
+			springs.push_back(Spring(toVector(record.point), &bodies[record.other],
+				toVector(record.otherPoint), (real)record.values[0], (real)record.values[1]));
+			generator = &springs.back();
+			break;
+
+		case SCENE_BUOYANCY:
+			buoyancies.push_back(Buoyancy(toVector(record.point), (real)record.values[0],
+				(real)record.values[1], (real)record.values[2], (real)record.values[3]));
+			generator = &buoyancies.back();
+			break;
+
+		default:
+			aeros.push_back(Aero(toMatrix(record.tensor), toVector(record.point), &windspeed));
+			generator = &aeros.back();
+			break;
+		}
+
+		registry.add(&bodies[record.body], generator);
+	}
+
+	for (unsigned i = 0; i < header.particleCount; i++)
+	{
+		const SceneParticle &record = data.particles[i];
+		Vector3 position = toVector(record.position);
+
+		Particle &particle = particles[i];
+		particle = Particle(position);
+		particle.setVelocity(toVector(record.velocity));
+		particle.setAcceleration(toVector(record.acceleration));
+		particle.setDamping((real)record.damping);
+		particle.setInverseMass((real)record.inverseMass);
+		particle.clearAccumulator();
+	}
+
+	unsigned linkIndex[4] = { 0, 0, 0, 0 };
+	for (unsigned i = 0; i < header.linkCount; i++)
+	{
+		const SceneLink &record = data.links[i];
+		bool joint = record.type == SCENE_CABLE || record.type == SCENE_ROD;
+
+		if (record.particle[0] >= header.particleCount ||
+			(joint && record.particle[1] >= header.particleCount))
+			return fail("Link", i);
+
+		Particle *first = &particles[record.particle[0]];
+		Particle *second = joint ? &particles[record.particle[1]] : 0;
+
+		switch (record.type)
+		{
+		case SCENE_CABLE:
+		{
+			ParticleCable &cable = cables[linkIndex[SCENE_CABLE]++];
+			cable.particle[0] = first;
+			cable.particle[1] = second;
+			cable.maxLength = (real)record.length;
+			cable.restitution = (real)record.restitution;
+			break;
+		}
+
+		case SCENE_ROD:
+		{
+			ParticleRod &rod = rods[linkIndex[SCENE_ROD]++];
+			rod.particle[0] = first;
+			rod.particle[1] = second;
+			rod.length = (real)record.length;
+			break;
+		}
+
+		case SCENE_CABLE_CONSTRAINT:
+		{
+			ParticleCableConstraint &cable = cableConstraints[linkIndex[SCENE_CABLE_CONSTRAINT]++];
+			cable.particle = first;
+			cable.anchor = toVector(record.anchor);
+			cable.maxLength = (real)record.length;
+			cable.restitution = (real)record.restitution;
+			break;
+		}
+
+		default:
+		{
+			ParticleRodConstraint &rod = rodConstraints[linkIndex[SCENE_ROD_CONSTRAINT]++];
+			rod.particle = first;
+			rod.anchor = toVector(record.anchor);
+			rod.lenght = (real)record.length;
+			break;
+		}
+		}
+	}
+
+	for (unsigned i = 0; i < header.clothCount; i++)
+	{
+		const SceneCloth &record = data.cloths[i];
+		if (record.particlesWidth < 2 || record.particlesHeight < 2)
+			return fail("Cloth", i);
+
+		Cloth *cloth = new Cloth((real)record.width, (real)record.height,
+			(int)record.particlesWidth, (int)record.particlesHeight, toVector(record.origin));
+
+		// A thickness of zero keeps the cloth's own default.
+		if (record.selfCollision)
+			cloth->setSelfCollision(true, record.thickness > 0 ? (real)record.thickness :
+				(real)(record.width / record.particlesWidth * 0.25));
+
+		cloths.push_back(cloth);
+	}
+
+	return true;
+}
+
+RigidBody* Scene::getBodies()
+{
+	return bodies.empty() ? 0 : &bodies[0];
+}
+
+unsigned Scene::getBodyCount() const
+{
+	return (unsigned)bodies.size();
+}
+
+CollisionSphere* Scene::getSpheres()
+{
+	return spheres.empty() ? 0 : &spheres[0];
+}
+
+unsigned Scene::getSphereCount() const
+{
+	return (unsigned)spheres.size();
+}
+
+CollisionBox* Scene::getBoxes()
+{
+	return boxes.empty() ? 0 : &boxes[0];
+}
+
+unsigned Scene::getBoxCount() const
+{
+	return (unsigned)boxes.size();
+}
+
+CollisionPlane* Scene::getPlanes()
+{
+	return planes.empty() ? 0 : &planes[0];
+}
+
+unsigned Scene::getPlaneCount() const
+{
+	return (unsigned)planes.size();
+}
+
+Particle* Scene::getParticles()
+{
+	return particles.empty() ? 0 : &particles[0];
+}
+
+unsigned Scene::getParticleCount() const
+{
+	return (unsigned)particles.size();
+}
+
+Cloth* Scene::getCloth(unsigned index)
+{
+	return cloths[index];
+}
+
+unsigned Scene::getClothCount() const
+{
+	return (unsigned)cloths.size();
+}
+
+ForceRegistry& Scene::getForceRegistry()
+{
+	return registry;
+}
+
+void Scene::setWindspeed(const Vector3 &windspeed)
+{
+	Scene::windspeed = windspeed;
+}
+
+void Scene::addTo(ParticleWorld &world)
+{
+	for (unsigned i = 0; i < particles.size(); i++)
+		world.getParticles().push_back(&particles[i]);
+
+	for (unsigned i = 0; i < cables.size(); i++)
+		world.getContactGenerators().push_back(&cables[i]);
+	for (unsigned i = 0; i < rods.size(); i++)
+		world.getContactGenerators().push_back(&rods[i]);
+	for (unsigned i = 0; i < cableConstraints.size(); i++)
+		world.getContactGenerators().push_back(&cableConstraints[i]);
+	for (unsigned i = 0; i < rodConstraints.size(); i++)
+		world.getContactGenerators().push_back(&rodConstraints[i]);
+}
\ No newline at end of file
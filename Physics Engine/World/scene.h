@@ -0,0 +1,96 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "scenefile.h"
+#include "../Collision/NarrowPhase.h"
+#include "../Dynamics/force_gen.h"
+#include "../Dynamics/pworld.h"
+#include "../Dynamics/cloth.h"
+
+namespace Physics_Engine
+{
+	/*
+		Holds the objects of a scene loaded from a scene file. The
+		counts in the file are used to allocate all the storage up
+		front, and the objects are then created in a single pass over
+		the records, so even very large scenes load quickly.
+
+		The scene owns its objects. Pointers to them stay valid until
+		the scene is loaded again or cleared.
+	*/
+	class Scene
+	{
+	protected:
+		std::vector<RigidBody> bodies;
+		std::vector<CollisionSphere> spheres;
+		std::vector<CollisionBox> boxes;
+		std::vector<CollisionPlane> planes;
+
+		std::vector<Gravity> gravities;
+		std::vector<Spring> springs;
+		std::vector<Buoyancy> buoyancies;
+		std::vector<Aero> aeros;
+		ForceRegistry registry;
+
+		std::vector<Particle> particles;
+		std::vector<ParticleCable> cables;
+		std::vector<ParticleRod> rods;
+		std::vector<ParticleCableConstraint> cableConstraints;
+		std::vector<ParticleRodConstraint> rodConstraints;
+
+		std::vector<Cloth*> cloths;
+
+		// The wind used by the aerodynamic surfaces.
+		Vector3 windspeed;
+
+		std::string error;
+
+	public:
+		Scene();
+		~Scene();
+
+		/*
+			Loads a scene file, binary or text. Returns false, leaving
+			the scene empty, if the file can't be read or refers to
+			objects that aren't in it. See getError().
+		*/
+		bool load(const char *filename);
+
+		// Creates the objects described by the records.
+		bool build(const SceneData &data);
+
+		void clear();
+
+		const char* getError() const;
+
+		RigidBody* getBodies();
+		unsigned getBodyCount() const;
+		CollisionSphere* getSpheres();
+		unsigned getSphereCount() const;
+		CollisionBox* getBoxes();
+		unsigned getBoxCount() const;
+		CollisionPlane* getPlanes();
+		unsigned getPlaneCount() const;
+		Particle* getParticles();
+		unsigned getParticleCount() const;
+		Cloth* getCloth(unsigned index);
+		unsigned getClothCount() const;
+
+		// Holds the force generators of the scene and their bodies.
+		ForceRegistry& getForceRegistry();
+
+		void setWindspeed(const Vector3 &windspeed);
+
+		// Adds the particles and their links to a particle world.
+		void addTo(ParticleWorld &world);
+
+	protected:
+		bool fail(const char *kind, unsigned index);
+
+	private:
+		// The force generators point at the scene, so it can't be copied.
+		Scene(const Scene &);
+		Scene& operator=(const Scene &);
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,524 @@
+#include "scenefile.h"
+#include "mappedfile.h"
+#include "../Math/core.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Physics_Engine;
+
+// The characters PESC (Physics Engine SCene).
+static const unsigned sceneMagic = 0x43534550;
+
+/*
+	Every record must be a whole number of doubles long, so that all
+	the arrays in a mapped file stay aligned.
+*/
+static_assert(sizeof(SceneHeader) % 8 == 0, "Scene records must be a multiple of 8 bytes");
+static_assert(sizeof(SceneBody) % 8 == 0, "Scene records must be a multiple of 8 bytes");
+static_assert(sizeof(ScenePrimitive) % 8 == 0, "Scene records must be a multiple of 8 bytes");
+static_assert(sizeof(SceneForce) % 8 == 0, "Scene records must be a multiple of 8 bytes");
+static_assert(sizeof(SceneParticle) % 8 == 0, "Scene records must be a multiple of 8 bytes");
+static_assert(sizeof(SceneLink) % 8 == 0, "Scene records must be a multiple of 8 bytes");
+static_assert(sizeof(SceneCloth) % 8 == 0, "Scene records must be a multiple of 8 bytes");
+
+// The most numbers a single field can hold (a 3x3 matrix).
+#define SCENE_MAX_VALUES 9
+
+// The most fields that can be given for one object.
+#define SCENE_MAX_FIELDS 16
+
+// A name=value field read from a line of a text scene.
+struct SceneField
+{
+	const char *name;
+	unsigned nameLength;
+	double values[SCENE_MAX_VALUES];
+	unsigned count;
+};
+
+static bool isName(const SceneField &field, const char *name)
+{
+	return strlen(name) == field.nameLength && strncmp(field.name, name, field.nameLength) == 0;
+}
+
+static void copy(double *to, const double *from, unsigned count)
+{
+	for (unsigned i = 0; i < count; i++)
+		to[i] = from[i];
+}
+
+static void setIdentity(double *matrix)
+{
+	for (unsigned i = 0; i < 9; i++)
+		matrix[i] = (i % 4 == 0) ? 1 : 0;
+}
+
+static double inverse(double value)
+{
+	// A mass of zero or less is taken to be infinite.
+	return value > 0 ? 1 / value : 0;
+}
+
+/*
+	Sets the inverse of a tensor given as three diagonal values or as
+	a full matrix. A tensor that can't be inverted is left as zero,
+	so the object won't rotate.
+*/
+static void setInverseTensor(double *inverse, const SceneField &field)
+{
+	Matrix3X3 tensor;
+	if (field.count == 3)
+		tensor.setInertiaTensorCoeffs(field.values[0], field.values[1], field.values[2]);
+	else
+		for (unsigned i = 0; i < 9; i++)
+			tensor.data[i] = field.values[i];
+
+	Matrix3X3 result(0, 0, 0, 0, 0, 0, 0, 0, 0);
+	result.setInverse(tensor);
+	copy(inverse, result.data, 9);
+}
+
+void SceneDescription::clear()
+{
+	bodies.clear();
+	primitives.clear();
+	forces.clear();
+	particles.clear();
+	links.clear();
+	cloths.clear();
+	error.clear();
+}
+
+const char* SceneDescription::getError() const
+{
+	return error.c_str();
+}
+
+bool SceneDescription::loadText(const char *filename)
+{
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		error = std::string("Can't open ") + filename;
+		return false;
+	}
+
+	return parseText((const char *)file.getData(), file.getSize());
+}
+
+bool SceneDescription::parseText(const char *text, size_t length)
+{
+	error.clear();
+
+	const char *end = text + length;
+	unsigned lineNumber = 1;
+
+	while (text < end)
+	{
+		const char *lineEnd = (const char *)memchr(text, '\n', end - text);
+		if (!lineEnd)
+			lineEnd = end;
+
+		if (!parseLine(text, lineEnd, lineNumber))
+			return false;
+
+		text = lineEnd + 1;
+		lineNumber++;
+	}
+
+	return true;
+}
+
+bool SceneDescription::parseLine(const char *line, const char *end, unsigned lineNumber)
+{
+	char message[256];
+
+	// Comments run to the end of the line.
+	const char *comment = (const char *)memchr(line, '#', end - line);
+	if (comment)
+		end = comment;
+
+	/*
+		Split the line into the type and the fields. The numbers are
+		copied out before they are read, as the text isn't terminated.
+	*/
+	const char *type = 0;
+	unsigned typeLength = 0;
+	SceneField fields[SCENE_MAX_FIELDS];
+	unsigned fieldCount = 0;
+
+	const char *p = line;
+	while (p < end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+			p++;
+		if (p == end)
+			break;
+
+		const char *token = p;
+		while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+			p++;
+
+		if (!type)
+		{
+			type = token;
+			typeLength = (unsigned)(p - token);
+			continue;
+		}
+
+		const char *equals = (const char *)memchr(token, '=', p - token);
+		if (!equals || fieldCount == SCENE_MAX_FIELDS)
+		{
+			snprintf(message, sizeof(message), "Line %u: expected name=value", lineNumber);
+			error = message;
+			return false;
+		}
+
+		SceneField &field = fields[fieldCount++];
+		field.name = token;
+		field.nameLength = (unsigned)(equals - token);
+		field.count = 0;
+
+		const char *value = equals + 1;
+		while (value < p)
+		{
+			char number[64];
+			const char *comma = (const char *)memchr(value, ',', p - value);
+			const char *valueEnd = comma ? comma : p;
+			size_t valueLength = valueEnd - value;
+
+			char *parsed;
+			if (valueLength == 0 || valueLength >= sizeof(number) || field.count == SCENE_MAX_VALUES)
+				parsed = number;
+			else
+			{
+				memcpy(number, value, valueLength);
+				number[valueLength] = 0;
+				field.values[field.count] = strtod(number, &parsed);
+			}
+
+			if (parsed != number + valueLength || valueLength == 0)
+			{
+				snprintf(message, sizeof(message), "Line %u: bad value for %.*s",
+					lineNumber, (int)field.nameLength, field.name);
+				error = message;
+				return false;
+			}
+
+			field.count++;
+			value = valueEnd + 1;
+		}
+	}
+
+	// A blank line.
+	if (!type)
+		return true;
+
+	std::string typeName(type, typeLength);
+
+	/*
+		Each field is checked against the names the type allows, along
+		with the number of values it should have.
+	*/
+	const SceneField *field = fields;
+	const SceneField *lastField = fields + fieldCount;
+
+#define SCENE_FIELD(name, valueCount) \
+	(isName(*field, name) && (field->count == (valueCount) || (badField = true, false)))
+
+	bool badField = false;
+
+	if (typeName == "body")
+	{
+		SceneBody body;
+		memset(&body, 0, sizeof(body));
+		body.inverseMass = 1;
+		setIdentity(body.inverseInertiaTensor);
+		body.orientation[0] = 1;
+		body.linearDamping = 0.99;
+		body.angularDamping = 0.8;
+		body.canSleep = 1;
+		body.awake = 1;
+
+		for (; field < lastField && !badField; field++)
+		{
+			if (SCENE_FIELD("mass", 1)) body.inverseMass = inverse(field->values[0]);
+			else if (SCENE_FIELD("inverseMass", 1)) body.inverseMass = field->values[0];
+			else if (isName(*field, "inertia") && (field->count == 3 || field->count == 9 || (badField = true, false)))
+				setInverseTensor(body.inverseInertiaTensor, *field);
+			else if (SCENE_FIELD("inverseInertia", 9)) copy(body.inverseInertiaTensor, field->values, 9);
+			else if (SCENE_FIELD("position", 3)) copy(body.position, field->values, 3);
+			else if (SCENE_FIELD("orientation", 4)) copy(body.orientation, field->values, 4);
+			else if (SCENE_FIELD("velocity", 3)) copy(body.velocity, field->values, 3);
+			else if (SCENE_FIELD("rotation", 3)) copy(body.rotation, field->values, 3);
+			else if (SCENE_FIELD("acceleration", 3)) copy(body.acceleration, field->values, 3);
+			else if (SCENE_FIELD("damping", 2))
+			{
+				body.linearDamping = field->values[0];
+				body.angularDamping = field->values[1];
+			}
+			else if (SCENE_FIELD("canSleep", 1)) body.canSleep = field->values[0] != 0;
+			else if (SCENE_FIELD("awake", 1)) body.awake = field->values[0] != 0;
+			else break;
+		}
+
+		if (field == lastField)
+			bodies.push_back(body);
+	}
+	else if (typeName == "sphere" || typeName == "box" || typeName == "plane")
+	{
+		ScenePrimitive primitive;
+		memset(&primitive, 0, sizeof(primitive));
+		primitive.type = typeName == "sphere" ? SCENE_SPHERE : typeName == "box" ? SCENE_BOX : SCENE_PLANE;
+		primitive.body = SCENE_NONE;
+		primitive.orientation[0] = 1;
+		if (primitive.type == SCENE_PLANE)
+			primitive.size[1] = 1;
+
+		for (; field < lastField && !badField; field++)
+		{
+			if (primitive.type != SCENE_PLANE && SCENE_FIELD("body", 1)) primitive.body = (unsigned)field->values[0];
+			else if (primitive.type != SCENE_PLANE && SCENE_FIELD("position", 3)) copy(primitive.position, field->values, 3);
+			else if (primitive.type != SCENE_PLANE && SCENE_FIELD("orientation", 4)) copy(primitive.orientation, field->values, 4);
+			else if (primitive.type == SCENE_SPHERE && SCENE_FIELD("radius", 1)) primitive.size[0] = field->values[0];
+			else if (primitive.type == SCENE_BOX && SCENE_FIELD("halfSize", 3)) copy(primitive.size, field->values, 3);
+			else if (primitive.type == SCENE_PLANE && SCENE_FIELD("normal", 3)) copy(primitive.size, field->values, 3);
+			else if (primitive.type == SCENE_PLANE && SCENE_FIELD("offset", 1)) primitive.size[3] = field->values[0];
+			else break;
+		}
+
+		if (field == lastField)
+			primitives.push_back(primitive);
+	}
+	else if (typeName == "gravity" || typeName == "spring" || typeName == "buoyancy" || typeName == "aero")
+	{
+		SceneForce force;
+		memset(&force, 0, sizeof(force));
+		force.body = SCENE_NONE;
+		force.other = SCENE_NONE;
+
+		if (typeName == "gravity")
+		{
+			force.type = SCENE_GRAVITY;
+			force.point[1] = -9.81;
+		}
+		else if (typeName == "spring")
+			force.type = SCENE_SPRING;
+		else if (typeName == "buoyancy")
+		{
+			force.type = SCENE_BUOYANCY;
+			force.values[3] = 1000;
+		}
+		else
+			force.type = SCENE_AERO;
+
+		for (; field < lastField && !badField; field++)
+		{
+			if (SCENE_FIELD("body", 1)) force.body = (unsigned)field->values[0];
+			else if (force.type == SCENE_GRAVITY && SCENE_FIELD("gravity", 3)) copy(force.point, field->values, 3);
+			else if (force.type == SCENE_SPRING && SCENE_FIELD("point", 3)) copy(force.point, field->values, 3);
+			else if (force.type == SCENE_SPRING && SCENE_FIELD("other", 1)) force.other = (unsigned)field->values[0];
+			else if (force.type == SCENE_SPRING && SCENE_FIELD("otherPoint", 3)) copy(force.otherPoint, field->values, 3);
+			else if (force.type == SCENE_SPRING && SCENE_FIELD("constant", 1)) force.values[0] = field->values[0];
+			else if (force.type == SCENE_SPRING && SCENE_FIELD("length", 1)) force.values[1] = field->values[0];
+			else if (force.type == SCENE_BUOYANCY && SCENE_FIELD("centre", 3)) copy(force.point, field->values, 3);
+			else if (force.type == SCENE_BUOYANCY && SCENE_FIELD("maxDepth", 1)) force.values[0] = field->values[0];
+			else if (force.type == SCENE_BUOYANCY && SCENE_FIELD("volume", 1)) force.values[1] = field->values[0];
+			else if (force.type == SCENE_BUOYANCY && SCENE_FIELD("waterHeight", 1)) force.values[2] = field->values[0];
+			else if (force.type == SCENE_BUOYANCY && SCENE_FIELD("density", 1)) force.values[3] = field->values[0];
+			else if (force.type == SCENE_AERO && SCENE_FIELD("position", 3)) copy(force.point, field->values, 3);
+			else if (force.type == SCENE_AERO && SCENE_FIELD("tensor", 9)) copy(force.tensor, field->values, 9);
+			else break;
+		}
+
+		if (field == lastField)
+			forces.push_back(force);
+	}
+	else if (typeName == "particle")
+	{
+		SceneParticle particle;
+		memset(&particle, 0, sizeof(particle));
+		particle.inverseMass = 1;
+		particle.damping = 0.99;
+
+		for (; field < lastField && !badField; field++)
+		{
+			if (SCENE_FIELD("mass", 1)) particle.inverseMass = inverse(field->values[0]);
+			else if (SCENE_FIELD("inverseMass", 1)) particle.inverseMass = field->values[0];
+			else if (SCENE_FIELD("position", 3)) copy(particle.position, field->values, 3);
+			else if (SCENE_FIELD("velocity", 3)) copy(particle.velocity, field->values, 3);
+			else if (SCENE_FIELD("acceleration", 3)) copy(particle.acceleration, field->values, 3);
+			else if (SCENE_FIELD("damping", 1)) particle.damping = field->values[0];
+			else break;
+		}
+
+		if (field == lastField)
+			particles.push_back(particle);
+	}
+	else if (typeName == "cable" || typeName == "rod" ||
+		typeName == "cable-constraint" || typeName == "rod-constraint")
+	{
+		SceneLink link;
+		memset(&link, 0, sizeof(link));
+		link.particle[0] = link.particle[1] = SCENE_NONE;
+		link.type = typeName == "cable" ? SCENE_CABLE : typeName == "rod" ? SCENE_ROD :
+			typeName == "cable-constraint" ? SCENE_CABLE_CONSTRAINT : SCENE_ROD_CONSTRAINT;
+		bool joint = link.type == SCENE_CABLE || link.type == SCENE_ROD;
+		bool cable = link.type == SCENE_CABLE || link.type == SCENE_CABLE_CONSTRAINT;
+
+		for (; field < lastField && !badField; field++)
+		{
+			if (joint && SCENE_FIELD("particles", 2))
+			{
+				link.particle[0] = (unsigned)field->values[0];
+				link.particle[1] = (unsigned)field->values[1];
+			}
+			else if (!joint && SCENE_FIELD("particle", 1)) link.particle[0] = (unsigned)field->values[0];
+			else if (!joint && SCENE_FIELD("anchor", 3)) copy(link.anchor, field->values, 3);
+			else if (SCENE_FIELD("length", 1)) link.length = field->values[0];
+			else if (cable && SCENE_FIELD("restitution", 1)) link.restitution = field->values[0];
+			else break;
+		}
+
+		if (field == lastField)
+			links.push_back(link);
+	}
+	else if (typeName == "cloth")
+	{
+		SceneCloth cloth;
+		memset(&cloth, 0, sizeof(cloth));
+		cloth.width = cloth.height = 1;
+		cloth.particlesWidth = cloth.particlesHeight = 10;
+
+		for (; field < lastField && !badField; field++)
+		{
+			if (SCENE_FIELD("size", 2))
+			{
+				cloth.width = field->values[0];
+				cloth.height = field->values[1];
+			}
+			else if (SCENE_FIELD("particles", 2))
+			{
+				cloth.particlesWidth = (unsigned)field->values[0];
+				cloth.particlesHeight = (unsigned)field->values[1];
+			}
+			else if (SCENE_FIELD("origin", 3)) copy(cloth.origin, field->values, 3);
+			else if (SCENE_FIELD("thickness", 1)) cloth.thickness = field->values[0];
+			else if (SCENE_FIELD("selfCollision", 1)) cloth.selfCollision = field->values[0] != 0;
+			else break;
+		}
+
+		if (field == lastField)
+			cloths.push_back(cloth);
+	}
+	else
+	{
+		snprintf(message, sizeof(message), "Line %u: unknown type %s", lineNumber, typeName.c_str());
+		error = message;
+		return false;
+	}
+
+#undef SCENE_FIELD
+
+	// The loop over the fields stops early at a field it can't use.
+	if (field != lastField)
+	{
+		if (badField)
+			snprintf(message, sizeof(message), "Line %u: wrong number of values for %.*s",
+				lineNumber, (int)field->nameLength, field->name);
+		else
+			snprintf(message, sizeof(message), "Line %u: %s has no field %.*s",
+				lineNumber, typeName.c_str(), (int)field->nameLength, field->name);
+		error = message;
+		return false;
+	}
+
+	return true;
+}
+
+SceneData SceneDescription::getData() const
+{
+	SceneData data;
+	memset(&data, 0, sizeof(data));
+
+	data.header.magic = sceneMagic;
+	data.header.version = SCENE_VERSION;
+	data.header.bodyCount = (unsigned)bodies.size();
+	data.header.primitiveCount = (unsigned)primitives.size();
+	data.header.forceCount = (unsigned)forces.size();
+	data.header.particleCount = (unsigned)particles.size();
+	data.header.linkCount = (unsigned)links.size();
+	data.header.clothCount = (unsigned)cloths.size();
+
+	data.bodies = bodies.empty() ? 0 : &bodies[0];
+	data.primitives = primitives.empty() ? 0 : &primitives[0];
+	data.forces = forces.empty() ? 0 : &forces[0];
+	data.particles = particles.empty() ? 0 : &particles[0];
+	data.links = links.empty() ? 0 : &links[0];
+	data.cloths = cloths.empty() ? 0 : &cloths[0];
+	return data;
+}
+
+bool SceneDescription::saveBinary(const char *filename) const
+{
+	FILE *file = fopen(filename, "wb");
+	if (!file)
+		return false;
+
+	SceneData data = getData();
+	bool written = fwrite(&data.header, sizeof(data.header), 1, file) == 1;
+
+	if (data.bodies)
+		written &= fwrite(data.bodies, sizeof(SceneBody), bodies.size(), file) == bodies.size();
+	if (data.primitives)
+		written &= fwrite(data.primitives, sizeof(ScenePrimitive), primitives.size(), file) == primitives.size();
+	if (data.forces)
+		written &= fwrite(data.forces, sizeof(SceneForce), forces.size(), file) == forces.size();
+	if (data.particles)
+		written &= fwrite(data.particles, sizeof(SceneParticle), particles.size(), file) == particles.size();
+	if (data.links)
+		written &= fwrite(data.links, sizeof(SceneLink), links.size(), file) == links.size();
+	if (data.cloths)
+		written &= fwrite(data.cloths, sizeof(SceneCloth), cloths.size(), file) == cloths.size();
+
+	return fclose(file) == 0 && written;
+}
+
+bool SceneDescription::isBinary(const void *buffer, size_t size)
+{
+	unsigned magic;
+	if (size < sizeof(magic))
+		return false;
+
+	memcpy(&magic, buffer, sizeof(magic));
+	return magic == sceneMagic;
+}
+
+bool SceneDescription::readBinary(const void *buffer, size_t size, SceneData *data)
+{
+	if (!isBinary(buffer, size) || size < sizeof(SceneHeader))
+		return false;
+
+	const unsigned char *start = (const unsigned char *)buffer;
+	memcpy(&data->header, start, sizeof(SceneHeader));
+	if (data->header.version != SCENE_VERSION)
+		return false;
+
+	// Work out where each array starts, and check the last one fits.
+	size_t offset = sizeof(SceneHeader);
+	data->bodies = (const SceneBody *)(start + offset);
+	offset += sizeof(SceneBody) * (size_t)data->header.bodyCount;
+	data->primitives = (const ScenePrimitive *)(start + offset);
+	offset += sizeof(ScenePrimitive) * (size_t)data->header.primitiveCount;
+	data->forces = (const SceneForce *)(start + offset);
+	offset += sizeof(SceneForce) * (size_t)data->header.forceCount;
+	data->particles = (const SceneParticle *)(start + offset);
+	offset += sizeof(SceneParticle) * (size_t)data->header.particleCount;
+	data->links = (const SceneLink *)(start + offset);
+	offset += sizeof(SceneLink) * (size_t)data->header.linkCount;
+	data->cloths = (const SceneCloth *)(start + offset);
+	offset += sizeof(SceneCloth) * (size_t)data->header.clothCount;
+
+	return offset <= size;
+}
\ No newline at end of file
@@ -0,0 +1,239 @@
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace Physics_Engine
+{
+	// Changes whenever the layout of a binary scene file changes.
+#define SCENE_VERSION 1
+
+	// Used in place of an index when a record doesn't refer to anything.
+#define SCENE_NONE 0xffffffff
+
+	/*
+		A scene file describes the objects of a scene, as a header of
+		counts followed by an array of fixed size records for each kind
+		of object. Objects refer to each other by their index in their
+		array, so a spring names the bodies at each end and a cable
+		names its two particles.
+
+		The records only use doubles and unsigned ints, and are all a
+		multiple of eight bytes, so a binary file can be mapped and its
+		arrays used where they are. The data is in the native byte
+		order of the machine.
+
+		The same scene can be written as text, which is easier to
+		author. See SceneDescription::parseText for the syntax.
+	*/
+	struct SceneHeader
+	{
+		unsigned magic;
+		unsigned version;
+		unsigned bodyCount;
+		unsigned primitiveCount;
+		unsigned forceCount;
+		unsigned particleCount;
+		unsigned linkCount;
+		unsigned clothCount;
+	};
+
+	struct SceneBody
+	{
+		double inverseMass;
+		double inverseInertiaTensor[9];
+		double position[3];
+		double orientation[4];
+		double velocity[3];
+		double rotation[3];
+		double acceleration[3];
+		double linearDamping;
+		double angularDamping;
+		unsigned canSleep;
+		unsigned awake;
+	};
+
+	enum ScenePrimitiveType
+	{
+		SCENE_SPHERE,
+		SCENE_BOX,
+		SCENE_PLANE
+	};
+
+	/*
+		A sphere has its radius as the first size, a box its half sizes.
+		A plane has its normal and its distance from the origin, and
+		doesn't use the body or the offset.
+	*/
+	struct ScenePrimitive
+	{
+		unsigned type;
+		unsigned body;
+		double position[3];
+		double orientation[4];
+		double size[4];
+	};
+
+	enum SceneForceType
+	{
+		SCENE_GRAVITY,
+		SCENE_SPRING,
+		SCENE_BUOYANCY,
+		SCENE_AERO
+	};
+
+	/*
+		The force applies to the body. What the rest of the record
+		holds depends on the type:
+
+		gravity:	point is the acceleration.
+		spring:		point is on the body and otherPoint on the other
+					body, values are the spring constant and rest length.
+		buoyancy:	point is the centre of buoyancy, values are the
+					maximum depth, volume, water height and density.
+		aero:		point is the position of the surface and tensor
+					is its aerodynamic tensor.
+	*/
+	struct SceneForce
+	{
+		unsigned type;
+		unsigned body;
+		unsigned other;
+		unsigned padding;
+		double point[3];
+		double otherPoint[3];
+		double values[4];
+		double tensor[9];
+	};
+
+	struct SceneParticle
+	{
+		double position[3];
+		double velocity[3];
+		double acceleration[3];
+		double damping;
+		double inverseMass;
+	};
+
+	enum SceneLinkType
+	{
+		SCENE_CABLE,
+		SCENE_ROD,
+		SCENE_CABLE_CONSTRAINT,
+		SCENE_ROD_CONSTRAINT
+	};
+
+	/*
+		Cables and rods join two particles. The constraints join one
+		particle to the anchor.
+	*/
+	struct SceneLink
+	{
+		unsigned type;
+		unsigned particle[2];
+		unsigned padding;
+		double anchor[3];
+		double length;
+		double restitution;
+	};
+
+	struct SceneCloth
+	{
+		double width;
+		double height;
+		unsigned particlesWidth;
+		unsigned particlesHeight;
+		double origin[3];
+		unsigned selfCollision;
+		unsigned padding;
+		double thickness;
+	};
+
+	/*
+		Points at the records of a scene, wherever they are stored. The
+		counts are in the header.
+	*/
+	struct SceneData
+	{
+		SceneHeader header;
+		const SceneBody *bodies;
+		const ScenePrimitive *primitives;
+		const SceneForce *forces;
+		const SceneParticle *particles;
+		const SceneLink *links;
+		const SceneCloth *cloths;
+	};
+
+	// Holds the records of a scene in memory, for authoring and converting.
+	class SceneDescription
+	{
+	public:
+		std::vector<SceneBody> bodies;
+		std::vector<ScenePrimitive> primitives;
+		std::vector<SceneForce> forces;
+		std::vector<SceneParticle> particles;
+		std::vector<SceneLink> links;
+		std::vector<SceneCloth> cloths;
+
+	protected:
+		std::string error;
+
+	public:
+		void clear();
+
+		/*
+			Adds the objects described by the text to the description.
+
+			Each line holds one object, as its type followed by any
+			number of fields of the form name=value. Values with more
+			than one number are separated by commas. Fields that are left
+			out take sensible defaults. A # starts a comment.
+
+			body		mass (or inverseMass), inertia (three diagonal or
+						nine values, or inverseInertia), position,
+						orientation, velocity, rotation, acceleration,
+						damping (linear and angular), canSleep, awake
+			sphere		body, position, orientation, radius
+			box			body, position, orientation, halfSize
+			plane		normal, offset
+			gravity		body, gravity
+			spring		body, point, other, otherPoint, constant, length
+			buoyancy	body, centre, maxDepth, volume, waterHeight, density
+			aero		body, position, tensor
+			particle	mass (or inverseMass), position, velocity,
+						acceleration, damping
+			cable		particles, length, restitution
+			rod			particles, length
+			cable-constraint	particle, anchor, length, restitution
+			rod-constraint		particle, anchor, length
+			cloth		size, particles, origin, thickness, selfCollision
+
+			Returns false if the text can't be read, see getError().
+		*/
+		bool parseText(const char *text, size_t length);
+		bool loadText(const char *filename);
+
+		bool saveBinary(const char *filename) const;
+
+		// Returns a view of the records held.
+		SceneData getData() const;
+
+		const char* getError() const;
+
+		/*
+			Finds the records in a binary scene file held in memory.
+			Returns false if it isn't a complete scene file of this
+			version.
+		*/
+		static bool readBinary(const void *buffer, size_t size, SceneData *data);
+
+		// Returns whether the data starts like a binary scene file.
+		static bool isBinary(const void *buffer, size_t size);
+
+	protected:
+		bool parseLine(const char *line, const char *end, unsigned lineNumber);
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "sleep.h"
+#include "profiler.h"
+
+using namespace Physics_Engine;
+
+// Marks a body that isn't one of those being updated.
+static const unsigned noIsland = 0xffffffff;
+
+SleepSystem::SleepSystem(real timeToSleep)
+	: timeToSleep(timeToSleep), parents(0), islandCount(0),
+	awakeCount(0), sleepingCount(0)
+{
+
+}
+
+void SleepSystem::setTimeToSleep(real timeToSleep)
+{
+	SleepSystem::timeToSleep = timeToSleep;
+}
+
+real SleepSystem::getTimeToSleep() const
+{
+	return timeToSleep;
+}
+
+unsigned SleepSystem::getIslandCount() const
+{
+	return islandCount;
+}
+
+unsigned SleepSystem::getAwakeCount() const
+{
+	return awakeCount;
+}
+
+unsigned SleepSystem::getSleepingCount() const
+{
+	return sleepingCount;
+}
+
+unsigned SleepSystem::findRoot(unsigned index)
+{
+	unsigned root = index;
+	while (parents[root] != root)
+		root = parents[root];
+
+	// Point everything on the way straight at the root.
+	while (parents[index] != root)
+	{
+		unsigned next = parents[index];
+		parents[index] = root;
+		index = next;
+	}
+
+	return root;
+}
+
+void SleepSystem::join(unsigned one, unsigned two)
+{
+	one = findRoot(one);
+	two = findRoot(two);
+
+	/*
+		Always joining to the lower index keeps the roots, and so the
+		results, independent of the order of the contacts.
+	*/
+	if (one < two)
+		parents[two] = one;
+	else if (two < one)
+		parents[one] = two;
+}
+
+void SleepSystem::update(RigidBody *const *bodies, unsigned bodyCount,
+	const Contact *contacts, unsigned contactCount, Arena &arena)
+{
+	PROFILE_ZONE("SleepSystem::update");
+
+	parents = arena.allocateArray<unsigned>(bodyCount);
+
+	// The shortest sleep time in each island, and whether it is awake.
+	real *islandSleepTimes = arena.allocateArray<real>(bodyCount);
+	unsigned char *islandAwake = arena.allocateArray<unsigned char>(bodyCount);
+	unsigned char *islandAsleep = arena.allocateArray<unsigned char>(bodyCount);
+
+	for (unsigned i = 0; i < bodyCount; i++)
+	{
+		parents[i] = i;
+		islandSleepTimes[i] = REAL_MAX;
+		islandAwake[i] = 0;
+		islandAsleep[i] = 0;
+		bodies[i]->island = bodies[i]->getInverseMass() > 0 ? i : noIsland;
+	}
+
+	/*
+		A contact might refer to a body that isn't in the array, and so
+		has a stale island index, so the index is checked against the
+		array before it is trusted.
+	*/
+	for (unsigned c = 0; c < contactCount; c++)
+	{
+		const Contact &contact = contacts[c];
+		if (!contact.body[0] || !contact.body[1])
+			continue;
+
+		unsigned one = contact.body[0]->island;
+		unsigned two = contact.body[1]->island;
+		if (one >= bodyCount || bodies[one] != contact.body[0] ||
+			two >= bodyCount || bodies[two] != contact.body[1])
+			continue;
+
+		join(one, two);
+	}
+
+	// Gather the state of each island at its root.
+	for (unsigned i = 0; i < bodyCount; i++)
+	{
+		const RigidBody *body = bodies[i];
+		if (body->island == noIsland)
+			continue;
+
+		unsigned root = findRoot(i);
+
+		// A body that can't sleep keeps its whole island awake.
+		real sleepTime = body->getCanSleep() ? body->getSleepTime() : 0;
+		if (!body->getAwake())
+			sleepTime = REAL_MAX;
+
+		if (sleepTime < islandSleepTimes[root])
+			islandSleepTimes[root] = sleepTime;
+
+		if (body->getAwake())
+			islandAwake[root] = 1;
+		else
+			islandAsleep[root] = 1;
+	}
+
+	islandCount = 0;
+	for (unsigned i = 0; i < bodyCount; i++)
+	{
+		RigidBody *body = bodies[i];
+		if (body->island == noIsland)
+			continue;
+
+		unsigned root = findRoot(i);
+		if (root == i)
+			islandCount++;
+
+		// An island that is entirely asleep stays that way.
+		if (!islandAwake[root])
+			continue;
+
+		if (islandSleepTimes[root] >= timeToSleep)
+		{
+			if (body->getAwake())
+				body->setAwake(false);
+		}
+		else if (islandAsleep[root] && !body->getAwake())
+		{
+			// Something has touched a sleeping part of the island.
+			body->setAwake();
+		}
+	}
+
+	awakeCount = 0;
+	for (unsigned i = 0; i < bodyCount; i++)
+	{
+		if (bodies[i]->getAwake())
+			awakeCount++;
+	}
+	sleepingCount = bodyCount - awakeCount;
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef SLEEP_H
+#define SLEEP_H
+
+#include "../Collision/contacts.h"
+#include "arena.h"
+
+namespace Physics_Engine
+{
+	/*
+		Decides when bodies go to sleep. Bodies touching each other
+		(directly or through other bodies) form an island, and the
+		bodies of an island sleep and wake together. A body on top of a
+		stack can't fall asleep while the body under it is still
+		moving, and a body that is knocked wakes everything it rests
+		on, so stacks neither sink nor hang in the air.
+
+		An island is put to sleep once every body in it has been still
+		for the time to sleep. Bodies that can't move (with an inverse
+		mass of zero) don't join islands, so the ground doesn't join
+		everything on it into a single island.
+
+		This should be called once per step, after the contacts are
+		resolved and the bodies integrated.
+	*/
+	class SleepSystem
+	{
+	protected:
+		real timeToSleep;
+
+		/*
+			The island each body belongs to, as a disjoint set forest
+			over the bodies' indices. It is only valid during an update.
+		*/
+		unsigned *parents;
+
+		unsigned islandCount;
+
+		// Holds the number of bodies left awake and asleep by the last update.
+		unsigned awakeCount;
+		unsigned sleepingCount;
+
+	public:
+		SleepSystem(real timeToSleep = 0.5);
+
+		void setTimeToSleep(real timeToSleep);
+		real getTimeToSleep() const;
+
+		/*
+			Builds the islands from the contacts of the last step and
+			puts them to sleep or wakes them. Contacts may refer to bodies
+			that aren't in the array, which are treated like the world.
+			The working space comes from the step's arena.
+		*/
+		void update(RigidBody *const *bodies, unsigned bodyCount,
+			const Contact *contacts, unsigned contactCount, Arena &arena);
+
+		// Returns the number of islands found by the last update.
+		unsigned getIslandCount() const;
+
+		unsigned getAwakeCount() const;
+		unsigned getSleepingCount() const;
+
+	protected:
+		unsigned findRoot(unsigned index);
+		void join(unsigned one, unsigned two);
+	};
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,401 @@
+#include "snapshot.h"
+#include <string.h>
+
+using namespace Physics_Engine;
+
+// The characters PESS (Physics Engine SnapShot).
+static const unsigned snapshotMagic = 0x53534550;
+
+void Snapshot::Writer::put(const void *data, unsigned bytes)
+{
+	if (buffer)
+		memcpy(buffer + size, data, bytes);
+	size += bytes;
+}
+
+void Snapshot::Reader::get(void *data, unsigned bytes)
+{
+	if (offset + bytes > size)
+	{
+		failed = true;
+		return;
+	}
+
+	memcpy(data, buffer + offset, bytes);
+	offset += bytes;
+}
+
+void Snapshot::Reader::skip(unsigned bytes)
+{
+	if (offset + bytes > size)
+	{
+		failed = true;
+		return;
+	}
+
+	offset += bytes;
+}
+
+Snapshot::Snapshot()
+	: bodies(0), bodyCount(0), particles(0), particleCount(0), cloths(0), clothCount(0)
+{
+
+}
+
+void Snapshot::setBodies(RigidBody *const *bodies, unsigned count)
+{
+	Snapshot::bodies = bodies;
+	bodyCount = count;
+}
+
+void Snapshot::setParticles(Particle *const *particles, unsigned count)
+{
+	Snapshot::particles = particles;
+	particleCount = count;
+}
+
+void Snapshot::setCloths(Cloth *const *cloths, unsigned count)
+{
+	Snapshot::cloths = cloths;
+	clothCount = count;
+}
+
+unsigned Snapshot::getSize() const
+{
+	Writer counter(0);
+	write(counter);
+	return counter.size;
+}
+
+unsigned Snapshot::save(void *buffer, unsigned capacity) const
+{
+	unsigned size = getSize();
+	if (capacity < size)
+		return 0;
+
+	Writer writer((unsigned char *)buffer);
+	write(writer);
+	return writer.size;
+}
+
+bool Snapshot::restore(const void *buffer, unsigned size) const
+{
+	/*
+		Everything is checked before anything is changed, so a bad
+		snapshot leaves the objects as they were.
+	*/
+	if (!check((const unsigned char *)buffer, size))
+		return false;
+
+	Reader reader((const unsigned char *)buffer, size);
+	read(reader);
+	return !reader.failed;
+}
+
+void Snapshot::write(Writer &writer) const
+{
+	Header header;
+	header.magic = snapshotMagic;
+	header.version = SNAPSHOT_VERSION;
+	header.size = 0;
+	header.bodyCount = bodyCount;
+	header.particleCount = particleCount;
+	header.clothCount = clothCount;
+
+	/*
+		The size isn't known until everything is written, so it is
+		filled in at the end.
+	*/
+	unsigned start = writer.size;
+	writer.put(&header, sizeof(header));
+
+	for (unsigned i = 0; i < bodyCount; i++)
+		writeBody(writer, *bodies[i]);
+
+	for (unsigned i = 0; i < particleCount; i++)
+		writeParticle(writer, *particles[i]);
+
+	for (unsigned i = 0; i < clothCount; i++)
+		writeCloth(writer, *cloths[i]);
+
+	if (writer.buffer)
+	{
+		header.size = writer.size - start;
+		memcpy(writer.buffer + start, &header, sizeof(header));
+	}
+}
+
+bool Snapshot::check(const unsigned char *buffer, unsigned size) const
+{
+	if (!buffer || size < sizeof(Header))
+		return false;
+
+	Header header;
+	memcpy(&header, buffer, sizeof(header));
+
+	if (header.magic != snapshotMagic || header.version != SNAPSHOT_VERSION)
+		return false;
+
+	if (header.bodyCount != bodyCount || header.particleCount != particleCount ||
+		header.clothCount != clothCount)
+		return false;
+
+	if (header.size != getSize() || header.size > size)
+		return false;
+
+	/*
+		The bodies and particles are a fixed size, so only the cloths
+		need to be walked, to check the counts and constraints that
+		readCloth relies on.
+	*/
+	Writer counter(0);
+	counter.put(&header, sizeof(header));
+	for (unsigned i = 0; i < bodyCount; i++)
+		writeBody(counter, *bodies[i]);
+	for (unsigned i = 0; i < particleCount; i++)
+		writeParticle(counter, *particles[i]);
+
+	Reader reader(buffer, header.size);
+	reader.skip(counter.size);
+
+	for (unsigned i = 0; i < clothCount; i++)
+	{
+		if (!checkCloth(reader, *cloths[i]))
+			return false;
+	}
+
+	return !reader.failed;
+}
+
+void Snapshot::read(Reader &reader) const
+{
+	Header header;
+	reader.get(&header, sizeof(header));
+
+	for (unsigned i = 0; i < bodyCount; i++)
+		readBody(reader, *bodies[i]);
+
+	for (unsigned i = 0; i < particleCount; i++)
+		readParticle(reader, *particles[i]);
+
+	for (unsigned i = 0; i < clothCount; i++)
+		readCloth(reader, *cloths[i]);
+}
+
+/*
+	The derived data (the transform and the world inertia tensor) is
+	saved as well as the state it comes from, as recalculating it would
+	also renormalise the orientation and change its bits.
+*/
+void Snapshot::writeBody(Writer &writer, const RigidBody &body)
+{
+	writer.put(&body.id, sizeof(body.id));
+	writer.put(&body.inverseMass, sizeof(body.inverseMass));
+	writer.put(&body.inverseInertiaTensor, sizeof(body.inverseInertiaTensor));
+	writer.put(&body.linearDamping, sizeof(body.linearDamping));
+	writer.put(&body.angularDamping, sizeof(body.angularDamping));
+	writer.put(&body.position, sizeof(body.position));
+	writer.put(&body.orientation, sizeof(body.orientation));
+	writer.put(&body.velocity, sizeof(body.velocity));
+	writer.put(&body.rotation, sizeof(body.rotation));
+	writer.put(&body.inverseInertiaTensorWorld, sizeof(body.inverseInertiaTensorWorld));
+	writer.put(&body.isAwake, sizeof(body.isAwake));
+	writer.put(&body.canSleep, sizeof(body.canSleep));
+	writer.put(&body.motion, sizeof(body.motion));
+	writer.put(&body.sleepEpsolion, sizeof(body.sleepEpsolion));
+	writer.put(&body.sleepTime, sizeof(body.sleepTime));
+	writer.put(&body.transformMatrix, sizeof(body.transformMatrix));
+	writer.put(&body.isDirty, sizeof(body.isDirty));
+	writer.put(&body.forceAccum, sizeof(body.forceAccum));
+	writer.put(&body.torqueAccum, sizeof(body.torqueAccum));
+	writer.put(&body.acceleration, sizeof(body.acceleration));
+	writer.put(&body.lastFrameAcceleration, sizeof(body.lastFrameAcceleration));
+	writer.put(&body.previousPosition, sizeof(body.previousPosition));
+	writer.put(&body.previousOrientation, sizeof(body.previousOrientation));
+}
+
+void Snapshot::readBody(Reader &reader, RigidBody &body)
+{
+	reader.get(&body.id, sizeof(body.id));
+	reader.get(&body.inverseMass, sizeof(body.inverseMass));
+	reader.get(&body.inverseInertiaTensor, sizeof(body.inverseInertiaTensor));
+	reader.get(&body.linearDamping, sizeof(body.linearDamping));
+	reader.get(&body.angularDamping, sizeof(body.angularDamping));
+	reader.get(&body.position, sizeof(body.position));
+	reader.get(&body.orientation, sizeof(body.orientation));
+	reader.get(&body.velocity, sizeof(body.velocity));
+	reader.get(&body.rotation, sizeof(body.rotation));
+	reader.get(&body.inverseInertiaTensorWorld, sizeof(body.inverseInertiaTensorWorld));
+	reader.get(&body.isAwake, sizeof(body.isAwake));
+	reader.get(&body.canSleep, sizeof(body.canSleep));
+	reader.get(&body.motion, sizeof(body.motion));
+	reader.get(&body.sleepEpsolion, sizeof(body.sleepEpsolion));
+	reader.get(&body.sleepTime, sizeof(body.sleepTime));
+	reader.get(&body.transformMatrix, sizeof(body.transformMatrix));
+	reader.get(&body.isDirty, sizeof(body.isDirty));
+	reader.get(&body.forceAccum, sizeof(body.forceAccum));
+	reader.get(&body.torqueAccum, sizeof(body.torqueAccum));
+	reader.get(&body.acceleration, sizeof(body.acceleration));
+	reader.get(&body.lastFrameAcceleration, sizeof(body.lastFrameAcceleration));
+	reader.get(&body.previousPosition, sizeof(body.previousPosition));
+	reader.get(&body.previousOrientation, sizeof(body.previousOrientation));
+
+	/*
+		The derived data is restored as it was, so a body saved before
+		its derived data was brought up to date is still dirty. Either
+		way, primitives have to see that it has changed.
+	*/
+	if (++body.transformVersion == 0)
+		body.transformVersion = 1;
+}
+
+void Snapshot::writeParticle(Writer &writer, const Particle &particle)
+{
+	writer.put(&particle.position, sizeof(particle.position));
+	writer.put(&particle.oldPosition, sizeof(particle.oldPosition));
+	writer.put(&particle.velocity, sizeof(particle.velocity));
+	writer.put(&particle.acceleration, sizeof(particle.acceleration));
+	writer.put(&particle.normal, sizeof(particle.normal));
+	writer.put(&particle.damping, sizeof(particle.damping));
+	writer.put(&particle.inverseMass, sizeof(particle.inverseMass));
+	writer.put(&particle.forceAccum, sizeof(particle.forceAccum));
+	writer.put(&particle.movable, sizeof(particle.movable));
+}
+
+void Snapshot::readParticle(Reader &reader, Particle &particle)
+{
+	reader.get(&particle.position, sizeof(particle.position));
+	reader.get(&particle.oldPosition, sizeof(particle.oldPosition));
+	reader.get(&particle.velocity, sizeof(particle.velocity));
+	reader.get(&particle.acceleration, sizeof(particle.acceleration));
+	reader.get(&particle.normal, sizeof(particle.normal));
+	reader.get(&particle.damping, sizeof(particle.damping));
+	reader.get(&particle.inverseMass, sizeof(particle.inverseMass));
+	reader.get(&particle.forceAccum, sizeof(particle.forceAccum));
+	reader.get(&particle.movable, sizeof(particle.movable));
+}
+
+/*
+	The cloth's constraints are saved as the indices of their particles
+	and their rest lengths. The positions are saved and the spatial hash
+	is rebuilt from them (it is built again at the start of every step
+	anyway), the normals are saved as they were last worked out.
+*/
+void Snapshot::writeCloth(Writer &writer, const Cloth &cloth)
+{
+	unsigned counts[4];
+	counts[0] = (unsigned)cloth.particles.size();
+	counts[1] = (unsigned)cloth.constraints.size();
+	counts[2] = (unsigned)cloth.positions.size();
+	counts[3] = (unsigned)cloth.triangleNormals.size();
+	writer.put(counts, sizeof(counts));
+
+	for (unsigned i = 0; i < counts[0]; i++)
+		writeParticle(writer, cloth.particles[i]);
+
+	const Particle *first = counts[0] ? &cloth.particles[0] : 0;
+	for (unsigned i = 0; i < counts[1]; i++)
+	{
+		const Constraint &constraint = cloth.constraints[i];
+		unsigned index[2] = { (unsigned)(constraint.p1 - first), (unsigned)(constraint.p2 - first) };
+		writer.put(index, sizeof(index));
+		writer.put(&constraint.rest_distance, sizeof(constraint.rest_distance));
+	}
+
+	if (counts[2])
+	{
+		writer.put(&cloth.positions[0], counts[2] * sizeof(Vector3));
+		writer.put(&cloth.normals[0], counts[0] * sizeof(Vector3));
+	}
+	if (counts[3])
+		writer.put(&cloth.triangleNormals[0], counts[3] * sizeof(Vector3));
+
+	writer.put(&cloth.boundsMin, sizeof(cloth.boundsMin));
+	writer.put(&cloth.boundsMax, sizeof(cloth.boundsMax));
+	writer.put(&cloth.selfCollisionEnabled, sizeof(cloth.selfCollisionEnabled));
+	writer.put(&cloth.thickness, sizeof(cloth.thickness));
+}
+
+void Snapshot::readCloth(Reader &reader, Cloth &cloth)
+{
+	unsigned counts[4];
+	reader.get(counts, sizeof(counts));
+
+	// The shape of the cloth and its constraints were checked by checkCloth.
+	for (unsigned i = 0; i < counts[0]; i++)
+		readParticle(reader, cloth.particles[i]);
+
+	Particle *first = counts[0] ? &cloth.particles[0] : 0;
+	for (unsigned i = 0; i < counts[1]; i++)
+	{
+		Constraint &constraint = cloth.constraints[i];
+		unsigned index[2];
+		reader.get(index, sizeof(index));
+		reader.get(&constraint.rest_distance, sizeof(constraint.rest_distance));
+
+		constraint.p1 = first + index[0];
+		constraint.p2 = first + index[1];
+	}
+
+	if (counts[2])
+	{
+		reader.get(&cloth.positions[0], counts[2] * sizeof(Vector3));
+		reader.get(&cloth.normals[0], counts[0] * sizeof(Vector3));
+	}
+	if (counts[3])
+		reader.get(&cloth.triangleNormals[0], counts[3] * sizeof(Vector3));
+
+	reader.get(&cloth.boundsMin, sizeof(cloth.boundsMin));
+	reader.get(&cloth.boundsMax, sizeof(cloth.boundsMax));
+	reader.get(&cloth.selfCollisionEnabled, sizeof(cloth.selfCollisionEnabled));
+	reader.get(&cloth.thickness, sizeof(cloth.thickness));
+
+	// The cell size depends on the thickness, as in Cloth::updateSpatialHash.
+	real cellSize = cloth.particleSpacing;
+	if (cellSize < cloth.thickness * 2)
+		cellSize = cloth.thickness * 2;
+	cloth.particleHash.setCellSize(cellSize);
+
+	if (counts[2])
+		cloth.particleHash.build(&cloth.positions[0], counts[2]);
+}
+
+bool Snapshot::checkCloth(Reader &reader, const Cloth &cloth)
+{
+	unsigned counts[4];
+	reader.get(counts, sizeof(counts));
+	if (reader.failed)
+		return false;
+
+	if (counts[0] != cloth.particles.size() || counts[1] != cloth.constraints.size() ||
+		counts[2] != cloth.positions.size() || counts[3] != cloth.triangleNormals.size())
+		return false;
+
+	// The normals are saved with the positions, one for each particle.
+	if (counts[2] && cloth.normals.size() < counts[0])
+		return false;
+
+	if (counts[0])
+	{
+		Writer counter(0);
+		writeParticle(counter, cloth.particles[0]);
+		reader.skip(counts[0] * counter.size);
+	}
+
+	for (unsigned i = 0; i < counts[1]; i++)
+	{
+		unsigned index[2];
+		reader.get(index, sizeof(index));
+		reader.skip(sizeof(cloth.constraints[i].rest_distance));
+		if (reader.failed || index[0] >= counts[0] || index[1] >= counts[0])
+			return false;
+	}
+
+	if (counts[2])
+		reader.skip((counts[2] + counts[0]) * sizeof(Vector3));
+	reader.skip(counts[3] * sizeof(Vector3));
+
+	reader.skip(sizeof(cloth.boundsMin) + sizeof(cloth.boundsMax) +
+		sizeof(cloth.selfCollisionEnabled) + sizeof(cloth.thickness));
+	return !reader.failed;
+}
\ No newline at end of file
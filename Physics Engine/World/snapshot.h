@@ -0,0 +1,120 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "../Dynamics/body.h"
+#include "../Dynamics/particle.h"
+#include "../Dynamics/cloth.h"
+
+namespace Physics_Engine
+{
+	// Changes whenever the layout of a snapshot changes.
+#define SNAPSHOT_VERSION 3
+
+	/*
+		Saves the complete state of a set of bodies, particles and
+		cloths into a single block of memory, and restores it again, for
+		checkpoints and for forking runs. Everything that affects the next
+		step is saved bit for bit, so a restored simulation carries on
+		exactly as the original would have.
+
+		A snapshot is restored into the same objects it was taken from
+		(or objects set up the same way), nothing is allocated. The data
+		is in the native byte order of the machine. Collision primitives
+		aren't saved, so calculateInternals should be called on them
+		after a restore.
+
+		The contact resolvers don't keep anything between steps, so
+		there is no solver state to save.
+	*/
+	class Snapshot
+	{
+	protected:
+		// Holds the start of every snapshot.
+		struct Header
+		{
+			unsigned magic;
+			unsigned version;
+			unsigned size;
+			unsigned bodyCount;
+			unsigned particleCount;
+			unsigned clothCount;
+		};
+
+		// Copies the data into a buffer, or only counts it if there is no buffer.
+		class Writer
+		{
+		public:
+			unsigned char *buffer;
+			unsigned size;
+
+			Writer(unsigned char *buffer) : buffer(buffer), size(0) {}
+			void put(const void *data, unsigned bytes);
+		};
+
+		class Reader
+		{
+		public:
+			const unsigned char *buffer;
+			unsigned size;
+			unsigned offset;
+			bool failed;
+
+			Reader(const unsigned char *buffer, unsigned size)
+				: buffer(buffer), size(size), offset(0), failed(false) {}
+			void get(void *data, unsigned bytes);
+
+			// Moves past the given number of bytes without reading them.
+			void skip(unsigned bytes);
+		};
+
+		RigidBody *const *bodies;
+		unsigned bodyCount;
+		Particle *const *particles;
+		unsigned particleCount;
+		Cloth *const *cloths;
+		unsigned clothCount;
+
+	public:
+		Snapshot();
+
+		// Sets the objects the snapshot covers.
+		void setBodies(RigidBody *const *bodies, unsigned count);
+		void setParticles(Particle *const *particles, unsigned count);
+		void setCloths(Cloth *const *cloths, unsigned count);
+
+		// Returns the number of bytes a snapshot of the objects takes.
+		unsigned getSize() const;
+
+		/*
+			Writes a snapshot into the buffer. Returns the number of bytes
+			written, or zero if the buffer is too small.
+		*/
+		unsigned save(void *buffer, unsigned capacity) const;
+
+		/*
+			Restores the objects from a snapshot. Returns false, having
+			changed nothing, if the snapshot is from a different version
+			or for a different set of objects.
+		*/
+		bool restore(const void *buffer, unsigned size) const;
+
+	protected:
+		void write(Writer &writer) const;
+		bool check(const unsigned char *buffer, unsigned size) const;
+		void read(Reader &reader) const;
+
+		static void writeBody(Writer &writer, const RigidBody &body);
+		static void readBody(Reader &reader, RigidBody &body);
+		static void writeParticle(Writer &writer, const Particle &particle);
+		static void readParticle(Reader &reader, Particle &particle);
+		static void writeCloth(Writer &writer, const Cloth &cloth);
+		static void readCloth(Reader &reader, Cloth &cloth);
+
+		/*
+			Checks that a saved cloth has the shape of the given one, and
+			that all its constraints join particles of the cloth.
+		*/
+		static bool checkCloth(Reader &reader, const Cloth &cloth);
+	};
+}
+#endif
\ No newline at end of file
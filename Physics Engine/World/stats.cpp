@@ -0,0 +1,153 @@
+#include "stats.h"
+#include "profiler.h"
+#include <string.h>
+
+using namespace Physics_Engine;
+
+StepStats::StepStats()
+	: step(0)
+{
+	clear();
+}
+
+void StepStats::clear()
+{
+	bodies = broadphasePairs = filteredPairs = 0;
+	for (unsigned i = 0; i < COLLISION_PAIR_TYPES; i++)
+		pairTests[i] = pairHits[i] = 0;
+
+	contactsGenerated = contactsDropped = 0;
+	velocityIterations = positionIterations = 0;
+	residualPenetration = residualVelocity = 0;
+	budgetsExhausted = 0;
+	awakeBodies = sleepingBodies = islands = 0;
+
+	for (unsigned i = 0; i < STEP_STAGES; i++)
+		stageTimes[i] = 0;
+	stepTime = 0;
+}
+
+void StepStats::addCollisionData(const CollisionData &data)
+{
+	for (unsigned i = 0; i < COLLISION_PAIR_TYPES; i++)
+	{
+		pairTests[i] += data.pairTests[i];
+		pairHits[i] += data.pairHits[i];
+	}
+
+	contactsGenerated += data.contactCount;
+	contactsDropped += data.droppedTests;
+}
+
+void StepStats::addResolver(const ContactResolver &resolver)
+{
+	velocityIterations += resolver.velocityIterationsUsed;
+	positionIterations += resolver.positionIterationsUsed;
+	if (resolver.wasBudgetExhausted())
+		budgetsExhausted++;
+
+	if (resolver.residualPenetration > residualPenetration)
+		residualPenetration = resolver.residualPenetration;
+	if (resolver.residualVelocity > residualVelocity)
+		residualVelocity = resolver.residualVelocity;
+}
+
+void StepStats::addResolver(const ParticleContactResolver &resolver)
+{
+	velocityIterations += resolver.getIterationsUsed();
+	if (resolver.wasBudgetExhausted())
+		budgetsExhausted++;
+
+	if (resolver.getResidualPenetration() > residualPenetration)
+		residualPenetration = resolver.getResidualPenetration();
+	if (resolver.getResidualVelocity() > residualVelocity)
+		residualVelocity = resolver.getResidualVelocity();
+}
+
+void StepStats::addSleepSystem(const SleepSystem &sleepSystem)
+{
+	awakeBodies += sleepSystem.getAwakeCount();
+	sleepingBodies += sleepSystem.getSleepingCount();
+	islands += sleepSystem.getIslandCount();
+}
+
+real StepStats::getHitRate(CollisionPairType type) const
+{
+	if (pairTests[type] == 0)
+		return 0;
+
+	return (real)pairHits[type] / (real)pairTests[type];
+}
+
+
+StepStatsChannel::StepStatsChannel()
+	: sequence(0)
+{
+	for (unsigned i = 0; i < words; i++)
+		data[i].store(0, std::memory_order_relaxed);
+}
+
+void StepStatsChannel::publish(const StepStats &stats)
+{
+	uint64_t buffer[words] = {0};
+	memcpy(buffer, &stats, sizeof(StepStats));
+
+	// An odd sequence number tells the readers a copy is under way.
+	unsigned start = sequence.load(std::memory_order_relaxed);
+	sequence.store(start + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (unsigned i = 0; i < words; i++)
+		data[i].store(buffer[i], std::memory_order_relaxed);
+
+	sequence.store(start + 2, std::memory_order_release);
+}
+
+bool StepStatsChannel::read(StepStats &stats) const
+{
+	uint64_t buffer[words];
+
+	for (;;)
+	{
+		unsigned start = sequence.load(std::memory_order_acquire);
+		if (start == 0)
+			return false;
+
+		// The writer is part way through, so its copy can't be used.
+		if (start & 1)
+			continue;
+
+		for (unsigned i = 0; i < words; i++)
+			buffer[i] = data[i].load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence.load(std::memory_order_relaxed) == start)
+			break;
+	}
+
+	memcpy(&stats, buffer, sizeof(StepStats));
+	return true;
+}
+
+
+StageTimer::StageTimer(StepStats &stats)
+	: stats(&stats)
+{
+	stats.clear();
+	stats.step++;
+
+	start = last = Profiler::now();
+}
+
+void StageTimer::lap(StepStage stage)
+{
+	uint64_t now = Profiler::now();
+	stats->stageTimes[stage] += (now - last) * 1e-9;
+	last = now;
+}
+
+void StageTimer::finish()
+{
+	last = Profiler::now();
+	stats->stepTime = (last - start) * 1e-9;
+}
\ No newline at end of file
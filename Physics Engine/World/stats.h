@@ -0,0 +1,149 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "../Collision/NarrowPhase.h"
+#include "../Dynamics/pcontacts.h"
+#include "sleep.h"
+#include <stdint.h>
+#include <atomic>
+
+namespace Physics_Engine
+{
+	// The stages of a step that are timed.
+	enum StepStage
+	{
+		STAGE_BROADPHASE,
+		STAGE_NARROWPHASE,
+		STAGE_RESOLUTION,
+		STAGE_INTEGRATION,
+		STAGE_SLEEP,
+		STEP_STAGES
+	};
+
+	/*
+		Holds what happened during one step: how many pairs were
+		found and tested, how many contacts came of them, how well the
+		resolver did with them and how long each stage took. Counts
+		that don't apply to a world (such as sleeping bodies in a
+		particle world) are left at zero.
+	*/
+	struct StepStats
+	{
+		// Holds the number of the step, counting from one.
+		uint64_t step;
+
+		unsigned bodies;
+
+		/*
+			Holds the number of pairs the broadphase passed on to be
+			tested, and the number of those the collision filter removed.
+		*/
+		unsigned broadphasePairs;
+		unsigned filteredPairs;
+
+		// Holds the pairs of each type tested, and how many made contacts.
+		unsigned pairTests[COLLISION_PAIR_TYPES];
+		unsigned pairHits[COLLISION_PAIR_TYPES];
+
+		/*
+			Holds the number of contacts made, and the number of tests
+			whose contacts were lost because there was no room for them.
+		*/
+		unsigned contactsGenerated;
+		unsigned contactsDropped;
+
+		/*
+			Holds the iterations the resolver took. Particle resolvers
+			only have one kind of iteration, which is counted as velocity.
+		*/
+		unsigned velocityIterations;
+		unsigned positionIterations;
+
+		// Holds how far from resolved the contacts were left.
+		real residualPenetration;
+		real residualVelocity;
+
+		// Holds the number of resolvers that stopped because they ran out of time.
+		unsigned budgetsExhausted;
+
+		unsigned awakeBodies;
+		unsigned sleepingBodies;
+		unsigned islands;
+
+		// Holds the time spent in each stage and in the whole step, in seconds.
+		double stageTimes[STEP_STAGES];
+		double stepTime;
+
+		StepStats();
+
+		// Sets everything but the step number to zero.
+		void clear();
+
+		// Adds the counts of the contacts generated into the data.
+		void addCollisionData(const CollisionData &data);
+
+		// Takes the iterations and residuals of the last resolution.
+		void addResolver(const ContactResolver &resolver);
+		void addResolver(const ParticleContactResolver &resolver);
+
+		// Takes the body counts of the last sleep update.
+		void addSleepSystem(const SleepSystem &sleepSystem);
+
+		// Returns the fraction of the pairs of the given type that made contacts.
+		real getHitRate(CollisionPairType type) const;
+	};
+
+	/*
+		Passes the stats of each step from the thread running the
+		simulation to any number of threads reading them (such as
+		telemetry, or something tuning the iteration budgets), without
+		locks. It is a sequence lock: the writer bumps the sequence
+		number before and after copying the stats in, and a reader
+		tries again if the number was odd or changed while it copied
+		them out. Writing never waits, so the step is never held up by
+		a slow reader.
+
+		There must only be one writer.
+	*/
+	class StepStatsChannel
+	{
+	protected:
+		const static unsigned words = (sizeof(StepStats) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+		std::atomic<unsigned> sequence;
+		std::atomic<uint64_t> data[words];
+
+	public:
+		StepStatsChannel();
+
+		void publish(const StepStats &stats);
+
+		/*
+			Copies the latest stats published. Returns false, leaving the
+			stats alone, if none have been published yet.
+		*/
+		bool read(StepStats &stats) const;
+	};
+
+	/*
+		Times the stages of a step. Each call to lap adds the time
+		since the last one to the given stage.
+	*/
+	class StageTimer
+	{
+	protected:
+		StepStats *stats;
+		uint64_t start;
+		uint64_t last;
+
+	public:
+		// Starts timing the next step, clearing the stats for it.
+		StageTimer(StepStats &stats);
+
+		void lap(StepStage stage);
+
+		// Records the time of the whole step.
+		void finish();
+	};
+}
+#endif
\ No newline at end of file
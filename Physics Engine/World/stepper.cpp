@@ -0,0 +1,80 @@
+#include "stepper.h"
+#include <assert.h>
+
+using namespace Physics_Engine;
+
+FixedStepper::FixedStepper(real stepSize, unsigned maxSubsteps)
+	: maxSubsteps(maxSubsteps)
+{
+	setStepSize(stepSize);
+	reset();
+}
+
+void FixedStepper::setStepSize(real stepSize)
+{
+	assert(stepSize > 0);
+	FixedStepper::stepSize = stepSize;
+}
+
+real FixedStepper::getStepSize() const
+{
+	return stepSize;
+}
+
+void FixedStepper::setMaxSubsteps(unsigned maxSubsteps)
+{
+	FixedStepper::maxSubsteps = maxSubsteps;
+}
+
+unsigned FixedStepper::getMaxSubsteps() const
+{
+	return maxSubsteps;
+}
+
+void FixedStepper::reset()
+{
+	accumulator = 0;
+	droppedTime = 0;
+	stepCount = 0;
+}
+
+unsigned FixedStepper::advance(real frameTime)
+{
+	if (frameTime > 0)
+		accumulator += frameTime;
+
+	unsigned steps = 0;
+	while (accumulator >= stepSize && steps < maxSubsteps)
+	{
+		accumulator -= stepSize;
+		steps++;
+	}
+
+	/*
+		If there is still a whole step owed the cap was hit, so the
+		rest is dropped rather than carried into the next frame.
+	*/
+	if (accumulator >= stepSize)
+	{
+		droppedTime += accumulator;
+		accumulator = 0;
+	}
+
+	stepCount += steps;
+	return steps;
+}
+
+real FixedStepper::getAlpha() const
+{
+	return accumulator / stepSize;
+}
+
+real FixedStepper::getDroppedTime() const
+{
+	return droppedTime;
+}
+
+unsigned FixedStepper::getStepCount() const
+{
+	return stepCount;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef STEPPER_H
+#define STEPPER_H
+
+#include "../Math/core.h"
+
+namespace Physics_Engine
+{
+	/*
+		Turns the variable time between frames into a whole number of
+		fixed size simulation steps. The time left over is kept for the
+		next frame, and is given as a fraction of a step so the renderer
+		can interpolate between the last two simulated states.
+
+		The number of steps per frame is capped, so a slow frame can't
+		make the following frames slower still. Time beyond the cap is
+		dropped and the simulation runs slower than real time instead.
+	*/
+	class FixedStepper
+	{
+	protected:
+		real stepSize;
+		unsigned maxSubsteps;
+
+		// Holds the simulated time owed that is less than one step.
+		real accumulator;
+
+		// Holds the total time dropped because of the substep cap.
+		real droppedTime;
+
+		// Holds the number of steps taken since the stepper was reset.
+		unsigned stepCount;
+
+	public:
+		FixedStepper(real stepSize = ((real)1.0) / 60, unsigned maxSubsteps = 5);
+
+		void setStepSize(real stepSize);
+		real getStepSize() const;
+		void setMaxSubsteps(unsigned maxSubsteps);
+		unsigned getMaxSubsteps() const;
+
+		// Clears the accumulated and dropped time.
+		void reset();
+
+		/*
+			Adds the time taken by the last frame and returns the number
+			of steps (each getStepSize() long) the simulation should
+			now take.
+		*/
+		unsigned advance(real frameTime);
+
+		/*
+			Returns how far the real time is between the last step and
+			the next one, from 0 to 1. Rendering previous * (1 - alpha) +
+			current * alpha gives smooth motion at any frame rate.
+		*/
+		real getAlpha() const;
+
+		real getDroppedTime() const;
+		unsigned getStepCount() const;
+	};
+}
+#endif
\ No newline at end of file